@@ -0,0 +1,542 @@
+/*
+standalone microbenchmark of the SIMD scanning, built without the server by "python3 build.sh benchmark",
+the parsers are copied here because the server objects need the whole server to link:
+the baseline functions are the std::string::find calls and the char-by-char loops used before simd_scan,
+the current functions follow http_parser.cpp and helper_functions.cpp and scan with the implementations selected for the CPU
+*/
+
+#include "../simd_scan.h"
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+
+//the bytes scanned by each measurement, enough to hide the timer resolution
+#define SIMD_BENCHMARK_BYTES (256ULL * 1024 * 1024)
+
+#define SIMD_BENCHMARK_UPLOAD_SIZE (16 * 1024 * 1024)
+
+#define SIMD_BENCHMARK_BOUNDARY "----WebKitFormBoundary7MA4YWxkTrZu0gW"
+
+//the result of every call is summed, so the compiler can not drop the scans
+static volatile uint64_t benchmark_sink;
+
+static const signed char benchmark_hex_charset[256] = {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+													   -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+													   -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0,
+													   1, 2, 3, 4, 5, 6, 7, 8, 9, -1, -1, -1, -1, -1, -1, -1,
+													   10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+													   -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+													   10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+													   -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+													   -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+													   -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+													   -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+													   -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+													   -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+													   -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+													   -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+													   -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1};
+
+//a request captured from a desktop browser submitting a search form
+static const char benchmark_browser_request[] =
+	"GET /search?q=fast+http+server%20benchmark&category=software&sort=relevance&page=2&lang=en-US&utm_source=newsletter&utm_medium=email&utm_campaign=autumn_2026 HTTP/1.1\r\n"
+	"Host: www.example.com\r\n"
+	"Connection: keep-alive\r\n"
+	"sec-ch-ua: \"Chromium\";v=\"128\", \"Not;A=Brand\";v=\"24\", \"Google Chrome\";v=\"128\"\r\n"
+	"sec-ch-ua-mobile: ?0\r\n"
+	"sec-ch-ua-platform: \"Linux\"\r\n"
+	"Upgrade-Insecure-Requests: 1\r\n"
+	"User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/128.0.0.0 Safari/537.36\r\n"
+	"Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,image/apng,*/*;q=0.8,application/signed-exchange;v=b3;q=0.7\r\n"
+	"Sec-Fetch-Site: same-origin\r\n"
+	"Sec-Fetch-Mode: navigate\r\n"
+	"Sec-Fetch-User: ?1\r\n"
+	"Sec-Fetch-Dest: document\r\n"
+	"Referer: https://www.example.com/search?q=fast+http+server&category=software\r\n"
+	"Accept-Encoding: gzip, deflate, br, zstd\r\n"
+	"Accept-Language: en-US,en;q=0.9,de;q=0.8,fr;q=0.7,ro;q=0.6\r\n"
+	"Cookie: _ga=GA1.1.1432517624.1727795911; _ga_5XK2QHZ1QW=GS1.1.1729171262.14.1.1729172038.0.0.0; "
+	"session_id=7c0f3a9e2b5d4e81a6f0c9b3d2e1f4a5; csrftoken=Qm8vT2xZ3kPj9RwHs4LcN6fDy1AeUbXo; "
+	"cart=%7B%22items%22%3A%5B%7B%22id%22%3A4815%2C%22qty%22%3A2%7D%2C%7B%22id%22%3A162342%2C%22qty%22%3A1%7D%5D%7D; "
+	"theme=dark; consent=analytics%3Dtrue%26ads%3Dfalse%26functional%3Dtrue\r\n"
+	"If-None-Match: \"5f3c2a1b9e8d7c6a\"\r\n"
+	"\r\n";
+
+//an urlencoded checkout form posted by the same browser
+static const char benchmark_form_body[] =
+	"csrfmiddlewaretoken=Qm8vT2xZ3kPj9RwHs4LcN6fDy1AeUbXo&first_name=Ana-Maria&last_name=Ionescu&email=ana.ionescu%40example.com"
+	"&phone=%2B40+721+555+012&street=Strada+Mihai+Eminescu+nr.+12%2C+bl.+A4%2C+ap.+7&city=Cluj-Napoca&postal_code=400001"
+	"&country=RO&shipping_method=express&gift_message=La+mul%C8%9Bi+ani%21+Sper+s%C4%83+%C3%AE%C8%9Bi+plac%C4%83+cadoul.+%3A%29"
+	"&coupon=AUTUMN26&newsletter=on&terms=on&payment=card&card_holder=ANA+MARIA+IONESCU&billing_same=on"
+	"&notes=Please+leave+the+parcel+at+the+reception+desk+if+nobody+answers%2C+the+building+code+is+%2312B"
+	"&items%5B0%5D%5Bid%5D=4815&items%5B0%5D%5Bqty%5D=2&items%5B1%5D%5Bid%5D=162342&items%5B1%5D%5Bqty%5D=1";
+
+struct SIMD_BENCHMARK_RESULT
+{
+	std::string scan;
+	size_t bytes;
+	double baseline_mbps;
+	double current_mbps;
+};
+
+//the old url_decode, one append per character
+static bool benchmark_url_decode_baseline(const std::string* s, std::string* result)
+{
+	for (size_t i = 0; i < s->size(); i++)
+	{
+		if (s[0][i] == '&' or s[0][i] == '=')
+		{
+			return false;
+		}
+		else if (s[0][i] == '%')
+		{
+			if (i + 2 >= s->size())
+			{
+				return false;
+			}
+
+			char high_half_pos = benchmark_hex_charset[(unsigned char)s[0][i + 1]];
+			if (high_half_pos == -1)
+			{
+				return false;
+			}
+
+			char low_half_pos = benchmark_hex_charset[(unsigned char)s[0][i + 2]];
+			if (low_half_pos == -1)
+			{
+				return false;
+			}
+
+			char c = (char)(low_half_pos | (high_half_pos << 4));
+			result->append(1, c);
+			i += 2;
+		}
+		else
+		{
+			result->append(1, s[0][i]);
+		}
+	}
+
+	return true;
+}
+
+//the current url_decode, the plain runs are copied in one step
+static bool benchmark_url_decode(const char* s, size_t len, std::string* result)
+{
+	size_t i = 0;
+	while (i < len)
+	{
+		size_t plain_len = SIMD_Scan_Any(s + i, len - i, "%&=", 3);
+		result->append(s + i, plain_len);
+		i += plain_len;
+
+		if (i == len)
+		{
+			break;
+		}
+
+		if (s[i] != '%' or i + 2 >= len)
+		{
+			return false;
+		}
+
+		char high_half_pos = benchmark_hex_charset[(unsigned char)s[i + 1]];
+		char low_half_pos = benchmark_hex_charset[(unsigned char)s[i + 2]];
+		if (high_half_pos == -1 or low_half_pos == -1)
+		{
+			return false;
+		}
+
+		result->append(1, (char)(low_half_pos | (high_half_pos << 4)));
+		i += 3;
+	}
+
+	return true;
+}
+
+//the old HTTP_Parse_Query, a per-character state machine
+static bool benchmark_parse_query_baseline(const std::string& query_part, std::unordered_map<std::string, std::string>* query_params)
+{
+	std::string query_name, query_value, dec_query_name, dec_query_value;
+	bool parser_state = 0; // 0->extracting key ; 1->extracting value
+
+	for (size_t i = 0; i < query_part.size(); i++)
+	{
+		if (query_part[i] == '=')
+		{
+			parser_state = 1;
+		}
+		else if (query_part[i] == '&')
+		{
+			parser_state = 0;
+
+			if (!benchmark_url_decode_baseline(&query_name, &dec_query_name) or !benchmark_url_decode_baseline(&query_value, &dec_query_value))
+			{
+				return false;
+			}
+
+			query_name.clear();
+			query_value.clear();
+
+			if (!dec_query_name.empty())
+			{
+				query_params[0][dec_query_name] = dec_query_value;
+			}
+
+			dec_query_name.clear();
+			dec_query_value.clear();
+		}
+		else if (parser_state)
+		{
+			query_value.append(1, query_part[i]);
+		}
+		else
+		{
+			query_name.append(1, query_part[i]);
+		}
+	}
+
+	if (!benchmark_url_decode_baseline(&query_name, &dec_query_name) or !benchmark_url_decode_baseline(&query_value, &dec_query_value))
+	{
+		return false;
+	}
+
+	if (!dec_query_name.empty())
+	{
+		query_params[0][dec_query_name] = dec_query_value;
+	}
+
+	return true;
+}
+
+//the current HTTP_Parse_Query, the pairs are found with the delimiter scan
+static bool benchmark_parse_query(const std::string& query_part, std::unordered_map<std::string, std::string>* query_params)
+{
+	std::string dec_query_name, dec_query_value;
+
+	const char* query = query_part.c_str();
+	size_t position = 0;
+	size_t query_end = query_part.size();
+
+	while (position <= query_end)
+	{
+		size_t pair_end = position + SIMD_Scan_Any(query + position, query_end - position, "&", 1);
+		size_t name_end = position + SIMD_Scan_Any(query + position, pair_end - position, "=", 1);
+
+		dec_query_name.clear();
+		dec_query_value.clear();
+
+		if (!benchmark_url_decode(query + position, name_end - position, &dec_query_name))
+		{
+			return false;
+		}
+
+		// the '=' characters inside the value are dropped
+		size_t value_position = name_end;
+		while (value_position < pair_end)
+		{
+			value_position++;
+
+			size_t value_part_end = value_position + SIMD_Scan_Any(query + value_position, pair_end - value_position, "=", 1);
+			if (!benchmark_url_decode(query + value_position, value_part_end - value_position, &dec_query_value))
+			{
+				return false;
+			}
+
+			value_position = value_part_end;
+		}
+
+		if (!dec_query_name.empty())
+		{
+			query_params[0][dec_query_name] = dec_query_value;
+		}
+
+		position = pair_end + 1;
+	}
+
+	return true;
+}
+
+//the old HTTP_Parse_Request_Headers, every header is copied into the map
+static bool benchmark_parse_headers_baseline(const std::string& raw_request, size_t headers_start_offset, std::unordered_map<std::string, std::string>* request_headers)
+{
+	size_t start_position = headers_start_offset;
+
+	size_t stop_position = raw_request.find("\r\n\r\n");
+	if (stop_position == std::string::npos)
+	{
+		return false;
+	}
+
+	std::string header_name, header_value;
+	while (true)
+	{
+		if (start_position >= raw_request.size() or raw_request[start_position] == '\n' or raw_request[start_position + 1] == '\n')
+		{
+			break;
+		}
+
+		size_t point_position = raw_request.find(": ", start_position);
+		if (point_position == std::string::npos)
+		{
+			return false;
+		}
+
+		header_name = raw_request.substr(start_position, point_position - start_position);
+		size_t new_line_position = raw_request.find("\r\n", point_position);
+
+		if (new_line_position == std::string::npos)
+		{
+			return false;
+		}
+
+		header_value = raw_request.substr(point_position + 2, new_line_position - (point_position + 2));
+
+		for (size_t i = 0; i < header_name.size(); i++)
+		{
+			header_name[i] = tolower(header_name[i]);
+		}
+
+		request_headers[0][header_name] = header_value;
+		start_position = new_line_position + 2;
+	}
+
+	return true;
+}
+
+//the current HTTP_Parse_Request_Headers, the headers are indexed in place
+static size_t benchmark_parse_headers(std::string& raw_request, size_t headers_start_offset, size_t* header_offsets)
+{
+	size_t headers = 0;
+	size_t line_start = headers_start_offset;
+
+	while (true)
+	{
+		size_t line_end = raw_request.find('\n', line_start);
+		if (line_end == std::string::npos)
+		{
+			return 0;
+		}
+
+		size_t value_end = line_end;
+		if (value_end > line_start and raw_request[value_end - 1] == '\r')
+		{
+			value_end--;
+		}
+
+		if (value_end == line_start)
+		{
+			return headers;
+		}
+
+		char* line = &raw_request[line_start];
+		size_t line_len = value_end - line_start;
+
+		const char* point_position = (const char*)memchr(line, ':', line_len);
+		if (!point_position or point_position == line)
+		{
+			return 0;
+		}
+
+		size_t name_len = point_position - line;
+		for (size_t i = 0; i < name_len; i++)
+		{
+			if (line[i] >= 'A' and line[i] <= 'Z')
+			{
+				line[i] += 'a' - 'A';
+			}
+		}
+
+		size_t value_start = name_len + 1;
+		while (value_start < line_len and (line[value_start] == ' ' or line[value_start] == '\t'))
+		{
+			value_start++;
+		}
+
+		header_offsets[headers * 2] = line_start;
+		header_offsets[headers * 2 + 1] = line_start + value_start;
+		headers++;
+
+		line_start = line_end + 1;
+	}
+}
+
+//the part separators found by the old HTTP_Parse_Multipart_Form_Data with std::string::find, their offsets are summed
+static size_t benchmark_multipart_baseline(const std::string* raw_request, const std::string& separator, const std::string& document_end)
+{
+	size_t sum = 0;
+	size_t position = raw_request->find(separator);
+
+	while (position != std::string::npos)
+	{
+		sum += position;
+		position = raw_request->find(separator, position + separator.size());
+	}
+
+	return sum + raw_request->rfind(document_end);
+}
+
+//the same separators found by HTTP_Find_Multipart_Separator
+static size_t benchmark_multipart(const std::string* raw_request, const std::string& separator, const std::string& document_end)
+{
+	size_t sum = 0;
+	size_t position = 0;
+
+	while (true)
+	{
+		size_t search_len = raw_request->size() - position;
+		size_t found = SIMD_Find_Substring(raw_request->c_str() + position, search_len, separator.c_str(), separator.size());
+		if (found == search_len)
+		{
+			break;
+		}
+
+		sum += position + found;
+		position += found + separator.size();
+	}
+
+	return sum + raw_request->rfind(document_end);
+}
+
+//random bytes like a compressed photo, with the partial boundary matches the real files also contain
+static std::string benchmark_binary_file(size_t len)
+{
+	std::string file(len, 0);
+	for (size_t i = 0; i < len; i++)
+	{
+		file[i] = (char)(rand() & 0xff);
+	}
+
+	for (size_t i = 4096; i + 4 < len; i += 4096)
+	{
+		file.replace(i, 4, "\r\n--");
+	}
+
+	return file;
+}
+
+//a browser upload of a few form fields, a large photo and a small text file
+static std::string benchmark_multipart_upload()
+{
+	std::string body;
+
+	body += "--" SIMD_BENCHMARK_BOUNDARY "\r\nContent-Disposition: form-data; name=\"title\"\r\n\r\nHoliday photos\r\n";
+	body += "--" SIMD_BENCHMARK_BOUNDARY "\r\nContent-Disposition: form-data; name=\"description\"\r\n\r\n";
+	body += "Taken in the Apuseni mountains, please keep the original resolution.\r\n";
+	body += "--" SIMD_BENCHMARK_BOUNDARY "\r\nContent-Disposition: form-data; name=\"album\"\r\n\r\n1623\r\n";
+	body += "--" SIMD_BENCHMARK_BOUNDARY "\r\nContent-Disposition: form-data; name=\"photo\"; filename=\"IMG_20261004_101512.jpg\"\r\nContent-Type: image/jpeg\r\n\r\n";
+	body += benchmark_binary_file(SIMD_BENCHMARK_UPLOAD_SIZE);
+	body += "\r\n--" SIMD_BENCHMARK_BOUNDARY "\r\nContent-Disposition: form-data; name=\"notes\"; filename=\"notes.txt\"\r\nContent-Type: text/plain\r\n\r\n";
+	body += std::string(benchmark_form_body);
+	body += "\r\n--" SIMD_BENCHMARK_BOUNDARY "--\r\n";
+
+	return body;
+}
+
+template<typename SCAN_FUNC>
+static double benchmark_run(size_t bytes, SCAN_FUNC scan)
+{
+	size_t iterations = SIMD_BENCHMARK_BYTES / bytes + 1;
+	uint64_t sum = 0;
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (size_t i = 0; i < iterations; i++)
+	{
+		sum += scan();
+	}
+
+	auto stop = std::chrono::steady_clock::now();
+	benchmark_sink += sum;
+
+	double seconds = std::chrono::duration<double>(stop - start).count();
+	return ((double)iterations * bytes) / seconds / (1024 * 1024);
+}
+
+int main()
+{
+	srand(1);
+	SIMD_Scan_Init();
+
+	std::vector<struct SIMD_BENCHMARK_RESULT> results;
+
+	std::string request(benchmark_browser_request);
+	size_t headers_start_offset = request.find("\r\n") + 2;
+	std::string request_query = request.substr(request.find('?') + 1, request.find(' ', request.find('?')) - request.find('?') - 1);
+	std::string form_body(benchmark_form_body);
+	std::string upload = benchmark_multipart_upload();
+
+	std::string separator = "--" SIMD_BENCHMARK_BOUNDARY "\r\nContent-Disposition: form-data; name=\"";
+	std::string document_end = "--" SIMD_BENCHMARK_BOUNDARY "--";
+
+	//the same headers, pairs and separators are expected from both versions
+	std::unordered_map<std::string, std::string> baseline_map, current_map;
+	size_t header_offsets[64];
+
+	if (!benchmark_parse_headers_baseline(request, headers_start_offset, &baseline_map) or benchmark_parse_headers(request, headers_start_offset, header_offsets) != baseline_map.size())
+	{
+		std::cout << "The header parsers disagree on the browser request!" << std::endl;
+		return -1;
+	}
+
+	const std::string* queries[2] = {&request_query, &form_body};
+	for (int i = 0; i < 2; i++)
+	{
+		baseline_map.clear();
+		current_map.clear();
+
+		if (!benchmark_parse_query_baseline(*queries[i], &baseline_map) or !benchmark_parse_query(*queries[i], &current_map) or baseline_map != current_map)
+		{
+			std::cout << "The query parsers disagree on " << *queries[i] << "!" << std::endl;
+			return -1;
+		}
+	}
+
+	if (benchmark_multipart_baseline(&upload, separator, document_end) != benchmark_multipart(&upload, separator, document_end))
+	{
+		std::cout << "The multipart parsers disagree on the upload!" << std::endl;
+		return -1;
+	}
+
+	struct SIMD_BENCHMARK_RESULT result;
+
+	result.scan = "request headers";
+	result.bytes = request.size() - headers_start_offset;
+	result.baseline_mbps = benchmark_run(result.bytes, [&]() { std::unordered_map<std::string, std::string> headers; benchmark_parse_headers_baseline(request, headers_start_offset, &headers); return headers.size(); });
+	result.current_mbps = benchmark_run(result.bytes, [&]() { return benchmark_parse_headers(request, headers_start_offset, header_offsets); });
+	results.push_back(result);
+
+	result.scan = "request query";
+	result.bytes = request_query.size();
+	result.baseline_mbps = benchmark_run(result.bytes, [&]() { std::unordered_map<std::string, std::string> params; benchmark_parse_query_baseline(request_query, &params); return params.size(); });
+	result.current_mbps = benchmark_run(result.bytes, [&]() { std::unordered_map<std::string, std::string> params; benchmark_parse_query(request_query, &params); return params.size(); });
+	results.push_back(result);
+
+	result.scan = "urlencoded form";
+	result.bytes = form_body.size();
+	result.baseline_mbps = benchmark_run(result.bytes, [&]() { std::unordered_map<std::string, std::string> params; benchmark_parse_query_baseline(form_body, &params); return params.size(); });
+	result.current_mbps = benchmark_run(result.bytes, [&]() { std::unordered_map<std::string, std::string> params; benchmark_parse_query(form_body, &params); return params.size(); });
+	results.push_back(result);
+
+	result.scan = "multipart upload";
+	result.bytes = upload.size();
+	result.baseline_mbps = benchmark_run(result.bytes, [&]() { return benchmark_multipart_baseline(&upload, separator, document_end); });
+	result.current_mbps = benchmark_run(result.bytes, [&]() { return benchmark_multipart(&upload, separator, document_end); });
+	results.push_back(result);
+
+	std::cout << std::left << std::setw(18) << "scan" << std::right << std::setw(12) << "bytes" << std::setw(16) << "baseline MB/s" << std::setw(14) << "SIMD MB/s" << std::setw(10) << "speedup" << std::endl;
+
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		std::cout << std::left << std::setw(18) << results[i].scan << std::right << std::setw(12) << results[i].bytes << std::fixed << std::setprecision(0)
+			<< std::setw(16) << results[i].baseline_mbps << std::setw(14) << results[i].current_mbps << std::setprecision(2) << std::setw(9) << results[i].current_mbps / results[i].baseline_mbps << "x" << std::endl;
+	}
+
+	return 0;
+}
@@ -5,6 +5,8 @@ import sys
 
 enable_MOD_MYSQL = True
 enable_https = True
+enable_io_uring = True
+enable_compression = True
 debug = False
 
 COMPILER = "clang++"
@@ -27,6 +29,16 @@ if enable_MOD_MYSQL:
 	LLIBS += " -lmysqlclient"	
 else:
 	COMPILER_FLAGS += " -DNO_MOD_MYSQL"
+
+
+if not enable_io_uring:
+	COMPILER_FLAGS += " -DDISABLE_IO_URING"
+
+
+if enable_compression:
+	LLIBS += " -lz -lbrotlienc -lzstd"
+else:
+	COMPILER_FLAGS += " -DDISABLE_COMPRESSION"
 	
 
 def get_source_dependencies(source_file):
@@ -74,6 +86,91 @@ def compile_helper_functions():
 			exit()
 
 
+def compile_simd_scan():
+	need_to_build = False
+	
+	if source_code_modified("../simd_scan.cpp","simd_scan.o") and len(sys.argv) < 3:
+		need_to_build = True	
+
+	if len(sys.argv) >= 3 and sys.argv[1].lower() == "compile" and sys.argv[2].lower() == "simd_scan":
+		 need_to_build = True
+		 
+	if need_to_build:
+		print("Building the SIMD scanning functions")
+		compiler_return_value = os.system(COMPILER + " -c ../simd_scan.cpp " + COMPILER_FLAGS)
+		if compiler_return_value != 0:
+			print("Can not compile the SIMD scanning functions")
+			exit()
+
+
+def compile_cpu_affinity():
+	need_to_build = False
+	
+	if source_code_modified("../cpu_affinity.cpp","cpu_affinity.o") and len(sys.argv) < 3:
+		need_to_build = True	
+
+	if len(sys.argv) >= 3 and sys.argv[1].lower() == "compile" and sys.argv[2].lower() == "cpu_affinity":
+		 need_to_build = True
+		 
+	if need_to_build:
+		print("Building the cpu affinity functions")
+		compiler_return_value = os.system(COMPILER + " -c ../cpu_affinity.cpp " + COMPILER_FLAGS)
+		if compiler_return_value != 0:
+			print("Can not compile the cpu affinity functions")
+			exit()
+
+
+def compile_server_upgrade():
+	need_to_build = False
+	
+	if source_code_modified("../server_upgrade.cpp","server_upgrade.o") and len(sys.argv) < 3:
+		need_to_build = True	
+
+	if len(sys.argv) >= 3 and sys.argv[1].lower() == "compile" and sys.argv[2].lower() == "server_upgrade":
+		 need_to_build = True
+		 
+	if need_to_build:
+		print("Building the server upgrade functions")
+		compiler_return_value = os.system(COMPILER + " -c ../server_upgrade.cpp " + COMPILER_FLAGS)
+		if compiler_return_value != 0:
+			print("Can not compile the server upgrade functions")
+			exit()
+
+
+def compile_mime_types():
+	need_to_build = False
+	
+	if source_code_modified("../mime_types.cpp","mime_types.o") and len(sys.argv) < 3:
+		need_to_build = True	
+
+	if len(sys.argv) >= 3 and sys.argv[1].lower() == "compile" and sys.argv[2].lower() == "mime_types":
+		 need_to_build = True
+		 
+	if need_to_build:
+		print("Building the MIME types table")
+		compiler_return_value = os.system(COMPILER + " -c ../mime_types.cpp " + COMPILER_FLAGS)
+		if compiler_return_value != 0:
+			print("Can not compile the MIME types table")
+			exit()
+
+
+def compile_file_cache():
+	need_to_build = False
+	
+	if source_code_modified("../file_cache.cpp","file_cache.o") and len(sys.argv) < 3:
+		need_to_build = True	
+
+	if len(sys.argv) >= 3 and sys.argv[1].lower() == "compile" and sys.argv[2].lower() == "file_cache":
+		 need_to_build = True
+		 
+	if need_to_build:
+		print("Building the file cache")
+		compiler_return_value = os.system(COMPILER + " -c ../file_cache.cpp " + COMPILER_FLAGS)
+		if compiler_return_value != 0:
+			print("Can not compile the file cache")
+			exit()
+
+
 def compile_server_config():
 	need_to_build = False
 	
@@ -243,6 +340,107 @@ def compile_hpack_api():
 			exit()
 
 
+def compile_io_uring_api():
+	need_to_build = False
+	
+	if source_code_modified("../http_worker/io_uring_api.cpp","io_uring_api.o") and len(sys.argv) < 3:
+		need_to_build = True
+		
+	if len(sys.argv) >= 3 and sys.argv[1].lower() == "compile" and sys.argv[2].lower() == "io_uring_api":
+		need_to_build = True
+		
+	if need_to_build:
+		print("Building the io_uring API")
+		compiler_return_value = os.system(COMPILER + " -c ../http_worker/io_uring_api.cpp " + COMPILER_FLAGS)
+		if compiler_return_value != 0:
+			print("Can not compile the io_uring API");
+			exit()
+
+
+def compile_timer_wheel():
+	need_to_build = False
+	
+	if source_code_modified("../http_worker/timer_wheel.cpp","timer_wheel.o") and len(sys.argv) < 3:
+		need_to_build = True
+		
+	if len(sys.argv) >= 3 and sys.argv[1].lower() == "compile" and sys.argv[2].lower() == "timer_wheel":
+		need_to_build = True
+		
+	if need_to_build:
+		print("Building the timer wheel")
+		compiler_return_value = os.system(COMPILER + " -c ../http_worker/timer_wheel.cpp " + COMPILER_FLAGS)
+		if compiler_return_value != 0:
+			print("Can not compile the timer wheel");
+			exit()
+
+def compile_client_queue():
+	need_to_build = False
+	
+	if source_code_modified("../http_worker/client_queue.cpp","client_queue.o") and len(sys.argv) < 3:
+		need_to_build = True
+		
+	if len(sys.argv) >= 3 and sys.argv[1].lower() == "compile" and sys.argv[2].lower() == "client_queue":
+		need_to_build = True
+		
+	if need_to_build:
+		print("Building the client queue")
+		compiler_return_value = os.system(COMPILER + " -c ../http_worker/client_queue.cpp " + COMPILER_FLAGS)
+		if compiler_return_value != 0:
+			print("Can not compile the client queue");
+			exit()
+
+
+def compile_content_cache():
+	need_to_build = False
+	
+	if source_code_modified("../http_worker/content_cache.cpp","content_cache.o") and len(sys.argv) < 3:
+		need_to_build = True
+		
+	if len(sys.argv) >= 3 and sys.argv[1].lower() == "compile" and sys.argv[2].lower() == "content_cache":
+		need_to_build = True
+		
+	if need_to_build:
+		print("Building the content cache")
+		compiler_return_value = os.system(COMPILER + " -c ../http_worker/content_cache.cpp " + COMPILER_FLAGS)
+		if compiler_return_value != 0:
+			print("Can not compile the content cache");
+			exit()
+
+
+def compile_http_compression():
+	need_to_build = False
+	
+	if source_code_modified("../http_worker/http_compression.cpp","http_compression.o") and len(sys.argv) < 3:
+		need_to_build = True
+		
+	if len(sys.argv) >= 3 and sys.argv[1].lower() == "compile" and sys.argv[2].lower() == "http_compression":
+		need_to_build = True
+		
+	if need_to_build:
+		print("Building the HTTP compression")
+		compiler_return_value = os.system(COMPILER + " -c ../http_worker/http_compression.cpp " + COMPILER_FLAGS)
+		if compiler_return_value != 0:
+			print("Can not compile the HTTP compression");
+			exit()
+
+
+def compile_file_io():
+	need_to_build = False
+	
+	if source_code_modified("../http_worker/file_io.cpp","file_io.o") and len(sys.argv) < 3:
+		need_to_build = True
+		
+	if len(sys.argv) >= 3 and sys.argv[1].lower() == "compile" and sys.argv[2].lower() == "file_io":
+		need_to_build = True
+		
+	if need_to_build:
+		print("Building the file I/O threads")
+		compiler_return_value = os.system(COMPILER + " -c ../http_worker/file_io.cpp " + COMPILER_FLAGS)
+		if compiler_return_value != 0:
+			print("Can not compile the file I/O threads");
+			exit()
+
+
 def compile_http_worker():
 	
 	#compile http worker submodules
@@ -253,6 +451,14 @@ def compile_http_worker():
 	compile_http2_frame_processor()
 	compile_http_request_processor()
 	compile_hpack_api()
+	compile_timer_wheel()
+	compile_client_queue()
+	compile_content_cache()
+	compile_http_compression()
+	compile_file_io()
+
+	if enable_io_uring:
+		compile_io_uring_api()
 
 	need_to_build = False
 	
@@ -355,6 +561,21 @@ def compile_main():
 			exit()
 
 
+def compile_simd_scan_benchmark():
+	need_to_build = False
+	
+	# compiled straight into its own executable, no object is left for the server link
+	if source_code_modified("../benchmarks/simd_scan_benchmark.cpp","simd_scan_benchmark") or source_code_modified("../simd_scan.cpp","simd_scan_benchmark"):
+		need_to_build = True
+		
+	if need_to_build:
+		print("Building the SIMD scanning benchmark")
+		compiler_return_value = os.system(COMPILER + " -o simd_scan_benchmark ../benchmarks/simd_scan_benchmark.cpp ../simd_scan.cpp " + COMPILER_FLAGS)
+		if compiler_return_value != 0:
+			print("Can not compile the SIMD scanning benchmark");
+			exit()
+
+
 if len(sys.argv) >= 2 and sys.argv[1].lower() == "clean":
 	rm_return_value = os.system("rm -Rf build")
 	if rm_return_value != 0:
@@ -371,13 +592,23 @@ if not os.path.isdir("build"):
     			print("Can not create the build directory")
     			exit()
     			
+if len(sys.argv) >= 2 and sys.argv[1].lower() == "benchmark":
+	os.chdir("build")
+	compile_simd_scan_benchmark()
+	exit()
+
 if len(sys.argv) == 1 or (len(sys.argv) >= 2 and sys.argv[1].lower() == "compile"):    		  
 	os.chdir("build")
 
 	compile_helper_functions()
+	compile_simd_scan()
+	compile_cpu_affinity()
+	compile_server_upgrade()
 	compile_server_config()
 	compile_server_log()
 	compile_file_permissions()
+	compile_mime_types()
+	compile_file_cache()
 	compile_http_worker()
 	compile_server_listener()
 
@@ -400,7 +631,7 @@ if len(sys.argv) == 1 or (len(sys.argv) >= 2 and sys.argv[1].lower() == "compile
 
 
 os.chdir("build")
-all_objects = os.listdir()
+all_objects = [object_file for object_file in os.listdir() if object_file.endswith(".o")]
 
 should_link = False
 if not os.path.isfile("fasthttpd") or (len(sys.argv) >= 2 and sys.argv[1].lower() == "link"):
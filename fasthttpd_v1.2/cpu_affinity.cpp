@@ -0,0 +1,251 @@
+#include "cpu_affinity.h"
+#include "helper_functions.h"
+
+#include <fstream>
+#include <iterator>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <linux/filter.h>
+
+static bool CPU_Affinity_Parse_Item(const std::string& item, std::vector<int>* cpus);
+
+static bool CPU_Affinity_Parse_Node(const std::string& node, std::vector<int>* cpus)
+{
+	bool invalid_chars;
+	str2uint(node, &invalid_chars);
+	if (node.empty() or invalid_chars)
+	{
+		return false;
+	}
+
+	//the kernel lists the cpus of the node in the same range format
+	std::ifstream cpulist_file("/sys/devices/system/node/node" + node + "/cpulist");
+	if (!cpulist_file.is_open())
+	{
+		return false;
+	}
+
+	std::string cpulist((std::istreambuf_iterator<char>(cpulist_file)), std::istreambuf_iterator<char>());
+	while (!cpulist.empty() and (cpulist.back() == '\n' or cpulist.back() == ' '))
+	{
+		cpulist.pop_back();
+	}
+
+	std::vector<std::string> items;
+	explode(&cpulist, ",", &items);
+
+	for (size_t i = 0; i < items.size(); i++)
+	{
+		if (!CPU_Affinity_Parse_Item(items[i], cpus))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool CPU_Affinity_Parse_Item(const std::string& item, std::vector<int>* cpus)
+{
+	if (item.compare(0, 4, "node") == 0)
+	{
+		return CPU_Affinity_Parse_Node(item.substr(4), cpus);
+	}
+
+	size_t dash = item.find('-');
+	std::string first_str = item.substr(0, dash);
+	std::string last_str = (dash == std::string::npos) ? first_str : item.substr(dash + 1);
+
+	bool first_invalid, last_invalid;
+	uint64_t first = str2uint(first_str, &first_invalid);
+	uint64_t last = str2uint(last_str, &last_invalid);
+
+	if (first_str.empty() or last_str.empty() or first_invalid or last_invalid or first > last or last >= CPU_SETSIZE)
+	{
+		return false;
+	}
+
+	for (uint64_t cpu = first; cpu <= last; cpu++)
+	{
+		cpus->push_back(cpu);
+	}
+
+	return true;
+}
+
+bool CPU_Affinity_Parse(const std::string& spec, std::vector<int>* cpus)
+{
+	cpus->clear();
+
+	if (spec == "auto")
+	{
+		cpu_set_t allowed_cpus;
+		if (sched_getaffinity(0, sizeof(allowed_cpus), &allowed_cpus) == -1)
+		{
+			return false;
+		}
+
+		for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+		{
+			if (CPU_ISSET(cpu, &allowed_cpus))
+			{
+				cpus->push_back(cpu);
+			}
+		}
+
+		return !cpus->empty();
+	}
+
+	std::vector<std::string> items;
+	explode(&spec, ",", &items);
+
+	for (size_t i = 0; i < items.size(); i++)
+	{
+		std::string item = items[i];
+		item.erase(0, item.find_first_not_of(' '));
+		item.erase(item.find_last_not_of(' ') + 1);
+
+		if (!CPU_Affinity_Parse_Item(item, cpus))
+		{
+			return false;
+		}
+	}
+
+	return !cpus->empty();
+}
+
+static bool CPU_Affinity_Pin_Handle(pthread_t thread, const std::vector<int>& cpus)
+{
+	cpu_set_t cpu_set;
+	CPU_ZERO(&cpu_set);
+
+	for (size_t i = 0; i < cpus.size(); i++)
+	{
+		CPU_SET(cpus[i], &cpu_set);
+	}
+
+	return pthread_setaffinity_np(thread, sizeof(cpu_set), &cpu_set) == 0;
+}
+
+bool CPU_Affinity_Pin_Current_Thread(int cpu)
+{
+	return CPU_Affinity_Pin_Handle(pthread_self(), std::vector<int>(1, cpu));
+}
+
+bool CPU_Affinity_Pin_Thread(std::thread* thread, int cpu)
+{
+	return CPU_Affinity_Pin_Handle(thread->native_handle(), std::vector<int>(1, cpu));
+}
+
+bool CPU_Affinity_Bind_Thread(std::thread* thread, const std::vector<int>& cpus)
+{
+	return !cpus.empty() and CPU_Affinity_Pin_Handle(thread->native_handle(), cpus);
+}
+
+void CPU_Affinity_Get_Nodes(std::vector<int>* nodes)
+{
+	nodes->clear();
+
+	//the kernel lists the node ids in the same range format as the cpus
+	std::ifstream online_file("/sys/devices/system/node/online");
+	if (online_file.is_open())
+	{
+		std::string online_list((std::istreambuf_iterator<char>(online_file)), std::istreambuf_iterator<char>());
+		while (!online_list.empty() and (online_list.back() == '\n' or online_list.back() == ' '))
+		{
+			online_list.pop_back();
+		}
+
+		std::vector<std::string> items;
+		explode(&online_list, ",", &items);
+
+		for (size_t i = 0; i < items.size(); i++)
+		{
+			if (!CPU_Affinity_Parse_Item(items[i], nodes))
+			{
+				nodes->clear();
+				break;
+			}
+		}
+	}
+
+	if (nodes->empty())
+	{
+		nodes->push_back(0);
+	}
+}
+
+int CPU_Affinity_Get_Node(int cpu)
+{
+	std::vector<int> nodes;
+	CPU_Affinity_Get_Nodes(&nodes);
+
+	for (size_t i = 0; i < nodes.size(); i++)
+	{
+		std::vector<int> node_cpus;
+		if (!CPU_Affinity_Parse_Node(int2str(nodes[i]), &node_cpus))
+		{
+			continue;
+		}
+
+		for (size_t j = 0; j < node_cpus.size(); j++)
+		{
+			if (node_cpus[j] == cpu)
+			{
+				return nodes[i];
+			}
+		}
+	}
+
+	return 0;
+}
+
+bool CPU_Affinity_Attach_Reuseport_Steering(int listener, const std::vector<int>& socket_cpus)
+{
+#ifdef SO_ATTACH_REUSEPORT_CBPF
+	/*
+	A = the cpu that received the packet
+	a jeq/ret pair for each cpu returns the index of its socket,
+	an index out of range lets the kernel fall back to the hash selection
+	*/
+	std::vector<struct sock_filter> program;
+
+	struct sock_filter load_cpu = BPF_STMT(BPF_LD | BPF_W | BPF_ABS, (uint32_t) (SKF_AD_OFF + SKF_AD_CPU));
+	program.push_back(load_cpu);
+
+	std::vector<bool> is_cpu_mapped(CPU_SETSIZE, false);
+	for (size_t i = 0; i < socket_cpus.size(); i++)
+	{
+		int cpu = socket_cpus[i];
+		if (cpu < 0 or cpu >= CPU_SETSIZE or is_cpu_mapped[cpu])
+		{
+			continue;
+		}
+
+		is_cpu_mapped[cpu] = true;
+
+		struct sock_filter compare_cpu = BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, (uint32_t) cpu, 0, 1);
+		struct sock_filter return_socket = BPF_STMT(BPF_RET | BPF_K, (uint32_t) i);
+		program.push_back(compare_cpu);
+		program.push_back(return_socket);
+	}
+
+	struct sock_filter return_fallback = BPF_STMT(BPF_RET | BPF_K, 0xFFFFFFFF);
+	program.push_back(return_fallback);
+
+	if (program.size() > BPF_MAXINSNS)
+	{
+		return false;
+	}
+
+	struct sock_fprog program_config;
+	program_config.len = program.size();
+	program_config.filter = program.data();
+
+	return setsockopt(listener, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &program_config, sizeof(program_config)) == 0;
+#else
+	return false;
+#endif
+}
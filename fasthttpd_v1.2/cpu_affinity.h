@@ -0,0 +1,33 @@
+#ifndef __cpu_affinity_incl__
+#define __cpu_affinity_incl__
+
+#include <string>
+#include <vector>
+#include <thread>
+
+/*
+expands a list of cpus, cpu ranges and NUMA nodes, for example "0-3,8,node1",
+"auto" is every cpu the process is allowed to run on
+*/
+bool CPU_Affinity_Parse(const std::string& spec, std::vector<int>* cpus);
+
+bool CPU_Affinity_Pin_Current_Thread(int cpu);
+bool CPU_Affinity_Pin_Thread(std::thread* thread, int cpu);
+
+//lets the thread run on any of the cpus, the scheduler picks one of them
+bool CPU_Affinity_Bind_Thread(std::thread* thread, const std::vector<int>& cpus);
+
+//the online NUMA nodes, a single node 0 if the kernel does not report them
+void CPU_Affinity_Get_Nodes(std::vector<int>* nodes);
+
+//the NUMA node of the cpu, 0 if it is unknown
+int CPU_Affinity_Get_Node(int cpu);
+
+/*
+attaches a classic BPF program to the SO_REUSEPORT group of the listener,
+a new connection goes to the socket whose index is mapped to the cpu that received it,
+socket_cpus[i] is the cpu of the i-th socket bound in the group
+*/
+bool CPU_Affinity_Attach_Reuseport_Steering(int listener, const std::vector<int>& socket_cpus);
+
+#endif
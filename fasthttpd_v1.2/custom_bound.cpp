@@ -1,6 +1,7 @@
 #include <string>
 #include <unordered_map>
 #include <cstdint>
+#include <new>
 
 #include "helper_functions.h"
 #include "server_config.h"
@@ -9,13 +10,15 @@
 #include "custom_bound.h"
 
 
-std::unordered_map <std::string,struct custom_bound_entry> custom_bound_table;
+//the table filled by load_custom_bound_paths, see build_custom_bound_table
+static std::unordered_map <std::string,struct custom_bound_entry>* custom_bound_table = NULL;
 
 bool check_custom_bound_path(const std::string& filename, struct custom_bound_entry* result)
 {
-	if(custom_bound_table.find(filename) != custom_bound_table.end())
+	auto entry = server_runtime_config->custom_bound_table->find(filename);
+	if(entry != server_runtime_config->custom_bound_table->end())
 	{
-		result[0] = custom_bound_table[filename];
+		result[0] = entry->second;
 		return true;
 	}
 
@@ -28,7 +31,7 @@ int run_custom_page_generator(const int worker_id, struct GENERIC_HTTP_CONNECTIO
 
 	//MOD_MYSQL auto reconnect
 	#ifndef NO_MOD_MYSQL
-	if(is_server_config_variable_true("enable_MOD_MYSQL") and is_server_config_variable_true("mysql_auto_reconnect"))
+	if(server_runtime_config->mysql_auto_reconnect)
 	{	
 		http_workers[worker_id].mysql_db_handle->reconnect_if_gone();
 	}
@@ -60,6 +63,11 @@ int run_custom_page_generator(const int worker_id, struct GENERIC_HTTP_CONNECTIO
 		generator->page_generator(handler_args);
 
 		handler_args.response->headers["content-length"] = int2str(handler_args.response->body.size());
+
+		if(generator->generate_etag)
+		{
+			HTTP_Request_Set_Body_ETag(handler_args.request, handler_args.response);
+		}
 		
 		if(conn->http_version == HTTP_VERSION_2)
 		{
@@ -79,11 +87,12 @@ int run_custom_page_generator(const int worker_id, struct GENERIC_HTTP_CONNECTIO
 	return generator->page_generator(handler_args);
 }
 
-void add_custom_bound_path(HTTP_CUSTOM_PAGE_HANDLER page_generator, const char* path, const char* hostname, bool execute_only_when_loaded)
+void add_custom_bound_path(HTTP_CUSTOM_PAGE_HANDLER page_generator, const char* path, const char* hostname, bool execute_only_when_loaded, bool generate_etag)
 {
 	struct custom_bound_entry new_entry;
 	new_entry.page_generator = page_generator;
 	new_entry.execute_only_when_loaded = execute_only_when_loaded;
+	new_entry.generate_etag = generate_etag;
 
 	std::string custom_path;
 	if(hostname == ANY_HOSTNAME_PATH)
@@ -94,7 +103,7 @@ void add_custom_bound_path(HTTP_CUSTOM_PAGE_HANDLER page_generator, const char*
 			custom_path.append(1,'/');
 			custom_path.append(path);
 			custom_path = rectify_path(&custom_path);
-			custom_bound_table[custom_path] = new_entry;
+			(*custom_bound_table)[custom_path] = new_entry;
 		}
 	}
 
@@ -109,7 +118,7 @@ void add_custom_bound_path(HTTP_CUSTOM_PAGE_HANDLER page_generator, const char*
 		custom_path.append(1,'/');
 		custom_path.append(path);
 		custom_path = rectify_path(&custom_path);
-		custom_bound_table[custom_path] = new_entry;
+		(*custom_bound_table)[custom_path] = new_entry;
 	}
 
 }
@@ -145,3 +154,18 @@ void load_custom_bound_paths()
 	#endif
 }
 
+void build_custom_bound_table(struct SERVER_RUNTIME_CONFIG* runtime_config)
+{
+	custom_bound_table = new (std::nothrow) std::unordered_map <std::string,struct custom_bound_entry>;
+	if(!custom_bound_table)
+	{
+		SERVER_ERROR_LOG_stdlib_err("Unable to allocate memory for the custom bound table!");
+		exit(-1);
+	}
+
+	//the paths are resolved with the host list loaded with the configuration
+	load_custom_bound_paths();
+
+	runtime_config->custom_bound_table = custom_bound_table;
+	custom_bound_table = NULL;
+}
@@ -24,6 +24,10 @@
 #define HTTP_COOKIE_ARGC ((args.request->COOKIES) ? (args.request->COOKIES->size()) : 0)
 #define HTTP_COOKIE_EXISTS(X) ((args.request->COOKIES) ? (args.request->COOKIES->find(X) != args.request->COOKIES->end()) : 0)
 
+//the HTTP/1 headers are not copied into args.request->headers, HTTP_Request_Materialize_Headers() does that
+#define HTTP_HEADER(X) HTTP_Request_Get_Header_String(args.request, X)
+#define HTTP_HEADER_EXISTS(X) HTTP_Request_Has_Header(args.request, X)
+
 struct HTTP_CUSTOM_PAGE_HANDLER_ARGUMENTS
 {
 	int worker_id;
@@ -38,12 +42,20 @@ typedef int (*HTTP_CUSTOM_PAGE_HANDLER)(const struct HTTP_CUSTOM_PAGE_HANDLER_AR
 struct custom_bound_entry
 {
 	bool execute_only_when_loaded;
+	bool generate_etag; //the polled pages that rarely change are revalidated with a hash of the body
 	HTTP_CUSTOM_PAGE_HANDLER page_generator;
 };
 
 bool check_custom_bound_path(const std::string& filename, struct custom_bound_entry* result);
 int run_custom_page_generator(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn, const uint32_t stream_id, struct custom_bound_entry* generator);
-void add_custom_bound_path(HTTP_CUSTOM_PAGE_HANDLER page_generator,const char* path,const char* hostname = ANY_HOSTNAME_PATH,bool execute_only_when_loaded = true);
+/*
+generate_etag applies to the pages sent when the handler returns,
+the other handlers can call HTTP_Request_Set_Body_ETag() before they send the response
+*/
+void add_custom_bound_path(HTTP_CUSTOM_PAGE_HANDLER page_generator,const char* path,const char* hostname = ANY_HOSTNAME_PATH,bool execute_only_when_loaded = true,bool generate_etag = false);
 void load_custom_bound_paths();
 
+//fills the custom bound table of a new runtime config snapshot
+void build_custom_bound_table(struct SERVER_RUNTIME_CONFIG* runtime_config);
+
 #endif
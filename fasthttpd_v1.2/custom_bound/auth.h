@@ -101,11 +101,11 @@ void auth_generator(std::list<struct http_connection>::iterator &http_connection
 	}
 
 	size_t session_token_size = 32;
-	size_t remote_addr_buffer_size = http_connection->remote_addr.size();
+	size_t remote_addr_buffer_size = strlen(http_connection->remote_addr);
 
 	insert_query.bind_param(0,MYSQL_TYPE_LONGLONG,&user_ID);
 	insert_query.bind_param(1,MYSQL_TYPE_BLOB,session_token,false,&session_token_size);
-	insert_query.bind_param(2,MYSQL_TYPE_STRING,(char*)http_connection->remote_addr.c_str(),false,&remote_addr_buffer_size);
+	insert_query.bind_param(2,MYSQL_TYPE_STRING,(char*)http_connection->remote_addr,false,&remote_addr_buffer_size);
 
 	if(!insert_query.execute())
 	{
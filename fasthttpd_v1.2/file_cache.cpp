@@ -0,0 +1,702 @@
+#include "file_cache.h"
+#include "helper_functions.h"
+#include "server_log.h"
+#include "mime_types.h"
+
+#include <new>
+#include <unordered_map>
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <list>
+#include <mutex>
+#include <atomic>
+#include <cstring>
+#include <cstdio>
+#include <ctime>
+#include <cstdlib>
+#include <climits>
+#include <errno.h>
+
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+//the lookups of different files rarely wait for the same lock
+#define FILE_CACHE_SHARDS 16
+
+//the changes that make an entry of the directory stale
+#define FILE_CACHE_WATCH_EVENTS (IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF)
+
+//the changes that bind a name of the directory to another file
+#define FILE_CACHE_RENAME_EVENTS (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO)
+
+const char* const file_cache_encoding_names[FILE_CACHE_ENCODINGS_NUM] = {"br", "zstd", "gzip"};
+const char* const file_cache_encoding_extensions[FILE_CACHE_ENCODINGS_NUM] = {".br", ".zst", ".gz"};
+
+struct FILE_CACHE_ENTRY
+{
+	bool exists;
+	std::shared_ptr<const struct FILE_CACHE_INFO> info; //immutable, the lookups take a reference instead of copying the strings
+	int file_descriptor; //-1 for the folders and the missing files
+
+	//set by the lookups, an entry used since the last eviction pass gets a second chance
+	std::atomic<bool> referenced;
+	std::list<std::string>::iterator order_iterator;
+};
+
+struct FILE_CACHE_SHARD
+{
+	pthread_rwlock_t lock;
+	std::unordered_map<std::string, struct FILE_CACHE_ENTRY> entries;
+	std::list<std::string> insertion_order;
+};
+
+static bool is_file_cache_enabled = false;
+static size_t file_cache_shard_size;
+static struct FILE_CACHE_SHARD* file_cache_shards = NULL;
+static int file_cache_inotify = -1;
+
+//increased before the entries are dropped, a lookup that raced with a change does not insert its result
+static std::atomic<uint64_t> file_cache_invalidations(0);
+
+//the entries built from a cached file, like the hot contents, are checked against its version
+static std::atomic<uint64_t> file_cache_versions(0);
+
+//a directory reached by several paths has a single watch
+static std::mutex file_cache_watch_lock;
+static std::unordered_map<int, std::vector<std::string>> watched_dirs;
+static std::unordered_map<std::string, int> watched_dir_descriptors;
+
+//the real paths of the symlinked files and folders, sorted so a folder finds the links below it, mapped to the paths they were reached by
+static std::map<std::string, std::vector<std::string>> linked_paths;
+
+static inline struct FILE_CACHE_SHARD* File_Cache_Shard(const std::string& path)
+{
+	return &file_cache_shards[std::hash<std::string>()(path) % FILE_CACHE_SHARDS];
+}
+
+//the encoding of a precompressed copy, -1 for the other files
+static int File_Cache_Encoding_By_Extension(const std::string& path)
+{
+	for (int i = 0; i < FILE_CACHE_ENCODINGS_NUM; i++)
+	{
+		size_t extension_len = strlen(file_cache_encoding_extensions[i]);
+		if (path.size() > extension_len and path.compare(path.size() - extension_len, extension_len, file_cache_encoding_extensions[i]) == 0)
+		{
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+static void File_Cache_Erase(struct FILE_CACHE_SHARD* shard, std::unordered_map<std::string, struct FILE_CACHE_ENTRY>::iterator entry_it)
+{
+	if (entry_it->second.file_descriptor != -1)
+	{
+		close(entry_it->second.file_descriptor);
+	}
+
+	shard->insertion_order.erase(entry_it->second.order_iterator);
+	shard->entries.erase(entry_it);
+}
+
+bool File_Cache_Init(size_t max_entries)
+{
+	if (max_entries == 0)
+	{
+		return true;
+	}
+
+	file_cache_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (file_cache_inotify == -1)
+	{
+		return false;
+	}
+
+	file_cache_shards = new (std::nothrow) struct FILE_CACHE_SHARD[FILE_CACHE_SHARDS];
+	if (!file_cache_shards)
+	{
+		SERVER_ERROR_LOG_stdlib_err("Unable to allocate memory for the file cache!");
+		exit(-1);
+	}
+
+	//the invalidations must not wait behind a steady stream of lookups
+	pthread_rwlockattr_t lock_attr;
+	pthread_rwlockattr_init(&lock_attr);
+	pthread_rwlockattr_setkind_np(&lock_attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+
+	for (int i = 0; i < FILE_CACHE_SHARDS; i++)
+	{
+		pthread_rwlock_init(&file_cache_shards[i].lock, &lock_attr);
+	}
+
+	pthread_rwlockattr_destroy(&lock_attr);
+
+	file_cache_shard_size = (max_entries + FILE_CACHE_SHARDS - 1) / FILE_CACHE_SHARDS;
+	is_file_cache_enabled = true;
+
+	return true;
+}
+
+void File_Cache_Free()
+{
+	if (!is_file_cache_enabled)
+	{
+		return;
+	}
+
+	for (int i = 0; i < FILE_CACHE_SHARDS; i++)
+	{
+		struct FILE_CACHE_SHARD* shard = &file_cache_shards[i];
+		while (!shard->entries.empty())
+		{
+			File_Cache_Erase(shard, shard->entries.begin());
+		}
+
+		pthread_rwlock_destroy(&shard->lock);
+	}
+
+	delete[] file_cache_shards;
+	file_cache_shards = NULL;
+
+	close(file_cache_inotify);
+	file_cache_inotify = -1;
+
+	is_file_cache_enabled = false;
+}
+
+int File_Cache_Notify_Descriptor()
+{
+	return file_cache_inotify;
+}
+
+static void File_Cache_Invalidate(const std::string& path, bool is_folder)
+{
+	struct FILE_CACHE_SHARD* shard = File_Cache_Shard(path);
+
+	pthread_rwlock_wrlock(&shard->lock);
+	auto entry_it = shard->entries.find(path);
+	if (entry_it != shard->entries.end())
+	{
+		File_Cache_Erase(shard, entry_it);
+	}
+	pthread_rwlock_unlock(&shard->lock);
+
+	if (!is_folder)
+	{
+		return;
+	}
+
+	//a renamed or deleted folder takes its whole subtree
+	std::string prefix = path;
+	prefix.append(1, '/');
+
+	for (int i = 0; i < FILE_CACHE_SHARDS; i++)
+	{
+		shard = &file_cache_shards[i];
+
+		pthread_rwlock_wrlock(&shard->lock);
+		for (auto it = shard->entries.begin(); it != shard->entries.end();)
+		{
+			auto current_it = it++;
+			if (current_it->first.compare(0, prefix.size(), prefix) == 0)
+			{
+				File_Cache_Erase(shard, current_it);
+			}
+		}
+		pthread_rwlock_unlock(&shard->lock);
+	}
+}
+
+static void File_Cache_Invalidate_All()
+{
+	for (int i = 0; i < FILE_CACHE_SHARDS; i++)
+	{
+		struct FILE_CACHE_SHARD* shard = &file_cache_shards[i];
+
+		pthread_rwlock_wrlock(&shard->lock);
+		while (!shard->entries.empty())
+		{
+			File_Cache_Erase(shard, shard->entries.begin());
+		}
+		pthread_rwlock_unlock(&shard->lock);
+	}
+}
+
+//must be called with file_cache_watch_lock held, drops the entries reached through a link to the path or to a folder above it
+static void File_Cache_Invalidate_Links(const std::string& path)
+{
+	if (linked_paths.empty())
+	{
+		return;
+	}
+
+	std::string prefix = path;
+	if (prefix != "/")
+	{
+		prefix.append(1, '/');
+	}
+
+	auto link_it = linked_paths.find(path);
+	if (link_it != linked_paths.end())
+	{
+		for (size_t i = 0; i < link_it->second.size(); i++)
+		{
+			File_Cache_Invalidate(link_it->second[i], true);
+		}
+	}
+
+	for (link_it = linked_paths.lower_bound(prefix); link_it != linked_paths.end() and link_it->first.compare(0, prefix.size(), prefix) == 0; ++link_it)
+	{
+		for (size_t i = 0; i < link_it->second.size(); i++)
+		{
+			File_Cache_Invalidate(link_it->second[i], true);
+		}
+	}
+}
+
+//must be called with file_cache_watch_lock held
+static void File_Cache_Forget_Watch(int watch_descriptor)
+{
+	auto dir_it = watched_dirs.find(watch_descriptor);
+	if (dir_it == watched_dirs.end())
+	{
+		return;
+	}
+
+	for (size_t i = 0; i < dir_it->second.size(); i++)
+	{
+		watched_dir_descriptors.erase(dir_it->second[i]);
+	}
+
+	watched_dirs.erase(dir_it);
+}
+
+void File_Cache_Process_Events()
+{
+	if (!is_file_cache_enabled)
+	{
+		return;
+	}
+
+	alignas(struct inotify_event) char events_buffer[4096];
+
+	while (true)
+	{
+		ssize_t read_bytes = read(file_cache_inotify, events_buffer, sizeof(events_buffer));
+		if (read_bytes <= 0)
+		{
+			if (read_bytes == -1 and errno == EINTR)
+			{
+				continue;
+			}
+
+			break;
+		}
+
+		file_cache_invalidations.fetch_add(1);
+
+		std::lock_guard<std::mutex> watch_guard(file_cache_watch_lock);
+
+		for (char* event_ptr = events_buffer; event_ptr < events_buffer + read_bytes;)
+		{
+			struct inotify_event* event = (struct inotify_event*) event_ptr;
+			event_ptr += sizeof(struct inotify_event) + event->len;
+
+			//some events were lost, none of the entries can be trusted
+			if (event->mask & IN_Q_OVERFLOW)
+			{
+				File_Cache_Invalidate_All();
+				continue;
+			}
+
+			auto dir_it = watched_dirs.find(event->wd);
+			if (dir_it == watched_dirs.end())
+			{
+				continue;
+			}
+
+			if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))
+			{
+				for (size_t i = 0; i < dir_it->second.size(); i++)
+				{
+					File_Cache_Invalidate(dir_it->second[i], true);
+					File_Cache_Invalidate_Links(dir_it->second[i]);
+				}
+
+				//the watch of a moved folder would report the events under its old paths
+				if (event->mask & IN_MOVE_SELF)
+				{
+					inotify_rm_watch(file_cache_inotify, event->wd);
+				}
+
+				File_Cache_Forget_Watch(event->wd);
+				continue;
+			}
+
+			if (event->len == 0)
+			{
+				continue;
+			}
+
+			//a replaced symlink to a folder is not reported as a folder, its watch still follows the old target
+			std::vector<int> rebound_watches;
+
+			for (size_t i = 0; i < dir_it->second.size(); i++)
+			{
+				std::string path = dir_it->second[i];
+				if (path != "/")
+				{
+					path.append(1, '/');
+				}
+
+				path.append(event->name);
+
+				auto rebound_it = (event->mask & FILE_CACHE_RENAME_EVENTS) ? watched_dir_descriptors.find(path) : watched_dir_descriptors.end();
+				if (rebound_it != watched_dir_descriptors.end())
+				{
+					rebound_watches.push_back(rebound_it->second);
+				}
+
+				File_Cache_Invalidate(path, (event->mask & IN_ISDIR) or rebound_it != watched_dir_descriptors.end());
+				File_Cache_Invalidate_Links(path);
+
+				//the original file caches which copies exist
+				int encoding = File_Cache_Encoding_By_Extension(path);
+				if (encoding != -1)
+				{
+					File_Cache_Invalidate(path.substr(0, path.size() - strlen(file_cache_encoding_extensions[encoding])), false);
+				}
+			}
+
+			for (size_t i = 0; i < rebound_watches.size(); i++)
+			{
+				auto rebound_it = watched_dirs.find(rebound_watches[i]);
+				if (rebound_it == watched_dirs.end())
+				{
+					continue;
+				}
+
+				for (size_t j = 0; j < rebound_it->second.size(); j++)
+				{
+					File_Cache_Invalidate(rebound_it->second[j], true);
+				}
+
+				inotify_rm_watch(file_cache_inotify, rebound_watches[i]);
+				File_Cache_Forget_Watch(rebound_watches[i]);
+			}
+		}
+	}
+}
+
+static std::string File_Cache_Parent_Dir(const std::string& path)
+{
+	size_t last_slash = path.find_last_of('/');
+	if (last_slash == std::string::npos)
+	{
+		return std::string();
+	}
+
+	if (last_slash == 0)
+	{
+		return std::string("/");
+	}
+
+	return path.substr(0, last_slash);
+}
+
+//must be called with file_cache_watch_lock held, true if the folder is watched or missing
+static bool File_Cache_Watch_Dir(const std::string& dir, bool* is_added)
+{
+	*is_added = false;
+
+	if (watched_dir_descriptors.find(dir) != watched_dir_descriptors.end())
+	{
+		return true;
+	}
+
+	int watch_descriptor = inotify_add_watch(file_cache_inotify, dir.c_str(), FILE_CACHE_WATCH_EVENTS | IN_ONLYDIR);
+	if (watch_descriptor == -1)
+	{
+		return errno == ENOENT or errno == ENOTDIR;
+	}
+
+	watched_dirs[watch_descriptor].push_back(dir);
+	watched_dir_descriptors[dir] = watch_descriptor;
+	*is_added = true;
+
+	return true;
+}
+
+//must be called with file_cache_watch_lock held, the folders holding the target are watched under their real paths up to /
+static bool File_Cache_Watch_Link(const std::string& path, const std::string& real_path)
+{
+	std::vector<std::string>& link_paths = linked_paths[real_path];
+	if (std::find(link_paths.begin(), link_paths.end(), path) == link_paths.end())
+	{
+		link_paths.push_back(path);
+	}
+
+	bool is_added;
+	for (std::string dir = File_Cache_Parent_Dir(real_path); !dir.empty(); dir = File_Cache_Parent_Dir(dir))
+	{
+		if (!File_Cache_Watch_Dir(dir, &is_added))
+		{
+			return false;
+		}
+
+		if (dir == "/")
+		{
+			break;
+		}
+	}
+
+	return true;
+}
+
+/*
+watches every folder from the parent of the path up to the document root,
+so a renamed ancestor drops the entries below it, the missing folders are skipped,
+the watches follow the symlinks, the folders above a symlinked target and the link itself are watched too
+*/
+static bool File_Cache_Watch_Ancestors(const std::string& path, const std::string& root)
+{
+	std::lock_guard<std::mutex> watch_guard(file_cache_watch_lock);
+
+	//the link may be above the document root, then the folders are watched up to /
+	bool is_linked = false;
+
+	std::string dir = File_Cache_Parent_Dir(path);
+	while (!dir.empty())
+	{
+		bool is_added;
+		if (!File_Cache_Watch_Dir(dir, &is_added))
+		{
+			return false;
+		}
+
+		char real_dir[PATH_MAX];
+		if (is_added and realpath(dir.c_str(), real_dir) and dir != real_dir)
+		{
+			is_linked = true;
+
+			if (!File_Cache_Watch_Link(dir, real_dir))
+			{
+				return false;
+			}
+		}
+
+		if ((dir.size() <= root.size() and !is_linked) or dir == "/")
+		{
+			break;
+		}
+
+		dir = File_Cache_Parent_Dir(dir);
+	}
+
+	//a symlinked file changes with its target, a dangling link is not cached until the target is created
+	struct stat link_stat;
+	if (lstat(path.c_str(), &link_stat) == 0 and S_ISLNK(link_stat.st_mode))
+	{
+		char real_path[PATH_MAX];
+		if (!realpath(path.c_str(), real_path))
+		{
+			return false;
+		}
+
+		return File_Cache_Watch_Link(path, real_path);
+	}
+
+	return true;
+}
+
+//0 for an existing file, 1 for a missing one, -1 if the result must not be cached
+static int File_Cache_Load(const std::string& path, struct FILE_CACHE_ENTRY* entry, struct FILE_CACHE_INFO* info, bool open_file)
+{
+	entry->file_descriptor = -1;
+	info->version = 0;
+	info->precompressed = 0;
+
+	struct stat file_stat;
+	if (stat(path.c_str(), &file_stat) == -1)
+	{
+		entry->exists = false;
+		return (errno == ENOENT or errno == ENOTDIR) ? 1 : -1;
+	}
+
+	entry->exists = true;
+	info->is_folder = S_ISDIR(file_stat.st_mode);
+	info->size = file_stat.st_size;
+	info->last_modified = file_stat.st_mtime;
+
+	if (info->is_folder)
+	{
+		return 0;
+	}
+
+	info->last_modified_date = convert_ctime2_http_date(file_stat.st_mtime);
+	info->content_type = MIME_Types_Get(path);
+
+	//a change within the same clock tick keeps the size and the mtime, such an ETag can not be strong
+	char etag[80];
+	uint64_t mtime_nsec = (uint64_t) file_stat.st_mtim.tv_sec * 1000000000 + file_stat.st_mtim.tv_nsec;
+	bool is_recent = file_stat.st_mtime >= time(NULL) - 1;
+
+	snprintf(etag, sizeof(etag), "%s\"%llx-%llx-%llx\"", is_recent ? "W/" : "", (unsigned long long) file_stat.st_ino,
+	         (unsigned long long) file_stat.st_size, (unsigned long long) mtime_nsec);
+	info->etag = etag;
+
+	//the copies are looked up once, their changes drop the entry of the original file
+	if (S_ISREG(file_stat.st_mode) and File_Cache_Encoding_By_Extension(path) == -1)
+	{
+		for (int i = 0; i < FILE_CACHE_ENCODINGS_NUM; i++)
+		{
+			struct stat precompressed_stat;
+			std::string precompressed_path = path + file_cache_encoding_extensions[i];
+
+			if (stat(precompressed_path.c_str(), &precompressed_stat) == 0 and S_ISREG(precompressed_stat.st_mode))
+			{
+				info->precompressed |= 1 << i;
+			}
+		}
+	}
+
+	//the file is being written, it is looked up again until it settles
+	if (is_recent)
+	{
+		return -1;
+	}
+
+	//a fifo or a device would block the worker on open
+	if (open_file and S_ISREG(file_stat.st_mode))
+	{
+		entry->file_descriptor = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	}
+
+	return 0;
+}
+
+int File_Cache_Get(const std::string& path, const std::string& root, std::shared_ptr<const struct FILE_CACHE_INFO>* info)
+{
+	if (!is_file_cache_enabled)
+	{
+		struct FILE_CACHE_ENTRY uncached_entry;
+		std::shared_ptr<struct FILE_CACHE_INFO> uncached_info = std::make_shared<struct FILE_CACHE_INFO>();
+		File_Cache_Load(path, &uncached_entry, uncached_info.get(), false);
+
+		if (!uncached_entry.exists)
+		{
+			return -1;
+		}
+
+		*info = uncached_info;
+		return 0;
+	}
+
+	struct FILE_CACHE_SHARD* shard = File_Cache_Shard(path);
+
+	pthread_rwlock_rdlock(&shard->lock);
+	auto entry_it = shard->entries.find(path);
+	if (entry_it != shard->entries.end())
+	{
+		entry_it->second.referenced.store(true, std::memory_order_relaxed);
+
+		bool exists = entry_it->second.exists;
+		if (exists)
+		{
+			*info = entry_it->second.info;
+		}
+
+		pthread_rwlock_unlock(&shard->lock);
+		return exists ? 0 : -1;
+	}
+	pthread_rwlock_unlock(&shard->lock);
+
+	//the watches are added before the stat, so a change after it is always reported
+	uint64_t invalidations = file_cache_invalidations.load();
+	bool is_watched = File_Cache_Watch_Ancestors(path, root);
+
+	struct FILE_CACHE_ENTRY loaded_entry;
+	std::shared_ptr<struct FILE_CACHE_INFO> loaded_info = std::make_shared<struct FILE_CACHE_INFO>();
+	int load_result = File_Cache_Load(path, &loaded_entry, loaded_info.get(), is_watched);
+
+	if (loaded_entry.exists)
+	{
+		*info = loaded_info;
+	}
+
+	if (!is_watched or load_result == -1)
+	{
+		return loaded_entry.exists ? 0 : -1;
+	}
+
+	pthread_rwlock_wrlock(&shard->lock);
+
+	if (invalidations != file_cache_invalidations.load() or shard->entries.find(path) != shard->entries.end())
+	{
+		pthread_rwlock_unlock(&shard->lock);
+
+		if (loaded_entry.file_descriptor != -1)
+		{
+			close(loaded_entry.file_descriptor);
+		}
+
+		return loaded_entry.exists ? 0 : -1;
+	}
+
+	//the info is not shared with the other workers yet
+	loaded_info->version = ++file_cache_versions;
+
+	shard->insertion_order.push_back(path);
+
+	struct FILE_CACHE_ENTRY& cache_entry = shard->entries[path];
+	cache_entry.exists = loaded_entry.exists;
+	cache_entry.info = loaded_info;
+	cache_entry.file_descriptor = loaded_entry.file_descriptor;
+	cache_entry.referenced.store(false, std::memory_order_relaxed);
+	cache_entry.order_iterator = --shard->insertion_order.end();
+
+	//second chance eviction, the oldest entry not used since the last pass is dropped
+	while (shard->entries.size() > file_cache_shard_size)
+	{
+		auto oldest_it = shard->entries.find(shard->insertion_order.front());
+		if (oldest_it->second.referenced.load(std::memory_order_relaxed) or oldest_it->first == path)
+		{
+			oldest_it->second.referenced.store(false, std::memory_order_relaxed);
+			shard->insertion_order.splice(shard->insertion_order.end(), shard->insertion_order, oldest_it->second.order_iterator);
+			continue;
+		}
+
+		File_Cache_Erase(shard, oldest_it);
+	}
+
+	pthread_rwlock_unlock(&shard->lock);
+
+	return loaded_entry.exists ? 0 : -1;
+}
+
+int File_Cache_Open(const std::string& path)
+{
+	if (is_file_cache_enabled)
+	{
+		struct FILE_CACHE_SHARD* shard = File_Cache_Shard(path);
+
+		//the duplicate has its own descriptor, the transfers read with explicit offsets
+		pthread_rwlock_rdlock(&shard->lock);
+		auto entry_it = shard->entries.find(path);
+		if (entry_it != shard->entries.end() and entry_it->second.file_descriptor != -1)
+		{
+			int file_descriptor = fcntl(entry_it->second.file_descriptor, F_DUPFD_CLOEXEC, 0);
+			pthread_rwlock_unlock(&shard->lock);
+
+			return file_descriptor;
+		}
+		pthread_rwlock_unlock(&shard->lock);
+	}
+
+	return open(path.c_str(), O_RDONLY | O_CLOEXEC);
+}
@@ -0,0 +1,57 @@
+#ifndef __file_cache_incl__
+#define __file_cache_incl__
+
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <ctime>
+
+/*
+cache of the static files shared by the workers, keyed by the full path,
+the entries are invalidated by inotify events on their directories,
+a missing file is cached too, so the repeated 404 requests do not reach the filesystem
+*/
+//the precompressed copies looked up next to each file, like app.js.br for app.js, in the order of preference
+#define FILE_CACHE_ENCODINGS_NUM 3
+extern const char* const file_cache_encoding_names[FILE_CACHE_ENCODINGS_NUM];
+extern const char* const file_cache_encoding_extensions[FILE_CACHE_ENCODINGS_NUM];
+
+struct FILE_CACHE_INFO
+{
+	bool is_folder;
+	uint64_t size;
+	time_t last_modified;
+	std::string last_modified_date; //rendered for the Last-Modified header
+	std::string content_type;
+
+	//"inode-size-mtime" in hex, weak when the file changed in the last second, such a file is not cached
+	std::string etag;
+
+	//bit i is set when the copy compressed with file_cache_encoding_names[i] exists
+	uint8_t precompressed;
+
+	//0 if the file is not cached, otherwise it changes each time the file is loaded again
+	uint64_t version;
+};
+
+//max_entries = 0 disables the cache, false if inotify can not be used
+bool File_Cache_Init(size_t max_entries);
+void File_Cache_Free();
+
+//the inotify descriptor, readable when some entries must be invalidated, -1 if the cache is disabled
+int File_Cache_Notify_Descriptor();
+
+//reads the pending inotify events and drops the changed entries, called by the main thread
+void File_Cache_Process_Events();
+
+/*
+-1 if the file does not exist or can not be accessed,
+root is the document root, the folders above it are not watched,
+the info is shared with the cache entry and stays valid after the entry is dropped
+*/
+int File_Cache_Get(const std::string& path, const std::string& root, std::shared_ptr<const struct FILE_CACHE_INFO>* info);
+
+//a new descriptor of the file, duplicated from the cache when possible, -1 on error
+int File_Cache_Open(const std::string& path);
+
+#endif
@@ -1,4 +1,5 @@
 #include "helper_functions.h"
+#include "simd_scan.h"
 
 #include <string>
 #include <ctime>
@@ -172,238 +173,6 @@ std::string get_file_extension(const std::string* filename)
 	return result;
 }
 
-std::string get_MIME_type_by_ext(const std::string* filename)
-{
-	std::string ext = get_file_extension(filename);
-
-	std::string result;
-
-	if(ext == "aac")
-		result = "audio/aac";
-		
-	else if(ext == "abw")
-		result = "application/x-abiword";
-		
-	else if(ext == "apng")
-		result = "image/png";
-		
-	else if(ext == "avi")
-		result = "video/x-msvideo";
-		
-	else if(ext == "azw")
-		result = "application/vnd.amazon.ebook";
-		
-	else if(ext == "bmp")
-		result = "image/bmp";
-		
-	else if(ext == "bz")
-		result = "application/x-bzip";
-	
-	else if(ext == "bz2")
-		result = "application/x-bzip2";
-	
-	else if(ext == "csh")
-		result = "application/x-csh";
-	
-	else if(ext == "css")
-		result = "text/css";
-	
-	else if(ext == "csv")
-		result = "text/csv";
-	
-	else if(ext == "doc")
-		result = "application/msword";
-	
-	else if(ext == "docx")
-		result = "application/vnd.openxmlformats-officedocument.wordprocessingml.document";
-	
-	else if(ext == "divx")
-		result = "video/x-divx";
-	
-	else if(ext == "eot")
-		result = "application/vnd.ms-fontobject";
-	
-	else if(ext == "epub")
-		result = "application/epub+zip";
-	
-	else if(ext == "es")
-		result = "application/ecmascript";
-	
-	else if(ext == "gif")
-		result = "image/gif";
-	
-	else if(ext == "htm")
-		result = "text/html";
-	
-	else if(ext == "html")
-		result = "text/html";
-	
-	else if(ext == "ico")
-		result = "image/x-icon";
-	
-	else if(ext == "ics")
-		result = "text/calendar";
-	
-	else if(ext == "jar")
-		result = "application/java-archive";
-	
-	else if(ext == "jpeg")
-		result = "image/jpeg";
-	
-	else if(ext == "jpg")
-		result = "image/jpeg";
-	
-	else if(ext == "js")
-		result = "text/javascript";
-		
-	else if(ext == "jsx")
-		result = "text/jsx";
-	
-	else if(ext == "json")
-		result = "application/json";
-	
-	else if(ext == "mid")
-		result = "audio/midi";
-	
-	else if(ext == "midi")
-		result = "audio/midi";
-	
-	else if(ext == "mkv")
-		result = "video/x-matroska";
-	
-	else if(ext == "mpeg")
-		result = "video/mpeg";
-	
-	else if(ext == "mpkg")
-		result = "application/vnd.apple.installer+xml";
-	
-	else if(ext == "mp3")
-		result = "audio/mpeg";
-	
-	else if(ext == "mp4")
-		result = "video/mp4";
-	
-	else if(ext == "odp")
-		result = "application/vnd.oasis.opendocument.presentation";
-	
-	else if(ext == "ods")
-		result = "application/vnd.oasis.opendocument.spreadsheet";
-	
-	else if(ext == "odt")
-		result = "application/vnd.oasis.opendocument.text";
-	
-	else if(ext == "oga")
-		result = "audio/ogg";
-	
-	else if(ext == "ogv")
-		result = "video/ogg";
-	
-	else if(ext == "ogx")
-		result = "application/ogg";
-	
-	else if(ext == "otf")
-		result = "font/otf";
-	
-	else if(ext == "png")
-		result = "image/png";
-	
-	else if(ext == "pdf")
-		result = "application/pdf";
-	
-	else if(ext == "ppt")
-		result = "application/vnd.ms-powerpoint";
-	
-	else if(ext == "pptx")
-		result = "application/vnd.openxmlformats-officedocument.presentationml.presentation";
-	
-	else if(ext == "rar")
-		result = "application/x-rar-compressed";
-	
-	else if(ext == "rtf")
-		result = "application/rtf";
-	
-	else if(ext == "sh")
-		result = "application/x-sh";
-	
-	else if(ext == "svg")
-		result = "image/svg+xml";
-	
-	else if(ext == "swf")
-		result = "application/x-shockwave-flash";
-	
-	else if(ext == "tar")
-		result = "application/x-tar";
-	
-	else if(ext == "tif")
-		result = "image/tiff";
-	
-	else if(ext == "tiff")
-		result = "image/tiff";
-	
-	else if(ext == "ts")
-		result = "application/typescript";
-	
-	else if(ext == "ttf")
-		result = "font/ttf";
-	
-	else if(ext == "txt")
-		result = "text/plain";
-	
-	else if(ext == "vsd")
-		result = "application/vnd.visio";
-	
-	else if(ext == "wav")
-		result = "audio/wav";
-	
-	else if(ext == "weba")
-		result = "audio/webm";
-	
-	else if(ext == "webm")
-		result = "audio/webm";
-	
-	else if(ext == "webp")
-		result = "image/webp";
-	
-	else if(ext == "woff")
-		result = "font/woff";
-	
-	else if(ext == "woff2")
-		result = "font/woff2";
-	
-	else if(ext == "xhtml")
-		result = "application/xhtml+xml";
-	
-	else if(ext == "xls")
-		result = "application/vnd.ms-excel";
-	
-	else if(ext == "xlsx")
-		result = "application/vnd.openxmlformats-officedocument.spreadsheetml.sheet";
-	
-	else if(ext == "xml")
-		result = "application/xml";
-	
-	else if(ext == "xul")
-		result = "application/vnd.mozilla.xul+xml";
-	
-	else if(ext == "zip")
-		result = "application/zip";
-	
-	else if(ext == "3gp")
-		result = "video/3gpp";
-	
-	else if(ext == "3g2")
-		result = "video/3gpp2";
-	
-	else if(ext == "7z")
-		result = "application/x-7z-compressed";
-	
-	else
-		result = "application/octet-stream";
-
-	return result;
-}
-
-
 void explode(const std::string* str,std::string separator,std::vector<std::string>* result)
 {
 	size_t last_position(0),separator_position;
@@ -468,7 +237,17 @@ bool url_decode(const std::string* s,std::string* result)
 		return false;
 	}
 
-	const signed char decoding_hex_charset[256] = {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	return url_decode(s->c_str(), s->size(), result);
+}
+
+bool url_decode(const char* s,size_t len,std::string* result)
+{
+	if(!s or !result)
+	{
+		return false;
+	}
+
+	static const signed char decoding_hex_charset[256] = {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
 												   -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
 												   -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0,
 												   1, 2, 3, 4, 5, 6, 7, 8, 9, -1, -1, -1, -1, -1, -1, -1,
@@ -485,41 +264,44 @@ bool url_decode(const std::string* s,std::string* result)
 												   -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
 												   -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1};
 
-	for(size_t i=0; i<s->size(); i++)
+	size_t i = 0;
+	while(i < len)
 	{
-		
-		if(s[0][i] == '&' or s[0][i] == '=')
+		//the plain characters are copied in one step
+		size_t plain_len = SIMD_Scan_Any(s + i, len - i, "%&=", 3);
+		result->append(s + i, plain_len);
+		i += plain_len;
+
+		if(i == len)
 		{
-			return false;
+			break;
 		}
-		else if(s[0][i] == '%')
-		{
-			if(i + 2 > s->size())
-			{
-				return false;
-			}
 
-			char high_half_pos = decoding_hex_charset[(unsigned char)s[0][i + 1]]; 
-			if(high_half_pos == -1)
-			{
-				return false;
-			}
+		if(s[i] != '%')
+		{
+			return false;
+		}
 
-			char low_half_pos = decoding_hex_charset[(unsigned char)s[0][i + 2]]; 
-			if(low_half_pos == -1)
-			{
-				return false;
-			}
+		if(i + 2 >= len)
+		{
+			return false;
+		}
 
-			char c = (char)( low_half_pos | ( high_half_pos << 4) );
-			result->append(1,c);
-			i+=2;
+		char high_half_pos = decoding_hex_charset[(unsigned char)s[i + 1]]; 
+		if(high_half_pos == -1)
+		{
+			return false;
 		}
 
-		else
+		char low_half_pos = decoding_hex_charset[(unsigned char)s[i + 2]]; 
+		if(low_half_pos == -1)
 		{
-			result->append(1,s[0][i]);
+			return false;
 		}
+
+		char c = (char)( low_half_pos | ( high_half_pos << 4) );
+		result->append(1,c);
+		i+=3;
 	}
 
 	return true;
@@ -24,12 +24,12 @@ std::string str_ansi_to_lower(std::string s);
 std::string str_ansi_to_upper(std::string s);
 
 std::string get_file_extension(const std::string* filename);
-std::string get_MIME_type_by_ext(const std::string* filename);
 
 void explode(const std::string* str,std::string separator,std::vector<std::string>* result);
 
 std::string url_encode(const std::string* s);
 bool url_decode(const std::string* s,std::string* result);
+bool url_decode(const char* s,size_t len,std::string* result);
 
 std::string rectify_path(const char* path);
 std::string rectify_path(const std::string* path);
@@ -0,0 +1,86 @@
+#include "client_queue.h"
+
+#include <new>
+
+bool Client_Queue_Init(struct CLIENT_QUEUE* queue, size_t size)
+{
+	//the position is mapped to a cell with a mask, so the size must be a power of 2
+	if (size < 2 or (size & (size - 1)) != 0)
+	{
+		return false;
+	}
+
+	queue->cells = new (std::nothrow) struct CLIENT_QUEUE_CELL[size];
+	if (!queue->cells)
+	{
+		return false;
+	}
+
+	//a cell is free for the position equal to its sequence, and holds a client for sequence = position + 1
+	for (size_t i = 0; i < size; i++)
+	{
+		queue->cells[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	queue->mask = size - 1;
+	queue->enqueue_position.store(0, std::memory_order_relaxed);
+	queue->dequeue_position = 0;
+
+	return true;
+}
+
+void Client_Queue_Free(struct CLIENT_QUEUE* queue)
+{
+	delete[] (queue->cells);
+	queue->cells = NULL;
+}
+
+bool Client_Queue_Push(struct CLIENT_QUEUE* queue, const HTTP_Worker_Add_Client_Parameters& client)
+{
+	size_t position = queue->enqueue_position.load(std::memory_order_relaxed);
+
+	while (true)
+	{
+		struct CLIENT_QUEUE_CELL* cell = &queue->cells[position & queue->mask];
+		size_t sequence = cell->sequence.load(std::memory_order_acquire);
+		intptr_t difference = (intptr_t) sequence - (intptr_t) position;
+
+		if (difference == 0)
+		{
+			//claim the cell, another producer may take it first
+			if (queue->enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+			{
+				cell->client = client;
+				cell->sequence.store(position + 1, std::memory_order_release);
+				return true;
+			}
+		}
+		else if (difference < 0)
+		{
+			//the consumer did not free the cell yet
+			return false;
+		}
+		else
+		{
+			position = queue->enqueue_position.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+bool Client_Queue_Pop(struct CLIENT_QUEUE* queue, HTTP_Worker_Add_Client_Parameters* client)
+{
+	size_t position = queue->dequeue_position;
+	struct CLIENT_QUEUE_CELL* cell = &queue->cells[position & queue->mask];
+
+	//a claimed cell is not readable until the producer publishes the sequence
+	if (cell->sequence.load(std::memory_order_acquire) != position + 1)
+	{
+		return false;
+	}
+
+	*client = cell->client;
+	cell->sequence.store(position + queue->mask + 1, std::memory_order_release);
+	queue->dequeue_position = position + 1;
+
+	return true;
+}
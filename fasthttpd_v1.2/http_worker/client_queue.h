@@ -0,0 +1,56 @@
+#ifndef __client_queue_incl__
+#define __client_queue_incl__
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include <atomic>
+
+#ifndef DISABLE_HTTPS
+#include <openssl/ssl.h>
+#endif
+
+//accepted socket handed to a worker, the address is formatted by the worker
+typedef struct
+{
+	int client_sock;
+	struct sockaddr_in6 remote_addr; //a sockaddr_in for IPv4 listeners
+	const char *server_addr;
+	uint16_t server_port;
+	bool https;
+	#ifndef DISABLE_HTTPS
+	SSL_CTX *openssl_ctx;
+	#endif
+} HTTP_Worker_Add_Client_Parameters;
+
+#define CLIENT_QUEUE_SIZE 4096
+
+struct CLIENT_QUEUE_CELL
+{
+	std::atomic<size_t> sequence;
+	HTTP_Worker_Add_Client_Parameters client;
+};
+
+//bounded queue, any number of listener threads push and only the owner worker pops
+struct CLIENT_QUEUE
+{
+	struct CLIENT_QUEUE_CELL* cells;
+	size_t mask;
+
+	//the producers and the consumer positions are kept on separate cache lines
+	alignas(64) std::atomic<size_t> enqueue_position;
+	alignas(64) size_t dequeue_position;
+};
+
+bool Client_Queue_Init(struct CLIENT_QUEUE* queue, size_t size);
+void Client_Queue_Free(struct CLIENT_QUEUE* queue);
+
+//false if the queue is full
+bool Client_Queue_Push(struct CLIENT_QUEUE* queue, const HTTP_Worker_Add_Client_Parameters& client);
+
+//false if the queue is empty
+bool Client_Queue_Pop(struct CLIENT_QUEUE* queue, HTTP_Worker_Add_Client_Parameters* client);
+
+#endif
@@ -0,0 +1,477 @@
+#include "content_cache.h"
+#include "http_compression.h"
+
+#include "../server_log.h"
+#include "../helper_functions.h"
+
+#include <new>
+#include <mutex>
+#include <functional>
+#include <cstring>
+#include <errno.h>
+
+#include <unistd.h>
+#include <sys/stat.h>
+
+//the average size used to size the table, smaller files are limited by the number of ways
+#define CONTENT_CACHE_AVERAGE_FILE_SIZE 4096
+
+//the bookkeeping of an entry, counted in the memory budget with its strings
+#define CONTENT_CACHE_ENTRY_OVERHEAD 256
+
+//each worker on its own cache line, the lookups never write a shared line
+struct alignas(64) CONTENT_CACHE_WORKER
+{
+	std::atomic<uint64_t> epoch; //the epoch seen at the last quiescent point, UINT64_MAX before the first one
+	std::atomic<uint64_t> hits;
+	std::atomic<uint64_t> misses;
+};
+
+static bool is_content_cache_enabled = false;
+static size_t content_cache_max_memory;
+static size_t content_cache_max_file_size;
+static size_t content_cache_max_compressed_file_size;
+
+//CONTENT_CACHE_SET_WAYS slots for each set, the number of sets is a power of 2
+static size_t content_cache_sets_num;
+static std::atomic<struct CONTENT_CACHE_ENTRY*>* content_cache_slots = NULL;
+
+static size_t content_cache_workers_num;
+static struct CONTENT_CACHE_WORKER* content_cache_workers = NULL;
+
+//increased after each entry is unpublished, the workers that saw a later value can not reach it
+static std::atomic<uint64_t> content_cache_epoch(1);
+
+//the inserts, the evictions and the frees are serialized, only the misses take it
+static std::mutex content_cache_write_lock;
+static std::atomic<size_t> content_cache_used_memory(0);
+static size_t content_cache_entries = 0;
+static size_t content_cache_clock_hand = 0;
+static std::vector<struct CONTENT_CACHE_ENTRY*> content_cache_retired;
+
+static inline size_t Content_Cache_Entry_Size(const struct CONTENT_CACHE_ENTRY* entry)
+{
+	return CONTENT_CACHE_ENTRY_OVERHEAD + entry->path.size() + entry->content_encoding.size() + entry->content.size() + entry->http1_headers.size() +
+	       entry->content_type.size() + entry->last_modified_date.size() + entry->content_length.size();
+}
+
+void Content_Cache_Init(size_t max_memory, size_t max_file_size, size_t max_compressed_file_size, size_t workers_num)
+{
+	if (max_memory == 0 or max_file_size == 0)
+	{
+		return;
+	}
+
+	content_cache_max_memory = max_memory;
+	content_cache_max_file_size = (max_file_size < max_memory) ? max_file_size : max_memory;
+	content_cache_max_compressed_file_size = max_compressed_file_size;
+
+	content_cache_sets_num = 16;
+	while (content_cache_sets_num * CONTENT_CACHE_SET_WAYS * CONTENT_CACHE_AVERAGE_FILE_SIZE < max_memory and content_cache_sets_num < (1 << 20))
+	{
+		content_cache_sets_num *= 2;
+	}
+
+	content_cache_slots = new (std::nothrow) std::atomic<struct CONTENT_CACHE_ENTRY*>[content_cache_sets_num * CONTENT_CACHE_SET_WAYS];
+	content_cache_workers = new (std::nothrow) struct CONTENT_CACHE_WORKER[workers_num];
+
+	if (!content_cache_slots or !content_cache_workers)
+	{
+		SERVER_ERROR_LOG_stdlib_err("Unable to allocate memory for the content cache!");
+		exit(-1);
+	}
+
+	for (size_t i = 0; i < content_cache_sets_num * CONTENT_CACHE_SET_WAYS; i++)
+	{
+		content_cache_slots[i].store(NULL);
+	}
+
+	content_cache_workers_num = workers_num;
+	for (size_t i = 0; i < workers_num; i++)
+	{
+		content_cache_workers[i].epoch.store(UINT64_MAX);
+		content_cache_workers[i].hits.store(0);
+		content_cache_workers[i].misses.store(0);
+	}
+
+	is_content_cache_enabled = true;
+}
+
+void Content_Cache_Free()
+{
+	if (!is_content_cache_enabled)
+	{
+		return;
+	}
+
+	for (size_t i = 0; i < content_cache_sets_num * CONTENT_CACHE_SET_WAYS; i++)
+	{
+		delete (content_cache_slots[i].load());
+	}
+
+	for (size_t i = 0; i < content_cache_retired.size(); i++)
+	{
+		delete (content_cache_retired[i]);
+	}
+
+	content_cache_retired.clear();
+
+	delete[] content_cache_slots;
+	content_cache_slots = NULL;
+
+	delete[] content_cache_workers;
+	content_cache_workers = NULL;
+
+	content_cache_used_memory = 0;
+	content_cache_entries = 0;
+	is_content_cache_enabled = false;
+}
+
+bool Content_Cache_Is_Eligible(const struct FILE_CACHE_INFO* info, bool compressed)
+{
+	//the content is tied to a version of the file cache, it is stale once the file cache reloads the file
+	size_t max_file_size = compressed ? content_cache_max_compressed_file_size : content_cache_max_file_size;
+	return is_content_cache_enabled and info->version != 0 and !info->is_folder and info->size <= max_file_size;
+}
+
+void Content_Cache_Quiescent(const int worker_id)
+{
+	if (!is_content_cache_enabled)
+	{
+		return;
+	}
+
+	uint64_t epoch = content_cache_epoch.load();
+	if (content_cache_workers[worker_id].epoch.load(std::memory_order_relaxed) != epoch)
+	{
+		content_cache_workers[worker_id].epoch.store(epoch);
+	}
+}
+
+static inline std::atomic<struct CONTENT_CACHE_ENTRY*>* Content_Cache_Set(const std::string& path)
+{
+	return &content_cache_slots[(std::hash<std::string>()(path) & (content_cache_sets_num - 1)) * CONTENT_CACHE_SET_WAYS];
+}
+
+//only the worker writes its counters
+static inline void Content_Cache_Count(std::atomic<uint64_t>* counter)
+{
+	counter->store(counter->load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+const struct CONTENT_CACHE_ENTRY* Content_Cache_Get(const int worker_id, const std::string& path, const struct FILE_CACHE_INFO* info, const char* content_encoding)
+{
+	std::atomic<struct CONTENT_CACHE_ENTRY*>* set = Content_Cache_Set(path);
+
+	for (int i = 0; i < CONTENT_CACHE_SET_WAYS; i++)
+	{
+		struct CONTENT_CACHE_ENTRY* entry = set[i].load();
+		if (entry and entry->file_version == info->version and entry->path == path and entry->content_type == info->content_type and
+		    entry->content_encoding == content_encoding)
+		{
+			uint8_t frequency = entry->frequency.load(std::memory_order_relaxed);
+			if (frequency < CONTENT_CACHE_MAX_FREQUENCY)
+			{
+				entry->frequency.store(frequency + 1, std::memory_order_relaxed);
+			}
+
+			Content_Cache_Count(&content_cache_workers[worker_id].hits);
+			return entry;
+		}
+	}
+
+	Content_Cache_Count(&content_cache_workers[worker_id].misses);
+	return NULL;
+}
+
+//the caller holds content_cache_write_lock
+static void Content_Cache_Replace(std::atomic<struct CONTENT_CACHE_ENTRY*>* slot, struct CONTENT_CACHE_ENTRY* new_entry)
+{
+	struct CONTENT_CACHE_ENTRY* old_entry = slot->exchange(new_entry);
+
+	if (new_entry)
+	{
+		content_cache_used_memory += Content_Cache_Entry_Size(new_entry);
+		content_cache_entries++;
+	}
+
+	if (old_entry)
+	{
+		content_cache_used_memory -= Content_Cache_Entry_Size(old_entry);
+		content_cache_entries--;
+
+		//the workers that announced an epoch up to this one may still read it
+		old_entry->retired_epoch = content_cache_epoch.fetch_add(1);
+		content_cache_retired.push_back(old_entry);
+	}
+}
+
+//the caller holds content_cache_write_lock
+static void Content_Cache_Free_Retired()
+{
+	uint64_t oldest_epoch = UINT64_MAX;
+	for (size_t i = 0; i < content_cache_workers_num; i++)
+	{
+		uint64_t epoch = content_cache_workers[i].epoch.load();
+		if (epoch < oldest_epoch)
+		{
+			oldest_epoch = epoch;
+		}
+	}
+
+	size_t kept_entries = 0;
+	for (size_t i = 0; i < content_cache_retired.size(); i++)
+	{
+		if (content_cache_retired[i]->retired_epoch < oldest_epoch and content_cache_retired[i]->references.load() == 0)
+		{
+			delete (content_cache_retired[i]);
+		}
+		else
+		{
+			content_cache_retired[kept_entries++] = content_cache_retired[i];
+		}
+	}
+
+	content_cache_retired.resize(kept_entries);
+}
+
+static const struct CONTENT_CACHE_ENTRY* Content_Cache_Insert(struct CONTENT_CACHE_ENTRY* new_entry)
+{
+	std::lock_guard<std::mutex> write_guard(content_cache_write_lock);
+
+	std::atomic<struct CONTENT_CACHE_ENTRY*>* set = Content_Cache_Set(new_entry->path);
+	std::atomic<struct CONTENT_CACHE_ENTRY*>* slot = NULL;
+
+	for (int i = 0; i < CONTENT_CACHE_SET_WAYS; i++)
+	{
+		struct CONTENT_CACHE_ENTRY* entry = set[i].load();
+		if (entry and entry->path == new_entry->path and entry->content_encoding == new_entry->content_encoding)
+		{
+			//another worker loaded the same version first
+			if (entry->file_version == new_entry->file_version and entry->content_type == new_entry->content_type)
+			{
+				delete (new_entry);
+				return entry;
+			}
+
+			slot = &set[i];
+			break;
+		}
+
+		if (!entry and !slot)
+		{
+			slot = &set[i];
+		}
+	}
+
+	//clock inside the set, the ways lose a use at each pass until one is unused
+	while (!slot)
+	{
+		for (int i = 0; i < CONTENT_CACHE_SET_WAYS and !slot; i++)
+		{
+			struct CONTENT_CACHE_ENTRY* entry = set[i].load();
+			uint8_t frequency = entry->frequency.load(std::memory_order_relaxed);
+
+			if (frequency == 0)
+			{
+				slot = &set[i];
+			}
+			else
+			{
+				entry->frequency.store(frequency - 1, std::memory_order_relaxed);
+			}
+		}
+	}
+
+	Content_Cache_Replace(slot, new_entry);
+
+	//the same clock over the whole table keeps the memory in the budget
+	size_t slots_num = content_cache_sets_num * CONTENT_CACHE_SET_WAYS;
+	while (content_cache_used_memory.load() > content_cache_max_memory and content_cache_entries > 1)
+	{
+		std::atomic<struct CONTENT_CACHE_ENTRY*>* hand_slot = &content_cache_slots[content_cache_clock_hand];
+		content_cache_clock_hand = (content_cache_clock_hand + 1) & (slots_num - 1);
+
+		struct CONTENT_CACHE_ENTRY* entry = hand_slot->load();
+		if (!entry or entry == new_entry)
+		{
+			continue;
+		}
+
+		uint8_t frequency = entry->frequency.load(std::memory_order_relaxed);
+		if (frequency == 0)
+		{
+			Content_Cache_Replace(hand_slot, NULL);
+		}
+		else
+		{
+			entry->frequency.store(frequency - 1, std::memory_order_relaxed);
+		}
+	}
+
+	Content_Cache_Free_Retired();
+
+	return new_entry;
+}
+
+//false if the file can not be read or it changed while it was read
+static bool Content_Cache_Read_File(const std::string& path, const struct FILE_CACHE_INFO* info, std::string* content)
+{
+	int file_descriptor = File_Cache_Open(path);
+	if (file_descriptor == -1)
+	{
+		return false;
+	}
+
+	content->resize(info->size);
+
+	size_t read_offset = 0;
+	while (read_offset < info->size)
+	{
+		ssize_t read_bytes = pread(file_descriptor, &(*content)[read_offset], info->size - read_offset, read_offset);
+		if (read_bytes == -1 and errno == EINTR)
+		{
+			continue;
+		}
+
+		if (read_bytes <= 0)
+		{
+			break;
+		}
+
+		read_offset += read_bytes;
+	}
+
+	//a file written while it was read is sent from the disk until the file cache sees the change
+	struct stat file_stat;
+	bool is_unchanged = read_offset == info->size and fstat(file_descriptor, &file_stat) == 0 and
+	                    (uint64_t) file_stat.st_size == info->size and file_stat.st_mtime == info->last_modified;
+
+	close(file_descriptor);
+
+	return is_unchanged;
+}
+
+//renders the headers of the content and inserts it, the content is moved into the entry
+static const struct CONTENT_CACHE_ENTRY* Content_Cache_Publish(const std::string& path, const struct FILE_CACHE_INFO* info, const char* content_encoding, std::string* content)
+{
+	struct CONTENT_CACHE_ENTRY* entry = new (std::nothrow) struct CONTENT_CACHE_ENTRY;
+	if (!entry)
+	{
+		SERVER_ERROR_LOG_stdlib_err("Unable to allocate memory for the content cache!");
+		exit(-1);
+	}
+
+	entry->path = path;
+	entry->file_version = info->version;
+	entry->content_encoding = content_encoding;
+	entry->content.swap(*content);
+	entry->frequency.store(1, std::memory_order_relaxed);
+	entry->retired_epoch = 0;
+	entry->references.store(0, std::memory_order_relaxed);
+
+	entry->content_type = info->content_type;
+	entry->last_modified_date = info->last_modified_date;
+	entry->content_length = int2str(entry->content.size());
+
+	//the compressed bytes depend on the encoder, only the meaning of the file is the same
+	entry->etag = info->etag;
+	if (!entry->content_encoding.empty() and entry->etag.compare(0, 2, "W/") != 0)
+	{
+		entry->etag.insert(0, "W/");
+	}
+
+	entry->http1_headers.append("HTTP/1.1 200 OK\r\ncontent-type: ");
+	entry->http1_headers.append(entry->content_type);
+	entry->http1_headers.append("\r\nlast-modified: ");
+	entry->http1_headers.append(entry->last_modified_date);
+	entry->http1_headers.append("\r\netag: ");
+	entry->http1_headers.append(entry->etag);
+	entry->http1_headers.append("\r\ncontent-length: ");
+	entry->http1_headers.append(entry->content_length);
+	entry->http1_headers.append("\r\n");
+
+	//the ranges are served from the file itself, never from a compressed copy
+	int headers_num = 4;
+	if (entry->content_encoding.empty())
+	{
+		entry->http1_headers.append("accept-ranges: bytes\r\n");
+		headers_num = 5;
+	}
+
+	const char* names[] = {"content-type", "last-modified", "etag", "content-length", "accept-ranges"};
+	const std::string* values[] = {&entry->content_type, &entry->last_modified_date, &entry->etag, &entry->content_length, NULL};
+
+	for (int i = 0; i < headers_num; i++)
+	{
+		nghttp2_nv header;
+		header.name = (uint8_t*) names[i];
+		header.namelen = strlen(names[i]);
+		header.value = values[i] ? (uint8_t*) values[i]->c_str() : (uint8_t*) "bytes";
+		header.valuelen = values[i] ? values[i]->size() : 5;
+		header.flags = NGHTTP2_NV_FLAG_NONE;
+
+		entry->http2_headers.push_back(header);
+	}
+
+	return Content_Cache_Insert(entry);
+}
+
+const struct CONTENT_CACHE_ENTRY* Content_Cache_Load(const std::string& path, const struct FILE_CACHE_INFO* info)
+{
+	std::string content;
+	if (!Content_Cache_Read_File(path, info, &content))
+	{
+		return NULL;
+	}
+
+	return Content_Cache_Publish(path, info, "", &content);
+}
+
+const struct CONTENT_CACHE_ENTRY* Content_Cache_Load_Compressed(const std::string& path, const struct FILE_CACHE_INFO* info, int encoding, int level)
+{
+	std::string content;
+	if (!Content_Cache_Read_File(path, info, &content))
+	{
+		return NULL;
+	}
+
+	std::string compressed_content;
+	if (!HTTP_Compress(encoding, level, content.data(), content.size(), &compressed_content))
+	{
+		return NULL;
+	}
+
+	return Content_Cache_Publish(path, info, http_compression_encoding_names[encoding], &compressed_content);
+}
+
+const struct CONTENT_CACHE_ENTRY* Content_Cache_Hold(const struct CONTENT_CACHE_ENTRY* entry)
+{
+	entry->references.fetch_add(1);
+	return entry;
+}
+
+void Content_Cache_Release(const struct CONTENT_CACHE_ENTRY* entry)
+{
+	entry->references.fetch_sub(1);
+}
+
+void Content_Cache_Get_Stats(uint64_t* hits, uint64_t* misses, size_t* used_memory)
+{
+	*hits = 0;
+	*misses = 0;
+	*used_memory = 0;
+
+	if (!is_content_cache_enabled)
+	{
+		return;
+	}
+
+	for (size_t i = 0; i < content_cache_workers_num; i++)
+	{
+		*hits += content_cache_workers[i].hits.load(std::memory_order_relaxed);
+		*misses += content_cache_workers[i].misses.load(std::memory_order_relaxed);
+	}
+
+	*used_memory = content_cache_used_memory.load();
+}
@@ -0,0 +1,83 @@
+#ifndef __content_cache_inc__
+#define __content_cache_inc__
+
+#include "../file_cache.h"
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+
+#include <nghttp2/nghttp2.h>
+
+//ways of a set, a lookup compares at most this many entries
+#define CONTENT_CACHE_SET_WAYS 4
+
+//the use counter saturates, so an entry popular long ago is evicted after a few clock passes
+#define CONTENT_CACHE_MAX_FREQUENCY 3
+
+/*
+the small static files kept in memory together with their pre-rendered headers,
+an entry is immutable once published, the lookups are lock free,
+the replaced entries are freed once every worker passed a quiescent point
+*/
+struct CONTENT_CACHE_ENTRY
+{
+	std::string path;
+	uint64_t file_version; //the version of the file cache entry the content was read from
+	std::string content_encoding; //empty for the file itself, otherwise the encoding applied on the fly
+
+	std::string content;
+
+	//"HTTP/1.1 200 OK\r\n" followed by the "content-type: ...\r\n" lines of the file, without the per request headers like content-encoding
+	std::string http1_headers;
+
+	//the same headers as an HPACK input, pointing inside the strings below
+	std::vector<nghttp2_nv> http2_headers;
+	std::string content_type;
+	std::string last_modified_date;
+	std::string etag;
+	std::string content_length;
+
+	std::atomic<uint8_t> frequency;
+	uint64_t retired_epoch;
+
+	//the HTTP/2 streams and frames still sending the content, a retired entry is freed by a later insert once none is left
+	mutable std::atomic<uint32_t> references;
+};
+
+//max_memory = 0 or max_file_size = 0 disables the cache, the compressed copies have their own file size limit
+void Content_Cache_Init(size_t max_memory, size_t max_file_size, size_t max_compressed_file_size, size_t workers_num);
+void Content_Cache_Free();
+
+//true if the file, or its compressed copy, is small enough to be kept in memory
+bool Content_Cache_Is_Eligible(const struct FILE_CACHE_INFO* info, bool compressed = false);
+
+//called by each worker between two batches of events, the entries it saw before can be freed
+void Content_Cache_Quiescent(const int worker_id);
+
+/*
+NULL if the file is not in memory or its content is older than the file cache entry,
+the content type is compared too, a precompressed copy is sent with the type of the original file,
+the copies compressed on the fly are looked up by their content encoding,
+valid until the next Content_Cache_Quiescent() call of the worker
+*/
+const struct CONTENT_CACHE_ENTRY* Content_Cache_Get(const int worker_id, const std::string& path, const struct FILE_CACHE_INFO* info, const char* content_encoding = "");
+
+//reads the file and publishes it, NULL if it changed while it was read
+const struct CONTENT_CACHE_ENTRY* Content_Cache_Load(const std::string& path, const struct FILE_CACHE_INFO* info);
+
+//reads and compresses the file, the copy is published with the encoding name, NULL on error
+const struct CONTENT_CACHE_ENTRY* Content_Cache_Load_Compressed(const std::string& path, const struct FILE_CACHE_INFO* info, int encoding, int level);
+
+/*
+the content stays valid after Content_Cache_Quiescent() until the entry is released,
+each hold is released once, from any worker
+*/
+const struct CONTENT_CACHE_ENTRY* Content_Cache_Hold(const struct CONTENT_CACHE_ENTRY* entry);
+void Content_Cache_Release(const struct CONTENT_CACHE_ENTRY* entry);
+
+//the counters summed over the workers
+void Content_Cache_Get_Stats(uint64_t* hits, uint64_t* misses, size_t* used_memory);
+
+#endif
@@ -0,0 +1,375 @@
+#include "file_io.h"
+#include "http_worker.h"
+
+#include "../server_log.h"
+#include "../cpu_affinity.h"
+#include "../helper_functions.h"
+
+#include <new>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <sys/eventfd.h>
+
+struct FILE_IO_LOAD
+{
+	int file_descriptor; //a duplicate, the transfer can be closed while it is loaded
+	int64_t offset;
+	int64_t stop_offset;
+	int64_t transfer_stop_offset;
+
+	int worker_id;
+	uint64_t event_data;
+	uint32_t stream_id;
+};
+
+//the I/O threads of a NUMA node, they run on the cpus of the node
+struct FILE_IO_NODE
+{
+	std::mutex queue_lock;
+	std::condition_variable queue_signal;
+	std::deque<struct FILE_IO_LOAD> queue;
+	bool is_stopping;
+
+	std::vector<std::thread*> threads;
+};
+
+struct FILE_IO_WORKER
+{
+	std::mutex completions_lock;
+	std::vector<struct FILE_IO_COMPLETION> completions;
+	int completions_event;
+
+	struct FILE_IO_NODE* node;
+};
+
+static std::vector<int> file_io_node_ids;
+static std::vector<struct FILE_IO_NODE*> file_io_nodes;
+static std::vector<struct FILE_IO_WORKER*> file_io_workers;
+
+static void File_IO_Load_Pages(const struct FILE_IO_LOAD& load)
+{
+	//the pages of the load are read at once, the probes only wait for them
+	posix_fadvise(load.file_descriptor, load.offset, load.stop_offset - load.offset, POSIX_FADV_WILLNEED);
+
+	for (int64_t offset = load.offset; offset < load.stop_offset; offset += FILE_IO_PROBE_STRIDE)
+	{
+		int64_t probe_offset = (load.stop_offset - offset > FILE_IO_PROBE_STRIDE) ? offset + FILE_IO_PROBE_STRIDE - 1 : load.stop_offset - 1;
+
+		char probe_byte;
+		ssize_t read_bytes;
+
+		do
+		{
+			read_bytes = pread(load.file_descriptor, &probe_byte, 1, probe_offset);
+		}
+		while (read_bytes == -1 and errno == EINTR);
+
+		//the errors are reported by the worker when it reads the chunk again
+		if (read_bytes <= 0)
+		{
+			break;
+		}
+	}
+
+	//the kernel loads the next part while the worker sends this one
+	if (load.stop_offset < load.transfer_stop_offset)
+	{
+		posix_fadvise(load.file_descriptor, load.stop_offset, FILE_IO_LOAD_SIZE, POSIX_FADV_WILLNEED);
+	}
+}
+
+static void File_IO_Thread_Main(struct FILE_IO_NODE* node)
+{
+	std::unique_lock<std::mutex> queue_guard(node->queue_lock);
+
+	while (true)
+	{
+		node->queue_signal.wait(queue_guard, [node] { return node->is_stopping or !node->queue.empty(); });
+
+		if (node->is_stopping)
+		{
+			break;
+		}
+
+		struct FILE_IO_LOAD load = node->queue.front();
+		node->queue.pop_front();
+
+		queue_guard.unlock();
+
+		File_IO_Load_Pages(load);
+		close(load.file_descriptor);
+
+		struct FILE_IO_WORKER* worker = file_io_workers[load.worker_id];
+
+		worker->completions_lock.lock();
+		worker->completions.push_back({load.event_data, load.stream_id});
+		worker->completions_lock.unlock();
+
+		uint64_t event_counter = 1;
+		if (write(worker->completions_event, &event_counter, sizeof(event_counter)) == -1 and errno != EAGAIN)
+		{
+			SERVER_ERROR_LOG_stdlib_err("Unable to wake up the http worker after a file load!");
+			exit(-1);
+		}
+
+		queue_guard.lock();
+	}
+}
+
+void File_IO_Init(size_t threads_per_node, size_t workers_num)
+{
+	if (threads_per_node == 0)
+	{
+		return;
+	}
+
+	CPU_Affinity_Get_Nodes(&file_io_node_ids);
+
+	for (size_t i = 0; i < file_io_node_ids.size(); i++)
+	{
+		struct FILE_IO_NODE* node = new (std::nothrow) struct FILE_IO_NODE;
+		if (!node)
+		{
+			SERVER_ERROR_LOG_stdlib_err("Unable to allocate memory for the file I/O threads!");
+			exit(-1);
+		}
+
+		node->is_stopping = false;
+		file_io_nodes.push_back(node);
+
+		std::vector<int> node_cpus;
+		CPU_Affinity_Parse("node" + int2str(file_io_node_ids[i]), &node_cpus);
+
+		for (size_t j = 0; j < threads_per_node; j++)
+		{
+			node->threads.push_back(new std::thread(File_IO_Thread_Main, node));
+
+			//a machine without NUMA nodes in sysfs lets the threads run anywhere
+			if (!node_cpus.empty() and !CPU_Affinity_Bind_Thread(node->threads.back(), node_cpus))
+			{
+				SERVER_ERROR_LOG_stdlib_err("Unable to bind the file I/O thread to its NUMA node!");
+			}
+		}
+	}
+
+	for (size_t i = 0; i < workers_num; i++)
+	{
+		struct FILE_IO_WORKER* worker = new (std::nothrow) struct FILE_IO_WORKER;
+		if (!worker)
+		{
+			SERVER_ERROR_LOG_stdlib_err("Unable to allocate memory for the file I/O completions!");
+			exit(-1);
+		}
+
+		worker->completions_event = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (worker->completions_event == -1)
+		{
+			SERVER_ERROR_LOG_stdlib_err("Unable to create the file I/O completions eventfd!");
+			exit(-1);
+		}
+
+		worker->node = file_io_nodes[0];
+		file_io_workers.push_back(worker);
+	}
+}
+
+void File_IO_Free()
+{
+	for (size_t i = 0; i < file_io_nodes.size(); i++)
+	{
+		struct FILE_IO_NODE* node = file_io_nodes[i];
+
+		node->queue_lock.lock();
+		node->is_stopping = true;
+		node->queue_lock.unlock();
+
+		node->queue_signal.notify_all();
+
+		for (size_t j = 0; j < node->threads.size(); j++)
+		{
+			node->threads[j]->join();
+			delete (node->threads[j]);
+		}
+
+		//the loads left in the queue were never started
+		for (size_t j = 0; j < node->queue.size(); j++)
+		{
+			close(node->queue[j].file_descriptor);
+		}
+
+		delete (node);
+	}
+
+	for (size_t i = 0; i < file_io_workers.size(); i++)
+	{
+		close(file_io_workers[i]->completions_event);
+		delete (file_io_workers[i]);
+	}
+
+	file_io_nodes.clear();
+	file_io_node_ids.clear();
+	file_io_workers.clear();
+}
+
+int File_IO_Worker_Event(const int worker_id)
+{
+	if (file_io_workers.empty())
+	{
+		return -1;
+	}
+
+	return file_io_workers[worker_id]->completions_event;
+}
+
+void File_IO_Bind_Worker(const int worker_id, int cpu)
+{
+	if (file_io_workers.empty() or cpu == -1)
+	{
+		return;
+	}
+
+	int node_id = CPU_Affinity_Get_Node(cpu);
+
+	for (size_t i = 0; i < file_io_node_ids.size(); i++)
+	{
+		if (file_io_node_ids[i] == node_id)
+		{
+			file_io_workers[worker_id]->node = file_io_nodes[i];
+			return;
+		}
+	}
+}
+
+//false if the queue is full or the descriptor can not be duplicated, the worker reads the chunk itself
+static bool File_IO_Queue_Load(const int worker_id, struct GENERIC_HTTP_CONNECTION* conn, struct HTTP_FILE_TRANSFER* file_transfer, const uint32_t stream_id)
+{
+	struct FILE_IO_LOAD load;
+	load.offset = file_transfer->file_offset;
+	load.stop_offset = (file_transfer->stop_offset - load.offset > FILE_IO_LOAD_SIZE) ? load.offset + FILE_IO_LOAD_SIZE : file_transfer->stop_offset;
+	load.transfer_stop_offset = file_transfer->stop_offset;
+	load.worker_id = worker_id;
+	load.event_data = HTTP_WORKER_EVENT_DATA(HTTP_WORKER_EVENT_CONNECTION, conn->event_generation, conn->slot_id);
+	load.stream_id = stream_id;
+
+	struct FILE_IO_NODE* node = file_io_workers[worker_id]->node;
+	std::lock_guard<std::mutex> queue_guard(node->queue_lock);
+
+	if (node->queue.size() >= FILE_IO_MAX_QUEUED_LOADS)
+	{
+		return false;
+	}
+
+	load.file_descriptor = fcntl(file_transfer->file_descriptor, F_DUPFD_CLOEXEC, 0);
+	if (load.file_descriptor == -1)
+	{
+		return false;
+	}
+
+	node->queue.push_back(load);
+	node->queue_signal.notify_one();
+
+	file_transfer->read_pending = true;
+	return true;
+}
+
+ssize_t File_IO_Read(const int worker_id, struct GENERIC_HTTP_CONNECTION* conn, struct HTTP_FILE_TRANSFER* file_transfer, const uint32_t stream_id, char* buffer, size_t len)
+{
+#ifdef RWF_NOWAIT
+	if (!file_io_workers.empty() and file_transfer->nowait_reads)
+	{
+		struct iovec iov = {buffer, len};
+
+		ssize_t read_bytes = preadv2(file_transfer->file_descriptor, &iov, 1, file_transfer->file_offset, RWF_NOWAIT);
+		if (read_bytes != -1 or errno == EINTR)
+		{
+			return read_bytes;
+		}
+
+		if (errno == EAGAIN and File_IO_Queue_Load(worker_id, conn, file_transfer, stream_id))
+		{
+			return FILE_IO_READ_PENDING;
+		}
+
+		//the file system does not support the non blocking reads, they are not tried again
+		if (errno == EOPNOTSUPP)
+		{
+			file_transfer->nowait_reads = false;
+		}
+	}
+#endif
+
+	return pread(file_transfer->file_descriptor, buffer, len, file_transfer->file_offset);
+}
+
+bool File_IO_Is_Resident(const int worker_id, struct GENERIC_HTTP_CONNECTION* conn, struct HTTP_FILE_TRANSFER* file_transfer, const uint32_t stream_id)
+{
+#ifdef RWF_NOWAIT
+	if (file_io_workers.empty() or !file_transfer->nowait_reads or file_transfer->file_offset == file_transfer->stop_offset)
+	{
+		return true;
+	}
+
+	//the first and the last page of the next load, the pages between them are usually loaded together
+	int64_t last_offset = (file_transfer->stop_offset - file_transfer->file_offset > FILE_IO_LOAD_SIZE) ? file_transfer->file_offset + FILE_IO_LOAD_SIZE : file_transfer->stop_offset;
+	int64_t probe_offsets[2] = {file_transfer->file_offset, last_offset - 1};
+
+	for (int i = 0; i < 2; i++)
+	{
+		char probe_byte;
+		struct iovec iov = {&probe_byte, 1};
+
+		if (preadv2(file_transfer->file_descriptor, &iov, 1, probe_offsets[i], RWF_NOWAIT) != -1)
+		{
+			continue;
+		}
+
+		if (errno == EAGAIN)
+		{
+			return !File_IO_Queue_Load(worker_id, conn, file_transfer, stream_id);
+		}
+
+		if (errno == EOPNOTSUPP)
+		{
+			file_transfer->nowait_reads = false;
+			break;
+		}
+	}
+#endif
+
+	return true;
+}
+
+void File_IO_Advise_Transfer(const struct HTTP_FILE_TRANSFER* file_transfer)
+{
+	//the descriptor shares the readahead state with the file cache, the other transfers of the file benefit too
+	if (file_transfer->stop_offset - file_transfer->file_offset >= FILE_IO_SEQUENTIAL_MIN_SIZE)
+	{
+		posix_fadvise(file_transfer->file_descriptor, 0, 0, POSIX_FADV_SEQUENTIAL);
+	}
+}
+
+void File_IO_Receive_Completions(const int worker_id, std::vector<struct FILE_IO_COMPLETION>* completions)
+{
+	struct FILE_IO_WORKER* worker = file_io_workers[worker_id];
+
+	//reset the eventfd before draining, a load finished afterwards triggers a new event
+	uint64_t event_counter;
+	if (read(worker->completions_event, &event_counter, sizeof(event_counter)) == -1 and errno != EAGAIN)
+	{
+		SERVER_ERROR_LOG_stdlib_err("Unable to read the file I/O completions event!");
+		exit(-1);
+	}
+
+	completions->clear();
+
+	worker->completions_lock.lock();
+	completions->swap(worker->completions);
+	worker->completions_lock.unlock();
+}
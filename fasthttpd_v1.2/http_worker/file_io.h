@@ -0,0 +1,64 @@
+#ifndef __file_io_inc__
+#define __file_io_inc__
+
+#include "http_core.h"
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include <sys/types.h>
+
+//returned instead of the read bytes when the chunk is not in memory, the worker is notified once an I/O thread loaded it
+#define FILE_IO_READ_PENDING -2
+
+//an I/O thread loads this much of the transfer at once, so the next chunks are found in memory
+#define FILE_IO_LOAD_SIZE (1024 * 1024)
+
+//an I/O thread waits for the requested pages with a 1 byte read this far apart, nothing is copied
+#define FILE_IO_PROBE_STRIDE (128 * 1024)
+
+//the kernel reads ahead more aggressively for the transfers at least this big
+#define FILE_IO_SEQUENTIAL_MIN_SIZE (4 * 1024 * 1024)
+
+//the loads waiting for the I/O threads of a node, the workers read the next chunks themselves
+#define FILE_IO_MAX_QUEUED_LOADS 1024
+
+//a load done for the file transfer of a connection, the HTTP/2 streams are told apart by their id
+struct FILE_IO_COMPLETION
+{
+	uint64_t event_data;
+	uint32_t stream_id;
+};
+
+/*
+threads_per_node = 0 keeps the reads in the workers,
+otherwise each NUMA node gets its own threads and each worker an eventfd for the completions
+*/
+void File_IO_Init(size_t threads_per_node, size_t workers_num);
+void File_IO_Free();
+
+//the eventfd of the worker completions, -1 if the reads are done by the workers
+int File_IO_Worker_Event(const int worker_id);
+
+//the loads of the worker go to the I/O threads of the NUMA node of its cpu, an unpinned worker (-1) uses the first node
+void File_IO_Bind_Worker(const int worker_id, int cpu);
+
+/*
+reads the next chunk of the transfer like pread() without waiting for the disk,
+a chunk that is not in memory is handed to an I/O thread, the transfer is marked as pending and FILE_IO_READ_PENDING is returned,
+a chunk partially in memory returns the bytes that were found,
+a file system without the non blocking reads is read directly for the rest of the transfer
+*/
+ssize_t File_IO_Read(const int worker_id, struct GENERIC_HTTP_CONNECTION* conn, struct HTTP_FILE_TRANSFER* file_transfer, const uint32_t stream_id, char* buffer, size_t len);
+
+//false if the next chunk of a sendfile() transfer is not in memory, it is handed to an I/O thread like a pending read
+bool File_IO_Is_Resident(const int worker_id, struct GENERIC_HTTP_CONNECTION* conn, struct HTTP_FILE_TRANSFER* file_transfer, const uint32_t stream_id);
+
+//asks the kernel for a larger readahead when the transfer is big enough
+void File_IO_Advise_Transfer(const struct HTTP_FILE_TRANSFER* file_transfer);
+
+//resets the eventfd and takes the completions of the worker
+void File_IO_Receive_Completions(const int worker_id, std::vector<struct FILE_IO_COMPLETION>* completions);
+
+#endif
@@ -7,7 +7,7 @@
 #include <iostream>
 
 
-bool HPACK_encode_headers(nghttp2_hd_deflater *hpack_encoder, const struct HTTP_RESPONSE *response, std::string *result)
+bool HPACK_encode_headers(nghttp2_hd_deflater *hpack_encoder, const struct HTTP_RESPONSE *response, std::string *result, const nghttp2_nv *extra_headers, size_t extra_headers_num)
 {
 	if(!hpack_encoder or !response or !result)
 	{
@@ -15,7 +15,7 @@ bool HPACK_encode_headers(nghttp2_hd_deflater *hpack_encoder, const struct HTTP_
 	}
 	
 	//add the special status header
-	unsigned int headers_num = response->headers.size() + 1;
+	unsigned int headers_num = response->headers.size() + extra_headers_num + 1;
 
 	//compute for set-cookie headers
 	if(response->COOKIES)
@@ -54,6 +54,11 @@ bool HPACK_encode_headers(nghttp2_hd_deflater *hpack_encoder, const struct HTTP_
 		header_index++;
 	}
 
+	for(size_t i = 0; i < extra_headers_num; i++)
+	{
+		nva[header_index++] = extra_headers[i];
+	}
+
 	//add set-cookie headers
 	std::vector<std::string> set_cookie_h_val;
 	if (response->COOKIES)
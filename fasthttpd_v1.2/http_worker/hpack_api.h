@@ -4,7 +4,8 @@
 #include "http2_core.h"
 #include <nghttp2/nghttp2.h>
 
-bool HPACK_encode_headers(nghttp2_hd_deflater *hpack_encoder, const struct HTTP_RESPONSE *response, std::string *result);
+//extra_headers are encoded after the headers of the response, like the pre-rendered headers of a cached file
+bool HPACK_encode_headers(nghttp2_hd_deflater *hpack_encoder, const struct HTTP_RESPONSE *response, std::string *result, const nghttp2_nv *extra_headers = NULL, size_t extra_headers_num = 0);
 bool HPACK_decode_headers(nghttp2_hd_inflater *hpack_decoder, const std::string& raw_headers, std::unordered_map<std::string, std::string>* headers);
 
 #endif
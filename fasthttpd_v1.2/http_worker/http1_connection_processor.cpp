@@ -1,6 +1,8 @@
 #include "http_worker.h"
 #include "http1_connection_processor.h"
 #include "http_parser.h"
+#include "http_compression.h"
+#include "file_io.h"
 
 #include "../server_config.h"
 #include "../server_log.h"
@@ -8,13 +10,14 @@
 
 #include <unistd.h>
 #include <cstring>
+#include <cstdio>
 
 int HTTP1_Connection_Read_Incoming_Data(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn)
 {
 	struct HTTP1_CONNECTION *http_conn = (struct HTTP1_CONNECTION *)conn->raw_connection;
 
-	uint32_t recv_buff_size = str2uint(SERVER_CONFIGURATION["read_buffer_size"]);
-    uint64_t max_req_size = str2uint(SERVER_CONFIGURATION["max_request_size"]) * 1024;
+	uint32_t recv_buff_size = server_runtime_config->read_buffer_size;
+    uint64_t max_req_size = server_runtime_config->max_request_size;
 
 	bool should_stop = false;
 	while (!should_stop)
@@ -34,44 +37,137 @@ int HTTP1_Connection_Read_Incoming_Data(const int worker_id, struct GENERIC_HTTP
 
 		http_conn->recv_buffer.append(http_workers[worker_id].recv_buffer, read_bytes);
 
-		if(http_conn->recv_buffer.size() > max_req_size)
+        // the pipelined requests can sum over the limit, the parser checks the size of each one
+        if (http_conn->recv_buffer.size() > max_req_size)
         {
-            return HTTP_Request_Set_Error_Page(worker_id, conn, 0, 413);
+            return HTTP1_CONNECTION_READ_STOPPED;
+        }
+
+        // a short read drains a plain socket, the next edge will signal new data
+        // SSL can hold already decrypted records, so keep reading until it reports no data
+        if (!conn->https and (uint32_t)read_bytes < recv_buff_size)
+        {
+            should_stop = true;
         }
 	}
 
     return HTTP_CONNECTION_OK;
 }
 
+bool HTTP1_Connection_Find_First_Line_End(struct HTTP1_CONNECTION *http_conn)
+{
+    size_t stop_pos = http_conn->recv_buffer.find('\n', http_conn->parser_helper.scan_offset);
+    if (stop_pos == std::string::npos)
+    {
+        // resume from here when more data arrives
+        http_conn->parser_helper.scan_offset = http_conn->recv_buffer.size();
+        return false;
+    }
+
+    // the headers end can be right after the first line
+    http_conn->parser_helper.scan_offset = stop_pos;
+    return true;
+}
+
+// neither kept alive nor upgraded, the connection is closed after the response
+static bool HTTP1_Connection_Closes_After_Response(struct HTTP1_CONNECTION *http_conn)
+{
+    auto connection_header = http_conn->response.headers.find("connection");
+    return connection_header == http_conn->response.headers.end() or (connection_header->second != "keep-alive" and connection_header->second != "upgrade");
+}
+
 int HTTP1_Connection_Send_Data(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn)
 {
 	struct HTTP1_CONNECTION *http_conn = (struct HTTP1_CONNECTION *)conn->raw_connection;
 
+    // the response of a pipelined request is held back and sent together with the next ones
+    if (conn->state == HTTP_STATE_CONTENT_BOUND and !http_conn->pipeline_buffer.empty() and
+        http_conn->send_buffer.size() - http_conn->send_buffer_offset < HTTP1_PIPELINE_MAX_BATCH_SIZE)
+    {
+        auto connection_header = http_conn->response.headers.find("connection");
+        if (connection_header != http_conn->response.headers.end() and connection_header->second == "keep-alive")
+        {
+            HTTP1_Connection_Next_Request(http_conn, true);
+            conn->state = HTTP_STATE_WAIT_PATH;
+            return HTTP_CONNECTION_OK;
+        }
+    }
+
 	bool should_stop = false;
 	while (!should_stop)
 	{
-        const char* send_buffer = (http_conn->send_buffer.c_str() +  http_conn->send_buffer_offset);
-        size_t bytes_to_send = http_conn->send_buffer.size() - http_conn->send_buffer_offset;
+        // the buffer is already sent when resuming a zero copy file transfer
+        if(http_conn->send_buffer_offset < http_conn->send_buffer.size())
+        {
+            // the last response is sent by the io_uring, in the same submission as the close
+            if (conn->state != HTTP_STATE_FILE_BOUND and HTTP1_Connection_Closes_After_Response(http_conn) and
+                Generic_Connection_Send_And_Delete(worker_id, conn, &http_conn->send_buffer, http_conn->send_buffer_offset))
+            {
+                return HTTP_CONNECTION_DELETED;
+            }
 
-		int32_t sent_bytes = Network_Write_Bytes(conn, (void*)send_buffer, bytes_to_send);
-		if (sent_bytes < 0)
-		{
-			Generic_Connection_Delete(worker_id, conn);
-			return HTTP_CONNECTION_DELETED;
-		}
+            const char* send_buffer = (http_conn->send_buffer.c_str() +  http_conn->send_buffer_offset);
+            size_t bytes_to_send = http_conn->send_buffer.size() - http_conn->send_buffer_offset;
 
-		if (sent_bytes == 0)
-		{
-			should_stop = true;
-			continue;
-		}
+            bool more_data = (conn->state == HTTP_STATE_FILE_BOUND and (http_conn->file_transfer.file_offset != http_conn->file_transfer.stop_offset or
+                              http_conn->file_transfer.next_part != http_conn->file_transfer.parts.size()));
 
-		http_conn->send_buffer_offset += sent_bytes;
+            int32_t sent_bytes = Network_Write_Bytes(conn, (void*)send_buffer, bytes_to_send, more_data);
+            if (sent_bytes < 0)
+            {
+                Generic_Connection_Delete(worker_id, conn);
+                return HTTP_CONNECTION_DELETED;
+            }
+
+            if (sent_bytes == 0)
+            {
+                should_stop = true;
+                continue;
+            }
+
+            http_conn->send_buffer_offset += sent_bytes;
+        }
 
 		if(http_conn->send_buffer_offset == http_conn->send_buffer.size())
 		{
             if(conn->state == HTTP_STATE_FILE_BOUND)
             {
+                // the next chunk is loaded by an I/O thread, its completion resumes the transfer
+                if(http_conn->file_transfer.read_pending)
+                {
+                    should_stop = true;
+                    continue;
+                }
+
+                // the header of the next multipart/byteranges part goes through the send buffer
+                if(HTTP_File_Transfer_Next_Part(&http_conn->file_transfer, &http_conn->send_buffer))
+                {
+                    http_conn->send_buffer_offset = 0;
+                    continue;
+                }
+
+                if(http_conn->file_transfer.file_offset != http_conn->file_transfer.stop_offset and http_conn->file_transfer.zero_copy)
+                {
+                    // sendfile() would block the worker on the pages missing from memory
+                    if(!File_IO_Is_Resident(worker_id, conn, &http_conn->file_transfer, 0))
+                    {
+                        should_stop = true;
+                        continue;
+                    }
+
+                    if(HTTP1_Connection_Send_File(worker_id, conn) == HTTP_CONNECTION_DELETED)
+                    {
+                        return HTTP_CONNECTION_DELETED;
+                    }
+
+                    // the socket is full, wait until it becomes writable
+                    if(http_conn->file_transfer.file_offset != http_conn->file_transfer.stop_offset and http_conn->file_transfer.zero_copy)
+                    {
+                        should_stop = true;
+                        continue;
+                    }
+                }
+
                 if(http_conn->file_transfer.file_offset != http_conn->file_transfer.stop_offset)
                 {
                     if(HTTP1_Connection_Load_File_Chunk(worker_id, conn) == HTTP_CONNECTION_DELETED)
@@ -81,6 +177,11 @@ int HTTP1_Connection_Send_Data(const int worker_id, struct GENERIC_HTTP_CONNECTI
 
                     continue;
                 }
+
+                if(http_conn->file_transfer.next_part != http_conn->file_transfer.parts.size())
+                {
+                    continue;
+                }
             }
 
             auto connection_header = http_conn->response.headers.find("connection");
@@ -94,7 +195,7 @@ int HTTP1_Connection_Send_Data(const int worker_id, struct GENERIC_HTTP_CONNECTI
 
                 else if(connection_header->second == "keep-alive")
                 {
-                    HTTP1_Connection_Delete(http_conn);
+                    HTTP1_Connection_Next_Request(http_conn, false);
                     conn->state = HTTP_STATE_WAIT_PATH;
                     return HTTP_CONNECTION_OK;
                 }
@@ -109,11 +210,118 @@ int HTTP1_Connection_Send_Data(const int worker_id, struct GENERIC_HTTP_CONNECTI
 	return HTTP_CONNECTION_OK;
 }
 
+int HTTP1_Connection_Flush_Send_Buffer(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn)
+{
+    struct HTTP1_CONNECTION *http_conn = (struct HTTP1_CONNECTION *)conn->raw_connection;
+
+    while (http_conn->send_buffer_offset < http_conn->send_buffer.size())
+    {
+        const char* send_buffer = (http_conn->send_buffer.c_str() +  http_conn->send_buffer_offset);
+        size_t bytes_to_send = http_conn->send_buffer.size() - http_conn->send_buffer_offset;
+
+        int32_t sent_bytes = Network_Write_Bytes(conn, (void*)send_buffer, bytes_to_send, false);
+        if (sent_bytes < 0)
+        {
+            Generic_Connection_Delete(worker_id, conn);
+            return HTTP_CONNECTION_DELETED;
+        }
+
+        if (sent_bytes == 0)
+        {
+            return HTTP_CONNECTION_OK;
+        }
+
+        http_conn->send_buffer_offset += sent_bytes;
+    }
+
+    http_conn->send_buffer.clear();
+    http_conn->send_buffer_offset = 0;
+
+    return HTTP_CONNECTION_OK;
+}
+
+int HTTP1_Connection_Send_Content(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn, const std::string &content)
+{
+    struct HTTP1_CONNECTION *http_conn = (struct HTTP1_CONNECTION *)conn->raw_connection;
+
+    // the headers and the content leave with a single writev, only the part the socket did not take is copied
+    size_t content_offset = 0;
+    if (!conn->https and http_conn->pipeline_buffer.empty())
+    {
+        struct iovec iov[2];
+        iov[0].iov_base = (void*)(http_conn->send_buffer.c_str() + http_conn->send_buffer_offset);
+        iov[0].iov_len = http_conn->send_buffer.size() - http_conn->send_buffer_offset;
+        iov[1].iov_base = (void*)content.c_str();
+        iov[1].iov_len = content.size();
+
+        int32_t sent_bytes = Network_Write_Vector(conn, iov, 2);
+        if (sent_bytes < 0)
+        {
+            Generic_Connection_Delete(worker_id, conn);
+            return HTTP_CONNECTION_DELETED;
+        }
+
+        size_t sent_header_bytes = ((size_t)sent_bytes < iov[0].iov_len) ? sent_bytes : iov[0].iov_len;
+        http_conn->send_buffer_offset += sent_header_bytes;
+        content_offset = sent_bytes - sent_header_bytes;
+    }
+
+    // the TLS records and the held back pipelined responses go through the send buffer
+    if (content_offset < content.size())
+    {
+        http_conn->send_buffer.append(content, content_offset, std::string::npos);
+    }
+
+    return HTTP1_Connection_Send_Data(worker_id, conn);
+}
+
+int HTTP1_Connection_Send_File(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn)
+{
+    struct HTTP1_CONNECTION *http_conn = (struct HTTP1_CONNECTION *)conn->raw_connection;
+
+    while (http_conn->file_transfer.file_offset != http_conn->file_transfer.stop_offset)
+    {
+        uint64_t remaining_bytes = http_conn->file_transfer.stop_offset - http_conn->file_transfer.file_offset;
+
+        int sent_bytes = Network_Sendfile(conn, http_conn->file_transfer.file_descriptor, &http_conn->file_transfer.file_offset, remaining_bytes);
+
+        if (sent_bytes == NETWORK_SENDFILE_UNSUPPORTED)
+        {
+            // continue the transfer by copying the file chunks
+            http_conn->file_transfer.zero_copy = false;
+            break;
+        }
+
+        // the promised content length can not be sent anymore
+        if (sent_bytes == NETWORK_SENDFILE_EOF)
+        {
+            std::string err_msg = "The requested file was truncated while it was sent (";
+            err_msg.append(http_conn->request.URI_path);
+            err_msg.append(" )");
+
+            SERVER_ERROR_LOG_stdlib_err(err_msg.c_str());
+        }
+
+        if (sent_bytes < 0)
+        {
+            Generic_Connection_Delete(worker_id, conn);
+            return HTTP_CONNECTION_DELETED;
+        }
+
+        if (sent_bytes == 0)
+        {
+            break;
+        }
+    }
+
+    return HTTP_CONNECTION_OK;
+}
+
 int HTTP1_Connection_Load_File_Chunk(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn)
 {
     struct HTTP1_CONNECTION *http_conn = (struct HTTP1_CONNECTION *)conn->raw_connection;
 
-    uint32_t max_read_size = str2uint(SERVER_CONFIGURATION["read_buffer_size"]) * 1024;
+    uint32_t max_read_size = server_runtime_config->read_buffer_size;
 
     uint64_t remaining_bytes = http_conn->file_transfer.stop_offset - http_conn->file_transfer.file_offset;
     uint64_t bytes_to_read = (remaining_bytes > max_read_size) ? max_read_size : remaining_bytes;
@@ -124,7 +332,13 @@ int HTTP1_Connection_Load_File_Chunk(const int worker_id, struct GENERIC_HTTP_CO
 
     while (!should_stop)
     {
-        read_bytes = pread(http_conn->file_transfer.file_descriptor, http_workers[worker_id].recv_buffer, bytes_to_read, http_conn->file_transfer.file_offset);
+        read_bytes = File_IO_Read(worker_id, conn, &http_conn->file_transfer, 0, http_workers[worker_id].recv_buffer, bytes_to_read);
+
+        // the send loop waits for the I/O thread
+        if (read_bytes == FILE_IO_READ_PENDING)
+        {
+            return HTTP_CONNECTION_OK;
+        }
 
         if (read_bytes == -1)
         {
@@ -148,9 +362,60 @@ int HTTP1_Connection_Load_File_Chunk(const int worker_id, struct GENERIC_HTTP_CO
         should_stop = true;
     }
 
+    // the file shrinks while it is sent, the rest of the content length would never come
+    if (read_bytes == 0)
+    {
+        std::string err_msg = "The requested file was truncated while it was sent (";
+        err_msg.append(http_conn->request.URI_path);
+        err_msg.append(" )");
+
+        SERVER_ERROR_LOG_stdlib_err(err_msg.c_str());
+
+        Generic_Connection_Delete(worker_id, conn);
+        return HTTP_CONNECTION_DELETED;
+    }
+
     http_conn->file_transfer.file_offset += read_bytes;
     http_conn->send_buffer_offset = 0;
-    http_conn->send_buffer = std::string(http_workers[worker_id].recv_buffer, read_bytes);
+
+    if (!http_conn->file_transfer.compressor)
+    {
+        http_conn->send_buffer = std::string(http_workers[worker_id].recv_buffer, read_bytes);
+        return HTTP_CONNECTION_OK;
+    }
+
+    bool last_chunk = http_conn->file_transfer.file_offset == http_conn->file_transfer.stop_offset;
+
+    std::string compressed_data;
+    if (!HTTP_Compressor_Update(http_conn->file_transfer.compressor, http_workers[worker_id].recv_buffer, read_bytes, last_chunk, &compressed_data))
+    {
+        std::string err_msg = "Unable to compress the requested file (";
+        err_msg.append(http_conn->request.URI_path);
+        err_msg.append(" )");
+
+        SERVER_ERROR_LOG_stdlib_err(err_msg.c_str());
+
+        Generic_Connection_Delete(worker_id, conn);
+        return HTTP_CONNECTION_DELETED;
+    }
+
+    // the encoder can keep the whole input, an empty buffer makes the send loop read the next chunk
+    http_conn->send_buffer.clear();
+
+    if (!compressed_data.empty())
+    {
+        char chunk_size[24];
+        snprintf(chunk_size, sizeof(chunk_size), "%zx\r\n", compressed_data.size());
+
+        http_conn->send_buffer.append(chunk_size);
+        http_conn->send_buffer.append(compressed_data);
+        http_conn->send_buffer.append("\r\n");
+    }
+
+    if (last_chunk)
+    {
+        http_conn->send_buffer.append("0\r\n\r\n");
+    }
 
     return HTTP_CONNECTION_OK;
 }
@@ -158,6 +423,11 @@ int HTTP1_Connection_Load_File_Chunk(const int worker_id, struct GENERIC_HTTP_CO
 void HTTP1_Connection_Init(struct HTTP1_CONNECTION *http_conn)
 {
     http_conn->send_buffer_offset = 0;
+    http_conn->parser_helper.scan_offset = 0;
+
+    http_conn->header_index.raw_request = &http_conn->recv_buffer;
+    http_conn->header_index.size = 0;
+    http_conn->request.header_index = &http_conn->header_index;
 
     http_conn->request.COOKIES = NULL;
     http_conn->request.POST_query = NULL;
@@ -167,6 +437,14 @@ void HTTP1_Connection_Init(struct HTTP1_CONNECTION *http_conn)
     http_conn->response.COOKIES = NULL;
 
     http_conn->file_transfer.file_descriptor = -1;
+    http_conn->file_transfer.zero_copy = false;
+    http_conn->file_transfer.read_pending = false;
+    http_conn->file_transfer.nowait_reads = false;
+    http_conn->file_transfer.compressor = NULL;
+    http_conn->file_transfer.parts.clear();
+    http_conn->file_transfer.next_part = 0;
+
+    http_conn->keep_alive_reused = false;
 }
 
 void HTTP1_Connection_HTTP2_101_Upgrade(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn)
@@ -197,6 +475,9 @@ void HTTP1_Connection_HTTP2_101_Upgrade(const int worker_id, struct GENERIC_HTTP
         return;
     }
     
+    //the HTTP/1.1 receive buffer is freed, so the headers are copied into the map
+    HTTP_Request_Materialize_Headers(&http_conn->request);
+
     struct HTTP_REQUEST& request = http2_conn->streams[1].request;
     request.method = http_conn->request.method;
     request.URI_path = http_conn->request.URI_path;
@@ -271,29 +552,84 @@ void HTTP1_Connection_HTTP2_Upgrade_Directly(const int worker_id, struct GENERIC
     }
 }
 
-void HTTP1_Connection_Process(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn)
+bool HTTP1_Connection_Is_Active(const struct GENERIC_HTTP_CONNECTION *conn, const uint32_t event_generation)
+{
+    // the slot keeps its address after the connection is deleted, the generation tells if it was reused
+    if (!conn->in_use or conn->event_generation != event_generation)
+    {
+        return false;
+    }
+
+    // the connection can also be upgraded to HTTP/2 by the request
+    return (conn->http_version == HTTP_VERSION_1 or conn->http_version == HTTP_VERSION_1_1);
+}
+
+void HTTP1_Connection_Split_Pipelined_Data(struct HTTP1_CONNECTION *http_conn, size_t request_end_offset)
+{
+    if (http_conn->recv_buffer.size() > request_end_offset)
+    {
+        http_conn->pipeline_buffer.assign(http_conn->recv_buffer, request_end_offset, std::string::npos);
+        http_conn->recv_buffer.resize(request_end_offset);
+    }
+}
+
+void HTTP1_Connection_Next_Request(struct HTTP1_CONNECTION *http_conn, bool keep_send_buffer)
+{
+    std::string pipelined_data;
+    pipelined_data.swap(http_conn->pipeline_buffer);
+
+    std::string pending_response;
+    size_t pending_response_offset = 0;
+
+    if (keep_send_buffer)
+    {
+        pending_response.swap(http_conn->send_buffer);
+        pending_response_offset = http_conn->send_buffer_offset;
+    }
+
+    HTTP1_Connection_Delete(http_conn);
+
+    http_conn->recv_buffer.swap(pipelined_data);
+    http_conn->send_buffer.swap(pending_response);
+    http_conn->send_buffer_offset = pending_response_offset;
+
+    http_conn->keep_alive_reused = true;
+}
+
+// the request being parsed starts the buffer, its headers are not complete yet so everything buffered belongs to it
+static int HTTP1_Connection_Check_Incomplete_Size(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn)
 {
     struct HTTP1_CONNECTION *http_conn = (struct HTTP1_CONNECTION *)conn->raw_connection;
 
-    if (conn->state == HTTP_STATE_WAIT_PATH or conn->state == HTTP_STATE_WAIT_HEADERS or conn->state == HTTP_STATE_WAIT_BODY)
+    if (http_conn->recv_buffer.size() > server_runtime_config->max_request_size)
     {
-        if(HTTP1_Connection_Read_Incoming_Data(worker_id, conn) == HTTP_CONNECTION_DELETED)
-        {
-            return;
-        }
+        HTTP_Request_Set_Error_Page(worker_id, conn, 0, 413);
+        return HTTP_PARSER_DONE;
     }
 
-    if (conn->state == HTTP_STATE_WAIT_PATH and http_conn->recv_buffer.find("\n") != std::string::npos)
+    return HTTP_PARSER_INCOMPLETE;
+}
+
+int HTTP1_Connection_Parse_Request(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn)
+{
+    struct HTTP1_CONNECTION *http_conn = (struct HTTP1_CONNECTION *)conn->raw_connection;
+
+    if (conn->state == HTTP_STATE_WAIT_PATH)
     {
+        if (!HTTP1_Connection_Find_First_Line_End(http_conn))
+        {
+            return HTTP1_Connection_Check_Incomplete_Size(worker_id, conn);
+        }
+
         // extract the path, the http version and the method
-        std::string raw_URI;
+        size_t URI_start, URI_len;
         int http_ver;
         int method;
 
-        if (!HTTP_Parse_Request_First_Line(http_conn->recv_buffer, &raw_URI, &method, &http_ver, &http_conn->parser_helper.headers_start_offset))
+        if (!HTTP_Parse_Request_First_Line(http_conn->recv_buffer, &URI_start, &URI_len, &method, &http_ver, &http_conn->parser_helper.headers_start_offset))
         {
             HTTP_Request_Set_Error_Page(worker_id, conn, 0, 400);
-            return;
+            return HTTP_PARSER_DONE;
         }
 
         if (http_ver == HTTP_VERSION_1)
@@ -307,100 +643,154 @@ void HTTP1_Connection_Process(const int worker_id, struct GENERIC_HTTP_CONNECTIO
         else if (http_ver == HTTP_VERSION_2 and memcmp(http_conn->recv_buffer.c_str(), HTTP2_magic_hello, 24) == 0)
         {
             HTTP1_Connection_HTTP2_Upgrade_Directly(worker_id, conn);
-            return;
+            return HTTP_PARSER_DONE;
         }
         else
         {
             HTTP_Request_Set_Error_Page(worker_id, conn, 0, 400);
-            return;
+            return HTTP_PARSER_DONE;
         }
 
         if (method == HTTP_METHOD_UNDEFINED)
         {
             HTTP_Request_Set_Error_Page(worker_id, conn, 0, 400);
-            return;
+            return HTTP_PARSER_DONE;
         }
         else
         {
             http_conn->request.method = method;
         }
 
-        unsigned int max_query_arg_limit = str2uint(&SERVER_CONFIGURATION["max_query_args"]);
-
-        bool continue_if_arg_limit_exceeded = false;
-        if (is_server_config_variable_true("continue_if_args_limit_exceeded"))
-        {
-            continue_if_arg_limit_exceeded = true;
-        }
-
-        if (!HTTP_Parse_Raw_URI(raw_URI, &http_conn->request.URI_path, &http_conn->request.URI_query, max_query_arg_limit, continue_if_arg_limit_exceeded))
+        if (!HTTP_Parse_Raw_URI(http_conn->recv_buffer, URI_start, URI_len, &http_conn->request.URI_path, &http_conn->request.URI_query, server_runtime_config->max_query_args, server_runtime_config->continue_if_args_limit_exceeded))
         {  
             HTTP_Request_Set_Error_Page(worker_id, conn, 0, 400);
-            return;
+            return HTTP_PARSER_DONE;
         }
 
+        // the header lines are parsed as they arrive
+        http_conn->parser_helper.scan_offset = http_conn->parser_helper.headers_start_offset;
+        http_conn->parser_helper.line_start_offset = http_conn->parser_helper.headers_start_offset;
+
         conn->state = HTTP_STATE_WAIT_HEADERS;
     }
 
-    if (conn->state == HTTP_STATE_WAIT_HEADERS and (http_conn->recv_buffer.find("\r\n\r\n", http_conn->parser_helper.headers_start_offset) != std::string::npos 
-                                                    or http_conn->recv_buffer.find("\n\n", http_conn->parser_helper.headers_start_offset) != std::string::npos))
+    if (conn->state == HTTP_STATE_WAIT_HEADERS)
     {
-        if (!HTTP_Parse_Request_Headers(http_conn->recv_buffer, http_conn->parser_helper.headers_start_offset, &http_conn->request.headers, &http_conn->parser_helper.body_start_offset))
+        int parse_result = HTTP_Parse_Request_Headers(http_conn->recv_buffer, &http_conn->parser_helper, &http_conn->request);
+        if (parse_result == HTTP_PARSER_ERROR)
         {
             HTTP_Request_Set_Error_Page(worker_id, conn, 0, 400);
-            return;
+            return HTTP_PARSER_DONE;
+        }
+        else if (parse_result == HTTP_PARSER_INCOMPLETE)
+        {
+            return HTTP1_Connection_Check_Incomplete_Size(worker_id, conn);
         }
 
         if (http_conn->request.method == HTTP_METHOD_POST or http_conn->request.method == HTTP_METHOD_PUT)
         {
             // parse the content length and check the validity
-            auto content_len_header = http_conn->request.headers.find("content-length");
-            if (content_len_header == http_conn->request.headers.end())
+            std::string content_len_header;
+            if (!HTTP_Request_Get_Header(&http_conn->request, "content-length", &content_len_header))
             {
                 HTTP_Request_Set_Error_Page(worker_id, conn, 0, 411);
-                return;
+                return HTTP_PARSER_DONE;
             }
 
             bool invalid_num = true;
-            http_conn->parser_helper.content_length = str2uint(content_len_header->second, &invalid_num);
+            http_conn->parser_helper.content_length = str2uint(content_len_header, &invalid_num);
 
             if (invalid_num)
             {
                 HTTP_Request_Set_Error_Page(worker_id, conn, 0, 400);
-                return;
+                return HTTP_PARSER_DONE;
             }
 
             conn->state = HTTP_STATE_WAIT_BODY;
         }
         else
         {
-            http_conn->recv_buffer.clear();
+            // the header index points inside recv_buffer, it is cleared after the response
+            HTTP1_Connection_Split_Pipelined_Data(http_conn, http_conn->parser_helper.body_start_offset);
+
             conn->state = HTTP_STATE_PROCESSING;
             HTTP_Request_Process(worker_id, conn, 0);
-            return;
+            return HTTP_PARSER_DONE;
         }
     }
     if (conn->state == HTTP_STATE_WAIT_BODY)
     {  
         uint64_t full_request_len = http_conn->parser_helper.body_start_offset + http_conn->parser_helper.content_length;
 
-        if(full_request_len > str2uint(SERVER_CONFIGURATION["max_request_size"]) * 1024)
+        if(full_request_len > server_runtime_config->max_request_size)
         {
             HTTP_Request_Set_Error_Page(worker_id, conn, 0, 413);
-            return;
+            return HTTP_PARSER_DONE;
         }
 
-        if(http_conn->recv_buffer.size() == http_conn->parser_helper.body_start_offset + http_conn->parser_helper.content_length)
+        if(http_conn->recv_buffer.size() >= full_request_len)
         {
+            // the body parsers read up to the end of recv_buffer
+            HTTP1_Connection_Split_Pipelined_Data(http_conn, full_request_len);
+
             conn->state = HTTP_STATE_PROCESSING;
             HTTP_Request_Process(worker_id, conn, 0);
-            return;
+            return HTTP_PARSER_DONE;
         }
     }
 
-    if (conn->state == HTTP_STATE_CONTENT_BOUND or conn->state == HTTP_STATE_FILE_BOUND)
+    return HTTP_PARSER_INCOMPLETE;
+}
+
+void HTTP1_Connection_Process(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn)
+{
+    const uint32_t event_generation = conn->event_generation;
+    bool socket_read = false;
+
+    // the pipelined requests are parsed from the buffer, the socket is read only when they run out
+    while (true)
     {
-        HTTP1_Connection_Send_Data(worker_id, conn);
+        if (conn->state == HTTP_STATE_CONTENT_BOUND or conn->state == HTTP_STATE_FILE_BOUND)
+        {
+            if (HTTP1_Connection_Send_Data(worker_id, conn) == HTTP_CONNECTION_DELETED or conn->state != HTTP_STATE_WAIT_PATH)
+            {
+                return;
+            }
+
+            // the requests received while the response was sent did not trigger a new event
+            socket_read = false;
+        }
+
+        if (conn->state != HTTP_STATE_WAIT_PATH and conn->state != HTTP_STATE_WAIT_HEADERS and conn->state != HTTP_STATE_WAIT_BODY)
+        {
+            return;
+        }
+
+        if (HTTP1_Connection_Parse_Request(worker_id, conn) == HTTP_PARSER_INCOMPLETE)
+        {
+            if (socket_read)
+            {
+                // send the responses held back for the pipelined requests
+                HTTP1_Connection_Flush_Send_Buffer(worker_id, conn);
+                return;
+            }
+
+            int read_result = HTTP1_Connection_Read_Incoming_Data(worker_id, conn);
+            if (read_result == HTTP_CONNECTION_DELETED)
+            {
+                return;
+            }
+
+            // the data left in the socket does not trigger a new event, it is read once the buffered requests are parsed
+            socket_read = (read_result != HTTP1_CONNECTION_READ_STOPPED);
+            continue;
+        }
+
+        // the request was answered, the connection may be closed or waiting for the socket
+        if (!HTTP1_Connection_Is_Active(conn, event_generation) or conn->state != HTTP_STATE_WAIT_PATH)
+        {
+            return;
+        }
     }
 }
 
@@ -408,13 +798,14 @@ void HTTP1_Connection_Generate_Response(struct GENERIC_HTTP_CONNECTION *conn)
 {
     struct HTTP1_CONNECTION *http_conn = (struct HTTP1_CONNECTION *)conn->raw_connection;
 
+    // the responses held back for the previous pipelined requests stay in front
     if (conn->http_version == HTTP_VERSION_1)
     {
-        http_conn->send_buffer = "HTTP/1.0 ";
+        http_conn->send_buffer.append("HTTP/1.0 ");
     }
     else
     {
-        http_conn->send_buffer = "HTTP/1.1 ";
+        http_conn->send_buffer.append("HTTP/1.1 ");
     }
 
     http_conn->send_buffer.append(int2str(http_conn->response.code));
@@ -661,12 +1052,39 @@ void HTTP1_Connection_Generate_Response(struct GENERIC_HTTP_CONNECTION *conn)
     http_conn->send_buffer.append(http_conn->response.body);
 }
 
+void HTTP1_Connection_Generate_Cached_Response(struct GENERIC_HTTP_CONNECTION *conn, const std::string &cached_headers)
+{
+    struct HTTP1_CONNECTION *http_conn = (struct HTTP1_CONNECTION *)conn->raw_connection;
+
+    // only the minor version of the status line differs for HTTP/1.0
+    size_t status_line_offset = http_conn->send_buffer.size();
+    http_conn->send_buffer.append(cached_headers);
+
+    if (conn->http_version == HTTP_VERSION_1)
+    {
+        http_conn->send_buffer[status_line_offset + sizeof("HTTP/1.") - 1] = '0';
+    }
+
+    for (auto i = http_conn->response.headers.begin(); i != http_conn->response.headers.end(); ++i)
+    {
+        http_conn->send_buffer.append(i->first);
+        http_conn->send_buffer.append(": ");
+        http_conn->send_buffer.append(i->second);
+        http_conn->send_buffer.append("\r\n");
+    }
+
+    http_conn->send_buffer.append("\r\n");
+}
+
 void HTTP1_Connection_Delete(struct HTTP1_CONNECTION *http_conn)
 {
     http_conn->recv_buffer.clear();
+    http_conn->pipeline_buffer.clear();
     http_conn->send_buffer.clear();
     http_conn->send_buffer_offset = 0;
+    http_conn->parser_helper.scan_offset = 0;
 
+    http_conn->header_index.size = 0;
     http_conn->request.headers.clear();
     http_conn->request.URI_path.clear();
     http_conn->request.URI_query.clear();
@@ -694,7 +1112,15 @@ void HTTP1_Connection_Delete(struct HTTP1_CONNECTION *http_conn)
         close(http_conn->file_transfer.file_descriptor);
     }
 
+    HTTP_Compressor_Delete(http_conn->file_transfer.compressor);
+
     http_conn->file_transfer.file_descriptor = -1;
+    http_conn->file_transfer.zero_copy = false;
+    http_conn->file_transfer.read_pending = false;
+    http_conn->file_transfer.nowait_reads = false;
+    http_conn->file_transfer.compressor = NULL;
+    http_conn->file_transfer.parts.clear();
+    http_conn->file_transfer.next_part = 0;
     http_conn->request.POST_type = HTTP_POST_TYPE_UNDEFINED;
 
     http_conn->response.headers.clear();
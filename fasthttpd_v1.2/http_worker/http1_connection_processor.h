@@ -3,8 +3,18 @@
 
 #include "http2_core.h"
 
+//the responses of pipelined requests are coalesced up to this size
+#define HTTP1_PIPELINE_MAX_BATCH_SIZE (64 * 1024)
+
+//the buffered requests are over max_request_size, the rest is left in the socket until they are parsed
+#define HTTP1_CONNECTION_READ_STOPPED 1
+
 int HTTP1_Connection_Read_Incoming_Data(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn);
+bool HTTP1_Connection_Find_First_Line_End(struct HTTP1_CONNECTION *http_conn);
 int HTTP1_Connection_Send_Data(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn);
+int HTTP1_Connection_Flush_Send_Buffer(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn);
+int HTTP1_Connection_Send_Content(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn, const std::string &content);
+int HTTP1_Connection_Send_File(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn);
 int HTTP1_Connection_Load_File_Chunk(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn);
 
 void HTTP1_Connection_Init(struct HTTP1_CONNECTION *http_conn);
@@ -12,8 +22,14 @@ void HTTP1_Connection_Init(struct HTTP1_CONNECTION *http_conn);
 void HTTP1_Connection_HTTP2_101_Upgrade(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn);
 void HTTP1_Connection_HTTP2_Upgrade_Directly(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn);
 
+bool HTTP1_Connection_Is_Active(const struct GENERIC_HTTP_CONNECTION *conn, const uint32_t event_generation);
+void HTTP1_Connection_Split_Pipelined_Data(struct HTTP1_CONNECTION *http_conn, size_t request_end_offset);
+void HTTP1_Connection_Next_Request(struct HTTP1_CONNECTION *http_conn, bool keep_send_buffer);
+int HTTP1_Connection_Parse_Request(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn);
 void HTTP1_Connection_Process(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn);
 void HTTP1_Connection_Generate_Response(struct GENERIC_HTTP_CONNECTION *conn);
+//the pre-rendered "HTTP/1.1 200 OK" block of a cached file followed by the per request headers of the response, without the body
+void HTTP1_Connection_Generate_Cached_Response(struct GENERIC_HTTP_CONNECTION *conn, const std::string &cached_headers);
 
 void HTTP1_Connection_Delete(struct HTTP1_CONNECTION *http_conn);
 
@@ -1,11 +1,14 @@
 #include "http2_connection_processor.h"
 #include "http_worker.h"
+#include "http2_stream_processor.h"
+#include "content_cache.h"
 
 #include "../helper_functions.h"
 #include "../server_config.h"
 #include "../server_log.h"
 #include "../endianness_conversions.h"
 
+#include <unistd.h>
 #include <cstring>
 #include <cstdlib>
 
@@ -22,9 +25,9 @@ void HTTP2_Connection_Init(struct HTTP2_CONNECTION *http2_conn)
 	// load default server settings
 	http2_conn->server_settings.hpack_table_size = 4096;
 	http2_conn->server_settings.enable_push = 0;
-	http2_conn->server_settings.max_concurrent_streams = str2uint(SERVER_CONFIGURATION["http2_max_concurrent_streams"]);
-	http2_conn->server_settings.init_window_size = str2uint(SERVER_CONFIGURATION["http2_init_window_size"]) * 1024;
-	http2_conn->server_settings.max_frame_size = str2uint(SERVER_CONFIGURATION["http2_max_frame_size"]) * 1024;
+	http2_conn->server_settings.max_concurrent_streams = server_runtime_config->http2_max_concurrent_streams;
+	http2_conn->server_settings.init_window_size = server_runtime_config->http2_init_window_size;
+	http2_conn->server_settings.max_frame_size = server_runtime_config->http2_max_frame_size;
 	http2_conn->server_settings.max_header_list_size = 65535;
 
 	// init HPACK encoder/decoder context
@@ -62,18 +65,34 @@ void HTTP2_Connection_Init(struct HTTP2_CONNECTION *http2_conn)
 		exit(-1);
 	}
 
-	http2_conn->frame_header_is_recv = false;
+	http2_conn->recv_buffer = NULL;
+	http2_conn->recv_buffer_size = 0;
+	http2_conn->recv_buffer_start = 0;
+	http2_conn->recv_buffer_end = 0;
 	http2_conn->recv_window_avail_bytes = http2_conn->server_settings.init_window_size;
 
 	http2_conn->send_buffer_len = 0;
 	http2_conn->send_buffer_offset = 0;
 	http2_conn->send_window_avail_bytes = http2_conn->client_settings.init_window_size;
+
+	http2_conn->send_file_descriptor = -1;
+	http2_conn->send_file_close = false;
+
+	http2_conn->send_cached_content = NULL;
+
+	http2_conn->last_stream_id = 0;
+	http2_conn->goaway_sent = false;
+
+	http2_conn->refused_stream_id = 0;
+	http2_conn->refused_header_block.clear();
 }
 
 void HTTP2_Connection_Insert_Frame(struct HTTP2_CONNECTION *http2_conn, const uint32_t data_len, uint8_t *contents, bool alloc_mem)
 {
 	struct HTTP2_FRAME_CONTAINER frame_container;
 	frame_container.length = data_len;
+	frame_container.file_descriptor = -1;
+	frame_container.cached_content = NULL;
 
 	if (alloc_mem)
 	{
@@ -128,6 +147,13 @@ int HTTP2_Connection_Send_Enqueued_Frames(const int worker_id, struct GENERIC_HT
 						http2_conn->send_buffer_len = frame_container.length;
 						http2_conn->send_buffer = frame_container.contents;
 
+						http2_conn->send_file_descriptor = frame_container.file_descriptor;
+						http2_conn->send_file_offset = frame_container.file_offset;
+						http2_conn->send_file_close = frame_container.close_file;
+
+						http2_conn->send_cached_content = frame_container.cached_content;
+						http2_conn->send_payload = frame_container.payload;
+
 						http2_conn->send_window_avail_bytes -= frame_len;
 					}
 					else
@@ -154,7 +180,52 @@ int HTTP2_Connection_Send_Enqueued_Frames(const int worker_id, struct GENERIC_HT
 
 		if (http2_conn->send_buffer_len != 0)
 		{
-			int written_bytes = Network_Write_Bytes(conn, http2_conn->send_buffer + http2_conn->send_buffer_offset, http2_conn->send_buffer_len - http2_conn->send_buffer_offset);
+			int written_bytes;
+
+			// the frame header is in memory, the payload is sent from the file
+			if (http2_conn->send_file_descriptor != -1 and http2_conn->send_buffer_offset >= sizeof(struct HTTP2_FRAME_HEADER))
+			{
+				written_bytes = Network_Sendfile(conn, http2_conn->send_file_descriptor, &http2_conn->send_file_offset, http2_conn->send_buffer_len - http2_conn->send_buffer_offset);
+
+				// the truncated files are read too, the frame is completed without them
+				if (written_bytes == NETWORK_SENDFILE_UNSUPPORTED or written_bytes == NETWORK_SENDFILE_EOF)
+				{
+					if (HTTP2_Connection_Load_File_Payload(worker_id, conn) == HTTP2_CONNECTION_DELETED)
+					{
+						return HTTP2_CONNECTION_DELETED;
+					}
+
+					continue;
+				}
+			}
+			// the payload of a cached file is sent from the entry, together with the rest of the frame header
+			else if (http2_conn->send_cached_content)
+			{
+				struct iovec iov[2];
+				int iov_count = 0;
+
+				if (http2_conn->send_buffer_offset < sizeof(struct HTTP2_FRAME_HEADER))
+				{
+					iov[iov_count].iov_base = http2_conn->send_buffer + http2_conn->send_buffer_offset;
+					iov[iov_count].iov_len = sizeof(struct HTTP2_FRAME_HEADER) - http2_conn->send_buffer_offset;
+					iov_count++;
+				}
+
+				uint32_t payload_offset = (http2_conn->send_buffer_offset > sizeof(struct HTTP2_FRAME_HEADER)) ? http2_conn->send_buffer_offset - sizeof(struct HTTP2_FRAME_HEADER) : 0;
+
+				iov[iov_count].iov_base = (void *)(http2_conn->send_payload + payload_offset);
+				iov[iov_count].iov_len = http2_conn->send_buffer_len - sizeof(struct HTTP2_FRAME_HEADER) - payload_offset;
+				iov_count++;
+
+				written_bytes = Network_Write_Vector(conn, iov, iov_count);
+			}
+			else
+			{
+				bool is_header_only = http2_conn->send_file_descriptor != -1;
+				uint32_t buffer_len = is_header_only ? sizeof(struct HTTP2_FRAME_HEADER) : http2_conn->send_buffer_len;
+				written_bytes = Network_Write_Bytes(conn, http2_conn->send_buffer + http2_conn->send_buffer_offset, buffer_len - http2_conn->send_buffer_offset, is_header_only);
+			}
+
 			if (written_bytes == 0)
 			{
 				send_loop_should_stop = true;
@@ -196,7 +267,8 @@ int HTTP2_Connection_Send_Enqueued_Frames(const int worker_id, struct GENERIC_HT
 					}
 				}
 
-				else if(frame_header->type == HTTP2_FRAME_TYPE_GOAWAY)
+				// a graceful GOAWAY lets the open streams finish
+				else if(frame_header->type == HTTP2_FRAME_TYPE_GOAWAY and conn->state == HTTP2_CONNECTION_STATE_ERROR)
 				{
 					Generic_Connection_Delete(worker_id, conn);
 					return HTTP2_CONNECTION_DELETED;
@@ -207,6 +279,22 @@ int HTTP2_Connection_Send_Enqueued_Frames(const int worker_id, struct GENERIC_HT
 				http2_conn->send_buffer = NULL;
 				http2_conn->send_buffer_len = 0;
 				http2_conn->send_buffer_offset = 0;
+
+				if (http2_conn->send_file_descriptor != -1)
+				{
+					if (http2_conn->send_file_close)
+					{
+						close(http2_conn->send_file_descriptor);
+					}
+
+					http2_conn->send_file_descriptor = -1;
+				}
+
+				if (http2_conn->send_cached_content)
+				{
+					Content_Cache_Release(http2_conn->send_cached_content);
+					http2_conn->send_cached_content = NULL;
+				}
 			}
 		}
 	}
@@ -214,177 +302,304 @@ int HTTP2_Connection_Send_Enqueued_Frames(const int worker_id, struct GENERIC_HT
 	return HTTP2_CONNECTION_OK;
 }
 
-void HTTP2_Connection_Recv_Data(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn, std::string* temp_buff)
+int HTTP2_Connection_Load_File_Payload(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn)
 {
-	//do not process additional frames for state = error
-	if(conn->state == HTTP2_CONNECTION_STATE_ERROR)
+	struct HTTP2_CONNECTION *http2_conn = (struct HTTP2_CONNECTION *)conn->raw_connection;
+
+	// the file can not be sent by the kernel, copy the payload after the frame header
+	uint8_t *frame_contents = new (std::nothrow) uint8_t[http2_conn->send_buffer_len];
+	if (!frame_contents)
 	{
-		return;
+		SERVER_ERROR_LOG_stdlib_err("Unable to allocate memory for a HTTP2 frame.");
+		exit(-1);
 	}
 
-	struct HTTP2_CONNECTION *http2_conn = (struct HTTP2_CONNECTION *) conn->raw_connection;
+	memcpy(frame_contents, http2_conn->send_buffer, sizeof(struct HTTP2_FRAME_HEADER));
 
-	size_t temp_buff_offset = 0;
-	size_t max_read_size = str2uint(SERVER_CONFIGURATION["read_buffer_size"].c_str()) * 1024;
+	uint32_t payload_len = http2_conn->send_buffer_len - sizeof(struct HTTP2_FRAME_HEADER);
+	int64_t payload_offset = http2_conn->send_file_offset - (http2_conn->send_buffer_offset - sizeof(struct HTTP2_FRAME_HEADER));
 
-	bool recv_stop = false;
-	while (!recv_stop)
+	bool is_truncated = false;
+
+	uint32_t loaded_bytes = 0;
+	while (loaded_bytes < payload_len)
 	{
-		if (!http2_conn->frame_header_is_recv)
+		ssize_t read_bytes = pread(http2_conn->send_file_descriptor, frame_contents + sizeof(struct HTTP2_FRAME_HEADER) + loaded_bytes, payload_len - loaded_bytes, payload_offset + loaded_bytes);
+
+		if (read_bytes == -1 and errno == EINTR)
 		{
-			size_t recv_buffer_offset = http2_conn->recv_buffer.size();
+			continue;
+		}
 
-			// feed already recv data from an local buffer
-			// useful for upgrade from http/1.1
-			if(temp_buff)
-			{
-				size_t needed_bytes = sizeof(struct HTTP2_FRAME_HEADER) - recv_buffer_offset;
-				if(needed_bytes > temp_buff->size() - temp_buff_offset)
-				{
-					needed_bytes = temp_buff->size() - temp_buff_offset;
-				}
+		// the file shrinks while it is sent, the frame is padded so the client can still parse the next ones
+		if (read_bytes == 0)
+		{
+			memset(frame_contents + sizeof(struct HTTP2_FRAME_HEADER) + loaded_bytes, 0, payload_len - loaded_bytes);
+			is_truncated = true;
+			break;
+		}
 
-				http2_conn->recv_buffer.append(temp_buff->c_str() + temp_buff_offset, needed_bytes);
-				recv_buffer_offset += needed_bytes;
-				temp_buff_offset += needed_bytes;
+		// the frame is partially sent, so the whole connection is compromised
+		if (read_bytes < 0)
+		{
+			SERVER_ERROR_LOG_stdlib_err("Unable to read from requested file!");
 
-				//the local buffer is fully consumed
-				//switch back to reading from the network
-				if(temp_buff_offset == temp_buff->size())
-				{
-					temp_buff = NULL;
-				}
-			}
-			else
-			{
-				int32_t read_bytes = Network_Read_Bytes(conn, http_workers[worker_id].recv_buffer, sizeof(struct HTTP2_FRAME_HEADER) - recv_buffer_offset);
-				if (read_bytes == 0)
-				{
-					recv_stop = true;
-					continue;
-				}
-				else if (read_bytes < 0)
-				{
-					Generic_Connection_Delete(worker_id, conn);
-					return;
-				}
+			delete[] frame_contents;
+			Generic_Connection_Delete(worker_id, conn);
+			return HTTP2_CONNECTION_DELETED;
+		}
 
-				http2_conn->recv_buffer.append(http_workers[worker_id].recv_buffer, read_bytes);
-				recv_buffer_offset += read_bytes;
-			}
+		loaded_bytes += read_bytes;
+	}
 
-			if (recv_buffer_offset == sizeof(struct HTTP2_FRAME_HEADER))
-			{
-				struct HTTP2_FRAME_HEADER *buff_frame_header = (struct HTTP2_FRAME_HEADER *)http2_conn->recv_buffer.c_str();
+	delete[] http2_conn->send_buffer;
+	http2_conn->send_buffer = frame_contents;
 
-				// read the frame header
-				http2_conn->recv_frame_header.length = endian_conv_ntoh24(buff_frame_header->length);
-				http2_conn->recv_frame_header.type = buff_frame_header->type;
-				http2_conn->recv_frame_header.flags = buff_frame_header->flags;
-				http2_conn->recv_frame_header.stream_id = endian_conv_ntoh_http31(buff_frame_header->stream_id);
+	if (http2_conn->send_file_close)
+	{
+		close(http2_conn->send_file_descriptor);
+	}
 
-				http2_conn->recv_buffer.clear(); // reset the buffer
-				http2_conn->frame_header_is_recv = true; // we have the frame header
+	http2_conn->send_file_descriptor = -1;
 
-				if(http2_conn->recv_frame_header.length == 0)
-				{	
-					//valid settings frame with ACK and len = 0
-					if(http2_conn->recv_frame_header.type == HTTP2_FRAME_TYPE_SETTINGS and (http2_conn->recv_frame_header.flags & HTTP2_FRAME_FLAG_ACK))
-					{
-						http2_conn->frame_header_is_recv = false;
-						continue;
-					}
+	struct HTTP2_FRAME_HEADER *frame_header = (struct HTTP2_FRAME_HEADER *)frame_contents;
+	uint32_t stream_id = endian_conv_ntoh_http31(frame_header->stream_id);
 
-					HTTP2_Connection_Error(worker_id, conn, HTTP2_ERROR_CODE_FRAME_SIZE_ERROR, http2_conn->recv_frame_header.stream_id , "frame size can't be 0");
-					return;
-				}
-				else if(http2_conn->recv_frame_header.length > http2_conn->server_settings.max_frame_size)
-				{	
-					HTTP2_Connection_Error(worker_id, conn, HTTP2_ERROR_CODE_FRAME_SIZE_ERROR, http2_conn->recv_frame_header.stream_id , "frame is too big");
-					return;
-				}
-				else if(http2_conn->recv_frame_header.type == HTTP2_FRAME_TYPE_DATA and http2_conn->recv_frame_header.length > http2_conn->recv_window_avail_bytes)
-				{	
-					HTTP2_Connection_Error(worker_id, conn, HTTP2_ERROR_CODE_FLOW_CONTROL_ERROR, http2_conn->recv_frame_header.stream_id , "data frame is bigger than control window");
-					return;
-				}
-			}
+	if (is_truncated)
+	{
+		SERVER_ERROR_LOG_stdlib_err("The requested file was truncated while it was sent!");
+
+		HTTP2_Stream_Cancel(worker_id, http2_conn, stream_id, HTTP2_ERROR_CODE_INTERNAL_ERROR);
+		return HTTP2_CONNECTION_OK;
+	}
+
+	// the following frames of the stream are read from the file too
+	auto stream_it = http2_conn->streams.find(stream_id);
+	if (stream_it != http2_conn->streams.end())
+	{
+		stream_it->second.file_transfer.zero_copy = false;
+	}
+
+	return HTTP2_CONNECTION_OK;
+}
+
+bool HTTP2_Connection_Hand_Over_File(struct HTTP2_CONNECTION *http2_conn, int file_descriptor)
+{
+	// the frames leave the queue in order, the last one waiting is the last user of the descriptor
+	for (auto it = http2_conn->frame_queue.rbegin(); it != http2_conn->frame_queue.rend(); it++)
+	{
+		if (it->file_descriptor == file_descriptor)
+		{
+			it->close_file = true;
+			return true;
 		}
+	}
+
+	if (http2_conn->send_file_descriptor == file_descriptor)
+	{
+		http2_conn->send_file_close = true;
+		return true;
+	}
+
+	return false;
+}
+
+bool HTTP2_Connection_Reserve_Recv_Buffer(struct HTTP2_CONNECTION *http2_conn, size_t needed_bytes)
+{
+	size_t pending_bytes = http2_conn->recv_buffer_end - http2_conn->recv_buffer_start;
 
-		if (http2_conn->frame_header_is_recv)
+	if (!http2_conn->recv_buffer or http2_conn->recv_buffer_size < needed_bytes)
+	{
+		size_t new_size = server_runtime_config->read_buffer_size;
+		if (new_size < needed_bytes)
 		{
-			size_t recv_buffer_offset = http2_conn->recv_buffer.size();
+			new_size = needed_bytes;
+		}
 
-			if(temp_buff) 
-			{
-				size_t needed_bytes = http2_conn->recv_frame_header.length - recv_buffer_offset;
-				if(needed_bytes > temp_buff->size() - temp_buff_offset)
-				{
-					needed_bytes = temp_buff->size() - temp_buff_offset;
-				}
+		uint8_t *new_buffer = new (std::nothrow) uint8_t[new_size];
+		if (!new_buffer)
+		{
+			return false;
+		}
 
-				http2_conn->recv_buffer.append(temp_buff->c_str() + temp_buff_offset, needed_bytes);
-				recv_buffer_offset += needed_bytes;
-				temp_buff_offset += needed_bytes;
+		if (http2_conn->recv_buffer)
+		{
+			memcpy(new_buffer, http2_conn->recv_buffer + http2_conn->recv_buffer_start, pending_bytes);
+			delete[] http2_conn->recv_buffer;
+		}
 
-				if(temp_buff_offset == temp_buff->size())
-				{
-					temp_buff = NULL;
-				}
+		http2_conn->recv_buffer = new_buffer;
+		http2_conn->recv_buffer_size = new_size;
+	}
+	else if (http2_conn->recv_buffer_start > 0)
+	{
+		// only an incomplete frame is left, so moving it to the front is cheap
+		memmove(http2_conn->recv_buffer, http2_conn->recv_buffer + http2_conn->recv_buffer_start, pending_bytes);
+	}
+
+	http2_conn->recv_buffer_start = 0;
+	http2_conn->recv_buffer_end = pending_bytes;
+
+	return true;
+}
+
+int HTTP2_Connection_Parse_Frames(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn)
+{
+	struct HTTP2_CONNECTION *http2_conn = (struct HTTP2_CONNECTION *) conn->raw_connection;
+
+	//do not process additional frames for state = error
+	while (conn->state != HTTP2_CONNECTION_STATE_ERROR)
+	{
+		size_t pending_bytes = http2_conn->recv_buffer_end - http2_conn->recv_buffer_start;
+		if (pending_bytes < sizeof(struct HTTP2_FRAME_HEADER))
+		{
+			break;
+		}
+
+		struct HTTP2_FRAME_HEADER *buff_frame_header = (struct HTTP2_FRAME_HEADER *)(http2_conn->recv_buffer + http2_conn->recv_buffer_start);
+
+		// read the frame header
+		http2_conn->recv_frame_header.length = endian_conv_ntoh24(buff_frame_header->length);
+		http2_conn->recv_frame_header.type = buff_frame_header->type;
+		http2_conn->recv_frame_header.flags = buff_frame_header->flags;
+		http2_conn->recv_frame_header.stream_id = endian_conv_ntoh_http31(buff_frame_header->stream_id);
+
+		if(http2_conn->recv_frame_header.length == 0)
+		{	
+			//valid settings frame with ACK and len = 0
+			if(http2_conn->recv_frame_header.type == HTTP2_FRAME_TYPE_SETTINGS and (http2_conn->recv_frame_header.flags & HTTP2_FRAME_FLAG_ACK))
+			{
+				http2_conn->recv_buffer_start += sizeof(struct HTTP2_FRAME_HEADER);
+				continue;
 			}
-			else
+
+			return HTTP2_Connection_Error(worker_id, conn, HTTP2_ERROR_CODE_FRAME_SIZE_ERROR, http2_conn->recv_frame_header.stream_id , "frame size can't be 0");
+		}
+		else if(http2_conn->recv_frame_header.length > http2_conn->server_settings.max_frame_size)
+		{	
+			return HTTP2_Connection_Error(worker_id, conn, HTTP2_ERROR_CODE_FRAME_SIZE_ERROR, http2_conn->recv_frame_header.stream_id , "frame is too big");
+		}
+		else if(http2_conn->recv_frame_header.type == HTTP2_FRAME_TYPE_DATA and http2_conn->recv_frame_header.length > http2_conn->recv_window_avail_bytes)
+		{	
+			return HTTP2_Connection_Error(worker_id, conn, HTTP2_ERROR_CODE_FLOW_CONTROL_ERROR, http2_conn->recv_frame_header.stream_id , "data frame is bigger than control window");
+		}
+
+		// the payload is not fully received yet
+		if (pending_bytes - sizeof(struct HTTP2_FRAME_HEADER) < http2_conn->recv_frame_header.length)
+		{
+			break;
+		}
+
+		http2_conn->recv_frame_payload = http2_conn->recv_buffer + http2_conn->recv_buffer_start + sizeof(struct HTTP2_FRAME_HEADER);
+
+		// window update for data frame
+		if (http2_conn->recv_frame_header.type == HTTP2_FRAME_TYPE_DATA)
+		{
+			http2_conn->recv_window_avail_bytes -= http2_conn->recv_frame_header.length;
+			const int32_t init_window_size = http2_conn->server_settings.init_window_size;
+
+			if (http2_conn->recv_window_avail_bytes <= init_window_size / 2)
 			{
-				size_t bytes_to_read =  http2_conn->recv_frame_header.length - recv_buffer_offset;
-				if(bytes_to_read > max_read_size)
-				{
-					bytes_to_read = max_read_size;
-				}
+				uint32_t window_increment = http2_conn->server_settings.init_window_size - http2_conn->recv_window_avail_bytes;
+				http2_conn->recv_window_avail_bytes += window_increment;
 
-				int32_t read_bytes = Network_Read_Bytes(conn, http_workers[worker_id].recv_buffer, bytes_to_read);
-				if (read_bytes == 0)
-				{
-					recv_stop = true;
-					continue;
-				}
-				else if (read_bytes < 0)
+				if(HTTP2_Frame_Window_Update_Generate(worker_id, conn, 0, window_increment) == HTTP2_CONNECTION_DELETED)
 				{
-					Generic_Connection_Delete(worker_id, conn);
-					return;
+					return HTTP2_CONNECTION_DELETED;
 				}
+			}
+		}
+
+		if(HTTP2_Frame_Process(worker_id, conn) == HTTP2_CONNECTION_DELETED)
+		{
+			return HTTP2_CONNECTION_DELETED;
+		}
+
+		// frame is processed
+		http2_conn->recv_buffer_start += sizeof(struct HTTP2_FRAME_HEADER) + http2_conn->recv_frame_header.length;
+	}
+
+	return HTTP2_CONNECTION_OK;
+}
+
+void HTTP2_Connection_Recv_Data(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn, std::string* temp_buff)
+{
+	struct HTTP2_CONNECTION *http2_conn = (struct HTTP2_CONNECTION *) conn->raw_connection;
+
+	size_t temp_buff_offset = 0;
 
-				http2_conn->recv_buffer.append(http_workers[worker_id].recv_buffer, read_bytes);
-				recv_buffer_offset += read_bytes;
+	bool recv_stop = false;
+	while (true)
+	{
+		// the frames left in the buffer by the previous read are processed first
+		if (HTTP2_Connection_Parse_Frames(worker_id, conn) == HTTP2_CONNECTION_DELETED)
+		{
+			return;
+		}
+
+		if (recv_stop or conn->state == HTTP2_CONNECTION_STATE_ERROR)
+		{
+			return;
+		}
+
+		// make room for the whole incomplete frame (or at least its header)
+		size_t needed_bytes = sizeof(struct HTTP2_FRAME_HEADER);
+		if (http2_conn->recv_buffer_end - http2_conn->recv_buffer_start >= sizeof(struct HTTP2_FRAME_HEADER))
+		{
+			needed_bytes += http2_conn->recv_frame_header.length;
+		}
+
+		if (!HTTP2_Connection_Reserve_Recv_Buffer(http2_conn, needed_bytes))
+		{
+			SERVER_ERROR_LOG_stdlib_err("Unable to allocate memory for the HTTP2 input buffer.");
+			exit(-1);
+		}
+
+		size_t free_bytes = http2_conn->recv_buffer_size - http2_conn->recv_buffer_end;
+
+		// feed already recv data from an local buffer
+		// useful for upgrade from http/1.1
+		if (temp_buff)
+		{
+			size_t copy_bytes = temp_buff->size() - temp_buff_offset;
+			if (copy_bytes > free_bytes)
+			{
+				copy_bytes = free_bytes;
 			}
 
-			if (recv_buffer_offset == http2_conn->recv_frame_header.length)
+			memcpy(http2_conn->recv_buffer + http2_conn->recv_buffer_end, temp_buff->c_str() + temp_buff_offset, copy_bytes);
+			http2_conn->recv_buffer_end += copy_bytes;
+			temp_buff_offset += copy_bytes;
+
+			//the local buffer is fully consumed
+			//switch back to reading from the network
+			if (temp_buff_offset == temp_buff->size())
 			{
-				// window update for data frame
-				if (http2_conn->recv_frame_header.type == HTTP2_FRAME_TYPE_DATA)
-				{
-					http2_conn->recv_window_avail_bytes -= http2_conn->recv_frame_header.length;
-					const int32_t init_window_size = http2_conn->server_settings.init_window_size;
+				temp_buff = NULL;
+			}
 
-					if (http2_conn->recv_window_avail_bytes <= init_window_size / 2)
-					{
-						uint32_t window_increment = http2_conn->server_settings.init_window_size - http2_conn->recv_window_avail_bytes;
-						http2_conn->recv_window_avail_bytes += window_increment;
+			continue;
+		}
 
-						if(HTTP2_Frame_Window_Update_Generate(worker_id, conn, 0, window_increment) == HTTP2_CONNECTION_DELETED)
-						{
-							return;
-						}
-					}
-				}
+		// read as much as is available, not frame by frame
+		int32_t read_bytes = Network_Read_Bytes(conn, http2_conn->recv_buffer + http2_conn->recv_buffer_end, free_bytes);
+		if (read_bytes == 0)
+		{
+			return;
+		}
+		else if (read_bytes < 0)
+		{
+			Generic_Connection_Delete(worker_id, conn);
+			return;
+		}
 
-				if(HTTP2_Frame_Process(worker_id, conn) == HTTP2_CONNECTION_DELETED)
-				{
-					return;
-				}
-				
-				// frame is processed
-				http2_conn->recv_buffer.clear();
-				http2_conn->frame_header_is_recv = false;
-			}
+		http2_conn->recv_buffer_end += read_bytes;
+
+		// a short read drains a plain socket, the next edge will signal new data
+		// SSL can hold already decrypted records, so keep reading until it reports no data
+		if (!conn->https and (size_t)read_bytes < free_bytes)
+		{
+			recv_stop = true;
 		}
 	}
 }
@@ -395,24 +610,28 @@ void HTTP2_Connection_Process(const int worker_id, struct GENERIC_HTTP_CONNECTIO
 
 	if (conn->state == HTTP2_CONNECTION_STATE_WAIT_HELLO)
 	{
-		size_t recv_buffer_offset = http2_conn->recv_buffer.size();
+		if (!HTTP2_Connection_Reserve_Recv_Buffer(http2_conn, 24))
+		{
+			SERVER_ERROR_LOG_stdlib_err("Unable to allocate memory for the HTTP2 input buffer.");
+			exit(-1);
+		}
 
-		int32_t read_bytes = Network_Read_Bytes(conn, http_workers[worker_id].recv_buffer, 24 - recv_buffer_offset);
+		// the frames that follow the hello stay in the input buffer
+		int32_t read_bytes = Network_Read_Bytes(conn, http2_conn->recv_buffer + http2_conn->recv_buffer_end, http2_conn->recv_buffer_size - http2_conn->recv_buffer_end);
 		if (read_bytes < 0)
 		{
 			Generic_Connection_Delete(worker_id, conn);
 			return;
 		}
 
-		recv_buffer_offset += read_bytes;
-		http2_conn->recv_buffer.append(http_workers[worker_id].recv_buffer, read_bytes);
+		http2_conn->recv_buffer_end += read_bytes;
 
-		if (recv_buffer_offset >= 24) // http2 hello len
+		if (http2_conn->recv_buffer_end >= 24) // http2 hello len
 		{
-			if (memcmp(HTTP2_magic_hello, http2_conn->recv_buffer.c_str(), 24) == 0)
+			if (memcmp(HTTP2_magic_hello, http2_conn->recv_buffer, 24) == 0)
 			{
 				conn->state = HTTP2_CONNECTION_STATE_WAIT_SETTINGS;
-				http2_conn->recv_buffer.clear();
+				http2_conn->recv_buffer_start += 24;
 
 				HTTP2_Frame_Settings_Generate(http2_conn);
 			}
@@ -434,14 +653,14 @@ void HTTP2_Connection_Process(const int worker_id, struct GENERIC_HTTP_CONNECTIO
 	}
 }
 
-int HTTP2_Connection_Error(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn, const uint32_t error_code, const uint32_t last_stream_id, const char *additional_info)
+static struct HTTP2_FRAME_CONTAINER HTTP2_Connection_Goaway_Generate(const uint32_t error_code, const uint32_t last_stream_id, const char *additional_info)
 {
-	struct HTTP2_CONNECTION *http2_conn = (struct HTTP2_CONNECTION *) conn->raw_connection;
-
 	uint32_t additional_info_len = (additional_info) ? strlen(additional_info) : 0;
 
 	struct HTTP2_FRAME_CONTAINER frame_container;
 	frame_container.length = 8 + additional_info_len + sizeof(struct HTTP2_FRAME_HEADER);
+	frame_container.file_descriptor = -1;
+	frame_container.cached_content = NULL;
 
 	frame_container.contents = new (std::nothrow) uint8_t[frame_container.length];
 	if (!frame_container.contents)
@@ -465,15 +684,39 @@ int HTTP2_Connection_Error(const int worker_id, struct GENERIC_HTTP_CONNECTION *
 		memcpy(frame_container.contents + sizeof(struct HTTP2_FRAME_HEADER) + 8, additional_info, additional_info_len);
 	}
 
-	http2_conn->frame_queue.push_front(frame_container);
+	return frame_container;
+}
+
+int HTTP2_Connection_Error(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn, const uint32_t error_code, const uint32_t last_stream_id, const char *additional_info)
+{
+	struct HTTP2_CONNECTION *http2_conn = (struct HTTP2_CONNECTION *) conn->raw_connection;
+
+	http2_conn->frame_queue.push_front(HTTP2_Connection_Goaway_Generate(error_code, last_stream_id, additional_info));
 
 	conn->state = HTTP2_CONNECTION_STATE_ERROR;
 
 	return HTTP2_Connection_Send_Enqueued_Frames(worker_id, conn);
 }
 
+int HTTP2_Connection_Shutdown(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn)
+{
+	struct HTTP2_CONNECTION *http2_conn = (struct HTTP2_CONNECTION *) conn->raw_connection;
+
+	// queued after the pending responses, the connection is closed once the open streams are done
+	http2_conn->frame_queue.push_back(HTTP2_Connection_Goaway_Generate(HTTP2_ERROR_CODE_NO_ERROR, http2_conn->last_stream_id, NULL));
+	http2_conn->goaway_sent = true;
+
+	return HTTP2_Connection_Send_Enqueued_Frames(worker_id, conn);
+}
+
 void HTTP2_Connection_Delete(const int worker_id, struct HTTP2_CONNECTION* http2_conn)
 {
+	if(http2_conn->recv_buffer)
+	{
+		delete[] http2_conn->recv_buffer;
+		http2_conn->recv_buffer = NULL;
+	}
+
 	//delete the current frame in buffer
 	if(http2_conn->send_buffer)
 	{
@@ -481,23 +724,41 @@ void HTTP2_Connection_Delete(const int worker_id, struct HTTP2_CONNECTION* http2
 		http2_conn->send_buffer = NULL;
 	}
 
-	//delete the enqueued frames
-	for(auto i = http2_conn->frame_queue.begin(); i != http2_conn->frame_queue.end(); i++)
+	if(http2_conn->send_file_descriptor != -1 and http2_conn->send_file_close)
 	{
-		delete[] (*i).contents;
+		close(http2_conn->send_file_descriptor);
 	}
 
-	for(auto it = http2_conn->streams.begin(); it != http2_conn->streams.end(); it++)
+	http2_conn->send_file_descriptor = -1;
+
+	if(http2_conn->send_cached_content)
 	{
-		auto temp_it = it;
-		it++;
+		Content_Cache_Release(http2_conn->send_cached_content);
+		http2_conn->send_cached_content = NULL;
+	}
 
-		HTTP2_Stream_Delete(worker_id, http2_conn, temp_it->first);
+	//delete the enqueued frames, the descriptors still owned by the streams are closed with them
+	for(auto i = http2_conn->frame_queue.begin(); i != http2_conn->frame_queue.end(); i++)
+	{
+		delete[] (*i).contents;
 
-		if(it == http2_conn->streams.end())
+		if((*i).file_descriptor != -1 and (*i).close_file)
 		{
-			break;
+			close((*i).file_descriptor);
 		}
+
+		if((*i).cached_content)
+		{
+			Content_Cache_Release((*i).cached_content);
+		}
+	}
+
+	http2_conn->frame_queue.clear();
+
+	//each delete erases the stream from the map
+	while(!http2_conn->streams.empty())
+	{
+		HTTP2_Stream_Delete(worker_id, http2_conn, http2_conn->streams.begin()->first);
 	}
 
 	//delete the HPACK contexts
@@ -6,8 +6,13 @@
 void HTTP2_Connection_Init(struct HTTP2_CONNECTION *http2_conn);
 void HTTP2_Connection_Insert_Frame(struct HTTP2_CONNECTION *http2_conn, const uint32_t data_len, uint8_t *contents, bool alloc_mem = true);
 int HTTP2_Connection_Send_Enqueued_Frames(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn);
+int HTTP2_Connection_Load_File_Payload(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn);
+bool HTTP2_Connection_Hand_Over_File(struct HTTP2_CONNECTION *http2_conn, int file_descriptor);
+bool HTTP2_Connection_Reserve_Recv_Buffer(struct HTTP2_CONNECTION *http2_conn, size_t needed_bytes);
+int HTTP2_Connection_Parse_Frames(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn);
 void HTTP2_Connection_Recv_Data(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn, std::string* temp_buff);
 int HTTP2_Connection_Error(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn, const uint32_t error_code, const uint32_t last_stream_id, const char *additional_info = NULL);
+int HTTP2_Connection_Shutdown(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn);
 void HTTP2_Connection_Process(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn, std::string* temp_buff = NULL);
 void HTTP2_Connection_Delete(const int worker_id, struct HTTP2_CONNECTION* http2_conn);
 
@@ -7,6 +7,8 @@
 
 #include <nghttp2/nghttp2.h>
 
+struct CONTENT_CACHE_ENTRY;
+
 #define HTTP2_FRAME_TYPE_DATA 0
 #define HTTP2_FRAME_TYPE_HEADERS 1
 #define HTTP2_FRAME_TYPE_PRIORITY 2
@@ -107,6 +109,15 @@ struct HTTP2_FRAME_CONTAINER
 {
 	uint32_t length;
 	uint8_t* contents; //this includes header too
+
+	//DATA frames sent with sendfile(), contents holds only the frame header
+	int file_descriptor; //-1 if the payload is in contents
+	int64_t file_offset;
+	bool close_file; //the frames share the descriptor of the stream, the last one sent closes it
+
+	//DATA frames of a cached file, contents holds only the frame header, each frame holds the entry until it is sent
+	const struct CONTENT_CACHE_ENTRY* cached_content; //NULL if the payload is not cached
+	const uint8_t* payload;
 };
 
 struct HTTP2_STREAM
@@ -126,6 +137,9 @@ struct HTTP2_STREAM
 	uint64_t expected_request_body_size;
 
 	struct HTTP_FILE_TRANSFER file_transfer;
+
+	//the body is framed from the held content, send_buffer_offset is the offset inside it
+	const struct CONTENT_CACHE_ENTRY* cached_content;
 };
 
 struct HTTP2_CONNECTION
@@ -135,21 +149,42 @@ struct HTTP2_CONNECTION
 	
 	std::unordered_map<uint32_t, struct HTTP2_STREAM> streams;
 	
-	bool frame_header_is_recv;
 	struct HTTP2_FRAME_HEADER recv_frame_header;
+	const uint8_t* recv_frame_payload; //points inside recv_buffer
 	
 	nghttp2_hd_deflater* hpack_encoder;
 	nghttp2_hd_inflater* hpack_decoder;
 	
-	std::string recv_buffer;
+	//input buffer, the complete frames are parsed in place
+	uint8_t* recv_buffer;
+	size_t recv_buffer_size;
+	size_t recv_buffer_start;
+	size_t recv_buffer_end;
 	int64_t recv_window_avail_bytes;
 	
 	uint8_t* send_buffer;
 	uint32_t send_buffer_len;
 	uint32_t send_buffer_offset;
 	int64_t send_window_avail_bytes;
+
+	//payload source of the frame in buffer, -1 if the payload is in send_buffer
+	int send_file_descriptor;
+	int64_t send_file_offset;
+	bool send_file_close;
+
+	//payload source of the frame in buffer when it comes from the content cache
+	const struct CONTENT_CACHE_ENTRY* send_cached_content;
+	const uint8_t* send_payload;
 	
 	std::list<struct HTTP2_FRAME_CONTAINER> frame_queue;
+
+	//highest stream opened by the client, the streams above it are refused after a graceful GOAWAY
+	uint32_t last_stream_id;
+	bool goaway_sent;
+
+	//a refused stream whose header block continues in CONTINUATION frames, 0 if none, the block is decoded once complete
+	uint32_t refused_stream_id;
+	std::string refused_header_block;
 };
 
 
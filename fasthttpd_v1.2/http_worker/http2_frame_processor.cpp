@@ -8,6 +8,8 @@
 #include "../helper_functions.h"
 #include "../endianness_conversions.h"
 
+#include <cstring>
+
 int HTTP2_Frame_Settings_Process(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn)
 {
 	struct HTTP2_CONNECTION *http2_conn = (struct HTTP2_CONNECTION *) conn->raw_connection;
@@ -27,7 +29,7 @@ int HTTP2_Frame_Settings_Process(const int worker_id, struct GENERIC_HTTP_CONNEC
 
 	for (unsigned int i = 0; i < http2_conn->recv_frame_header.length; i += sizeof(struct HTTP2_SETTINGS_PARAMETER))
 	{
-		settings_param = (struct HTTP2_SETTINGS_PARAMETER*) (http2_conn->recv_buffer.c_str() + i);
+		settings_param = (struct HTTP2_SETTINGS_PARAMETER*) (http2_conn->recv_frame_payload + i);
 
 		// convert to host endianness
 		uint16_t parameter_id = endian_conv_ntoh16(settings_param->id);
@@ -86,6 +88,8 @@ void HTTP2_Frame_Settings_Generate(struct HTTP2_CONNECTION* http2_conn)
 {
 	struct HTTP2_FRAME_CONTAINER frame_container;
 	frame_container.length = sizeof(struct HTTP2_FRAME_HEADER) + (sizeof(struct HTTP2_SETTINGS_PARAMETER) * 6);	
+	frame_container.file_descriptor = -1;
+	frame_container.cached_content = NULL;
 	
 	frame_container.contents = new (std::nothrow) uint8_t[frame_container.length];
 
@@ -133,7 +137,10 @@ int HTTP2_Frame_Window_Update_Process(const int worker_id, struct GENERIC_HTTP_C
 		return HTTP2_Connection_Error(worker_id, conn, HTTP2_ERROR_CODE_PROTOCOL_ERROR, 0, "invalid window_update frame");
 	}
 
-	uint32_t increment = endian_conv_ntoh_http31(((uint32_t *)http2_conn->recv_buffer.c_str())[0]);
+	// the payload is not aligned inside the input buffer
+	uint32_t increment;
+	memcpy(&increment, http2_conn->recv_frame_payload, sizeof(increment));
+	increment = endian_conv_ntoh_http31(increment);
 
 	if (increment == 0)
 	{
@@ -186,6 +193,8 @@ int HTTP2_Frame_Window_Update_Generate(const int worker_id, struct GENERIC_HTTP_
 	
 	struct HTTP2_FRAME_CONTAINER frame_container;
 	frame_container.length = sizeof(struct HTTP2_FRAME_HEADER) + 4;	
+	frame_container.file_descriptor = -1;
+	frame_container.cached_content = NULL;
 	
 	frame_container.contents = new (std::nothrow) uint8_t[frame_container.length];
 
@@ -226,7 +235,7 @@ int HTTP2_Frame_Header_Process(const int worker_id, struct GENERIC_HTTP_CONNECTI
 		return HTTP2_Connection_Error(worker_id, conn, HTTP2_ERROR_CODE_PROTOCOL_ERROR, 0, "headers frame on the stream 0");
 	}
 
-	uint8_t *header_block_start = (uint8_t *)http2_conn->recv_buffer.c_str();
+	uint8_t *header_block_start = (uint8_t *)http2_conn->recv_frame_payload;
 	int32_t header_block_size = (int32_t)http2_conn->recv_frame_header.length;
 
 	bool is_padded = http2_conn->recv_frame_header.flags & HTTP2_FRAME_FLAG_PADDED;
@@ -261,6 +270,37 @@ int HTTP2_Frame_Header_Process(const int worker_id, struct GENERIC_HTTP_CONNECTI
 		return HTTP2_Connection_Error(worker_id, conn, HTTP2_ERROR_CODE_FRAME_SIZE_ERROR, stream_id, "frame size error (<= 0)");
 	}
 
+	// the client did not see the GOAWAY yet, the header block only updates the HPACK table
+	if (http2_conn->goaway_sent and stream_id > http2_conn->last_stream_id)
+	{
+		// a single header block can be open at a time, its CONTINUATION frames carry the same stream id
+		if (http2_conn->refused_stream_id != 0 and http2_conn->refused_stream_id != stream_id)
+		{
+			return HTTP2_Connection_Error(worker_id, conn, HTTP2_ERROR_CODE_PROTOCOL_ERROR, stream_id, "interleaved header blocks");
+		}
+
+		http2_conn->refused_header_block.append((const char *)header_block_start, header_block_size);
+
+		if (!is_last_header_block)
+		{
+			http2_conn->refused_stream_id = stream_id;
+			return HTTP2_CONNECTION_OK;
+		}
+
+		std::unordered_map<std::string, std::string> refused_headers;
+		bool is_decoded = HPACK_decode_headers(http2_conn->hpack_decoder, http2_conn->refused_header_block, &refused_headers);
+
+		http2_conn->refused_stream_id = 0;
+		http2_conn->refused_header_block.clear();
+
+		if (!is_decoded)
+		{
+			return HTTP2_Connection_Error(worker_id, conn, HTTP2_ERROR_CODE_COMPRESSION_ERROR, stream_id);
+		}
+
+		return HTTP2_CONNECTION_OK;
+	}
+
 	// create a new stream
 	if (http2_conn->streams.find(stream_id) == http2_conn->streams.end())
 	{
@@ -302,15 +342,7 @@ int HTTP2_Frame_Header_Process(const int worker_id, struct GENERIC_HTTP_CONNECTI
 
 		if (h2_header_path != decoded_headers->end())
 		{
-			unsigned int max_query_arg_limit = str2uint(&SERVER_CONFIGURATION["max_query_args"]);
-
-			bool continue_if_arg_limit_exceeded = false;
-			if (is_server_config_variable_true("continue_if_args_limit_exceeded"))
-			{
-				continue_if_arg_limit_exceeded = true;
-			}
-
-			if(!HTTP_Parse_Raw_URI(h2_header_path->second, &current_stream.request.URI_path, &current_stream.request.URI_query, max_query_arg_limit, continue_if_arg_limit_exceeded))
+			if(!HTTP_Parse_Raw_URI(h2_header_path->second, &current_stream.request.URI_path, &current_stream.request.URI_query, server_runtime_config->max_query_args, server_runtime_config->continue_if_args_limit_exceeded))
 			{
 				return HTTP_Request_Set_Error_Page(worker_id, conn, stream_id, 400);
 			}
@@ -326,7 +358,7 @@ int HTTP2_Frame_Header_Process(const int worker_id, struct GENERIC_HTTP_CONNECTI
 			current_stream.request.headers["host"] = h2_header_authority->second;
 		}
 
-		max_req_size = str2uint(SERVER_CONFIGURATION["max_request_size"]) * 1024;
+		max_req_size = server_runtime_config->max_request_size;
 		if(deflated_headers_size > max_req_size)
 		{
 			return HTTP_Request_Set_Error_Page(worker_id, conn, stream_id, 413);
@@ -381,7 +413,7 @@ int HTTP2_Frame_Data_Process(const int worker_id, struct GENERIC_HTTP_CONNECTION
 		return HTTP2_Connection_Error(worker_id, conn, HTTP2_ERROR_CODE_PROTOCOL_ERROR, 0, "data frame on the stream 0");
 	}
 
-	uint8_t *data_block_start = (uint8_t *)http2_conn->recv_buffer.c_str();
+	uint8_t *data_block_start = (uint8_t *)http2_conn->recv_frame_payload;
 	int32_t data_block_size = (int32_t)http2_conn->recv_frame_header.length;
 
 	bool is_padded = http2_conn->recv_frame_header.flags & HTTP2_FRAME_FLAG_PADDED;
@@ -496,6 +528,8 @@ int HTTP2_Frame_Ping_Process(const int worker_id, struct GENERIC_HTTP_CONNECTION
 		//send a ping frame with ACK flag
 		struct HTTP2_FRAME_CONTAINER frame_container;
 		frame_container.length = sizeof(struct HTTP2_FRAME_HEADER) + 8;	
+		frame_container.file_descriptor = -1;
+		frame_container.cached_content = NULL;
 	
 		frame_container.contents = new (std::nothrow) uint8_t[frame_container.length];
 
@@ -511,8 +545,7 @@ int HTTP2_Frame_Ping_Process(const int worker_id, struct GENERIC_HTTP_CONNECTION
 		frame_header->flags = HTTP2_FRAME_FLAG_ACK;
 		frame_header->length = endian_conv_hton24(8);
 
-		uint64_t* ping_frame_contents = (uint64_t*)(frame_container.contents + sizeof(struct HTTP2_FRAME_HEADER));
-		ping_frame_contents[0] = *((uint64_t*)http2_conn->recv_buffer.c_str());
+		memcpy(frame_container.contents + sizeof(struct HTTP2_FRAME_HEADER), http2_conn->recv_frame_payload, 8);
 
 		//a ping frame must be sent with high priority
 		http2_conn->frame_queue.push_front(frame_container);
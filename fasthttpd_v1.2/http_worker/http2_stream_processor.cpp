@@ -1,5 +1,8 @@
 #include "http2_stream_processor.h"
 #include "http_worker.h"
+#include "http_compression.h"
+#include "file_io.h"
+#include "content_cache.h"
 
 #include "../server_log.h"
 #include "../server_config.h"
@@ -28,6 +31,13 @@ int HTTP2_Stream_Init(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn,
 	current_stream.send_buffer_offset = 0;
 
 	current_stream.file_transfer.file_descriptor = -1;
+	current_stream.file_transfer.zero_copy = false;
+	current_stream.file_transfer.read_pending = false;
+	current_stream.file_transfer.nowait_reads = false;
+	current_stream.file_transfer.compressor = NULL;
+	current_stream.file_transfer.next_part = 0;
+
+	current_stream.cached_content = NULL;
 
 	current_stream.expected_request_body_size = 0;
 
@@ -38,18 +48,19 @@ int HTTP2_Stream_Init(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn,
 	current_stream.request.POST_query = NULL;
 	current_stream.request.POST_files = NULL;
 	current_stream.request.POST_type = HTTP_POST_TYPE_UNDEFINED;
+	current_stream.request.header_index = NULL;
 
 	current_stream.response.COOKIES = NULL;
 
 	http2_conn->streams[stream_id] = current_stream;
 
-	total_http_connections++;
-
-	if (is_server_load_balancer_fair)
+	if (stream_id > http2_conn->last_stream_id)
 	{
-		connections_per_worker[worker_id]++;
+		http2_conn->last_stream_id = stream_id;
 	}
 
+	http_workers_load[worker_id].connections++;
+
 	return HTTP2_CONNECTION_OK;
 }
 
@@ -73,10 +84,12 @@ int HTTP2_Stream_Send_Headers(const int worker_id, struct GENERIC_HTTP_CONNECTIO
 
 		last_header_frame = (current_frame_size + current_stream.send_buffer_offset) == current_stream.send_buffer.size();
 		bool first_header_frame = current_stream.send_buffer_offset == 0;
-		bool last_frame = last_header_frame and current_stream.response.body.empty() and current_stream.state != HTTP2_STREAM_STATE_FILE_BOUND;
+		bool last_frame = last_header_frame and current_stream.response.body.empty() and current_stream.state != HTTP2_STREAM_STATE_FILE_BOUND and !current_stream.cached_content;
 
 		struct HTTP2_FRAME_CONTAINER frame_container;
 		frame_container.length = sizeof(struct HTTP2_FRAME_HEADER) + current_frame_size;
+		frame_container.file_descriptor = -1;
+		frame_container.cached_content = NULL;
 		frame_container.contents = new (std::nothrow) uint8_t[frame_container.length];
 
 		if (!frame_container.contents)
@@ -150,17 +163,22 @@ void HTTP2_Stream_Send_Body(const int worker_id, struct HTTP2_CONNECTION *http2_
 		return;
 	}
 
-	int32_t current_frame_size = (int32_t) (current_stream.send_buffer.size() - current_stream.send_buffer_offset);
+	// a cached file is sent from the entry, the frames point inside it
+	const std::string &body = current_stream.cached_content ? current_stream.cached_content->content : current_stream.send_buffer;
+
+	int32_t current_frame_size = (int32_t) (body.size() - current_stream.send_buffer_offset);
 	if (current_frame_size > max_frame_size)
 	{
 		current_frame_size = max_frame_size;
 	}
 
-	bool last_frame = ((size_t)current_frame_size + current_stream.send_buffer_offset) == current_stream.send_buffer.size();
+	bool last_frame = ((size_t)current_frame_size + current_stream.send_buffer_offset) == body.size();
 
 	HTTP2_FRAME_CONTAINER frame_container;
 	frame_container.length = sizeof(struct HTTP2_FRAME_HEADER) + current_frame_size;
-	frame_container.contents = new (std::nothrow) uint8_t[frame_container.length];
+	frame_container.file_descriptor = -1;
+	frame_container.cached_content = NULL;
+	frame_container.contents = new (std::nothrow) uint8_t[current_stream.cached_content ? sizeof(struct HTTP2_FRAME_HEADER) : frame_container.length];
 
 	if (!frame_container.contents)
 	{
@@ -179,6 +197,61 @@ void HTTP2_Stream_Send_Body(const int worker_id, struct HTTP2_CONNECTION *http2_
 		frame_header->flags = HTTP2_FRAME_FLAG_END_STREAM;
 	}
 
+	if (current_stream.cached_content)
+	{
+		frame_container.cached_content = Content_Cache_Hold(current_stream.cached_content);
+		frame_container.payload = (const uint8_t *)body.data() + current_stream.send_buffer_offset;
+	}
+	else
+	{
+		memcpy(frame_container.contents + sizeof(struct HTTP2_FRAME_HEADER), body.c_str() + current_stream.send_buffer_offset, current_frame_size);
+	}
+
+	http2_conn->frame_queue.push_back(frame_container);
+
+	current_stream.send_buffer_offset += current_frame_size;
+	current_stream.send_window_avail_bytes -= current_frame_size;
+
+	// http request complete
+	if (last_frame)
+	{
+		HTTP2_Stream_Delete(worker_id, http2_conn, stream_id);
+	}
+}
+
+//one DATA frame from the send buffer of the stream, the last one ends the stream once the file transfer is complete
+static int HTTP2_Stream_Send_Buffered_Frame(const int worker_id, struct HTTP2_CONNECTION *http2_conn, const uint32_t stream_id, uint32_t max_frame_size)
+{
+	struct HTTP2_STREAM &current_stream = http2_conn->streams[stream_id];
+	struct HTTP_FILE_TRANSFER &file_transfer = current_stream.file_transfer;
+
+	uint32_t current_frame_size = current_stream.send_buffer.size() - current_stream.send_buffer_offset;
+	if (current_frame_size > max_frame_size)
+	{
+		current_frame_size = max_frame_size;
+	}
+
+	bool last_frame = file_transfer.file_offset == file_transfer.stop_offset and file_transfer.next_part == file_transfer.parts.size() and
+	                  current_stream.send_buffer_offset + current_frame_size == current_stream.send_buffer.size();
+
+	HTTP2_FRAME_CONTAINER frame_container;
+	frame_container.file_descriptor = -1;
+	frame_container.cached_content = NULL;
+	frame_container.length = sizeof(struct HTTP2_FRAME_HEADER) + current_frame_size;
+	frame_container.contents = new (std::nothrow) uint8_t[frame_container.length];
+
+	if (!frame_container.contents)
+	{
+		SERVER_ERROR_LOG_stdlib_err("Unable to allocate memory for a HTTP2 frame.");
+		exit(-1);
+	}
+
+	struct HTTP2_FRAME_HEADER *frame_header = (struct HTTP2_FRAME_HEADER *)frame_container.contents;
+	frame_header->stream_id = endian_conv_hton32(stream_id);
+	frame_header->length = endian_conv_hton24(current_frame_size);
+	frame_header->type = HTTP2_FRAME_TYPE_DATA;
+	frame_header->flags = last_frame ? HTTP2_FRAME_FLAG_END_STREAM : 0;
+
 	memcpy(frame_container.contents + sizeof(struct HTTP2_FRAME_HEADER), current_stream.send_buffer.c_str() + current_stream.send_buffer_offset, current_frame_size);
 	http2_conn->frame_queue.push_back(frame_container);
 
@@ -190,6 +263,58 @@ void HTTP2_Stream_Send_Body(const int worker_id, struct HTTP2_CONNECTION *http2_
 	{
 		HTTP2_Stream_Delete(worker_id, http2_conn, stream_id);
 	}
+
+	return HTTP2_CONNECTION_OK;
+}
+
+/*
+the compressed output waits in the send buffer of the stream, each call sends one frame of it,
+the file is read again only when the buffer is empty
+*/
+static int HTTP2_Stream_Send_Compressed_File(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn, const uint32_t stream_id, uint32_t max_frame_size)
+{
+	struct HTTP2_CONNECTION *http2_conn = (struct HTTP2_CONNECTION *)conn->raw_connection;
+	struct HTTP2_STREAM &current_stream = http2_conn->streams[stream_id];
+	struct HTTP_FILE_TRANSFER &file_transfer = current_stream.file_transfer;
+
+	uint32_t read_buffer_size = server_runtime_config->read_buffer_size;
+
+	while (current_stream.send_buffer_offset == current_stream.send_buffer.size() and file_transfer.file_offset != file_transfer.stop_offset)
+	{
+		uint64_t file_len = file_transfer.stop_offset - file_transfer.file_offset;
+		uint64_t bytes_to_read = (file_len > read_buffer_size) ? read_buffer_size : file_len;
+
+		ssize_t read_bytes = File_IO_Read(worker_id, conn, &file_transfer, stream_id, http_workers[worker_id].recv_buffer, bytes_to_read);
+		if (read_bytes == -1 and errno == EINTR)
+		{
+			continue;
+		}
+
+		if (read_bytes == FILE_IO_READ_PENDING)
+		{
+			return HTTP2_CONNECTION_OK;
+		}
+
+		current_stream.send_buffer.clear();
+		current_stream.send_buffer_offset = 0;
+
+		// the stream would never end if the file shrinks while it is sent
+		if (read_bytes <= 0 or !HTTP_Compressor_Update(file_transfer.compressor, http_workers[worker_id].recv_buffer, read_bytes,
+		                                               file_transfer.file_offset + read_bytes == file_transfer.stop_offset, &current_stream.send_buffer))
+		{
+			std::string err_msg = "Unable to compress the requested file (";
+			err_msg.append(current_stream.request.URI_path);
+			err_msg.append(" )");
+
+			SERVER_ERROR_LOG_stdlib_err(err_msg.c_str());
+
+			return HTTP2_Stream_Reset(worker_id, conn, stream_id, HTTP2_ERROR_CODE_INTERNAL_ERROR);
+		}
+
+		file_transfer.file_offset += read_bytes;
+	}
+
+	return HTTP2_Stream_Send_Buffered_Frame(worker_id, http2_conn, stream_id, max_frame_size);
 }
 
 int HTTP2_Stream_Send_From_File(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn, const uint32_t stream_id)
@@ -197,6 +322,12 @@ int HTTP2_Stream_Send_From_File(const int worker_id, struct GENERIC_HTTP_CONNECT
 	struct HTTP2_CONNECTION *http2_conn = (struct HTTP2_CONNECTION *)conn->raw_connection;
 	struct HTTP2_STREAM &current_stream = http2_conn->streams[stream_id];
 
+	// the next chunk is loaded by an I/O thread, its completion sends the next frame
+	if (current_stream.file_transfer.read_pending)
+	{
+		return HTTP2_CONNECTION_OK;
+	}
+
 	uint32_t max_read_size = http2_conn->client_settings.max_frame_size;
 	if (max_read_size > current_stream.send_window_avail_bytes)
 	{
@@ -209,53 +340,114 @@ int HTTP2_Stream_Send_From_File(const int worker_id, struct GENERIC_HTTP_CONNECT
 		return HTTP2_CONNECTION_OK;
 	}
 
-	uint32_t read_buffer_size = str2uint(SERVER_CONFIGURATION["read_buffer_size"].c_str()) * 1024;
+	uint32_t read_buffer_size = server_runtime_config->read_buffer_size;
 
 	if(max_read_size > read_buffer_size)
 	{
 		max_read_size = read_buffer_size;
 	}
 
+	if (current_stream.file_transfer.compressor)
+	{
+		return HTTP2_Stream_Send_Compressed_File(worker_id, conn, stream_id, max_read_size);
+	}
+
+	// the part headers of a multipart/byteranges response are framed from the send buffer, their bytes from the file
+	if (!current_stream.file_transfer.parts.empty())
+	{
+		if (current_stream.send_buffer_offset == current_stream.send_buffer.size() and HTTP_File_Transfer_Next_Part(&current_stream.file_transfer, &current_stream.send_buffer))
+		{
+			current_stream.send_buffer_offset = 0;
+		}
+
+		if (current_stream.send_buffer_offset != current_stream.send_buffer.size())
+		{
+			return HTTP2_Stream_Send_Buffered_Frame(worker_id, http2_conn, stream_id, max_read_size);
+		}
+	}
+
 	ssize_t read_bytes;
 	uint64_t bytes_to_read, file_len;
 
 	file_len = current_stream.file_transfer.stop_offset - current_stream.file_transfer.file_offset;
 	bytes_to_read = (file_len > max_read_size) ? max_read_size : file_len;
 
-	bool should_stop = false;
-	while (!should_stop)
+	HTTP2_FRAME_CONTAINER frame_container;
+	frame_container.file_descriptor = -1;
+	frame_container.cached_content = NULL;
+
+	if (current_stream.file_transfer.zero_copy)
 	{
-		read_bytes = pread(current_stream.file_transfer.file_descriptor, http_workers[worker_id].recv_buffer, bytes_to_read, current_stream.file_transfer.file_offset);
+		// sendfile() would block the worker on the pages missing from memory
+		if (!File_IO_Is_Resident(worker_id, conn, &current_stream.file_transfer, stream_id))
+		{
+			return HTTP2_CONNECTION_OK;
+		}
+
+		/*
+		the payload is sent from the file when the frame leaves the queue,
+		the descriptor of the stream is handed over to its last frame when the stream is deleted
+		*/
+		frame_container.file_descriptor = current_stream.file_transfer.file_descriptor;
+		frame_container.close_file = false;
 
-		if (read_bytes == -1)
+		frame_container.file_offset = current_stream.file_transfer.file_offset;
+		read_bytes = bytes_to_read;
+	}
+	else
+	{
+		bool should_stop = false;
+		while (!should_stop)
 		{
-			if (errno == EINTR)
+			read_bytes = File_IO_Read(worker_id, conn, &current_stream.file_transfer, stream_id, http_workers[worker_id].recv_buffer, bytes_to_read);
+
+			if (read_bytes == FILE_IO_READ_PENDING)
 			{
-				continue;
+				return HTTP2_CONNECTION_OK;
 			}
-			else
-			{
-				std::string err_msg = "Unable to read from requested file (";
-				err_msg.append(current_stream.request.URI_path);
-				err_msg.append(" )");
-
-				SERVER_ERROR_LOG_stdlib_err(err_msg.c_str());
 
-				return HTTP2_Stream_Reset(worker_id, conn, stream_id, HTTP2_ERROR_CODE_INTERNAL_ERROR);
+			if (read_bytes == -1)
+			{
+				if (errno == EINTR)
+				{
+					continue;
+				}
+				else
+				{
+					std::string err_msg = "Unable to read from requested file (";
+					err_msg.append(current_stream.request.URI_path);
+					err_msg.append(" )");
+
+					SERVER_ERROR_LOG_stdlib_err(err_msg.c_str());
+
+					return HTTP2_Stream_Reset(worker_id, conn, stream_id, HTTP2_ERROR_CODE_INTERNAL_ERROR);
+				}
 			}
+
+			should_stop = true;
 		}
 
-		should_stop = true;
+		// the file shrinks while it is sent, the rest of the content length would never come
+		if (read_bytes == 0)
+		{
+			std::string err_msg = "The requested file was truncated while it was sent (";
+			err_msg.append(current_stream.request.URI_path);
+			err_msg.append(" )");
+
+			SERVER_ERROR_LOG_stdlib_err(err_msg.c_str());
+
+			return HTTP2_Stream_Reset(worker_id, conn, stream_id, HTTP2_ERROR_CODE_INTERNAL_ERROR);
+		}
 	}
 
 	current_stream.file_transfer.file_offset += read_bytes;
 	current_stream.send_window_avail_bytes -= read_bytes;
 
-	bool last_frame = current_stream.file_transfer.file_offset == current_stream.file_transfer.stop_offset;
+	bool last_frame = current_stream.file_transfer.file_offset == current_stream.file_transfer.stop_offset and
+	                  current_stream.file_transfer.next_part == current_stream.file_transfer.parts.size();
 
-	HTTP2_FRAME_CONTAINER frame_container;
 	frame_container.length = sizeof(struct HTTP2_FRAME_HEADER) + read_bytes;
-	frame_container.contents = new (std::nothrow) uint8_t[frame_container.length];
+	frame_container.contents = new (std::nothrow) uint8_t[(frame_container.file_descriptor == -1) ? frame_container.length : sizeof(struct HTTP2_FRAME_HEADER)];
 
 	if (!frame_container.contents)
 	{
@@ -274,7 +466,11 @@ int HTTP2_Stream_Send_From_File(const int worker_id, struct GENERIC_HTTP_CONNECT
 		frame_header->flags = HTTP2_FRAME_FLAG_END_STREAM;
 	}
 
-	memcpy(frame_container.contents + sizeof(struct HTTP2_FRAME_HEADER), http_workers[worker_id].recv_buffer, read_bytes);
+	if (frame_container.file_descriptor == -1)
+	{
+		memcpy(frame_container.contents + sizeof(struct HTTP2_FRAME_HEADER), http_workers[worker_id].recv_buffer, read_bytes);
+	}
+
 	http2_conn->frame_queue.push_back(frame_container);
 
 	// http request complete
@@ -286,12 +482,12 @@ int HTTP2_Stream_Send_From_File(const int worker_id, struct GENERIC_HTTP_CONNECT
 	return HTTP2_CONNECTION_OK;
 }
 
-int HTTP2_Stream_Reset(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn, const uint32_t stream_id, const uint32_t error_code)
+static struct HTTP2_FRAME_CONTAINER HTTP2_Stream_Reset_Generate(const uint32_t stream_id, const uint32_t error_code)
 {
-	struct HTTP2_CONNECTION *http2_conn = (struct HTTP2_CONNECTION *) conn->raw_connection;
-	
 	struct HTTP2_FRAME_CONTAINER frame_container;
 	frame_container.length = sizeof(struct HTTP2_FRAME_HEADER) + 4;	
+	frame_container.file_descriptor = -1;
+	frame_container.cached_content = NULL;
 	
 	frame_container.contents = new (std::nothrow) uint8_t[frame_container.length];
 
@@ -310,13 +506,55 @@ int HTTP2_Stream_Reset(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn
 	uint32_t* err_code = (uint32_t*)  (frame_container.contents + sizeof(struct HTTP2_FRAME_HEADER));
 	*err_code = endian_conv_hton32(error_code);
 
-	http2_conn->frame_queue.push_back(frame_container);
+	return frame_container;
+}
+
+int HTTP2_Stream_Reset(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn, const uint32_t stream_id, const uint32_t error_code)
+{
+	struct HTTP2_CONNECTION *http2_conn = (struct HTTP2_CONNECTION *) conn->raw_connection;
+
+	http2_conn->frame_queue.push_back(HTTP2_Stream_Reset_Generate(stream_id, error_code));
 
 	HTTP2_Stream_Delete(worker_id, http2_conn, stream_id);
 
 	return HTTP2_Connection_Send_Enqueued_Frames(worker_id, conn);
 }
 
+void HTTP2_Stream_Cancel(const int worker_id, struct HTTP2_CONNECTION *http2_conn, const uint32_t stream_id, const uint32_t error_code)
+{
+	if (http2_conn->streams.find(stream_id) != http2_conn->streams.end())
+	{
+		HTTP2_Stream_Delete(worker_id, http2_conn, stream_id);
+	}
+
+	// nothing else is sent on a reset stream, its queued frames would read past the end of the file too
+	for (auto it = http2_conn->frame_queue.begin(); it != http2_conn->frame_queue.end();)
+	{
+		struct HTTP2_FRAME_HEADER *frame_header = (struct HTTP2_FRAME_HEADER *)it->contents;
+
+		if (endian_conv_ntoh_http31(frame_header->stream_id) != stream_id)
+		{
+			it++;
+			continue;
+		}
+
+		if (it->file_descriptor != -1 and it->close_file)
+		{
+			close(it->file_descriptor);
+		}
+
+		if (it->cached_content)
+		{
+			Content_Cache_Release(it->cached_content);
+		}
+
+		delete[] it->contents;
+		it = http2_conn->frame_queue.erase(it);
+	}
+
+	http2_conn->frame_queue.push_front(HTTP2_Stream_Reset_Generate(stream_id, error_code));
+}
+
 void HTTP2_Stream_Delete(const int worker_id, struct HTTP2_CONNECTION *http2_conn, const uint32_t stream_id)
 {
 	struct HTTP2_STREAM& stream = http2_conn->streams[stream_id];
@@ -341,17 +579,22 @@ void HTTP2_Stream_Delete(const int worker_id, struct HTTP2_CONNECTION *http2_con
 		delete(stream.response.COOKIES);
 	}
 
-	if(stream.state == HTTP2_STREAM_STATE_FILE_BOUND and stream.file_transfer.file_descriptor != -1)
+	// the queued DATA frames send their payload from the descriptor
+	if(stream.state == HTTP2_STREAM_STATE_FILE_BOUND and stream.file_transfer.file_descriptor != -1 and
+	   !HTTP2_Connection_Hand_Over_File(http2_conn, stream.file_transfer.file_descriptor))
 	{
 		close(stream.file_transfer.file_descriptor);
 	}
 
-	http2_conn->streams.erase(stream_id);
-
-	total_http_connections--;
+	HTTP_Compressor_Delete(stream.file_transfer.compressor);
 
-	if(is_server_load_balancer_fair)
+	// the queued DATA frames hold the entry on their own
+	if(stream.cached_content)
 	{
-		connections_per_worker[worker_id]--;
+		Content_Cache_Release(stream.cached_content);
 	}
+
+	http2_conn->streams.erase(stream_id);
+
+	http_workers_load[worker_id].connections--;
 }
\ No newline at end of file
@@ -8,6 +8,9 @@ int HTTP2_Stream_Send_Headers(const int worker_id, struct GENERIC_HTTP_CONNECTIO
 void HTTP2_Stream_Send_Body(const int worker_id, struct HTTP2_CONNECTION *http2_conn, const uint32_t stream_id);
 int HTTP2_Stream_Send_From_File(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn, const uint32_t stream_id);
 int HTTP2_Stream_Reset(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn, const uint32_t stream_id, const uint32_t error_code);
+
+//the frames of the stream are dropped from the queue and RST_STREAM is sent right after the frame in progress
+void HTTP2_Stream_Cancel(const int worker_id, struct HTTP2_CONNECTION *http2_conn, const uint32_t stream_id, const uint32_t error_code);
 void HTTP2_Stream_Delete(const int worker_id, struct HTTP2_CONNECTION *http2_conn, const uint32_t stream_id);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,375 @@
+#include "http_compression.h"
+#include "http_parser.h"
+#include "content_cache.h"
+
+#include "../server_config.h"
+#include "../server_log.h"
+#include "../helper_functions.h"
+
+#include <new>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_set>
+#include <cstring>
+
+#ifndef DISABLE_COMPRESSION
+#include <zlib.h>
+#include <brotli/encode.h>
+#include <zstd.h>
+#endif
+
+const char* const http_compression_encoding_names[HTTP_COMPRESSION_ENCODINGS_NUM] = {"br", "zstd", "gzip", "deflate"};
+
+struct HTTP_COMPRESSOR
+{
+	int encoding;
+
+#ifndef DISABLE_COMPRESSION
+	z_stream zlib_stream;
+	BrotliEncoderState* brotli_state;
+	ZSTD_CCtx* zstd_context;
+#endif
+};
+
+struct HTTP_COMPRESSION_JOB
+{
+	std::string key; //the encoding and the path, a file is queued once for each encoding
+	std::string path;
+	struct FILE_CACHE_INFO info;
+	int encoding;
+	int level;
+};
+
+static std::vector<std::thread*> http_compression_threads;
+
+static std::mutex http_compression_queue_lock;
+static std::condition_variable http_compression_queue_signal;
+static std::deque<struct HTTP_COMPRESSION_JOB> http_compression_queue;
+static std::unordered_set<std::string> http_compression_queued_files;
+static bool is_http_compression_stopping = false;
+
+//the compressed copies are published in the content cache, the workers find them there
+static void HTTP_Compression_Helper_Main()
+{
+	std::unique_lock<std::mutex> queue_guard(http_compression_queue_lock);
+
+	while (true)
+	{
+		http_compression_queue_signal.wait(queue_guard, [] { return is_http_compression_stopping or !http_compression_queue.empty(); });
+
+		if (is_http_compression_stopping)
+		{
+			return;
+		}
+
+		struct HTTP_COMPRESSION_JOB job = http_compression_queue.front();
+		http_compression_queue.pop_front();
+
+		queue_guard.unlock();
+		Content_Cache_Load_Compressed(job.path, &job.info, job.encoding, job.level);
+		queue_guard.lock();
+
+		http_compression_queued_files.erase(job.key);
+	}
+}
+
+void HTTP_Compression_Init(size_t threads_num)
+{
+	is_http_compression_stopping = false;
+
+	for (size_t i = 0; i < threads_num; i++)
+	{
+		http_compression_threads.push_back(new std::thread(HTTP_Compression_Helper_Main));
+	}
+}
+
+void HTTP_Compression_Free()
+{
+	http_compression_queue_lock.lock();
+	is_http_compression_stopping = true;
+	http_compression_queue_lock.unlock();
+
+	http_compression_queue_signal.notify_all();
+
+	for (size_t i = 0; i < http_compression_threads.size(); i++)
+	{
+		http_compression_threads[i]->join();
+		delete (http_compression_threads[i]);
+	}
+
+	http_compression_threads.clear();
+	http_compression_queue.clear();
+	http_compression_queued_files.clear();
+}
+
+bool HTTP_Compression_Is_Compressible(const std::string& content_type, uint64_t size)
+{
+	//an empty response has nothing to compress
+	if (!server_runtime_config->compression_enabled or size == 0 or size < server_runtime_config->compression_min_size)
+	{
+		return false;
+	}
+
+	std::string mime_type = str_ansi_to_lower(content_type.substr(0, content_type.find(';')));
+	mime_type.erase(mime_type.find_last_not_of(" \t") + 1);
+
+	const std::vector<std::string>& allowed_types = server_runtime_config->compression_mime_types;
+	for (size_t i = 0; i < allowed_types.size(); i++)
+	{
+		//"text/*" allows every text type
+		size_t allowed_len = allowed_types[i].size();
+		if (allowed_len >= 2 and allowed_types[i][allowed_len - 1] == '*' and allowed_types[i][allowed_len - 2] == '/')
+		{
+			if (mime_type.compare(0, allowed_len - 1, allowed_types[i], 0, allowed_len - 1) == 0)
+			{
+				return true;
+			}
+		}
+		else if (mime_type == allowed_types[i])
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+int HTTP_Compression_Select_Encoding(const struct HTTP_REQUEST* request)
+{
+	if (!server_runtime_config->compression_enabled)
+	{
+		return -1;
+	}
+
+	return HTTP_Request_Select_Encoding(request, http_compression_encoding_names, HTTP_COMPRESSION_ENCODINGS_NUM, (1 << HTTP_COMPRESSION_ENCODINGS_NUM) - 1);
+}
+
+#ifndef DISABLE_COMPRESSION
+//maps the 1-9 level of the config onto the range of the encoder, 1 stays the fastest and 9 the strongest one
+static int HTTP_Compression_Encoder_Level(int encoding, int level)
+{
+	if (encoding == HTTP_COMPRESSION_ENCODING_BR)
+	{
+		return (level * HTTP_COMPRESSION_BROTLI_MAX_QUALITY + 4) / 9;
+	}
+	else if (encoding == HTTP_COMPRESSION_ENCODING_ZSTD)
+	{
+		return 1 + ((level - 1) * (HTTP_COMPRESSION_ZSTD_MAX_LEVEL - 1) + 4) / 8;
+	}
+
+	return level;
+}
+#endif
+
+struct HTTP_COMPRESSOR* HTTP_Compressor_Create(int encoding, int level)
+{
+#ifdef DISABLE_COMPRESSION
+	return NULL;
+#else
+	struct HTTP_COMPRESSOR* compressor = new (std::nothrow) struct HTTP_COMPRESSOR;
+	if (!compressor)
+	{
+		SERVER_ERROR_LOG_stdlib_err("Unable to allocate memory for a compressor!");
+		exit(-1);
+	}
+
+	compressor->encoding = encoding;
+	compressor->brotli_state = NULL;
+	compressor->zstd_context = NULL;
+	memset(&compressor->zlib_stream, 0, sizeof(compressor->zlib_stream));
+
+	bool is_created = false;
+	level = HTTP_Compression_Encoder_Level(encoding, level);
+
+	if (encoding == HTTP_COMPRESSION_ENCODING_BR)
+	{
+		compressor->brotli_state = BrotliEncoderCreateInstance(NULL, NULL, NULL);
+		is_created = compressor->brotli_state and BrotliEncoderSetParameter(compressor->brotli_state, BROTLI_PARAM_QUALITY, level) and
+		             BrotliEncoderSetParameter(compressor->brotli_state, BROTLI_PARAM_LGWIN, HTTP_COMPRESSION_WINDOW_BITS);
+	}
+	else if (encoding == HTTP_COMPRESSION_ENCODING_ZSTD)
+	{
+		compressor->zstd_context = ZSTD_createCCtx();
+		is_created = compressor->zstd_context and !ZSTD_isError(ZSTD_CCtx_setParameter(compressor->zstd_context, ZSTD_c_compressionLevel, level)) and
+		             !ZSTD_isError(ZSTD_CCtx_setParameter(compressor->zstd_context, ZSTD_c_windowLog, HTTP_COMPRESSION_WINDOW_BITS));
+	}
+	else
+	{
+		//gzip wraps the deflate stream with its header and trailer, the deflate encoding is the zlib format
+		int window_bits = (encoding == HTTP_COMPRESSION_ENCODING_GZIP) ? MAX_WBITS + 16 : MAX_WBITS;
+		is_created = deflateInit2(&compressor->zlib_stream, level, Z_DEFLATED, window_bits, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+	}
+
+	if (!is_created)
+	{
+		SERVER_ERROR_LOG_stdlib_err("Unable to create a compressor!");
+
+		HTTP_Compressor_Delete(compressor);
+		return NULL;
+	}
+
+	return compressor;
+#endif
+}
+
+void HTTP_Compressor_Delete(struct HTTP_COMPRESSOR* compressor)
+{
+	if (!compressor)
+	{
+		return;
+	}
+
+#ifndef DISABLE_COMPRESSION
+	if (compressor->encoding == HTTP_COMPRESSION_ENCODING_BR)
+	{
+		if (compressor->brotli_state)
+		{
+			BrotliEncoderDestroyInstance(compressor->brotli_state);
+		}
+	}
+	else if (compressor->encoding == HTTP_COMPRESSION_ENCODING_ZSTD)
+	{
+		ZSTD_freeCCtx(compressor->zstd_context);
+	}
+	else
+	{
+		//a stream that failed to initialize has no state, deflateEnd() ignores it
+		deflateEnd(&compressor->zlib_stream);
+	}
+#endif
+
+	delete (compressor);
+}
+
+bool HTTP_Compressor_Update(struct HTTP_COMPRESSOR* compressor, const char* input, size_t input_len, bool finish, std::string* output)
+{
+#ifdef DISABLE_COMPRESSION
+	return false;
+#else
+	if (compressor->encoding == HTTP_COMPRESSION_ENCODING_BR)
+	{
+		const uint8_t* next_in = (const uint8_t*) input;
+		size_t avail_in = input_len;
+		BrotliEncoderOperation operation = finish ? BROTLI_OPERATION_FINISH : BROTLI_OPERATION_PROCESS;
+
+		while (true)
+		{
+			//no output buffer, the encoder hands out its own
+			size_t avail_out = 0;
+			if (!BrotliEncoderCompressStream(compressor->brotli_state, operation, &avail_in, &next_in, &avail_out, NULL, NULL))
+			{
+				return false;
+			}
+
+			size_t compressed_len = 0;
+			const uint8_t* compressed_data = BrotliEncoderTakeOutput(compressor->brotli_state, &compressed_len);
+			output->append((const char*) compressed_data, compressed_len);
+
+			if (avail_in == 0 and !BrotliEncoderHasMoreOutput(compressor->brotli_state) and (!finish or BrotliEncoderIsFinished(compressor->brotli_state)))
+			{
+				return true;
+			}
+		}
+	}
+
+	if (compressor->encoding == HTTP_COMPRESSION_ENCODING_ZSTD)
+	{
+		ZSTD_inBuffer input_buffer = {input, input_len, 0};
+		ZSTD_EndDirective directive = finish ? ZSTD_e_end : ZSTD_e_continue;
+
+		while (true)
+		{
+			size_t output_start = output->size();
+			output->resize(output_start + HTTP_COMPRESSION_OUTPUT_CHUNK_SIZE);
+
+			ZSTD_outBuffer output_buffer = {&(*output)[output_start], HTTP_COMPRESSION_OUTPUT_CHUNK_SIZE, 0};
+			size_t remaining_bytes = ZSTD_compressStream2(compressor->zstd_context, &output_buffer, &input_buffer, directive);
+
+			output->resize(output_start + output_buffer.pos);
+
+			if (ZSTD_isError(remaining_bytes))
+			{
+				return false;
+			}
+
+			if (finish ? remaining_bytes == 0 : input_buffer.pos == input_buffer.size)
+			{
+				return true;
+			}
+		}
+	}
+
+	z_stream* zlib_stream = &compressor->zlib_stream;
+	zlib_stream->next_in = (Bytef*) input;
+	zlib_stream->avail_in = input_len;
+
+	while (true)
+	{
+		size_t output_start = output->size();
+		output->resize(output_start + HTTP_COMPRESSION_OUTPUT_CHUNK_SIZE);
+
+		zlib_stream->next_out = (Bytef*) &(*output)[output_start];
+		zlib_stream->avail_out = HTTP_COMPRESSION_OUTPUT_CHUNK_SIZE;
+
+		int result = deflate(zlib_stream, finish ? Z_FINISH : Z_NO_FLUSH);
+
+		output->resize(output_start + HTTP_COMPRESSION_OUTPUT_CHUNK_SIZE - zlib_stream->avail_out);
+
+		if (result == Z_STREAM_ERROR)
+		{
+			return false;
+		}
+
+		//a full output buffer may hide more pending bytes
+		if (finish ? result == Z_STREAM_END : (zlib_stream->avail_in == 0 and zlib_stream->avail_out != 0))
+		{
+			return true;
+		}
+	}
+#endif
+}
+
+bool HTTP_Compress(int encoding, int level, const char* input, size_t input_len, std::string* output)
+{
+	struct HTTP_COMPRESSOR* compressor = HTTP_Compressor_Create(encoding, level);
+	if (!compressor)
+	{
+		return false;
+	}
+
+	bool is_compressed = HTTP_Compressor_Update(compressor, input, input_len, true, output);
+	HTTP_Compressor_Delete(compressor);
+
+	return is_compressed;
+}
+
+bool HTTP_Compression_Is_Inline(const struct FILE_CACHE_INFO* info)
+{
+	return http_compression_threads.empty() or info->size < HTTP_COMPRESSION_ASYNC_MIN_SIZE;
+}
+
+void HTTP_Compression_Queue_File(const std::string& path, const struct FILE_CACHE_INFO* info, int encoding, int level)
+{
+	struct HTTP_COMPRESSION_JOB job;
+	job.key = int2str(encoding);
+	job.key.append(1, ':');
+	job.key.append(path);
+
+	std::lock_guard<std::mutex> queue_guard(http_compression_queue_lock);
+
+	if (http_compression_queue.size() >= HTTP_COMPRESSION_MAX_QUEUED_FILES or !http_compression_queued_files.insert(job.key).second)
+	{
+		return;
+	}
+
+	job.path = path;
+	job.info = *info;
+	job.encoding = encoding;
+	job.level = level;
+
+	http_compression_queue.push_back(job);
+	http_compression_queue_signal.notify_one();
+}
@@ -0,0 +1,65 @@
+#ifndef __http_compression_inc__
+#define __http_compression_inc__
+
+#include "http_core.h"
+#include "../file_cache.h"
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+//the encodings applied on the fly, in the order of preference
+#define HTTP_COMPRESSION_ENCODINGS_NUM 4
+#define HTTP_COMPRESSION_ENCODING_BR 0
+#define HTTP_COMPRESSION_ENCODING_ZSTD 1
+#define HTTP_COMPRESSION_ENCODING_GZIP 2
+#define HTTP_COMPRESSION_ENCODING_DEFLATE 3
+
+extern const char* const http_compression_encoding_names[HTTP_COMPRESSION_ENCODINGS_NUM];
+
+//a file at least this big is compressed by the helper threads, the requests sent before it is ready get a compressed stream
+#define HTTP_COMPRESSION_ASYNC_MIN_SIZE 65536
+
+//the files waiting for a helper thread, the next ones are only streamed
+#define HTTP_COMPRESSION_MAX_QUEUED_FILES 256
+
+//the window of the brotli and zstd encoders, each compressed stream keeps one in memory
+#define HTTP_COMPRESSION_WINDOW_BITS 18
+
+//compression_level is on the zlib scale 1-9, it is mapped linearly onto these brotli qualities and zstd levels
+#define HTTP_COMPRESSION_BROTLI_MAX_QUALITY 11
+#define HTTP_COMPRESSION_ZSTD_MAX_LEVEL 19
+
+//the output grows by this much while the zlib and zstd encoders fill it
+#define HTTP_COMPRESSION_OUTPUT_CHUNK_SIZE 16384
+
+//threads_num = 0 compresses every cached file in the worker that misses it
+void HTTP_Compression_Init(size_t threads_num);
+void HTTP_Compression_Free();
+
+//true if a response of this type and size is compressed, checked against the runtime config
+bool HTTP_Compression_Is_Compressible(const std::string& content_type, uint64_t size);
+
+//the encoding used for the response, -1 if the client accepts none or the compression is disabled
+int HTTP_Compression_Select_Encoding(const struct HTTP_REQUEST* request);
+
+//NULL if the encoder can not be created, level is the configured compression_level
+struct HTTP_COMPRESSOR* HTTP_Compressor_Create(int encoding, int level);
+void HTTP_Compressor_Delete(struct HTTP_COMPRESSOR* compressor);
+
+/*
+appends the compressed input to output, the encoder may keep the input and return nothing,
+finish flushes everything and ends the stream, false on error
+*/
+bool HTTP_Compressor_Update(struct HTTP_COMPRESSOR* compressor, const char* input, size_t input_len, bool finish, std::string* output);
+
+//compresses a whole buffer, false on error
+bool HTTP_Compress(int encoding, int level, const char* input, size_t input_len, std::string* output);
+
+//true if the compressed copy of the file for the content cache is made by the worker itself
+bool HTTP_Compression_Is_Inline(const struct FILE_CACHE_INFO* info);
+
+//hands the file to a helper thread, a file already queued or a full queue is ignored
+void HTTP_Compression_Queue_File(const std::string& path, const struct FILE_CACHE_INFO* info, int encoding, int level);
+
+#endif
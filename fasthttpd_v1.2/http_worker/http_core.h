@@ -56,11 +56,33 @@ struct HTTP_COOKIE
 	bool http_only;
 };
 
+#define HTTP_HEADER_INDEX_SIZE 32
+
+struct HTTP_HEADER_INDEX_ENTRY
+{
+	uint32_t name_offset;
+	uint32_t name_len; //0 for a removed entry
+	uint32_t value_offset;
+	uint32_t value_len;
+};
+
+//the HTTP/1 headers are kept as offsets inside the receive buffer
+struct HTTP_HEADER_INDEX
+{
+	const std::string* raw_request;
+	unsigned int size;
+	struct HTTP_HEADER_INDEX_ENTRY entries[HTTP_HEADER_INDEX_SIZE];
+};
+
 struct HTTP_REQUEST
 {
 	int method;
 	int POST_type;
+
+	//use HTTP_Request_Find_Header(), for HTTP/1 the map holds only the headers that are not in the index
 	std::unordered_map <std::string , std::string> headers;
+	struct HTTP_HEADER_INDEX* header_index; //NULL for HTTP/2
+
 	std::string URI_path;
 	std::unordered_map <std::string,std::string> URI_query;
 	std::unordered_map <std::string,std::string>* POST_query;
@@ -76,15 +98,50 @@ struct HTTP_RESPONSE
 	std::vector<struct HTTP_COOKIE> *COOKIES;
 };
 
+struct HTTP_COMPRESSOR;
+
+//a requested byte range, stop is the first byte after it
+struct HTTP_BYTE_RANGE
+{
+	int64_t start;
+	int64_t stop;
+};
+
+//a part of a multipart/byteranges response, the closing boundary is a part without bytes
+struct HTTP_FILE_PART
+{
+	std::string header; //the boundary and the part headers, sent before the bytes
+	int64_t file_offset;
+	int64_t stop_offset;
+};
+
 struct HTTP_FILE_TRANSFER
 {
 	int file_descriptor;
 	int64_t file_offset;
 	int64_t stop_offset;
+
+	//the file is sent directly by the kernel, cleared if the file does not support sendfile()
+	bool zero_copy;
+
+	//the next chunk is loaded by an I/O thread, the transfer waits for its completion
+	bool read_pending;
+
+	//the reads do not wait for the disk, cleared if the file system does not support RWF_NOWAIT
+	bool nowait_reads;
+
+	//not NULL when the file is compressed while it is sent, HTTP/1.1 sends it chunked
+	struct HTTP_COMPRESSOR* compressor;
+
+	//the parts of a multipart/byteranges response, sent once the current range is done, empty for the other responses
+	std::vector<struct HTTP_FILE_PART> parts;
+	size_t next_part;
 };
 
 struct HTTP_PARSER_HELPER
 {
+	size_t scan_offset; //recv_buffer is already searched up to this offset
+	size_t line_start_offset; //start of the header line being received
 	size_t headers_start_offset;
 	size_t body_start_offset;
 	uint64_t content_length;
@@ -93,6 +150,7 @@ struct HTTP_PARSER_HELPER
 struct HTTP1_CONNECTION
 {
 	std::string recv_buffer;
+	std::string pipeline_buffer; //requests received after the one being processed
 
 	std::string send_buffer;
 	size_t send_buffer_offset;
@@ -103,6 +161,9 @@ struct HTTP1_CONNECTION
 	struct HTTP_FILE_TRANSFER file_transfer;
 
 	struct HTTP_PARSER_HELPER parser_helper;
+	struct HTTP_HEADER_INDEX header_index;
+
+	bool keep_alive_reused; //a response was already sent, an empty buffer means the connection is idle
 };
 
 #endif
@@ -4,55 +4,80 @@
 #include "../server_config.h"
 #include "../server_log.h"
 #include "../helper_functions.h"
+#include "../simd_scan.h"
 
 #include <algorithm>
+#include <cstdlib>
 #include <cstring>
+#include <strings.h>
 
-int HTTP_Parse_Method(const std::string &method)
+int HTTP_Parse_Method(const char *method, size_t method_len)
 {
-	if (method == "get" or method == "GET")
-	{
-		return HTTP_METHOD_GET;
-	}
-	else if (method == "post" or method == "POST")
-	{
-		return HTTP_METHOD_POST;
-	}
-	else if (method == "put" or method == "PUT")
-	{
-		return HTTP_METHOD_PUT;
-	}
-	else if (method == "head" or method == "HEAD")
-	{
-		return HTTP_METHOD_HEAD;
-	}
-	else if (method == "delete" or method == "DELETE")
+	switch (method_len)
 	{
-		return HTTP_METHOD_DELETE;
-	}
-	else if (method == "options" or method == "OPTIONS")
-	{
-		return HTTP_METHOD_OPTIONS;
-	}
-	else if (method == "connect" or method == "CONNECT")
-	{
-		return HTTP_METHOD_CONNECT;
-	}
-	else if (method == "trace" or method == "TRACE")
-	{
-		return HTTP_METHOD_TRACE;
-	}
-	else if (method == "patch" or method == "PATCH")
-	{
-		return HTTP_METHOD_PATCH;
+		case 3:
+			if (strncasecmp(method, "GET", 3) == 0)
+			{
+				return HTTP_METHOD_GET;
+			}
+			else if (strncasecmp(method, "PUT", 3) == 0)
+			{
+				return HTTP_METHOD_PUT;
+			}
+			break;
+
+		case 4:
+			if (strncasecmp(method, "POST", 4) == 0)
+			{
+				return HTTP_METHOD_POST;
+			}
+			else if (strncasecmp(method, "HEAD", 4) == 0)
+			{
+				return HTTP_METHOD_HEAD;
+			}
+			break;
+
+		case 5:
+			if (strncasecmp(method, "TRACE", 5) == 0)
+			{
+				return HTTP_METHOD_TRACE;
+			}
+			else if (strncasecmp(method, "PATCH", 5) == 0)
+			{
+				return HTTP_METHOD_PATCH;
+			}
+			break;
+
+		case 6:
+			if (strncasecmp(method, "DELETE", 6) == 0)
+			{
+				return HTTP_METHOD_DELETE;
+			}
+			break;
+
+		case 7:
+			if (strncasecmp(method, "OPTIONS", 7) == 0)
+			{
+				return HTTP_METHOD_OPTIONS;
+			}
+			else if (strncasecmp(method, "CONNECT", 7) == 0)
+			{
+				return HTTP_METHOD_CONNECT;
+			}
+			break;
 	}
 
 	return HTTP_METHOD_UNDEFINED;
 }
 
-bool HTTP_Parse_Request_First_Line(const std::string &first_line, std::string* URI, int* method, int* http_version, size_t* headers_start_offset)
+int HTTP_Parse_Method(const std::string &method)
 {
-    size_t stop_pos = first_line.find('\n');
+	return HTTP_Parse_Method(method.c_str(), method.size());
+}
+
+bool HTTP_Parse_Request_First_Line(const std::string &raw_request, size_t* URI_start, size_t* URI_len, int* method, int* http_version, size_t* headers_start_offset)
+{
+    size_t stop_pos = raw_request.find('\n');
     if(stop_pos == std::string::npos)
     {
         return false;
@@ -60,38 +85,44 @@ bool HTTP_Parse_Request_First_Line(const std::string &first_line, std::string* U
 
     headers_start_offset[0] = stop_pos + 1;
 
-    if(first_line.size() >= 2 and first_line[stop_pos - 1] == '\r')
+    if(stop_pos > 0 and raw_request[stop_pos - 1] == '\r')
     {
         stop_pos--;
     }
 
-    size_t first_space = first_line.find(' ');
-    if(first_space == std::string::npos or first_space >= stop_pos)
+    // the fields are only located, nothing is copied
+    const char *first_line = raw_request.c_str();
+
+    const char *first_space = (const char *)memchr(first_line, ' ', stop_pos);
+    if(!first_space)
     {
        return false;
     }
 
-    std::string ascii_method = first_line.substr(0, first_space);
-    method[0] = HTTP_Parse_Method(ascii_method);
+    method[0] = HTTP_Parse_Method(first_line, first_space - first_line);
 
-    size_t second_space = first_line.find(' ', first_space + 1);
-    if(second_space == std::string::npos or second_space >= stop_pos)
+    size_t URI_offset = (first_space - first_line) + 1;
+    const char *second_space = (const char *)memchr(first_line + URI_offset, ' ', stop_pos - URI_offset);
+    if(!second_space)
     {
        return false;
     }
 
-    URI[0] = first_line.substr(first_space + 1, second_space - (first_space + 1));
+    URI_start[0] = URI_offset;
+    URI_len[0] = (second_space - first_line) - URI_offset;
+
+    size_t version_offset = (second_space - first_line) + 1;
+    size_t version_len = stop_pos - version_offset;
 
-    std::string ascii_http_version = first_line.substr(second_space + 1, stop_pos - (second_space + 1));
-    if(ascii_http_version == "HTTP/1.0")
+    if(version_len == 8 and memcmp(first_line + version_offset, "HTTP/1.0", 8) == 0)
     {
         http_version[0] = HTTP_VERSION_1;
     }
-    else if(ascii_http_version == "HTTP/1.1")
+    else if(version_len == 8 and memcmp(first_line + version_offset, "HTTP/1.1", 8) == 0)
     {
         http_version[0] = HTTP_VERSION_1_1;
     }
-    else if(ascii_http_version == "HTTP/2.0")
+    else if(version_len == 8 and memcmp(first_line + version_offset, "HTTP/2.0", 8) == 0)
     {
         http_version[0] = HTTP_VERSION_2;
     }
@@ -113,8 +144,7 @@ bool HTTP_Parse_Query(const std::string &query_part, std::unordered_map<std::str
 
     *query_args_limit_exceeded = false;
 
-    std::string query_name, query_value, dec_query_name, dec_query_value;
-    bool parser_state = 0; // 0->extracting key ; 1->extracting value
+    std::string dec_query_name, dec_query_value;
 
     if (end_offset < 0)
     {
@@ -126,87 +156,79 @@ bool HTTP_Parse_Query(const std::string &query_part, std::unordered_map<std::str
         return false;
     }
 
-    for (int i = start_offset; i <= end_offset; i++)
+    const char *query = query_part.c_str();
+    size_t position = start_offset;
+    size_t query_end = end_offset + 1;
+
+    while (position <= query_end)
     {
-        if (query_part[i] == '=')
+        // one name=value pair
+        size_t pair_end = position + SIMD_Scan_Any(query + position, query_end - position, "&", 1);
+        size_t name_end = position + SIMD_Scan_Any(query + position, pair_end - position, "=", 1);
+
+        dec_query_name.clear();
+        dec_query_value.clear();
+
+        if (!url_decode(query + position, name_end - position, &dec_query_name))
         {
-            parser_state = 1;
+            return false;
         }
-        else if (query_part[i] == '&')
+
+        // the '=' characters inside the value are dropped
+        size_t value_position = name_end;
+        while (value_position < pair_end)
         {
-            parser_state = 0;
+            value_position++;
 
-            if (!url_decode(&query_name, &dec_query_name) or !url_decode(&query_value, &dec_query_value))
+            size_t value_part_end = value_position + SIMD_Scan_Any(query + value_position, pair_end - value_position, "=", 1);
+            if (!url_decode(query + value_position, value_part_end - value_position, &dec_query_value))
             {
                 return false;
             }
 
-            query_name.clear();
-            query_value.clear();
-
-            if (!dec_query_name.empty())
-            {
-                query_params[0][dec_query_name] = dec_query_value;
-            }
-
-            dec_query_name.clear();
-            dec_query_value.clear();
+            value_position = value_part_end;
         }
 
-        // extracting value
-        else if (parser_state)
-        {
-            query_value.append(1, query_part[i]);
-        }
-
-        // extracting key
-        else
-        {
-            query_name.append(1, query_part[i]);
-        }
-    }
-
-    if (!url_decode(&query_name, &dec_query_name) or !url_decode(&query_value, &dec_query_value))
-    {
-        return false;
-    }
-
-    if (!dec_query_name.empty() and !(*query_args_limit_exceeded))
-    {
-        if (query_params->size() + 1 > max_query_args)
+        if (!dec_query_name.empty() and !(*query_args_limit_exceeded))
         {
-            *query_args_limit_exceeded = true;
+            if (query_params->size() + 1 > max_query_args)
+            {
+                *query_args_limit_exceeded = true;
 
-            if (!continue_if_exceeded)
+                if (!continue_if_exceeded)
+                {
+                    return false;
+                }
+            }
+            else
             {
-                return false;
+                query_params[0][dec_query_name] = dec_query_value;
             }
         }
-        else
-        {
-            query_params[0][dec_query_name] = dec_query_value;
-        }
+
+        position = pair_end + 1;
     }
 
     return true;
 }
 
-bool HTTP_Parse_Raw_URI(const std::string &raw_URI, std::string *URI, std::unordered_map<std::string, std::string> *URI_query_params, unsigned int max_arg_limit, bool continue_if_exceeded)
+bool HTTP_Parse_Raw_URI(const std::string &raw_request, size_t URI_start, size_t URI_len, std::string *URI, std::unordered_map<std::string, std::string> *URI_query_params, unsigned int max_arg_limit, bool continue_if_exceeded)
 {
-    size_t query_mark = raw_URI.find('?');
-    if (query_mark == std::string::npos)
+    const char *raw_URI = raw_request.c_str() + URI_start;
+
+    const char *query_mark = (const char *)memchr(raw_URI, '?', URI_len);
+    if (!query_mark)
     {
-        return url_decode(&raw_URI, URI);
+        return url_decode(raw_URI, URI_len, URI);
     }
 
-    std::string URI_Path = raw_URI.substr(0, query_mark);
-    if (!url_decode(&URI_Path, URI))
+    if (!url_decode(raw_URI, query_mark - raw_URI, URI))
     {
         return false;
     }
 
     bool arg_limit_exceeded;
-    bool parse_result = HTTP_Parse_Query(raw_URI, URI_query_params, max_arg_limit, &arg_limit_exceeded, continue_if_exceeded, query_mark + 1);
+    bool parse_result = HTTP_Parse_Query(raw_request, URI_query_params, max_arg_limit, &arg_limit_exceeded, continue_if_exceeded, (query_mark - raw_request.c_str()) + 1, URI_start + URI_len - 1);
 
     if (arg_limit_exceeded)
     {
@@ -219,74 +241,272 @@ bool HTTP_Parse_Raw_URI(const std::string &raw_URI, std::string *URI, std::unord
     return parse_result;
 }
 
-bool HTTP_Decode_Content_Range(const std::string &content_range, int64_t *offset_start, int64_t *offset_stop)
+bool HTTP_Parse_Raw_URI(const std::string &raw_URI, std::string *URI, std::unordered_map<std::string, std::string> *URI_query_params, unsigned int max_arg_limit, bool continue_if_exceeded)
 {
-    std::vector<std::string> content_range_el;
-    explode(&content_range, "=", &content_range_el);
+    return HTTP_Parse_Raw_URI(raw_URI, 0, raw_URI.size(), URI, URI_query_params, max_arg_limit, continue_if_exceeded);
+}
 
-    if (content_range_el.size() != 2 or content_range_el[0] != "bytes")
+int HTTP_Decode_Byte_Ranges(const std::string &range_header, uint64_t file_size, std::vector<struct HTTP_BYTE_RANGE> *ranges)
+{
+    ranges->clear();
+
+    size_t unit_end = range_header.find('=');
+    if (unit_end == std::string::npos or str_ansi_to_lower(range_header.substr(0, unit_end)) != "bytes")
     {
-        return false;
+        return HTTP_RANGE_NOT_SATISFIABLE;
     }
 
-    std::vector<std::string> content_range_data;
-    explode(&content_range_el[1], "-", &content_range_data);
+    std::string range_set = range_header.substr(unit_end + 1);
 
-    if (content_range_data.size() != 2)
+    std::vector<std::string> range_specs;
+    explode(&range_set, ",", &range_specs);
+
+    if (range_specs.size() > HTTP_MAX_BYTE_RANGES)
     {
-        return false;
+        return HTTP_RANGE_IGNORED;
     }
 
-    bool is_invalid;
-    offset_start[0] = (int64_t)str2uint(&content_range_data[0], &is_invalid);
-
-    if (is_invalid)
+    for (size_t i = 0; i < range_specs.size(); i++)
     {
-        return false;
+        std::string &range_spec = range_specs[i];
+        range_spec.erase(0, range_spec.find_first_not_of(" \t"));
+        range_spec.erase(range_spec.find_last_not_of(" \t") + 1);
+
+        if (range_spec.empty())
+        {
+            continue;
+        }
+
+        size_t separator = range_spec.find('-');
+        if (separator == std::string::npos)
+        {
+            return HTTP_RANGE_NOT_SATISFIABLE;
+        }
+
+        std::string first_byte = range_spec.substr(0, separator);
+        std::string last_byte = range_spec.substr(separator + 1);
+
+        bool is_invalid;
+        struct HTTP_BYTE_RANGE range;
+
+        // "-500" are the last 500 bytes of the file
+        if (first_byte.empty())
+        {
+            uint64_t suffix_length = str2uint(&last_byte, &is_invalid);
+            if (is_invalid)
+            {
+                return HTTP_RANGE_NOT_SATISFIABLE;
+            }
+
+            range.start = (suffix_length < file_size) ? file_size - suffix_length : 0;
+            range.stop = file_size;
+        }
+        else
+        {
+            range.start = str2uint(&first_byte, &is_invalid);
+            if (is_invalid)
+            {
+                return HTTP_RANGE_NOT_SATISFIABLE;
+            }
+
+            // the last byte is included, some browsers specifiy only the starting offset
+            range.stop = file_size;
+            if (!last_byte.empty())
+            {
+                uint64_t last_offset = str2uint(&last_byte, &is_invalid);
+                if (is_invalid or last_offset < (uint64_t)range.start)
+                {
+                    return HTTP_RANGE_NOT_SATISFIABLE;
+                }
+
+                if (last_offset < file_size)
+                {
+                    range.stop = last_offset + 1;
+                }
+            }
+        }
+
+        if ((uint64_t)range.start < file_size and range.start < range.stop)
+        {
+            ranges->push_back(range);
+        }
     }
 
-    // some browsers specifiy only the starting offset
-    if (content_range_data[1].empty())
+    if (ranges->empty())
     {
-        offset_stop[0] = -1;
+        return HTTP_RANGE_NOT_SATISFIABLE;
     }
-    else
-    {
-        offset_stop[0] = (int64_t)str2uint(&content_range_data[1], &is_invalid);
 
-        if (is_invalid)
+    std::sort(ranges->begin(), ranges->end(), [](const struct HTTP_BYTE_RANGE &a, const struct HTTP_BYTE_RANGE &b) { return a.start < b.start; });
+
+    size_t merged_num = 0;
+    for (size_t i = 1; i < ranges->size(); i++)
+    {
+        struct HTTP_BYTE_RANGE &merged_range = (*ranges)[merged_num];
+        if ((*ranges)[i].start <= merged_range.stop)
         {
-            return false;
+            merged_range.stop = std::max(merged_range.stop, (*ranges)[i].stop);
+        }
+        else
+        {
+            (*ranges)[++merged_num] = (*ranges)[i];
         }
     }
 
-    return true;
+    ranges->resize(merged_num + 1);
+    return HTTP_RANGE_SATISFIABLE;
 }
 
 std::string HTTP_Encode_Content_Range(int64_t offset_start, int64_t offset_stop, int64_t file_size)
 {
         std::string result = "bytes ";
         result.append(int2str(offset_start)); result.append(1,'-');
-        result.append(int2str(offset_stop)); result.append(1,'/');
+        result.append(int2str(offset_stop - 1)); result.append(1,'/');
         result.append(int2str(file_size));
         return result;
 }
 
+int HTTP_Request_Select_Encoding(const struct HTTP_REQUEST *request, const char* const* encodings, int encodings_num, uint32_t available_encodings)
+{
+	std::string accept_encoding;
+	if (!HTTP_Request_Get_Header(request, "accept-encoding", &accept_encoding))
+	{
+		return -1;
+	}
+
+	std::vector<std::string> codings;
+	explode(&accept_encoding, ",", &codings);
+
+	std::vector<float> weights(encodings_num, 0);
+	std::vector<bool> is_listed(encodings_num, false);
+	float wildcard_weight = 0;
+
+	for (size_t i = 0; i < codings.size(); i++)
+	{
+		size_t params_start = codings[i].find(';');
+		std::string coding_name = str_ansi_to_lower(codings[i].substr(0, params_start));
+		coding_name.erase(0, coding_name.find_first_not_of(" \t"));
+		coding_name.erase(coding_name.find_last_not_of(" \t") + 1);
+
+		//q=0 marks a coding the client does not accept
+		float weight = 1;
+		if (params_start != std::string::npos)
+		{
+			size_t weight_start = codings[i].find("q=", params_start);
+			if (weight_start != std::string::npos)
+			{
+				weight = strtof(codings[i].c_str() + weight_start + 2, NULL);
+			}
+		}
+
+		if (coding_name == "*")
+		{
+			wildcard_weight = weight;
+			continue;
+		}
+
+		if (coding_name == "x-gzip")
+		{
+			coding_name = "gzip";
+		}
+
+		for (int j = 0; j < encodings_num; j++)
+		{
+			if (coding_name == encodings[j])
+			{
+				weights[j] = weight;
+				is_listed[j] = true;
+			}
+		}
+	}
+
+	//the equal weights keep the order of preference of the server
+	int selected_encoding = -1;
+	float selected_weight = 0;
+
+	for (int i = 0; i < encodings_num; i++)
+	{
+		float weight = is_listed[i] ? weights[i] : wildcard_weight;
+		if ((available_encodings & (1 << i)) and weight > selected_weight)
+		{
+			selected_encoding = i;
+			selected_weight = weight;
+		}
+	}
+
+	return selected_encoding;
+}
+
+bool HTTP_Match_ETag(const std::string &etag_list, const std::string &etag, bool weak_comparison)
+{
+	bool is_etag_weak = etag.compare(0, 2, "W/") == 0;
+	if (is_etag_weak and !weak_comparison)
+	{
+		return false;
+	}
+
+	const char* opaque_tag = etag.c_str() + (is_etag_weak ? 2 : 0);
+	size_t opaque_tag_len = etag.size() - (is_etag_weak ? 2 : 0);
+
+	//the quoted tags may contain commas, so the list is not exploded
+	size_t i = 0;
+	while (i < etag_list.size())
+	{
+		if (etag_list[i] == ' ' or etag_list[i] == '\t' or etag_list[i] == ',')
+		{
+			i++;
+			continue;
+		}
+
+		if (etag_list[i] == '*')
+		{
+			return true;
+		}
+
+		bool is_weak = etag_list.compare(i, 2, "W/") == 0;
+		if (is_weak)
+		{
+			i += 2;
+		}
+
+		if (i >= etag_list.size() or etag_list[i] != '"')
+		{
+			return false;
+		}
+
+		size_t tag_end = etag_list.find('"', i + 1);
+		if (tag_end == std::string::npos)
+		{
+			return false;
+		}
+
+		if ((weak_comparison or !is_weak) and tag_end + 1 - i == opaque_tag_len and etag_list.compare(i, opaque_tag_len, opaque_tag) == 0)
+		{
+			return true;
+		}
+
+		i = tag_end + 1;
+	}
+
+	return false;
+}
+
 bool HTTP_Decode_POST_type(struct HTTP_REQUEST *http_request)
 {
-    auto it = http_request->headers.find("content-type");
+    const char *content_type;
+    size_t content_type_len;
 	
-	if(it ==  http_request->headers.end())
+	if(!HTTP_Request_Find_Header(http_request, "content-type", &content_type, &content_type_len))
     {
         return false;
     }
         	                   
-	if(it->second == "application/x-www-form-urlencoded")
+	if(content_type_len == 33 and memcmp(content_type, "application/x-www-form-urlencoded", 33) == 0)
     {
         http_request->POST_type = HTTP_POST_APPLICATION_X_WWW_FORM_URLENCODED;
     }
 
-    else if(memcmp(it->second.c_str(),"multipart/form-data", 19) == 0)
+    else if(content_type_len >= 19 and memcmp(content_type, "multipart/form-data", 19) == 0)
     {
 		http_request->POST_type = HTTP_POST_MULTIPART_FORM_DATA;
     }
@@ -299,70 +519,207 @@ bool HTTP_Decode_POST_type(struct HTTP_REQUEST *http_request)
 }
 
 
-bool HTTP_Parse_Request_Headers(const std::string &raw_request, size_t headers_start_offset, std::unordered_map<std::string, std::string> *request_headers, size_t* body_start_offset)
+int HTTP_Parse_Request_Headers(std::string &raw_request, struct HTTP_PARSER_HELPER *parser_helper, struct HTTP_REQUEST *request)
 {
-    bool use_standard_newline = false;
-
-    size_t start_position = headers_start_offset;
-    if(raw_request[headers_start_offset - 2] == '\r')
+    while (true)
     {
-        use_standard_newline = true;
-    }
+        size_t line_end = raw_request.find('\n', parser_helper->scan_offset);
+        if (line_end == std::string::npos)
+        {
+            // resume from here when more data arrives
+            parser_helper->scan_offset = raw_request.size();
+            return HTTP_PARSER_INCOMPLETE;
+        }
 
-    size_t stop_position = raw_request.find((use_standard_newline ? "\r\n\r\n" : "\n\n"));
-    if (stop_position == std::string::npos)
-    {
-        return false;
-    }
+        size_t line_start = parser_helper->line_start_offset;
+        parser_helper->scan_offset = line_end + 1;
+        parser_helper->line_start_offset = line_end + 1;
 
-    body_start_offset[0] = stop_position + ((use_standard_newline) ? 4 : 2);
+        size_t value_end = line_end;
+        if (value_end > line_start and raw_request[value_end - 1] == '\r')
+        {
+            value_end--;
+        }
 
-    std::string header_name, header_value;
-    while (true)
-    {
-        if (start_position >= raw_request.size() or raw_request[start_position] == '\n' or raw_request[start_position + 1] == '\n')
+        // the empty line ends the headers
+        if (value_end == line_start)
         {
-            break;
+            parser_helper->body_start_offset = line_end + 1;
+            return HTTP_PARSER_DONE;
         }
 
-        size_t point_position = raw_request.find(": ", start_position);
-        if (point_position == std::string::npos)
+        char *line = &raw_request[line_start];
+        size_t line_len = value_end - line_start;
+
+        const char *point_position = (const char *)memchr(line, ':', line_len);
+        if (!point_position or point_position == line)
         {
-            return false;
+            return HTTP_PARSER_ERROR;
         }
 
-        header_name = raw_request.substr(start_position, point_position - start_position);
-        size_t new_line_position = raw_request.find((use_standard_newline ? "\r\n" : "\n"), point_position);
+        size_t name_len = point_position - line;
 
-        if (new_line_position == std::string::npos)
+        //store the name as lowercase, in place
+        for (size_t i = 0; i < name_len; i++)
         {
-            return false;
+            if (line[i] >= 'A' and line[i] <= 'Z')
+            {
+                line[i] += 'a' - 'A';
+            }
         }
 
-        header_value = raw_request.substr(point_position + 2, new_line_position - (point_position + 2));
+        size_t value_start = name_len + 1;
+        while (value_start < line_len and (line[value_start] == ' ' or line[value_start] == '\t'))
+        {
+            value_start++;
+        }
 
-        //store the value as lowercase
-        header_name = str_ansi_to_lower(&header_name);
+        while (line_len > value_start and (line[line_len - 1] == ' ' or line[line_len - 1] == '\t'))
+        {
+            line_len--;
+        }
 
-        //append multiple cookie headers into a single one
-        if(header_name == "cookie")
+        HTTP_Request_Add_Header(request, line_start, name_len, line_start + value_start, line_len - value_start);
+    }
+}
+
+void HTTP_Request_Add_Header(struct HTTP_REQUEST *request, size_t name_offset, size_t name_len, size_t value_offset, size_t value_len)
+{
+    struct HTTP_HEADER_INDEX *header_index = request->header_index;
+    const char *raw_request = header_index->raw_request->c_str();
+
+    //append multiple cookie headers into a single one
+    const char *cookie_value;
+    size_t cookie_value_len;
+    if (name_len == 6 and memcmp(raw_request + name_offset, "cookie", 6) == 0 and HTTP_Request_Find_Header(request, "cookie", &cookie_value, &cookie_value_len))
+    {
+        std::string &cookie_header = request->headers["cookie"];
+        if (cookie_header.empty())
         {
-            //append separator in case of multiple cookie headers
-            header_value.append(1, ';');
-            
-            request_headers[0]["cookie"].append(header_value);
+            cookie_header.assign(cookie_value, cookie_value_len);
+
+            for (unsigned int i = 0; i < header_index->size; i++)
+            {
+                if (header_index->entries[i].name_len == 6 and memcmp(raw_request + header_index->entries[i].name_offset, "cookie", 6) == 0)
+                {
+                    header_index->entries[i].name_len = 0;
+                }
+            }
         }
-        else
+
+        //append separator in case of multiple cookie headers
+        cookie_header.append(1, ';');
+        cookie_header.append(raw_request + value_offset, value_len);
+        return;
+    }
+
+    //the index is full, the rest of the headers go to the map
+    if (header_index->size == HTTP_HEADER_INDEX_SIZE)
+    {
+        request->headers[std::string(raw_request + name_offset, name_len)].assign(raw_request + value_offset, value_len);
+        return;
+    }
+
+    struct HTTP_HEADER_INDEX_ENTRY *entry = &header_index->entries[header_index->size++];
+    entry->name_offset = name_offset;
+    entry->name_len = name_len;
+    entry->value_offset = value_offset;
+    entry->value_len = value_len;
+}
+
+bool HTTP_Request_Find_Header(const struct HTTP_REQUEST *request, const char *name, const char **value, size_t *value_len)
+{
+    //the map holds the values added after the index was filled
+    if (!request->headers.empty())
+    {
+        auto header_it = request->headers.find(name);
+        if (header_it != request->headers.end())
         {
-             request_headers[0][header_name] = header_value;
+            *value = header_it->second.c_str();
+            *value_len = header_it->second.size();
+            return true;
         }
+    }
+
+    const struct HTTP_HEADER_INDEX *header_index = request->header_index;
+    if (!header_index)
+    {
+        return false;
+    }
+
+    size_t name_len = strlen(name);
+    const char *raw_request = header_index->raw_request->c_str();
+
+    //the last occurrence of a header wins
+    for (unsigned int i = header_index->size; i > 0; i--)
+    {
+        const struct HTTP_HEADER_INDEX_ENTRY *entry = &header_index->entries[i - 1];
+
+        if (entry->name_len == name_len and memcmp(raw_request + entry->name_offset, name, name_len) == 0)
+        {
+            *value = raw_request + entry->value_offset;
+            *value_len = entry->value_len;
+            return true;
+        }
+    }
+
+    return false;
+}
 
-        start_position = new_line_position + (use_standard_newline ? 2 : 1);
+bool HTTP_Request_Get_Header(const struct HTTP_REQUEST *request, const char *name, std::string *value)
+{
+    const char *header_value;
+    size_t header_value_len;
+
+    if (!HTTP_Request_Find_Header(request, name, &header_value, &header_value_len))
+    {
+        return false;
     }
 
+    value->assign(header_value, header_value_len);
     return true;
 }
 
+bool HTTP_Request_Has_Header(const struct HTTP_REQUEST *request, const char *name)
+{
+    const char *header_value;
+    size_t header_value_len;
+
+    return HTTP_Request_Find_Header(request, name, &header_value, &header_value_len);
+}
+
+std::string HTTP_Request_Get_Header_String(const struct HTTP_REQUEST *request, const char *name)
+{
+    std::string value;
+    HTTP_Request_Get_Header(request, name, &value);
+
+    return value;
+}
+
+void HTTP_Request_Materialize_Headers(struct HTTP_REQUEST *request)
+{
+    struct HTTP_HEADER_INDEX *header_index = request->header_index;
+    if (!header_index)
+    {
+        return;
+    }
+
+    const char *raw_request = header_index->raw_request->c_str();
+
+    //insert() keeps the newer values already in the map
+    for (unsigned int i = header_index->size; i > 0; i--)
+    {
+        const struct HTTP_HEADER_INDEX_ENTRY *entry = &header_index->entries[i - 1];
+
+        if (entry->name_len > 0)
+        {
+            request->headers.insert(std::make_pair(std::string(raw_request + entry->name_offset, entry->name_len), std::string(raw_request + entry->value_offset, entry->value_len)));
+        }
+    }
+
+    header_index->size = 0;
+}
+
 int HTTP_Parse_Request_Body(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn, const uint32_t stream_id, struct HTTP_REQUEST *request, struct HTTP_RESPONSE *response)
 {
 	if ((request->method == HTTP_METHOD_POST or request->method == HTTP_METHOD_PUT) and request->POST_type == HTTP_POST_TYPE_UNDEFINED)
@@ -372,15 +729,6 @@ int HTTP_Parse_Request_Body(const int worker_id, struct GENERIC_HTTP_CONNECTION
 			return HTTP_Request_Set_Error_Page(worker_id, conn, stream_id, 400);
 		}
 
-		unsigned int max_POST_arg_limit = str2uint(&SERVER_CONFIGURATION["max_post_args"]);
-		unsigned int max_upload_files_limit = str2uint(&SERVER_CONFIGURATION["max_uploaded_files"]);
-
-		bool continue_if_arg_limit_exceeded = false;
-		if (is_server_config_variable_true("continue_if_args_limit_exceeded"))
-		{
-			continue_if_arg_limit_exceeded = true;
-		}
-
 		std::string *request_body = NULL;
 		size_t parser_start_offset = 0;
 
@@ -396,7 +744,7 @@ int HTTP_Parse_Request_Body(const int worker_id, struct GENERIC_HTTP_CONNECTION
 			parser_start_offset = http1_conn->parser_helper.body_start_offset;
 		}
 
-		if (!HTTP_Parse_POST_Body(request, request_body, parser_start_offset, max_POST_arg_limit, max_upload_files_limit, continue_if_arg_limit_exceeded))
+		if (!HTTP_Parse_POST_Body(request, request_body, parser_start_offset, server_runtime_config->max_post_args, server_runtime_config->max_uploaded_files, server_runtime_config->continue_if_args_limit_exceeded))
 		{
 			SERVER_LOG_WRITE_ERROR.lock();
 			SERVER_LOG_WRITE(SERVER_LOG_strtime(SERVER_LOG_LOCALTIME_REPORTING), true);
@@ -409,7 +757,11 @@ int HTTP_Parse_Request_Body(const int worker_id, struct GENERIC_HTTP_CONNECTION
             return HTTP2_CONNECTION_DELETED;
 		}
 
-		request_body->clear();
+		//the HTTP/1 header index still points inside the receive buffer
+		if (conn->http_version == HTTP_VERSION_2)
+		{
+			request_body->clear();
+		}
 	}
 
 	return HTTP2_CONNECTION_OK;
@@ -575,6 +927,20 @@ void HTTP_Init_Cookie(struct HTTP_COOKIE *cookie, const std::string* name, const
 	HTTP_Init_Cookie(cookie,name->c_str(),value->c_str());
 }
 
+size_t HTTP_Find_Multipart_Separator(const std::string *raw_request, const std::string &separator, size_t start_offset)
+{
+    if (start_offset >= raw_request->size())
+    {
+        return std::string::npos;
+    }
+
+    // the separator is searched over the whole uploaded content
+    size_t search_len = raw_request->size() - start_offset;
+    size_t position = SIMD_Find_Substring(raw_request->c_str() + start_offset, search_len, separator.c_str(), separator.size());
+
+    return (position == search_len) ? std::string::npos : start_offset + position;
+}
+
 bool HTTP_Parse_Multipart_Form_Data(const std::string *raw_request, size_t start_offset, const std::string *boundary, std::unordered_map<std::string, std::string> *POST_query,
                                std::unordered_map<std::string, std::unordered_map<std::string, struct HTTP_POST_FILE>> *POST_files, unsigned int POST_arg_limit,
                                unsigned int POST_files_limit, bool *POST_arg_limit_exceeded, bool *POST_files_limit_exceeded, bool continue_when_limit_exceeded)
@@ -608,17 +974,17 @@ bool HTTP_Parse_Multipart_Form_Data(const std::string *raw_request, size_t start
     document_end.append("--");
 
     // content-disposition header
-    size_t cd_header_start = raw_request->find(b_separator, POST_body_position);
+    size_t cd_header_start = HTTP_Find_Multipart_Separator(raw_request, b_separator, POST_body_position);
 
     if (cd_header_start == std::string::npos)
     {
         b_separator[2 + boundary->size() + (use_standard_newline ? 2 : 1) + 8] = 'd'; // search for "Content-disposition"
-        cd_header_start = raw_request->find(b_separator, POST_body_position);
+        cd_header_start = HTTP_Find_Multipart_Separator(raw_request, b_separator, POST_body_position);
 
         if (cd_header_start == std::string::npos)
         {
             b_separator[2 + boundary->size() + (use_standard_newline ? 2 : 1)] = 'c'; // search for "content-disposition"
-            cd_header_start = raw_request->find(b_separator, POST_body_position);
+            cd_header_start = HTTP_Find_Multipart_Separator(raw_request, b_separator, POST_body_position);
 
             if (cd_header_start == std::string::npos)
             {
@@ -680,7 +1046,7 @@ bool HTTP_Parse_Multipart_Form_Data(const std::string *raw_request, size_t start
             is_file = true;
         }
 
-        cd_header_start = raw_request->find(b_separator, cd_header_start);
+        cd_header_start = HTTP_Find_Multipart_Separator(raw_request, b_separator, cd_header_start);
         if (cd_header_start == std::string::npos)
         {
             cd_header_start = raw_request->rfind(document_end); // try to find the multipart terminator
@@ -803,19 +1169,19 @@ bool HTTP_Parse_POST_Body(struct HTTP_REQUEST *http_request, const std::string*
             exit(-1);
         }
 
-        auto content_type_iter = http_request->headers.find("content-type");
-        if (content_type_iter == http_request->headers.end())
+        std::string content_type_header;
+        if (!HTTP_Request_Get_Header(http_request, "content-type", &content_type_header))
         {
             return false;
         }
 
-        size_t boundary_string_pos = content_type_iter->second.find("boundary=");
+        size_t boundary_string_pos = content_type_header.find("boundary=");
         if (boundary_string_pos == std::string::npos)
         {
             return false;
         }
 
-        std::string boundary = content_type_iter->second.substr(boundary_string_pos + 9); // strlen("boundary=")
+        std::string boundary = content_type_header.substr(boundary_string_pos + 9); // strlen("boundary=")
 
         parse_result = HTTP_Parse_Multipart_Form_Data(recv_buffer, start_offset, &boundary, http_request->POST_query, http_request->POST_files,
                                                  args_limit, files_limit, &args_limit_exceeded, &files_limit_exceeded, continue_if_exceeded);
@@ -3,19 +3,51 @@
 
 #include "http_worker.h"
 
+#define HTTP_PARSER_INCOMPLETE 0
+#define HTTP_PARSER_DONE 1
+#define HTTP_PARSER_ERROR 2
+
+int HTTP_Parse_Method(const char *method, size_t method_len);
 int HTTP_Parse_Method(const std::string &method);
-bool HTTP_Parse_Request_First_Line(const std::string &first_line, std::string* URI, int* method, int* http_version, size_t* headers_start_offset);
+bool HTTP_Parse_Request_First_Line(const std::string &raw_request, size_t* URI_start, size_t* URI_len, int* method, int* http_version, size_t* headers_start_offset);
 
 bool HTTP_Parse_Query(const std::string &query_part, std::unordered_map<std::string, std::string> *query_params, unsigned int max_query_args, bool *query_args_limit_exceeded,
                       bool continue_if_exceeded, int start_offset = 0, int end_offset = -1);
 
+bool HTTP_Parse_Raw_URI(const std::string &raw_request, size_t URI_start, size_t URI_len, std::string *URI, std::unordered_map<std::string, std::string> *URI_query_params, unsigned int max_arg_limit, bool continue_if_exceeded);
 bool HTTP_Parse_Raw_URI(const std::string &raw_URI, std::string *URI, std::unordered_map<std::string, std::string> *URI_query_params, unsigned int max_arg_limit, bool continue_if_exceeded);
 
-bool HTTP_Parse_Request_Headers(const std::string &raw_request, size_t headers_start_offset, std::unordered_map<std::string, std::string> *request_headers, size_t* body_start_offset);
+int HTTP_Parse_Request_Headers(std::string &raw_request, struct HTTP_PARSER_HELPER *parser_helper, struct HTTP_REQUEST *request);
+
+void HTTP_Request_Add_Header(struct HTTP_REQUEST *request, size_t name_offset, size_t name_len, size_t value_offset, size_t value_len);
+bool HTTP_Request_Find_Header(const struct HTTP_REQUEST *request, const char *name, const char **value, size_t *value_len);
+bool HTTP_Request_Get_Header(const struct HTTP_REQUEST *request, const char *name, std::string *value);
+bool HTTP_Request_Has_Header(const struct HTTP_REQUEST *request, const char *name);
+std::string HTTP_Request_Get_Header_String(const struct HTTP_REQUEST *request, const char *name);
+void HTTP_Request_Materialize_Headers(struct HTTP_REQUEST *request);
+
+//more ranges in one request are not worth their part headers, the whole file is sent instead
+#define HTTP_MAX_BYTE_RANGES 16
+
+#define HTTP_RANGE_SATISFIABLE 0
+#define HTTP_RANGE_NOT_SATISFIABLE 1
+#define HTTP_RANGE_IGNORED 2
 
-bool HTTP_Decode_Content_Range(const std::string &content_range, int64_t *offset_start, int64_t *offset_stop);
+/*
+the ranges of the Range header clipped to the file, sorted and with the overlapping or adjacent ones merged,
+not satisfiable if the header can not be parsed or every range starts after the end of the file
+*/
+int HTTP_Decode_Byte_Ranges(const std::string &range_header, uint64_t file_size, std::vector<struct HTTP_BYTE_RANGE> *ranges);
+
+//offset_stop is the first byte after the range
 std::string HTTP_Encode_Content_Range(int64_t offset_start, int64_t offset_stop, int64_t file_size);
 
+//the accepted encoding with the highest weight in accept-encoding, the encodings are in the order of preference, -1 if none is accepted
+int HTTP_Request_Select_Encoding(const struct HTTP_REQUEST *request, const char* const* encodings, int encodings_num, uint32_t available_encodings);
+
+//true if an entity tag of the list matches etag, "*" matches any, the weak comparison ignores the W/ prefixes, the strong one rejects them
+bool HTTP_Match_ETag(const std::string &etag_list, const std::string &etag, bool weak_comparison);
+
 bool HTTP_Decode_POST_type(struct HTTP_REQUEST *http_request);
 bool HTTP_Parse_POST_Body(struct HTTP_REQUEST *http_request, const std::string *recv_buffer, size_t start_offset, unsigned int args_limit, unsigned int files_limit, bool continue_if_exceeded);
 int HTTP_Parse_Request_Body(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn, const uint32_t stream_id, struct HTTP_REQUEST *request, struct HTTP_RESPONSE *response);
@@ -1,35 +1,78 @@
 #include "http_worker.h"
 #include "hpack_api.h"
+#include "content_cache.h"
+#include "file_io.h"
 
 #include "../server_config.h"
 #include "../server_log.h"
 #include "../file_permissions.h"
 #include "../helper_functions.h"
+#include "../server_listener.h"
+#include "../cpu_affinity.h"
+
+#ifndef DISABLE_HTTPS
+#include "../https_listener.h"
+#endif
 
 #include <unistd.h>
 #include <sys/resource.h>
+#include <sched.h>
 #include <sys/socket.h>
 #include <sys/eventfd.h>
 #include <sys/epoll.h>
+#include <sys/sendfile.h>
 
 #include <cstring>
 
 std::vector<struct HTTP_WORKER_NODE> http_workers;
-std::atomic<size_t> total_http_connections;
+struct HTTP_WORKER_LOAD* http_workers_load = NULL;
+
+int server_load_balancer_algo;
 
 // for round robin load balancing
-unsigned int next_worker = 0;
-std::mutex next_worker_mutex;
+std::atomic<unsigned int> next_worker(0);
+
+// every worker accepts on its own SO_REUSEPORT listener
+bool is_server_worker_listeners_enabled;
+
+#ifndef DISABLE_HTTPS
+SSL_CTX* worker_listeners_openssl_ctx = NULL;
+#endif
 
-// for fair load balancing
-bool is_server_load_balancer_fair;
-std::vector<std::atomic<int>> connections_per_worker;
+int server_event_backend;
+
+std::atomic<bool> is_server_draining(false);
+
+#ifndef DISABLE_IO_URING
+#define IO_URING_WORKER_RING_ENTRIES 256
+
+//the buffers shared by the multishot recv of the plain connections of a worker, the entries are a power of 2
+#define IO_URING_WORKER_RECV_BUFFERS 256
+#define IO_URING_WORKER_RECV_BUFFER_SIZE (8 * 1024)
+#define IO_URING_WORKER_RECV_BUFFER_GROUP 0
+
+//the received buffers a connection holds before its recv is paused, the client is stopped by the TCP window again
+#define IO_URING_WORKER_RECV_QUEUE_MAX 8
+
+//the accepts kept in flight on each worker listener, each one has its own peer address slot
+#define IO_URING_WORKER_ACCEPTS 8
+#endif
+
+#define HTTP_WORKER_CLIENT_EVENTS (EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLHUP | EPOLLERR)
 
 
 int Network_Read_Bytes(struct GENERIC_HTTP_CONNECTION *conn, void *buffer, size_t len)
 {
 	int result;
 
+	#ifndef DISABLE_IO_URING
+	//the data was already received by the worker io_uring, nothing left means EAGAIN
+	if (conn->recv_buffers)
+	{
+		return IO_Uring_Buffer_Queue_Read(conn->recv_buffers, &conn->recv_queue, buffer, len);
+	}
+	#endif
+
 	while (true)
 	{
 		if (!conn->https)
@@ -81,15 +124,28 @@ int Network_Read_Bytes(struct GENERIC_HTTP_CONNECTION *conn, void *buffer, size_
 	return result;
 }
 
-int Network_Write_Bytes(struct GENERIC_HTTP_CONNECTION *conn, void *buffer, size_t len)
+int Network_Write_Bytes(struct GENERIC_HTTP_CONNECTION *conn, void *buffer, size_t len, bool more_data)
 {
 	int result;
 
+	bool plain_send = !conn->https;
+
+	#ifndef DISABLE_HTTPS
+	#ifdef SSL_OP_ENABLE_KTLS
+	//the kernel encrypts the plain writes too, the data sent from a file afterwards goes in the same TLS record
+	if (conn->https and conn->ktls_send and more_data)
+	{
+		plain_send = true;
+	}
+	#endif
+	#endif
+
 	while (true)
 	{
-		if (!conn->https)
+		if (plain_send)
 		{
-			result = send(conn->client_sock, buffer, len, 0);
+			//MSG_MORE lets the kernel merge the headers with the first part of the body
+			result = send(conn->client_sock, buffer, len, more_data ? MSG_MORE : 0);
 
 			if (result < 0)
 			{
@@ -136,335 +192,1517 @@ int Network_Write_Bytes(struct GENERIC_HTTP_CONNECTION *conn, void *buffer, size
 	return result;
 }
 
-void HTTP_Worker_Add_Client(HTTP_Worker_Add_Client_Parameters& params)
+int Network_Write_Vector(struct GENERIC_HTTP_CONNECTION *conn, const struct iovec *iov, int iov_count)
 {
-	int worker_id;
+	ssize_t result;
 
-	if (is_server_load_balancer_fair)
+	while (true)
 	{
-		worker_id = 0;
-		int min_connections = connections_per_worker[0];
+		result = writev(conn->client_sock, iov, iov_count);
 
-		size_t n_workers = connections_per_worker.size();
-		for (size_t i = 1; i < n_workers; i++)
+		if (result < 0)
 		{
-			if (connections_per_worker[i] < min_connections)
+			if (errno == EINTR)
 			{
-				min_connections = connections_per_worker[i];
-				worker_id = i;
+				continue;
+			}
+
+			if (errno == EAGAIN or errno == EWOULDBLOCK)
+			{
+				return 0;
 			}
-		}
-	}
-	else
-	{
-		next_worker_mutex.lock();
 
-		worker_id = next_worker;
-		next_worker++;
+			SERVER_ERROR_LOG_stdlib_err("Unable to write to client socket!");
 
-		if (next_worker >= http_workers.size())
-		{
-			next_worker = 0;
+			return -1;
 		}
 
-		next_worker_mutex.unlock();
+		break;
 	}
 
-	struct GENERIC_HTTP_CONNECTION current_connection;
+	return result;
+}
 
-	current_connection.client_sock = params.client_sock;
-	current_connection.remote_addr = params.remote_addr;
-	current_connection.server_addr = params.server_addr;
-	current_connection.remote_port = params.remote_port;
-	current_connection.server_port = params.server_port;
-	current_connection.ip_addr_version = params.ip_addr_version;
-	current_connection.milisecond_timeout = str2uint(&SERVER_CONFIGURATION["request_timeout"]) * 1000;
-	current_connection.https = params.https;
+int Network_Sendfile(struct GENERIC_HTTP_CONNECTION *conn, int file_descriptor, int64_t *file_offset, size_t len)
+{
+	ssize_t result;
 
-	// init a http/1.1 connection
-	if (!params.https)
+	#ifndef DISABLE_HTTPS
+	if (conn->https)
 	{
-		current_connection.http_version = HTTP_VERSION_1_1;
-		current_connection.state = HTTP_STATE_WAIT_PATH;
-
-		struct HTTP1_CONNECTION *http_conn = new (std::nothrow) struct HTTP1_CONNECTION();
-		if(!http_conn)
+		#ifndef SSL_OP_ENABLE_KTLS
+		return NETWORK_SENDFILE_UNSUPPORTED;
+		#else
+		if (!conn->ktls_send)
 		{
-			SERVER_ERROR_LOG_stdlib_err("Unable to allocate memory for a HTTP1_CONNECTION.");
-			exit(-1);
+			return NETWORK_SENDFILE_UNSUPPORTED;
 		}
 
-		current_connection.raw_connection = http_conn;
+		result = SSL_sendfile(conn->ssl_wrapper, file_descriptor, *file_offset, len, 0);
 
-		HTTP1_Connection_Init(http_conn);
-	}
+		if (result < 0)
+		{
+			int error_code = SSL_get_error(conn->ssl_wrapper, result);
+			if (error_code == SSL_ERROR_WANT_READ or error_code == SSL_ERROR_WANT_WRITE)
+			{
+				return 0;
+			}
 
-#ifndef DISABLE_HTTPS
-	else
-	{
-		current_connection.http_version = HTTP_VERSION_UNDEFINED;
-		current_connection.state = HTTP_STATE_SSL_INIT;
+			SERVER_ERROR_LOG_openssl_err("Unable to send the file to SSL!");
 
-		current_connection.ssl_wrapper = SSL_new(params.openssl_ctx);
-		if (current_connection.ssl_wrapper == NULL)
+			return -1;
+		}
+
+		if (result == 0 and len > 0)
 		{
-			SERVER_ERROR_LOG_openssl_err("Unable to allocate a SSL!");
-			exit(-1);
+			return NETWORK_SENDFILE_EOF;
 		}
 
-		SSL_set_fd(current_connection.ssl_wrapper, params.client_sock);
+		*file_offset += result;
+		return result;
+		#endif
 	}
-#endif
+	#endif
 
-	if (clock_gettime(CLOCK_MONOTONIC, &current_connection.last_action) == -1)
+	while (true)
 	{
-		SERVER_ERROR_LOG_stdlib_err("Unable to get time!");
-		exit(-1);
-	}
-
-	http_workers[worker_id].connections_mutex->lock();
-	http_workers[worker_id].connections[params.client_sock] = current_connection;
-
-	struct epoll_event epoll_config;
-	memset(&epoll_config, 0, sizeof(epoll_config)); //suppress valgrind warnings
-	epoll_config.events = EPOLLIN | EPOLLOUT | EPOLLET | EPOLLRDHUP | EPOLLRDHUP | EPOLLHUP | EPOLLERR;
-	epoll_config.data.fd = params.client_sock;
+		off_t offset = *file_offset;
+		result = sendfile(conn->client_sock, file_descriptor, &offset, len);
 
-	if (epoll_ctl(http_workers[worker_id].worker_epoll, EPOLL_CTL_ADD, params.client_sock, &epoll_config) == -1)
-	{
-		SERVER_ERROR_LOG_stdlib_err("Unable to add the client to the worker epoll!");
-		exit(-1);
-	}
+		if (result < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
 
-	if (is_server_load_balancer_fair)
-	{
-		connections_per_worker[worker_id]++;
-	}
+			if (errno == EAGAIN or errno == EWOULDBLOCK)
+			{
+				return 0;
+			}
 
-	http_workers[worker_id].connections_mutex->unlock();
-}
+			//the file system does not support sendfile(), the caller falls back to read/write
+			if (errno == EINVAL or errno == ENOSYS or errno == EOPNOTSUPP)
+			{
+				return NETWORK_SENDFILE_UNSUPPORTED;
+			}
 
-void close_all_expired_connections(const int worker_id, const struct timespec& current_time)
-{	
-	http_workers[worker_id].connections_mutex->lock();
+			SERVER_ERROR_LOG_stdlib_err("Unable to send the file to client socket!");
 
-	for (auto i = http_workers[worker_id].connections.begin(); i != http_workers[worker_id].connections.end(); ++i)
-	{
-		int64_t elapsed_miliseconds = ((current_time.tv_sec * 1000) + (current_time.tv_nsec / 1000000)) - 
-		((i->second.last_action.tv_sec * 1000) + (i->second.last_action.tv_nsec / 1000000));
+			return -1;
+		}
 
-		// infinite timeout
-		if (i->second.milisecond_timeout == 0)
+		//a full socket fails with EAGAIN, nothing sent means the end of the file
+		if (result == 0 and len > 0)
 		{
-			continue;
+			return NETWORK_SENDFILE_EOF;
 		}
 
-		if (elapsed_miliseconds > i->second.milisecond_timeout)
-		{	
-			auto expired_connection = i;
-			i++;
-
-			Generic_Connection_Delete(worker_id, &expired_connection->second, false);
-			
-			if(i == http_workers[worker_id].connections.end())
-			{
-				break;
-			}
-		}
+		*file_offset = offset;
+		break;
 	}
 
-	http_workers[worker_id].connections_mutex->unlock();
+	return result;
 }
 
-#ifndef DISABLE_HTTPS
-void Accept_SSL_Connection(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn)
+int HTTP_Workers_Total_Clients()
 {
-	int ssl_status = SSL_accept(conn->ssl_wrapper);
-	if (ssl_status <= 0)
+	//the counters are read without synchronization, the limit is approximate
+	int total = 0;
+	for (size_t i = 0; i < http_workers.size(); i++)
 	{
-		int ssl_errno = SSL_get_error(conn->ssl_wrapper, ssl_status);
+		total += http_workers_load[i].clients.load(std::memory_order_relaxed);
+	}
 
-		if (ssl_errno == SSL_ERROR_WANT_READ or ssl_errno == SSL_ERROR_WANT_WRITE)
+	return total;
+}
+
+uint64_t HTTP_Workers_Oldest_Config_Generation()
+{
+	uint64_t oldest_generation = UINT64_MAX;
+	for (size_t i = 0; i < http_workers.size(); i++)
+	{
+		uint64_t generation = http_workers_load[i].config_generation.load();
+		if (generation < oldest_generation)
 		{
-			return;
+			oldest_generation = generation;
 		}
-
-		SERVER_ERROR_LOG_openssl_err("Unable to accept the incoming SSL connection!");
-
-		Generic_Connection_Delete(worker_id, conn);
-		return;
 	}
 
-	const uint8_t *ALPN_selected_ext = NULL;
-	unsigned int ALPN_selected_ext_len = 0;
-	SSL_get0_alpn_selected(conn->ssl_wrapper, &ALPN_selected_ext, &ALPN_selected_ext_len);
+	return oldest_generation;
+}
 
-	if (ALPN_selected_ext_len == 2 and memcmp("h2", ALPN_selected_ext, 2) == 0) // ALPN h2
-	{
-		conn->http_version = HTTP_VERSION_2;
-	}
-	else if (ALPN_selected_ext_len == 8 and memcmp("http/1.1", ALPN_selected_ext, 8) == 0) // ALPN http/1.1
+//the snapshot is switched between two batches of events, never while a request is processed
+static void HTTP_Worker_Refresh_Config(int worker_id)
+{
+	uint64_t generation = acquire_server_runtime_config()->generation;
+
+	//announced after the switch, so the announced generation is never newer than the one in use
+	if (http_workers_load[worker_id].config_generation.load(std::memory_order_relaxed) != generation)
 	{
-		conn->http_version = HTTP_VERSION_1_1;
+		http_workers_load[worker_id].config_generation.store(generation);
 	}
-	else // no APLN negotiation
+}
+
+static int HTTP_Worker_Load(int worker_id)
+{
+	return http_workers_load[worker_id].connections.load(std::memory_order_relaxed) + http_workers_load[worker_id].event_backlog.load(std::memory_order_relaxed);
+}
+
+static uint32_t HTTP_Worker_Random()
+{
+	//xorshift, every listener thread has its own state
+	static thread_local uint32_t random_state = 0;
+	if (random_state == 0)
 	{
-		conn->http_version = HTTP_VERSION_1_1;
+		random_state = (uint32_t) std::hash<std::thread::id>()(std::this_thread::get_id()) | 1;
 	}
 
-	if (conn->http_version == HTTP_VERSION_2)
-	{
-		conn->state = HTTP2_CONNECTION_STATE_WAIT_HELLO;
+	random_state ^= random_state << 13;
+	random_state ^= random_state >> 17;
+	random_state ^= random_state << 5;
 
-		struct HTTP2_CONNECTION *http2_conn = new (std::nothrow) struct HTTP2_CONNECTION();
-		if(!http2_conn)
+	return random_state;
+}
+
+int HTTP_Worker_Select()
+{
+	int n_workers = http_workers.size();
+
+	if (server_load_balancer_algo == SERVER_LOAD_BALANCER_P2C and n_workers > 1)
+	{
+		//two distinct random workers, the less loaded one gets the client
+		int first_worker = HTTP_Worker_Random() % n_workers;
+		int second_worker = HTTP_Worker_Random() % (n_workers - 1);
+		if (second_worker >= first_worker)
 		{
-			SERVER_ERROR_LOG_stdlib_err("Unable to allocate memory for a HTTP2_CONNECTION.");
-			exit(-1);
+			second_worker++;
 		}
 
-		conn->raw_connection = http2_conn;
-
-		HTTP2_Connection_Init(http2_conn);
-		HTTP2_Connection_Process(worker_id, conn);
+		return (HTTP_Worker_Load(second_worker) < HTTP_Worker_Load(first_worker)) ? second_worker : first_worker;
 	}
-	else
+
+	if (server_load_balancer_algo == SERVER_LOAD_BALANCER_FAIR)
 	{
-		conn->state = HTTP_STATE_WAIT_PATH;
+		int worker_id = 0;
+		int min_connections = http_workers_load[0].connections.load(std::memory_order_relaxed);
 
-		struct HTTP1_CONNECTION *http_conn = new (std::nothrow) struct HTTP1_CONNECTION();
-		if(!http_conn)
+		for (int i = 1; i < n_workers; i++)
 		{
-			SERVER_ERROR_LOG_stdlib_err("Unable to allocate memory for a HTTP1_CONNECTION.");
-			exit(-1);
+			int connections = http_workers_load[i].connections.load(std::memory_order_relaxed);
+			if (connections < min_connections)
+			{
+				min_connections = connections;
+				worker_id = i;
+			}
 		}
-				
-		conn->raw_connection = http_conn;
 
-		HTTP1_Connection_Init(http_conn);
-		HTTP1_Connection_Process(worker_id, conn);
+		return worker_id;
 	}
+
+	return next_worker.fetch_add(1, std::memory_order_relaxed) % n_workers;
 }
-#endif
 
-void Generic_Connection_Delete(const int worker_id, struct GENERIC_HTTP_CONNECTION* conn, bool lock_mutex)
+void HTTP_Worker_Add_Client(const int worker_id, HTTP_Worker_Add_Client_Parameters& params)
 {
-	if(conn->http_version == HTTP_VERSION_2)
-	{
-		HTTP2_Connection_Delete(worker_id, (struct HTTP2_CONNECTION*)conn->raw_connection);
-		delete( ((struct HTTP2_CONNECTION*)conn->raw_connection) );
-	}
-	else if(conn->http_version == HTTP_VERSION_1 or conn->http_version == HTTP_VERSION_1_1)
-	{
-		HTTP1_Connection_Delete((struct HTTP1_CONNECTION*)conn->raw_connection);
-		delete( ((struct HTTP1_CONNECTION*)conn->raw_connection) );
-	}
+	//counted before the handover, so the next selections already see it
+	http_workers_load[worker_id].connections++;
+	http_workers_load[worker_id].clients++;
 
-	#ifndef DISABLE_HTTPS
-	if(conn->https)
+	//the worker registers the client in its own event loop, so its connections are never shared
+	if (!Client_Queue_Push(http_workers[worker_id].client_queue, params))
 	{
-		SSL_free(conn->ssl_wrapper);
+		SERVER_ERROR_LOG_client_queue_full();
+		close(params.client_sock);
+		http_workers_load[worker_id].connections--;
+		http_workers_load[worker_id].clients--;
+		return;
 	}
-	#endif
 
-	close(conn->client_sock);
-
-	if(lock_mutex)
+	uint64_t event_counter = 1;
+	if (write(http_workers[worker_id].client_queue_event, &event_counter, sizeof(event_counter)) == -1 and errno != EAGAIN)
 	{
-		http_workers[worker_id].connections_mutex->lock();
-		http_workers[worker_id].connections.erase(conn->client_sock);
-		http_workers[worker_id].connections_mutex->unlock();
+		SERVER_ERROR_LOG_stdlib_err("Unable to wake up the http worker!");
+		exit(-1);
 	}
-	else
+}
+
+void HTTP_Worker_Receive_Clients(const int worker_id)
+{
+	//reset the eventfd before draining, a client pushed afterwards triggers a new event
+	uint64_t event_counter;
+	if (read(http_workers[worker_id].client_queue_event, &event_counter, sizeof(event_counter)) == -1 and errno != EAGAIN)
 	{
-		http_workers[worker_id].connections.erase(conn->client_sock);
+		SERVER_ERROR_LOG_stdlib_err("Unable to read the http worker client queue event!");
+		exit(-1);
 	}
 
-	total_http_connections--;
-
-	if(is_server_load_balancer_fair)
+	HTTP_Worker_Add_Client_Parameters params;
+	while (Client_Queue_Pop(http_workers[worker_id].client_queue, &params))
 	{
-		connections_per_worker[worker_id]--;
+		HTTP_Worker_Insert_Client(worker_id, params);
 	}
 }
 
-void http_worker_thread(int worker_id)
+void HTTP_Worker_Receive_File_IO(const int worker_id, const struct timespec& current_time)
 {
-	HTTP_Worker_Init_Aux_Modules(worker_id);
-
-	struct epoll_event triggered_events[128];
-
-	size_t recv_buffer_size = str2uint(SERVER_CONFIGURATION["read_buffer_size"]) * 1024;
-	http_workers[worker_id].recv_buffer = new (std::nothrow) char[recv_buffer_size];
-	if (!http_workers[worker_id].recv_buffer)
-	{
-		SERVER_ERROR_LOG_stdlib_err("Unable to allocate memory for the http worker recv buffer!");
-		exit(-1);
-	}
+	std::vector<struct FILE_IO_COMPLETION> completions;
+	File_IO_Receive_Completions(worker_id, &completions);
 
-	int epoll_wait_time = 500;
-	bool epoll_loop_should_stop = false;
-	while (!epoll_loop_should_stop)
+	for (size_t i = 0; i < completions.size(); i++)
 	{
-		int epoll_result = epoll_wait(http_workers[worker_id].worker_epoll, triggered_events, sizeof(triggered_events) / sizeof(struct epoll_event), epoll_wait_time);
-
-		if (epoll_result == -1)
+		//the connection was deleted while its file was loaded
+		struct GENERIC_HTTP_CONNECTION* conn = HTTP_Connection_Table_Get(http_workers[worker_id].connections, completions[i].event_data);
+		if (!conn)
 		{
-			if (errno != EINTR)
-			{
-				SERVER_ERROR_LOG_stdlib_err("Unable to listen to epoll!");
-				exit(-1);
-			}
-
 			continue;
 		}
 
-		struct timespec current_time;
-		if (clock_gettime(CLOCK_MONOTONIC, &current_time) == -1)
-		{
-			SERVER_ERROR_LOG_stdlib_err("Unable to get time!");
-			exit(-1);
-		}
-
-		for (int event_num = 0; event_num < epoll_result; event_num++)
+		if (conn->http_version == HTTP_VERSION_2)
 		{
-			struct epoll_event triggered_event = triggered_events[event_num];
+			struct HTTP2_CONNECTION* http2_conn = (struct HTTP2_CONNECTION*) conn->raw_connection;
 
-			// shutdown triggered
-			if (triggered_event.data.fd == 0)
+			//the stream was reset or the connection is closing
+			auto stream_it = http2_conn->streams.find(completions[i].stream_id);
+			if (stream_it == http2_conn->streams.end() or !stream_it->second.file_transfer.read_pending)
 			{
-				epoll_loop_should_stop = true;
-				break;
+				continue;
 			}
 
-			struct GENERIC_HTTP_CONNECTION *triggered_connection = NULL;
-			auto triggered_connection_it = http_workers[worker_id].connections.find(triggered_event.data.fd);
+			stream_it->second.file_transfer.read_pending = false;
 
-			if(triggered_connection_it != http_workers[worker_id].connections.end())
-			{
-				triggered_connection = &triggered_connection_it->second;
-			}
-			else
+			if (HTTP2_Stream_Send_From_File(worker_id, conn, completions[i].stream_id) == HTTP2_CONNECTION_DELETED or
+			    HTTP2_Connection_Send_Enqueued_Frames(worker_id, conn) == HTTP2_CONNECTION_DELETED)
 			{
-				//the connection was deleted
 				continue;
 			}
-			
-			triggered_connection->last_action = current_time;
-
-			if (triggered_event.events & EPOLLHUP or triggered_event.events & EPOLLRDHUP or triggered_event.events & EPOLLERR)
+		}
+		else
+		{
+			struct HTTP1_CONNECTION* http_conn = (struct HTTP1_CONNECTION*) conn->raw_connection;
+			if (conn->state != HTTP_STATE_FILE_BOUND or !http_conn->file_transfer.read_pending)
 			{
-				Generic_Connection_Delete(worker_id, triggered_connection);
 				continue;
 			}
 
-			if (triggered_connection->state == HTTP_STATE_SSL_INIT and triggered_connection->http_version == HTTP_VERSION_UNDEFINED)
-			{
-				#ifndef DISABLE_HTTPS
-				Accept_SSL_Connection(worker_id, triggered_connection);
-				#endif
-			}
-			else
+			http_conn->file_transfer.read_pending = false;
+			HTTP1_Connection_Process(worker_id, conn);
+		}
+
+		if (HTTP_Connection_Table_Get(http_workers[worker_id].connections, completions[i].event_data))
+		{
+			conn->last_action = current_time;
+			Generic_Connection_Update_Timer(worker_id, conn);
+		}
+	}
+}
+
+void HTTP_Worker_Insert_Client(const int worker_id, HTTP_Worker_Add_Client_Parameters& params)
+{
+	struct GENERIC_HTTP_CONNECTION current_connection;
+
+	const char* ip2text_result = NULL;
+	if (params.remote_addr.sin6_family == AF_INET6)
+	{
+		ip2text_result = inet_ntop(AF_INET6, (const void*) &params.remote_addr.sin6_addr, current_connection.remote_addr, sizeof(current_connection.remote_addr));
+	}
+	else
+	{
+		struct sockaddr_in *remote_addr4 = (struct sockaddr_in*) &params.remote_addr;
+		ip2text_result = inet_ntop(AF_INET, (const void*) &remote_addr4->sin_addr, current_connection.remote_addr, sizeof(current_connection.remote_addr));
+	}
+
+	if (ip2text_result == NULL)
+	{
+		SERVER_ERROR_LOG_stdlib_err("Unable to read the remote socket address!");
+		close(params.client_sock);
+		http_workers_load[worker_id].connections--;
+		http_workers_load[worker_id].clients--;
+		return;
+	}
+
+	current_connection.client_sock = params.client_sock;
+	strncpy(current_connection.server_addr, params.server_addr, sizeof(current_connection.server_addr) - 1);
+	current_connection.server_addr[sizeof(current_connection.server_addr) - 1] = 0;
+	//sin_port and sin6_port have the same offset
+	current_connection.remote_port = endian_conv_ntoh16(params.remote_addr.sin6_port);
+	current_connection.server_port = params.server_port;
+	current_connection.ip_addr_version = params.remote_addr.sin6_family;
+	current_connection.https = params.https;
+
+	// init a http/1.1 connection
+	if (!params.https)
+	{
+		current_connection.http_version = HTTP_VERSION_1_1;
+		current_connection.state = HTTP_STATE_WAIT_PATH;
+
+		struct HTTP1_CONNECTION *http_conn = new (std::nothrow) struct HTTP1_CONNECTION();
+		if(!http_conn)
+		{
+			SERVER_ERROR_LOG_stdlib_err("Unable to allocate memory for a HTTP1_CONNECTION.");
+			exit(-1);
+		}
+
+		current_connection.raw_connection = http_conn;
+
+		HTTP1_Connection_Init(http_conn);
+	}
+
+#ifndef DISABLE_HTTPS
+	else
+	{
+		current_connection.http_version = HTTP_VERSION_UNDEFINED;
+		current_connection.state = HTTP_STATE_SSL_INIT;
+		current_connection.ktls_send = false;
+
+		current_connection.ssl_wrapper = SSL_new(params.openssl_ctx);
+		if (current_connection.ssl_wrapper == NULL)
+		{
+			SERVER_ERROR_LOG_openssl_err("Unable to allocate a SSL!");
+			exit(-1);
+		}
+
+		SSL_set_fd(current_connection.ssl_wrapper, params.client_sock);
+	}
+#endif
+
+	#ifndef DISABLE_IO_URING
+	current_connection.recv_buffers = NULL;
+	#endif
+
+	if (clock_gettime(CLOCK_MONOTONIC, &current_connection.last_action) == -1)
+	{
+		SERVER_ERROR_LOG_stdlib_err("Unable to get time!");
+		exit(-1);
+	}
+
+	struct GENERIC_HTTP_CONNECTION* inserted_connection = HTTP_Connection_Table_Insert(http_workers[worker_id].connections, current_connection);
+	if (!inserted_connection)
+	{
+		//the listeners check max_connections against approximate counters, a worker can still receive one client too many
+		SERVER_ERROR_LOG_conn_exceeded();
+
+		if (!params.https)
+		{
+			HTTP1_Connection_Delete((struct HTTP1_CONNECTION*)current_connection.raw_connection);
+			delete( ((struct HTTP1_CONNECTION*)current_connection.raw_connection) );
+		}
+
+		#ifndef DISABLE_HTTPS
+		else
+		{
+			SSL_free(current_connection.ssl_wrapper);
+		}
+		#endif
+
+		close(params.client_sock);
+		http_workers_load[worker_id].connections--;
+		http_workers_load[worker_id].clients--;
+		return;
+	}
+
+	uint64_t event_data = HTTP_WORKER_EVENT_DATA(HTTP_WORKER_EVENT_CONNECTION, inserted_connection->event_generation, inserted_connection->slot_id);
+
+	#ifndef DISABLE_IO_URING
+	if (http_workers[worker_id].io_ring)
+	{
+		uint32_t poll_events = HTTP_WORKER_CLIENT_EVENTS;
+
+		//the plain connections are read by a multishot recv, the poll reports only the writable socket, OpenSSL reads the TLS ones itself
+		if (!params.https and http_workers[worker_id].recv_buffers)
+		{
+			inserted_connection->recv_buffers = http_workers[worker_id].recv_buffers;
+			IO_Uring_Buffer_Queue_Init(&inserted_connection->recv_queue);
+			inserted_connection->recv_state = HTTP_CONNECTION_RECV_ARMED;
+
+			if (!IO_Uring_Recv_Multishot(http_workers[worker_id].io_ring, params.client_sock, IO_URING_WORKER_RECV_BUFFER_GROUP, event_data | HTTP_WORKER_EVENT_IO))
+			{
+				SERVER_ERROR_LOG_stdlib_err("Unable to add the client recv to the worker io_uring!");
+				exit(-1);
+			}
+
+			poll_events = EPOLLOUT | EPOLLHUP | EPOLLERR;
+		}
+
+		//queued now, submitted together with the next wait of the worker
+		if (!IO_Uring_Poll_Multishot(http_workers[worker_id].io_ring, params.client_sock, poll_events, event_data))
+		{
+			SERVER_ERROR_LOG_stdlib_err("Unable to add the client to the worker io_uring!");
+			exit(-1);
+		}
+	}
+	else
+	#endif
+	{
+		struct epoll_event epoll_config;
+		memset(&epoll_config, 0, sizeof(epoll_config)); //suppress valgrind warnings
+		epoll_config.events = HTTP_WORKER_CLIENT_EVENTS | EPOLLET;
+		epoll_config.data.u64 = event_data;
+
+		if (epoll_ctl(http_workers[worker_id].worker_epoll, EPOLL_CTL_ADD, params.client_sock, &epoll_config) == -1)
+		{
+			SERVER_ERROR_LOG_stdlib_err("Unable to add the client to the worker epoll!");
+			exit(-1);
+		}
+	}
+
+	//the timer node points to the slot, which keeps its address
+	Timer_Wheel_Node_Init(&inserted_connection->timeout_timer, inserted_connection);
+
+	uint64_t timeout = Generic_Connection_Get_Timeout(inserted_connection);
+	if (timeout != 0)
+	{
+		Timer_Wheel_Add(http_workers[worker_id].timeout_wheel, &inserted_connection->timeout_timer, HTTP_Worker_Milliseconds(inserted_connection->last_action) + timeout);
+	}
+}
+
+bool HTTP_Connection_Table_Init(struct HTTP_CONNECTION_TABLE* table, uint32_t max_connections)
+{
+	table->max_chunks = (max_connections + HTTP_CONNECTION_TABLE_CHUNK_SIZE - 1) / HTTP_CONNECTION_TABLE_CHUNK_SIZE;
+	table->allocated_chunks = 0;
+	table->first_free_slot = HTTP_CONNECTION_TABLE_NO_SLOT;
+
+	//the chunk directory has a fixed size, the chunks are allocated on demand
+	table->chunks = new (std::nothrow) struct GENERIC_HTTP_CONNECTION*[table->max_chunks];
+	if (!table->chunks)
+	{
+		return false;
+	}
+
+	memset(table->chunks, 0, table->max_chunks * sizeof(struct GENERIC_HTTP_CONNECTION*));
+	return true;
+}
+
+void HTTP_Connection_Table_Free(struct HTTP_CONNECTION_TABLE* table)
+{
+	for (uint32_t i = 0; i < table->allocated_chunks; i++)
+	{
+		delete[] (table->chunks[i]);
+	}
+
+	delete[] (table->chunks);
+	table->chunks = NULL;
+	table->allocated_chunks = 0;
+}
+
+struct GENERIC_HTTP_CONNECTION* HTTP_Connection_Table_Insert(struct HTTP_CONNECTION_TABLE* table, const struct GENERIC_HTTP_CONNECTION& conn)
+{
+	if (table->first_free_slot == HTTP_CONNECTION_TABLE_NO_SLOT)
+	{
+		//the caller refuses the connection
+		if (table->allocated_chunks == table->max_chunks)
+		{
+			return NULL;
+		}
+
+		struct GENERIC_HTTP_CONNECTION* chunk = new (std::nothrow) struct GENERIC_HTTP_CONNECTION[HTTP_CONNECTION_TABLE_CHUNK_SIZE];
+		if (!chunk)
+		{
+			SERVER_ERROR_LOG_stdlib_err("Unable to allocate memory for the http worker connection table!");
+			exit(-1);
+		}
+
+		uint32_t first_slot = table->allocated_chunks * HTTP_CONNECTION_TABLE_CHUNK_SIZE;
+		for (uint32_t i = 0; i < HTTP_CONNECTION_TABLE_CHUNK_SIZE; i++)
+		{
+			chunk[i].slot_id = first_slot + i;
+			chunk[i].next_free_slot = (i + 1 < HTTP_CONNECTION_TABLE_CHUNK_SIZE) ? first_slot + i + 1 : HTTP_CONNECTION_TABLE_NO_SLOT;
+			chunk[i].in_use = false;
+			chunk[i].event_generation = 0;
+		}
+
+		table->chunks[table->allocated_chunks] = chunk;
+		table->allocated_chunks++;
+		table->first_free_slot = first_slot;
+	}
+
+	uint32_t slot_id = table->first_free_slot;
+	struct GENERIC_HTTP_CONNECTION* slot = &table->chunks[slot_id / HTTP_CONNECTION_TABLE_CHUNK_SIZE][slot_id % HTTP_CONNECTION_TABLE_CHUNK_SIZE];
+
+	table->first_free_slot = slot->next_free_slot;
+
+	uint32_t event_generation = slot->event_generation;
+
+	*slot = conn;
+	slot->slot_id = slot_id;
+	slot->next_free_slot = HTTP_CONNECTION_TABLE_NO_SLOT;
+	slot->event_generation = event_generation;
+	slot->in_use = true;
+
+	return slot;
+}
+
+void HTTP_Connection_Table_Remove(struct HTTP_CONNECTION_TABLE* table, struct GENERIC_HTTP_CONNECTION* conn)
+{
+	conn->in_use = false;
+	conn->event_generation++;
+
+	conn->next_free_slot = table->first_free_slot;
+	table->first_free_slot = conn->slot_id;
+}
+
+struct GENERIC_HTTP_CONNECTION* HTTP_Connection_Table_Get(struct HTTP_CONNECTION_TABLE* table, uint64_t event_data)
+{
+	uint32_t slot_id = HTTP_WORKER_EVENT_ID(event_data);
+	if (slot_id / HTTP_CONNECTION_TABLE_CHUNK_SIZE >= table->allocated_chunks)
+	{
+		return NULL;
+	}
+
+	struct GENERIC_HTTP_CONNECTION* slot = &table->chunks[slot_id / HTTP_CONNECTION_TABLE_CHUNK_SIZE][slot_id % HTTP_CONNECTION_TABLE_CHUNK_SIZE];
+
+	//the event was queued for a connection that is already deleted
+	if (!slot->in_use or (slot->event_generation & HTTP_WORKER_EVENT_GENERATION_MASK) != HTTP_WORKER_EVENT_GENERATION(event_data))
+	{
+		return NULL;
+	}
+
+	return slot;
+}
+
+uint64_t HTTP_Worker_Milliseconds(const struct timespec& time)
+{
+	return ((uint64_t)time.tv_sec * 1000) + (time.tv_nsec / 1000000);
+}
+
+uint64_t Generic_Connection_Get_Timeout(struct GENERIC_HTTP_CONNECTION* conn)
+{
+	if (conn->http_version == HTTP_VERSION_2)
+	{
+		struct HTTP2_CONNECTION* http2_conn = (struct HTTP2_CONNECTION*) conn->raw_connection;
+
+		if (conn->state != HTTP2_CONNECTION_STATE_NORMAL)
+		{
+			return server_runtime_config->header_timeout;
+		}
+
+		//the client is not reading the queued frames
+		if (!http2_conn->frame_queue.empty() or http2_conn->send_buffer_offset < http2_conn->send_buffer_len)
+		{
+			return server_runtime_config->send_timeout;
+		}
+
+		if (!http2_conn->streams.empty())
+		{
+			return server_runtime_config->body_timeout;
+		}
+
+		return server_runtime_config->keep_alive_timeout;
+	}
+
+	if (conn->http_version == HTTP_VERSION_1 or conn->http_version == HTTP_VERSION_1_1)
+	{
+		struct HTTP1_CONNECTION* http_conn = (struct HTTP1_CONNECTION*) conn->raw_connection;
+
+		//the pipelined responses are still waiting for the client to read them
+		if (http_conn->send_buffer_offset < http_conn->send_buffer.size())
+		{
+			return server_runtime_config->send_timeout;
+		}
+
+		if (conn->state == HTTP_STATE_WAIT_PATH)
+		{
+			if (http_conn->keep_alive_reused and http_conn->recv_buffer.empty())
+			{
+				return server_runtime_config->keep_alive_timeout;
+			}
+
+			return server_runtime_config->header_timeout;
+		}
+
+		if (conn->state == HTTP_STATE_WAIT_HEADERS)
+		{
+			return server_runtime_config->header_timeout;
+		}
+
+		if (conn->state == HTTP_STATE_WAIT_BODY)
+		{
+			return server_runtime_config->body_timeout;
+		}
+
+		return server_runtime_config->send_timeout;
+	}
+
+	//TLS handshake
+	return server_runtime_config->header_timeout;
+}
+
+void Generic_Connection_Update_Timer(const int worker_id, struct GENERIC_HTTP_CONNECTION* conn)
+{
+	uint64_t timeout = Generic_Connection_Get_Timeout(conn);
+	uint64_t deadline = HTTP_Worker_Milliseconds(conn->last_action) + timeout;
+
+	/*
+	a later deadline is picked up when the scheduled one fires,
+	the wheel is only touched when the new state has a shorter timeout
+	*/
+	if (timeout != 0 and Timer_Wheel_Node_Is_Armed(&conn->timeout_timer) and Timer_Wheel_Milliseconds_To_Tick(deadline) >= conn->timeout_timer.expire_tick)
+	{
+		return;
+	}
+
+	if (timeout == 0 and !Timer_Wheel_Node_Is_Armed(&conn->timeout_timer))
+	{
+		return;
+	}
+
+	if (timeout == 0)
+	{
+		Timer_Wheel_Remove(&conn->timeout_timer);
+	}
+	else
+	{
+		Timer_Wheel_Add(http_workers[worker_id].timeout_wheel, &conn->timeout_timer, deadline);
+	}
+}
+
+void close_all_expired_connections(const int worker_id, const struct timespec& current_time)
+{
+	uint64_t current_miliseconds = HTTP_Worker_Milliseconds(current_time);
+
+	std::vector<void*> expired_connections;
+	Timer_Wheel_Advance(http_workers[worker_id].timeout_wheel, current_miliseconds, &expired_connections);
+
+	for (size_t i = 0; i < expired_connections.size(); i++)
+	{
+		struct GENERIC_HTTP_CONNECTION* conn = (struct GENERIC_HTTP_CONNECTION*) expired_connections[i];
+
+		uint64_t timeout = Generic_Connection_Get_Timeout(conn);
+		if (timeout == 0)
+		{
+			continue;
+		}
+
+		// the connection was active since the timer was scheduled
+		uint64_t deadline = HTTP_Worker_Milliseconds(conn->last_action) + timeout;
+		if (deadline > current_miliseconds)
+		{
+			Timer_Wheel_Add(http_workers[worker_id].timeout_wheel, &conn->timeout_timer, deadline);
+			continue;
+		}
+
+		Generic_Connection_Delete(worker_id, conn);
+	}
+}
+
+#ifndef DISABLE_HTTPS
+void Accept_SSL_Connection(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn)
+{
+	int ssl_status = SSL_accept(conn->ssl_wrapper);
+	if (ssl_status <= 0)
+	{
+		int ssl_errno = SSL_get_error(conn->ssl_wrapper, ssl_status);
+
+		if (ssl_errno == SSL_ERROR_WANT_READ or ssl_errno == SSL_ERROR_WANT_WRITE)
+		{
+			return;
+		}
+
+		SERVER_ERROR_LOG_openssl_err("Unable to accept the incoming SSL connection!");
+
+		Generic_Connection_Delete(worker_id, conn);
+		return;
+	}
+
+	//the kernel TLS offload is set up during the handshake, if the kernel supports it
+	#ifdef SSL_OP_ENABLE_KTLS
+	conn->ktls_send = BIO_get_ktls_send(SSL_get_wbio(conn->ssl_wrapper));
+	#endif
+
+	const uint8_t *ALPN_selected_ext = NULL;
+	unsigned int ALPN_selected_ext_len = 0;
+	SSL_get0_alpn_selected(conn->ssl_wrapper, &ALPN_selected_ext, &ALPN_selected_ext_len);
+
+	if (ALPN_selected_ext_len == 2 and memcmp("h2", ALPN_selected_ext, 2) == 0) // ALPN h2
+	{
+		conn->http_version = HTTP_VERSION_2;
+	}
+	else if (ALPN_selected_ext_len == 8 and memcmp("http/1.1", ALPN_selected_ext, 8) == 0) // ALPN http/1.1
+	{
+		conn->http_version = HTTP_VERSION_1_1;
+	}
+	else // no APLN negotiation
+	{
+		conn->http_version = HTTP_VERSION_1_1;
+	}
+
+	if (conn->http_version == HTTP_VERSION_2)
+	{
+		conn->state = HTTP2_CONNECTION_STATE_WAIT_HELLO;
+
+		struct HTTP2_CONNECTION *http2_conn = new (std::nothrow) struct HTTP2_CONNECTION();
+		if(!http2_conn)
+		{
+			SERVER_ERROR_LOG_stdlib_err("Unable to allocate memory for a HTTP2_CONNECTION.");
+			exit(-1);
+		}
+
+		conn->raw_connection = http2_conn;
+
+		HTTP2_Connection_Init(http2_conn);
+		HTTP2_Connection_Process(worker_id, conn);
+	}
+	else
+	{
+		conn->state = HTTP_STATE_WAIT_PATH;
+
+		struct HTTP1_CONNECTION *http_conn = new (std::nothrow) struct HTTP1_CONNECTION();
+		if(!http_conn)
+		{
+			SERVER_ERROR_LOG_stdlib_err("Unable to allocate memory for a HTTP1_CONNECTION.");
+			exit(-1);
+		}
+				
+		conn->raw_connection = http_conn;
+
+		HTTP1_Connection_Init(http_conn);
+		HTTP1_Connection_Process(worker_id, conn);
+	}
+}
+#endif
+
+#ifndef DISABLE_IO_URING
+//the requests of the socket hold a reference to it, the close is chained after their removal and submitted with the next wait
+static void io_uring_close_client(const int worker_id, struct GENERIC_HTTP_CONNECTION* conn, std::string* final_data, size_t final_data_offset)
+{
+	struct IO_URING_RING* ring = http_workers[worker_id].io_ring;
+	uint64_t event_data = HTTP_WORKER_EVENT_DATA(HTTP_WORKER_EVENT_CONNECTION, conn->event_generation, conn->slot_id);
+	uint64_t ignored_event_data = HTTP_WORKER_EVENT_DATA(HTTP_WORKER_EVENT_IGNORED, 0, 0);
+
+	//a chain split between two submissions would close the socket before the send
+	if (!IO_Uring_Reserve(ring, 5))
+	{
+		SERVER_ERROR_LOG_stdlib_err("Unable to submit the worker io_uring requests!");
+		exit(-1);
+	}
+
+	//the hard links run the next request even if this one fails, the successful ones do not post a completion
+	if (conn->recv_buffers)
+	{
+		IO_Uring_Buffer_Queue_Clear(conn->recv_buffers, &conn->recv_queue);
+
+		if (conn->recv_state != HTTP_CONNECTION_RECV_PAUSED)
+		{
+			IO_Uring_Cancel(ring, event_data | HTTP_WORKER_EVENT_IO, ignored_event_data);
+			IO_Uring_Set_Last_Flags(ring, IOSQE_IO_HARDLINK | IOSQE_CQE_SKIP_SUCCESS);
+		}
+	}
+
+	IO_Uring_Poll_Remove(ring, event_data, ignored_event_data);
+	IO_Uring_Set_Last_Flags(ring, IOSQE_IO_HARDLINK | IOSQE_CQE_SKIP_SUCCESS);
+
+	if (final_data)
+	{
+		uint32_t send_slot;
+		if (http_workers[worker_id].free_final_sends.empty())
+		{
+			send_slot = http_workers[worker_id].final_sends.size();
+			http_workers[worker_id].final_sends.push_back(final_data);
+		}
+		else
+		{
+			send_slot = http_workers[worker_id].free_final_sends.back();
+			http_workers[worker_id].free_final_sends.pop_back();
+			http_workers[worker_id].final_sends[send_slot] = final_data;
+		}
+
+		//MSG_WAITALL keeps the request until everything is sent, the send timeout cancels it for a client that stopped reading
+		IO_Uring_Send(ring, conn->client_sock, final_data->c_str() + final_data_offset, final_data->size() - final_data_offset, MSG_WAITALL | MSG_NOSIGNAL, HTTP_WORKER_EVENT_DATA(HTTP_WORKER_EVENT_IGNORED, 0, send_slot) | HTTP_WORKER_EVENT_IO);
+		IO_Uring_Set_Last_Flags(ring, IOSQE_IO_HARDLINK);
+
+		if (server_runtime_config->send_timeout != 0)
+		{
+			IO_Uring_Link_Timeout(ring, server_runtime_config->send_timeout, ignored_event_data);
+			IO_Uring_Set_Last_Flags(ring, IOSQE_IO_HARDLINK);
+		}
+	}
+
+	IO_Uring_Close(ring, conn->client_sock, ignored_event_data);
+	IO_Uring_Set_Last_Flags(ring, IOSQE_CQE_SKIP_SUCCESS);
+}
+#endif
+
+static void Generic_Connection_Free(const int worker_id, struct GENERIC_HTTP_CONNECTION* conn, std::string* final_data, size_t final_data_offset)
+{
+	if(conn->http_version == HTTP_VERSION_2)
+	{
+		HTTP2_Connection_Delete(worker_id, (struct HTTP2_CONNECTION*)conn->raw_connection);
+		delete( ((struct HTTP2_CONNECTION*)conn->raw_connection) );
+	}
+	else if(conn->http_version == HTTP_VERSION_1 or conn->http_version == HTTP_VERSION_1_1)
+	{
+		HTTP1_Connection_Delete((struct HTTP1_CONNECTION*)conn->raw_connection);
+		delete( ((struct HTTP1_CONNECTION*)conn->raw_connection) );
+	}
+
+	#ifndef DISABLE_HTTPS
+	if(conn->https)
+	{
+		SSL_free(conn->ssl_wrapper);
+	}
+	#endif
+
+	#ifndef DISABLE_IO_URING
+	if(http_workers[worker_id].io_ring)
+	{
+		io_uring_close_client(worker_id, conn, final_data, final_data_offset);
+	}
+	else
+	#endif
+	{
+		close(conn->client_sock);
+	}
+
+	Timer_Wheel_Remove(&conn->timeout_timer);
+	HTTP_Connection_Table_Remove(http_workers[worker_id].connections, conn);
+
+	http_workers_load[worker_id].connections--;
+	http_workers_load[worker_id].clients--;
+}
+
+void Generic_Connection_Delete(const int worker_id, struct GENERIC_HTTP_CONNECTION* conn)
+{
+	Generic_Connection_Free(worker_id, conn, NULL, 0);
+}
+
+bool Generic_Connection_Send_And_Delete(const int worker_id, struct GENERIC_HTTP_CONNECTION* conn, std::string* data, size_t offset)
+{
+	#ifndef DISABLE_IO_URING
+	if (!http_workers[worker_id].io_ring or conn->https)
+	{
+		return false;
+	}
+
+	//the connection buffers are freed with it, the data stays until its send completes
+	std::string* final_data = new (std::nothrow) std::string;
+	if (!final_data)
+	{
+		SERVER_ERROR_LOG_stdlib_err("Unable to allocate memory for the final response!");
+		exit(-1);
+	}
+
+	final_data->swap(*data);
+	Generic_Connection_Free(worker_id, conn, final_data, offset);
+
+	return true;
+	#else
+	return false;
+	#endif
+}
+
+#ifndef DISABLE_IO_URING
+//the received data is queued in the connection, its buffer goes back to the kernel once the connection read it
+static bool io_uring_recv_completion(const int worker_id, struct GENERIC_HTTP_CONNECTION* conn, uint64_t user_data, int result, uint32_t flags, struct epoll_event* triggered_event)
+{
+	struct IO_URING_BUFFER_RING* recv_buffers = http_workers[worker_id].recv_buffers;
+	bool is_multishot_active = flags & IORING_CQE_F_MORE;
+
+	//the data received before the connection was deleted
+	if (!conn)
+	{
+		if (flags & IORING_CQE_F_BUFFER)
+		{
+			IO_Uring_Buffer_Recycle(recv_buffers, flags >> IORING_CQE_BUFFER_SHIFT);
+		}
+
+		return false;
+	}
+
+	memset(triggered_event, 0, sizeof(struct epoll_event));
+	triggered_event->data.u64 = user_data & ~HTTP_WORKER_EVENT_IO;
+
+	if (result > 0)
+	{
+		IO_Uring_Buffer_Queue_Push(recv_buffers, &conn->recv_queue, flags >> IORING_CQE_BUFFER_SHIFT, result);
+		triggered_event->events = EPOLLIN;
+
+		//the client sends faster than its requests are processed
+		if (is_multishot_active and conn->recv_state == HTTP_CONNECTION_RECV_ARMED and conn->recv_queue.length >= IO_URING_WORKER_RECV_QUEUE_MAX)
+		{
+			if (!IO_Uring_Cancel(http_workers[worker_id].io_ring, user_data, HTTP_WORKER_EVENT_DATA(HTTP_WORKER_EVENT_IGNORED, 0, 0)))
+			{
+				SERVER_ERROR_LOG_stdlib_err("Unable to pause the client recv of the worker io_uring!");
+				exit(-1);
+			}
+
+			conn->recv_state = HTTP_CONNECTION_RECV_CANCELLING;
+		}
+	}
+	else if (result != -ENOBUFS and result != -ECANCELED)
+	{
+		//the client closed the connection or it failed, the event loop deletes it
+		triggered_event->events = (result == 0) ? EPOLLRDHUP : EPOLLERR;
+		conn->recv_state = HTTP_CONNECTION_RECV_PAUSED;
+		return true;
+	}
+
+	//stopped by the cancel or by the lack of free buffers, armed again once the received data is read
+	if (!is_multishot_active)
+	{
+		conn->recv_state = HTTP_CONNECTION_RECV_PAUSED;
+		http_workers[worker_id].paused_recvs.push_back(user_data);
+	}
+
+	return result > 0;
+}
+
+static void io_uring_resume_recvs(const int worker_id)
+{
+	struct IO_URING_BUFFER_RING* recv_buffers = http_workers[worker_id].recv_buffers;
+	std::vector<uint64_t>& paused_recvs = http_workers[worker_id].paused_recvs;
+
+	//the buffers held by the other connections are read first, so the resumed recvs do not fail again
+	if (paused_recvs.empty() or recv_buffers->held > recv_buffers->entries / 2)
+	{
+		return;
+	}
+
+	size_t paused_num = 0;
+	for (size_t i = 0; i < paused_recvs.size(); i++)
+	{
+		struct GENERIC_HTTP_CONNECTION* conn = HTTP_Connection_Table_Get(http_workers[worker_id].connections, paused_recvs[i]);
+		if (!conn)
+		{
+			continue;
+		}
+
+		if (conn->recv_queue.length > 0)
+		{
+			paused_recvs[paused_num] = paused_recvs[i];
+			paused_num++;
+			continue;
+		}
+
+		if (!IO_Uring_Recv_Multishot(http_workers[worker_id].io_ring, conn->client_sock, IO_URING_WORKER_RECV_BUFFER_GROUP, paused_recvs[i]))
+		{
+			SERVER_ERROR_LOG_stdlib_err("Unable to resume the client recv of the worker io_uring!");
+			exit(-1);
+		}
+
+		conn->recv_state = HTTP_CONNECTION_RECV_ARMED;
+	}
+
+	paused_recvs.resize(paused_num);
+}
+
+//arms the idle accept slots of the listener, listener_index is 0 for http and 1 for https
+static bool HTTP_Worker_Arm_Accepts(struct HTTP_WORKER_NODE& worker, int listener_index, int listener)
+{
+	for (uint32_t slot_id = listener_index * IO_URING_WORKER_ACCEPTS; slot_id < (uint32_t)(listener_index + 1) * IO_URING_WORKER_ACCEPTS; slot_id++)
+	{
+		struct HTTP_WORKER_ACCEPT_SLOT& slot = worker.accept_slots[slot_id];
+		if (slot.is_armed)
+		{
+			continue;
+		}
+
+		slot.addr_size = sizeof(slot.addr);
+		if (!IO_Uring_Accept(worker.io_ring, listener, (struct sockaddr*) &slot.addr, &slot.addr_size, HTTP_WORKER_EVENT_DATA(HTTP_WORKER_EVENT_LISTENER, slot_id, listener)))
+		{
+			return false;
+		}
+
+		slot.is_armed = true;
+	}
+
+	return true;
+}
+
+int io_uring_wait_events(const int worker_id, struct epoll_event* triggered_events, int max_events, int milisecond_timeout, accept_new_client_func_parameters& http_accept_params, accept_new_client_func_parameters& https_accept_params)
+{
+	struct IO_URING_RING* ring = http_workers[worker_id].io_ring;
+
+	if (http_workers[worker_id].recv_buffers)
+	{
+		io_uring_resume_recvs(worker_id);
+	}
+
+	//a single syscall submits all the queued requests and waits for the completions
+	if (IO_Uring_Submit_And_Wait(ring, 1, milisecond_timeout) == -1)
+	{
+		return -1;
+	}
+
+	/*
+	the poll completions are translated into epoll events,
+	so the event loop and the connection processors stay the same for both backends
+	*/
+	int events_num = 0;
+	struct io_uring_cqe* cqe;
+	while (events_num < max_events and (cqe = IO_Uring_Peek_CQE(ring)) != NULL)
+	{
+		uint64_t user_data = cqe->user_data;
+		int result = cqe->res;
+		uint32_t flags = cqe->flags;
+		bool is_multishot_active = flags & IORING_CQE_F_MORE;
+
+		IO_Uring_CQE_Seen(ring);
+
+		switch (HTTP_WORKER_EVENT_TYPE(user_data))
+		{
+			case HTTP_WORKER_EVENT_CLOSE_TRIGGER:
+			{
+				memset(&triggered_events[events_num], 0, sizeof(struct epoll_event));
+				triggered_events[events_num].events = EPOLLIN;
+				events_num++;
+				break;
+			}
+
+			case HTTP_WORKER_EVENT_LISTENER:
+			{
+				int fd = HTTP_WORKER_EVENT_ID(user_data);
+
+				//clients handed over by the server listeners and the file loads of the I/O threads, drained by the event loop
+				if (fd == http_workers[worker_id].client_queue_event or fd == http_workers[worker_id].file_io_event)
+				{
+					if (result >= 0)
+					{
+						memset(&triggered_events[events_num], 0, sizeof(struct epoll_event));
+						triggered_events[events_num].events = result;
+						triggered_events[events_num].data.u64 = user_data;
+						events_num++;
+					}
+
+					if (!is_multishot_active)
+					{
+						if (!IO_Uring_Poll_Multishot(ring, fd, EPOLLIN, user_data))
+						{
+							SERVER_ERROR_LOG_stdlib_err("Unable to rearm the worker io_uring eventfd poll!");
+							exit(-1);
+						}
+					}
+
+					break;
+				}
+
+				//the listener field is already -1 when a draining worker receives the cancelled accept
+				accept_new_client_func_parameters &accept_params = (fd == http_accept_params.http_listener) ? http_accept_params : https_accept_params;
+
+				uint32_t slot_id = HTTP_WORKER_EVENT_GENERATION(user_data);
+				http_workers[worker_id].accept_slots[slot_id].is_armed = false;
+
+				if (result >= 0)
+				{
+					//the socket is already nonblocking and the peer address is in the slot
+					if (setup_new_client(accept_params, result, http_workers[worker_id].accept_slots[slot_id].addr) == -1)
+					{
+						exit(-1);
+					}
+				}
+				else if (!http_workers[worker_id].draining)
+				{
+					handle_accept_error(accept_params, -result);
+				}
+
+				//the paused accepts are armed again once the backoff expires
+				if (!http_workers[worker_id].draining and accept_params.accept_resume_ms == 0)
+				{
+					if (!HTTP_Worker_Arm_Accepts(http_workers[worker_id], slot_id / IO_URING_WORKER_ACCEPTS, fd))
+					{
+						SERVER_ERROR_LOG_stdlib_err("Unable to rearm the worker io_uring accept!");
+						exit(-1);
+					}
+				}
+
+				break;
+			}
+
+			case HTTP_WORKER_EVENT_CONNECTION:
+			{
+				struct GENERIC_HTTP_CONNECTION* conn = HTTP_Connection_Table_Get(http_workers[worker_id].connections, user_data);
+
+				if (user_data & HTTP_WORKER_EVENT_IO)
+				{
+					if (io_uring_recv_completion(worker_id, conn, user_data, result, flags, &triggered_events[events_num]))
+					{
+						events_num++;
+					}
+
+					break;
+				}
+
+				//the completion belongs to a connection that was already deleted
+				if (!conn)
+				{
+					break;
+				}
+
+				memset(&triggered_events[events_num], 0, sizeof(struct epoll_event));
+				triggered_events[events_num].data.u64 = user_data;
+
+				if (result < 0)
+				{
+					triggered_events[events_num].events = EPOLLERR;
+				}
+				else
+				{
+					triggered_events[events_num].events = result;
+
+					if (!is_multishot_active)
+					{
+						uint32_t poll_events = conn->recv_buffers ? (EPOLLOUT | EPOLLHUP | EPOLLERR) : HTTP_WORKER_CLIENT_EVENTS;
+						if (!IO_Uring_Poll_Multishot(ring, conn->client_sock, poll_events, user_data))
+						{
+							SERVER_ERROR_LOG_stdlib_err("Unable to rearm the worker io_uring poll!");
+							exit(-1);
+						}
+					}
+				}
+
+				events_num++;
+				break;
+			}
+
+			case HTTP_WORKER_EVENT_IGNORED:
+			{
+				//the final response of a closed connection was sent
+				if (user_data & HTTP_WORKER_EVENT_IO)
+				{
+					uint32_t send_slot = HTTP_WORKER_EVENT_ID(user_data);
+
+					delete (http_workers[worker_id].final_sends[send_slot]);
+					http_workers[worker_id].final_sends[send_slot] = NULL;
+					http_workers[worker_id].free_final_sends.push_back(send_slot);
+				}
+
+				break;
+			}
+
+			default:
+				break;
+		}
+	}
+
+	return events_num;
+}
+#endif
+
+//retries the accepts paused by running out of descriptors or memory
+static void HTTP_Worker_Resume_Accepts(int worker_id, accept_new_client_func_parameters& http_accept_params, accept_new_client_func_parameters& https_accept_params, uint64_t current_ms)
+{
+	struct HTTP_WORKER_NODE& worker = http_workers[worker_id];
+	if (worker.draining)
+	{
+		return;
+	}
+
+	int listeners[2] = {worker.http_listener, worker.https_listener};
+	accept_new_client_func_parameters* accept_params[2] = {&http_accept_params, &https_accept_params};
+
+	for (int i = 0; i < 2; i++)
+	{
+		if (listeners[i] == -1 or !accept_backoff_expired(*accept_params[i], current_ms))
+		{
+			continue;
+		}
+
+		#ifndef DISABLE_IO_URING
+		if (worker.io_ring)
+		{
+			if (!HTTP_Worker_Arm_Accepts(worker, i, listeners[i]))
+			{
+				SERVER_ERROR_LOG_stdlib_err("Unable to rearm the worker io_uring accept!");
+				exit(-1);
+			}
+
+			continue;
+		}
+		#endif
+
+		if (accept_new_client(*accept_params[i]) == -1)
+		{
+			exit(-1);
+		}
+	}
+}
+
+static void HTTP_Worker_Start_Draining(int worker_id)
+{
+	struct HTTP_WORKER_NODE& worker = http_workers[worker_id];
+	worker.draining = true;
+
+	//the upgraded server accepts on the same sockets from now on
+	int* listeners[2] = {&worker.http_listener, &worker.https_listener};
+	for (int i = 0; i < 2; i++)
+	{
+		if (*listeners[i] == -1)
+		{
+			continue;
+		}
+
+		#ifndef DISABLE_IO_URING
+		if (worker.io_ring)
+		{
+			for (uint32_t slot_id = i * IO_URING_WORKER_ACCEPTS; slot_id < (uint32_t)(i + 1) * IO_URING_WORKER_ACCEPTS; slot_id++)
+			{
+				if (worker.accept_slots[slot_id].is_armed and
+				    !IO_Uring_Cancel(worker.io_ring, HTTP_WORKER_EVENT_DATA(HTTP_WORKER_EVENT_LISTENER, slot_id, *listeners[i]), HTTP_WORKER_EVENT_DATA(HTTP_WORKER_EVENT_IGNORED, 0, 0)))
+				{
+					SERVER_ERROR_LOG_stdlib_err("Unable to cancel the worker io_uring accept!");
+					exit(-1);
+				}
+			}
+		}
+		else
+		#endif
+		{
+			epoll_ctl(worker.worker_epoll, EPOLL_CTL_DEL, *listeners[i], NULL);
+		}
+
+		close(*listeners[i]);
+		*listeners[i] = -1;
+	}
+}
+
+//closes the idle connections and asks the HTTP/2 clients to stop opening streams
+static void HTTP_Worker_Drain_Connections(int worker_id)
+{
+	struct HTTP_CONNECTION_TABLE* connections = http_workers[worker_id].connections;
+	for (uint32_t slot_id = 0; slot_id < connections->allocated_chunks * HTTP_CONNECTION_TABLE_CHUNK_SIZE; slot_id++)
+	{
+		struct GENERIC_HTTP_CONNECTION* conn = &connections->chunks[slot_id / HTTP_CONNECTION_TABLE_CHUNK_SIZE][slot_id % HTTP_CONNECTION_TABLE_CHUNK_SIZE];
+		if (!conn->in_use)
+		{
+			continue;
+		}
+
+		if (conn->http_version == HTTP_VERSION_2)
+		{
+			struct HTTP2_CONNECTION* http2_conn = (struct HTTP2_CONNECTION*) conn->raw_connection;
+
+			//the client did not send the preface yet, no stream can be open
+			if (conn->state == HTTP2_CONNECTION_STATE_WAIT_HELLO)
+			{
+				Generic_Connection_Delete(worker_id, conn);
+			}
+			//the server SETTINGS are queued with the preface, the GOAWAY can follow them before the client SETTINGS arrive
+			else if ((conn->state == HTTP2_CONNECTION_STATE_NORMAL or conn->state == HTTP2_CONNECTION_STATE_WAIT_SETTINGS) and !http2_conn->goaway_sent)
+			{
+				HTTP2_Connection_Shutdown(worker_id, conn);
+			}
+			else if (http2_conn->goaway_sent and http2_conn->streams.empty() and http2_conn->frame_queue.empty() and http2_conn->send_buffer_len == 0)
+			{
+				Generic_Connection_Delete(worker_id, conn);
+			}
+		}
+		else if (conn->http_version == HTTP_VERSION_1 or conn->http_version == HTTP_VERSION_1_1)
+		{
+			struct HTTP1_CONNECTION* http_conn = (struct HTTP1_CONNECTION*) conn->raw_connection;
+
+			//a kept alive connection between two requests
+			if (conn->state == HTTP_STATE_WAIT_PATH and http_conn->keep_alive_reused and http_conn->recv_buffer.empty())
+			{
+				Generic_Connection_Delete(worker_id, conn);
+			}
+		}
+	}
+}
+
+void http_worker_thread(int worker_id)
+{
+	//pinned first, so the buffers and the connection slots are allocated on the local NUMA node
+	if (http_workers[worker_id].cpu != -1 and !CPU_Affinity_Pin_Current_Thread(http_workers[worker_id].cpu))
+	{
+		SERVER_ERROR_LOG_stdlib_err("Unable to pin the http worker to its cpu!");
+	}
+
+	struct timespec start_time;
+	if (clock_gettime(CLOCK_MONOTONIC, &start_time) == -1)
+	{
+		SERVER_ERROR_LOG_stdlib_err("Unable to get time!");
+		exit(-1);
+	}
+
+	http_workers[worker_id].timeout_wheel = new (std::nothrow) struct TIMER_WHEEL;
+	if (!http_workers[worker_id].timeout_wheel)
+	{
+		SERVER_ERROR_LOG_stdlib_err("Unable to allocate memory for the http worker timer wheel!");
+		exit(-1);
+	}
+
+	Timer_Wheel_Init(http_workers[worker_id].timeout_wheel, HTTP_Worker_Milliseconds(start_time));
+
+	//the chunk directory is allocated here, the chunks when the worker needs them
+	http_workers[worker_id].connections = new (std::nothrow) struct HTTP_CONNECTION_TABLE;
+	if (!http_workers[worker_id].connections or !HTTP_Connection_Table_Init(http_workers[worker_id].connections, str2uint(&SERVER_CONFIGURATION["max_connections"])))
+	{
+		SERVER_ERROR_LOG_stdlib_err("Unable to allocate memory for the http worker connection table!");
+		exit(-1);
+	}
+
+	HTTP_Worker_Init_Aux_Modules(worker_id);
+
+	struct epoll_event triggered_events[128];
+
+	//zeroed for the backoff checks, the parameters of a missing listener are never initialized
+	accept_new_client_func_parameters http_accept_params = {}, https_accept_params = {};
+	if (is_server_worker_listeners_enabled)
+	{
+		server_listener_parameters listener_params;
+		listener_params.server_epoll = http_workers[worker_id].worker_epoll;
+		#ifndef DISABLE_HTTPS
+		listener_params.openssl_ctx = NULL;
+		#endif
+		listener_params.http_listener = http_workers[worker_id].http_listener;
+		listener_params.https = false;
+
+		init_accept_new_client_parameters(listener_params, http_accept_params, worker_id);
+
+		#ifndef DISABLE_HTTPS
+		if (http_workers[worker_id].https_listener != -1)
+		{
+			listener_params.http_listener = http_workers[worker_id].https_listener;
+			listener_params.https = true;
+			listener_params.openssl_ctx = worker_listeners_openssl_ctx;
+
+			init_accept_new_client_parameters(listener_params, https_accept_params, worker_id);
+		}
+		#endif
+	}
+
+	//the worker is ready once it stopped reading SERVER_CONFIGURATION, a reload may change it from now on
+	HTTP_Worker_Refresh_Config(worker_id);
+
+	//read_buffer_size is not changed by a reload
+	size_t recv_buffer_size = server_runtime_config->read_buffer_size;
+	http_workers[worker_id].recv_buffer = new (std::nothrow) char[recv_buffer_size];
+	if (!http_workers[worker_id].recv_buffer)
+	{
+		SERVER_ERROR_LOG_stdlib_err("Unable to allocate memory for the http worker recv buffer!");
+		exit(-1);
+	}
+
+	int epoll_wait_time = 500;
+	bool epoll_loop_should_stop = false;
+	while (!epoll_loop_should_stop)
+	{
+		HTTP_Worker_Refresh_Config(worker_id);
+
+		//the cached contents seen in the previous batch are not used anymore
+		Content_Cache_Quiescent(worker_id);
+
+		int epoll_result;
+
+		//woken up earlier for the retry of the paused accepts
+		int wait_time = epoll_wait_time;
+		if (http_accept_params.accept_resume_ms != 0 or https_accept_params.accept_resume_ms != 0)
+		{
+			wait_time = SERVER_LISTENER_ACCEPT_BACKOFF_MIN_MS;
+		}
+
+		#ifndef DISABLE_IO_URING
+		if (http_workers[worker_id].io_ring)
+		{
+			epoll_result = io_uring_wait_events(worker_id, triggered_events, sizeof(triggered_events) / sizeof(struct epoll_event), wait_time, http_accept_params, https_accept_params);
+		}
+		else
+		#endif
+		{
+			epoll_result = epoll_wait(http_workers[worker_id].worker_epoll, triggered_events, sizeof(triggered_events) / sizeof(struct epoll_event), wait_time);
+		}
+
+		if (epoll_result == -1)
+		{
+			if (errno != EINTR)
+			{
+				SERVER_ERROR_LOG_stdlib_err("Unable to listen to epoll!");
+				exit(-1);
+			}
+
+			continue;
+		}
+
+		//written only when it changes, the balancer reads this cache line on every accept
+		if (http_workers_load[worker_id].event_backlog.load(std::memory_order_relaxed) != epoll_result)
+		{
+			http_workers_load[worker_id].event_backlog.store(epoll_result, std::memory_order_relaxed);
+		}
+
+		struct timespec current_time;
+		if (clock_gettime(CLOCK_MONOTONIC, &current_time) == -1)
+		{
+			SERVER_ERROR_LOG_stdlib_err("Unable to get time!");
+			exit(-1);
+		}
+
+		HTTP_Worker_Resume_Accepts(worker_id, http_accept_params, https_accept_params, HTTP_Worker_Milliseconds(current_time));
+
+		for (int event_num = 0; event_num < epoll_result; event_num++)
+		{
+			struct epoll_event triggered_event = triggered_events[event_num];
+
+			uint64_t event_type = HTTP_WORKER_EVENT_TYPE(triggered_event.data.u64);
+
+			// shutdown triggered
+			if (event_type == HTTP_WORKER_EVENT_CLOSE_TRIGGER)
+			{
+				//a second close trigger while draining stops the worker
+				if (is_server_draining and !http_workers[worker_id].draining)
+				{
+					HTTP_Worker_Start_Draining(worker_id);
+					continue;
+				}
+
+				epoll_loop_should_stop = true;
+				break;
+			}
+
+			if (event_type == HTTP_WORKER_EVENT_LISTENER)
+			{
+				int listener = HTTP_WORKER_EVENT_ID(triggered_event.data.u64);
+
+				// new clients accepted by the server listeners
+				if (listener == http_workers[worker_id].client_queue_event)
+				{
+					HTTP_Worker_Receive_Clients(worker_id);
+					continue;
+				}
+
+				// the file chunks loaded by the I/O threads
+				if (listener == http_workers[worker_id].file_io_event)
+				{
+					HTTP_Worker_Receive_File_IO(worker_id, current_time);
+					continue;
+				}
+
+				// the listener was closed by the drain
+				if (http_workers[worker_id].draining)
+				{
+					continue;
+				}
+
+				// new clients on the listeners owned by this worker, a new client does not end the backoff of the paused accepts
+				accept_new_client_func_parameters &accept_params = (listener == http_workers[worker_id].http_listener) ? http_accept_params : https_accept_params;
+				if (accept_params.accept_resume_ms == 0 and accept_new_client(accept_params) == -1)
+				{
+					exit(-1);
+				}
+
+				continue;
+			}
+
+			struct GENERIC_HTTP_CONNECTION *triggered_connection = HTTP_Connection_Table_Get(http_workers[worker_id].connections, triggered_event.data.u64);
+			if (!triggered_connection)
+			{
+				//the connection was deleted
+				continue;
+			}
+			
+			triggered_connection->last_action = current_time;
+
+			if (triggered_event.events & EPOLLHUP or triggered_event.events & EPOLLRDHUP or triggered_event.events & EPOLLERR)
+			{
+				Generic_Connection_Delete(worker_id, triggered_connection);
+				continue;
+			}
+
+			if (triggered_connection->state == HTTP_STATE_SSL_INIT and triggered_connection->http_version == HTTP_VERSION_UNDEFINED)
+			{
+				#ifndef DISABLE_HTTPS
+				Accept_SSL_Connection(worker_id, triggered_connection);
+				#endif
+			}
+			else
 			{
 				// process the connection
 				if (triggered_connection->http_version == HTTP_VERSION_2)
@@ -476,76 +1714,426 @@ void http_worker_thread(int worker_id)
 					HTTP1_Connection_Process(worker_id, triggered_connection);
 				}
 			}
+
+			// the processing can move the connection to a state with a shorter timeout
+			if (HTTP_Connection_Table_Get(http_workers[worker_id].connections, triggered_event.data.u64))
+			{
+				Generic_Connection_Update_Timer(worker_id, triggered_connection);
+			}
 		}
 
 		close_all_expired_connections(worker_id, current_time);
+
+		if (http_workers[worker_id].draining and !epoll_loop_should_stop)
+		{
+			HTTP_Worker_Drain_Connections(worker_id);
+
+			if (http_workers_load[worker_id].connections.load() == 0)
+			{
+				epoll_loop_should_stop = true;
+			}
+		}
 	}
 
 	delete[] http_workers[worker_id].recv_buffer;
 
-	//free all connections
-	http_workers[worker_id].connections_mutex->lock();
-	for(auto it = http_workers[worker_id].connections.begin(); it != http_workers[worker_id].connections.end(); it++)
+	//stop accepting new clients
+	if (http_workers[worker_id].http_listener != -1)
 	{
-		auto temp_it = it;
-		it++;
+		close(http_workers[worker_id].http_listener);
+	}
 
-		Generic_Connection_Delete(worker_id, &temp_it->second, false);
+	if (http_workers[worker_id].https_listener != -1)
+	{
+		close(http_workers[worker_id].https_listener);
+	}
 
-		if(it == http_workers[worker_id].connections.end())
+	//the clients still waiting in the queue were never registered
+	if (http_workers[worker_id].client_queue)
+	{
+		HTTP_Worker_Add_Client_Parameters params;
+		while (Client_Queue_Pop(http_workers[worker_id].client_queue, &params))
 		{
-			break;
+			close(params.client_sock);
+			http_workers_load[worker_id].connections--;
+			http_workers_load[worker_id].clients--;
 		}
 	}
-	http_workers[worker_id].connections_mutex->unlock();
 
-	//delete the connections mutex
-	delete(http_workers[worker_id].connections_mutex);
+	//free all connections
+	struct HTTP_CONNECTION_TABLE* connections = http_workers[worker_id].connections;
+	for (uint32_t slot_id = 0; slot_id < connections->allocated_chunks * HTTP_CONNECTION_TABLE_CHUNK_SIZE; slot_id++)
+	{
+		struct GENERIC_HTTP_CONNECTION* conn = &connections->chunks[slot_id / HTTP_CONNECTION_TABLE_CHUNK_SIZE][slot_id % HTTP_CONNECTION_TABLE_CHUNK_SIZE];
+		if (conn->in_use)
+		{
+			Generic_Connection_Delete(worker_id, conn);
+		}
+	}
 
 	//close the epoll fd
-	close(http_workers[worker_id].worker_epoll);
+	if (http_workers[worker_id].worker_epoll != -1)
+	{
+		close(http_workers[worker_id].worker_epoll);
+	}
+
+	#ifndef DISABLE_IO_URING
+	if (http_workers[worker_id].io_ring)
+	{
+		//the sockets of the deleted connections are closed by the queued requests
+		IO_Uring_Submit_And_Wait(http_workers[worker_id].io_ring, 0, 0);
+
+		if (http_workers[worker_id].recv_buffers)
+		{
+			IO_Uring_Buffer_Ring_Free(http_workers[worker_id].io_ring, http_workers[worker_id].recv_buffers);
+			delete (http_workers[worker_id].recv_buffers);
+		}
+
+		IO_Uring_Free(http_workers[worker_id].io_ring);
+		delete (http_workers[worker_id].io_ring);
+
+		//the accepts were cancelled with the ring, nothing writes to their slots anymore
+		delete[] (http_workers[worker_id].accept_slots);
+
+		//the sends still pending were cancelled with the ring
+		for (size_t i = 0; i < http_workers[worker_id].final_sends.size(); i++)
+		{
+			delete (http_workers[worker_id].final_sends[i]);
+		}
+	}
+	#endif
+
+	delete (http_workers[worker_id].timeout_wheel);
+
+	HTTP_Connection_Table_Free(http_workers[worker_id].connections);
+	delete (http_workers[worker_id].connections);
 
 	HTTP_Worker_Free_Aux_Modules(worker_id);
 }
 
+void HTTP_Worker_Init_Listeners(struct HTTP_WORKER_NODE& worker)
+{
+	/*
+	each worker binds its own socket in the SO_REUSEPORT group,
+	the kernel spreads the incoming connections between them
+	*/
+	worker.http_listener = init_server_listener_socket(false);
+	if (worker.http_listener == -1)
+	{
+		exit(-1);
+	}
+
+	#ifndef DISABLE_HTTPS
+	if (worker_listeners_openssl_ctx)
+	{
+		worker.https_listener = init_server_listener_socket(true);
+		if (worker.https_listener == -1)
+		{
+			exit(-1);
+		}
+	}
+	#endif
+
+	#ifndef DISABLE_IO_URING
+	if (worker.io_ring)
+	{
+		//the kernel writes to the slots until the ring is freed, they do not move with the worker entry
+		worker.accept_slots = new (std::nothrow) struct HTTP_WORKER_ACCEPT_SLOT[2 * IO_URING_WORKER_ACCEPTS]();
+		if (!worker.accept_slots)
+		{
+			SERVER_ERROR_LOG_stdlib_err("Unable to allocate memory for the http worker accepts!");
+			exit(-1);
+		}
+	}
+	#endif
+
+	int listeners[2] = {worker.http_listener, worker.https_listener};
+	for (int i = 0; i < 2; i++)
+	{
+		if (listeners[i] == -1)
+		{
+			continue;
+		}
+
+		#ifndef DISABLE_IO_URING
+		if (worker.io_ring)
+		{
+			if (!HTTP_Worker_Arm_Accepts(worker, i, listeners[i]))
+			{
+				SERVER_ERROR_LOG_stdlib_err("Unable to add the listener socket to the worker io_uring!");
+				exit(-1);
+			}
+
+			continue;
+		}
+		#endif
+
+		struct epoll_event epoll_config;
+		memset(&epoll_config, 0, sizeof(epoll_config)); //suppress valgrind warnings
+		epoll_config.events = EPOLLIN | EPOLLET;
+		epoll_config.data.u64 = HTTP_WORKER_EVENT_DATA(HTTP_WORKER_EVENT_LISTENER, 0, listeners[i]);
+
+		if (epoll_ctl(worker.worker_epoll, EPOLL_CTL_ADD, listeners[i], &epoll_config) == -1)
+		{
+			SERVER_ERROR_LOG_stdlib_err("Unable to add the listener socket to the worker epoll!");
+			exit(-1);
+		}
+	}
+}
+
+void HTTP_Worker_Init_CPU_Steering()
+{
+	//the worker listeners were bound in order, so the socket index in the group is the worker id
+	std::vector<int> socket_cpus;
+	std::vector<bool> is_cpu_used(CPU_SETSIZE, false);
+
+	for (size_t i = 0; i < http_workers.size(); i++)
+	{
+		//a worker sharing the cpu of a previous one would never receive a steered connection
+		if (is_cpu_used[http_workers[i].cpu])
+		{
+			SERVER_LOG_WRITE(SERVER_LOG_strtime(SERVER_LOG_LOCALTIME_REPORTING), true);
+			SERVER_LOG_WRITE(" The reuseport cpu steering requires a distinct cpu for each worker!\nDisabling the reuseport cpu steering!\n\n", true);
+			return;
+		}
+
+		is_cpu_used[http_workers[i].cpu] = true;
+		socket_cpus.push_back(http_workers[i].cpu);
+	}
+
+	int listeners[2] = {http_workers[0].http_listener, http_workers[0].https_listener};
+	for (int i = 0; i < 2; i++)
+	{
+		if (listeners[i] != -1 and !CPU_Affinity_Attach_Reuseport_Steering(listeners[i], socket_cpus))
+		{
+			SERVER_ERROR_LOG_stdlib_err("Unable to attach the reuseport cpu steering program!");
+		}
+	}
+}
+
+void HTTP_Worker_Init_Client_Queue(struct HTTP_WORKER_NODE& worker)
+{
+	worker.client_queue = new (std::nothrow) struct CLIENT_QUEUE;
+	if (!worker.client_queue or !Client_Queue_Init(worker.client_queue, CLIENT_QUEUE_SIZE))
+	{
+		SERVER_ERROR_LOG_stdlib_err("Unable to allocate memory for the http worker client queue!");
+		exit(-1);
+	}
+
+	worker.client_queue_event = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (worker.client_queue_event == -1)
+	{
+		SERVER_ERROR_LOG_stdlib_err("Unable to create the http worker client queue eventfd!");
+		exit(-1);
+	}
+
+	uint64_t event_data = HTTP_WORKER_EVENT_DATA(HTTP_WORKER_EVENT_LISTENER, 0, worker.client_queue_event);
+
+	#ifndef DISABLE_IO_URING
+	if (worker.io_ring)
+	{
+		if (!IO_Uring_Poll_Multishot(worker.io_ring, worker.client_queue_event, EPOLLIN, event_data))
+		{
+			SERVER_ERROR_LOG_stdlib_err("Unable to add the client queue eventfd to the worker io_uring!");
+			exit(-1);
+		}
+
+		return;
+	}
+	#endif
+
+	struct epoll_event epoll_config;
+	memset(&epoll_config, 0, sizeof(epoll_config)); //suppress valgrind warnings
+	epoll_config.events = EPOLLIN | EPOLLET;
+	epoll_config.data.u64 = event_data;
+
+	if (epoll_ctl(worker.worker_epoll, EPOLL_CTL_ADD, worker.client_queue_event, &epoll_config) == -1)
+	{
+		SERVER_ERROR_LOG_stdlib_err("Unable to add the client queue eventfd to the worker epoll!");
+		exit(-1);
+	}
+}
+
+void HTTP_Worker_Init_File_IO(struct HTTP_WORKER_NODE& worker, const int worker_id)
+{
+	worker.file_io_event = File_IO_Worker_Event(worker_id);
+	if (worker.file_io_event == -1)
+	{
+		return;
+	}
+
+	File_IO_Bind_Worker(worker_id, worker.cpu);
+
+	uint64_t event_data = HTTP_WORKER_EVENT_DATA(HTTP_WORKER_EVENT_LISTENER, 0, worker.file_io_event);
+
+	#ifndef DISABLE_IO_URING
+	if (worker.io_ring)
+	{
+		if (!IO_Uring_Poll_Multishot(worker.io_ring, worker.file_io_event, EPOLLIN, event_data))
+		{
+			SERVER_ERROR_LOG_stdlib_err("Unable to add the file I/O eventfd to the worker io_uring!");
+			exit(-1);
+		}
+
+		return;
+	}
+	#endif
+
+	struct epoll_event epoll_config;
+	memset(&epoll_config, 0, sizeof(epoll_config)); //suppress valgrind warnings
+	epoll_config.events = EPOLLIN | EPOLLET;
+	epoll_config.data.u64 = event_data;
+
+	if (epoll_ctl(worker.worker_epoll, EPOLL_CTL_ADD, worker.file_io_event, &epoll_config) == -1)
+	{
+		SERVER_ERROR_LOG_stdlib_err("Unable to add the file I/O eventfd to the worker epoll!");
+		exit(-1);
+	}
+}
+
 void HTTP_Workers_Init(int close_trigger)
 {
 	size_t num_workers = str2uint(&SERVER_CONFIGURATION["server_workers"]);
 	init_file_access_control_API(num_workers);
 
-	if (is_server_load_balancer_fair)
+	//the counters are allocated once, so the listeners can read them without locking
+	if (posix_memalign((void**) &http_workers_load, alignof(struct HTTP_WORKER_LOAD), num_workers * sizeof(struct HTTP_WORKER_LOAD)) != 0)
+	{
+		SERVER_ERROR_LOG_stdlib_err("Unable to allocate memory for the http worker load counters!");
+		exit(-1);
+	}
+
+	for (size_t i = 0; i < num_workers; i++)
+	{
+		new (&http_workers_load[i]) struct HTTP_WORKER_LOAD(); //zero initialized
+	}
+
+	#ifndef DISABLE_HTTPS
+	if (is_server_worker_listeners_enabled and is_server_config_variable_true("enable_https"))
+	{
+		worker_listeners_openssl_ctx = init_openssl_server_context();
+	}
+	#endif
+
+	//the started workers keep using their entries, the vector is never reallocated under them
+	http_workers.reserve(num_workers);
+
+	std::vector<int> worker_cpus;
+	if (SERVER_CONFIGURATION["worker_cpu_affinity"] != "none")
 	{
-		connections_per_worker = std::vector<std::atomic<int>>(num_workers);
+		CPU_Affinity_Parse(SERVER_CONFIGURATION["worker_cpu_affinity"], &worker_cpus);
 	}
 
 	for (unsigned int i = 0; i < num_workers; i++)
 	{
 		struct HTTP_WORKER_NODE this_worker;
+		this_worker.cpu = worker_cpus.empty() ? -1 : worker_cpus[i % worker_cpus.size()];
+		this_worker.http_listener = -1;
+		this_worker.https_listener = -1;
+		this_worker.draining = false;
+		this_worker.worker_epoll = -1;
+
+		//allocated by the worker thread, once it runs on its cpu
+		this_worker.timeout_wheel = NULL;
+		this_worker.connections = NULL;
+
+		#ifndef DISABLE_IO_URING
+		this_worker.io_ring = NULL;
+		this_worker.recv_buffers = NULL;
+		this_worker.accept_slots = NULL;
+
+		if (server_event_backend == SERVER_EVENT_BACKEND_IO_URING)
+		{
+			this_worker.io_ring = new (std::nothrow) struct IO_URING_RING;
+			if (!this_worker.io_ring)
+			{
+				SERVER_ERROR_LOG_stdlib_err("Unable to allocate memory for the http worker io_uring!");
+				exit(-1);
+			}
+
+			if (!IO_Uring_Init(this_worker.io_ring, IO_URING_WORKER_RING_ENTRIES))
+			{
+				if (i > 0)
+				{
+					SERVER_ERROR_LOG_stdlib_err("Unable to create the http worker io_uring!");
+					exit(-1);
+				}
+
+				//the kernel does not support the required io_uring features
+				SERVER_ERROR_LOG_stdlib_err("Unable to create the http worker io_uring, reverting to epoll!");
+
+				delete (this_worker.io_ring);
+				this_worker.io_ring = NULL;
+
+				server_event_backend = SERVER_EVENT_BACKEND_EPOLL;
+				SERVER_CONFIGURATION["event_backend"] = "epoll";
+			}
+			else if (!IO_Uring_Poll_Multishot(this_worker.io_ring, close_trigger, EPOLLIN, HTTP_WORKER_EVENT_DATA(HTTP_WORKER_EVENT_CLOSE_TRIGGER, 0, 0)))
+			{
+				SERVER_ERROR_LOG_stdlib_err("Unable to add the server close trigger to io_uring!");
+				exit(-1);
+			}
+			else
+			{
+				this_worker.recv_buffers = new (std::nothrow) struct IO_URING_BUFFER_RING;
+				if (!this_worker.recv_buffers)
+				{
+					SERVER_ERROR_LOG_stdlib_err("Unable to allocate memory for the http worker recv buffers!");
+					exit(-1);
+				}
+
+				//the multishot recv came with linux 6.0 like IORING_OP_SEND_ZC, the plain connections are polled like the TLS ones without it
+				if (!IO_Uring_Opcode_Supported(this_worker.io_ring, IORING_OP_SEND_ZC) or
+					!IO_Uring_Buffer_Ring_Init(this_worker.io_ring, this_worker.recv_buffers, IO_URING_WORKER_RECV_BUFFER_GROUP, IO_URING_WORKER_RECV_BUFFERS, IO_URING_WORKER_RECV_BUFFER_SIZE))
+				{
+					delete (this_worker.recv_buffers);
+					this_worker.recv_buffers = NULL;
+				}
+			}
+		}
+		#endif
 
-		this_worker.worker_epoll = epoll_create1(EPOLL_CLOEXEC);
-		if (this_worker.worker_epoll == -1)
+		if (server_event_backend == SERVER_EVENT_BACKEND_EPOLL)
 		{
-			SERVER_ERROR_LOG_stdlib_err("Unable to create the http worker epoll!");
-			exit(-1);
+			this_worker.worker_epoll = epoll_create1(EPOLL_CLOEXEC);
+			if (this_worker.worker_epoll == -1)
+			{
+				SERVER_ERROR_LOG_stdlib_err("Unable to create the http worker epoll!");
+				exit(-1);
+			}
+
+			struct epoll_event epoll_config;
+			epoll_config.events = EPOLLIN | EPOLLET;
+			epoll_config.data.u64 = HTTP_WORKER_EVENT_DATA(HTTP_WORKER_EVENT_CLOSE_TRIGGER, 0, 0);
+
+			if (epoll_ctl(this_worker.worker_epoll, EPOLL_CTL_ADD, close_trigger, &epoll_config) == -1)
+			{
+				SERVER_ERROR_LOG_stdlib_err("Unable to add the server close trigger to epoll!");
+				exit(-1);
+			}
 		}
 
-		struct epoll_event epoll_config;
-		epoll_config.events = EPOLLIN | EPOLLET;
-		epoll_config.data.ptr = 0;
+		this_worker.client_queue = NULL;
+		this_worker.client_queue_event = -1;
 
-		if (epoll_ctl(this_worker.worker_epoll, EPOLL_CTL_ADD, close_trigger, &epoll_config) == -1)
+		if (is_server_worker_listeners_enabled)
 		{
-			SERVER_ERROR_LOG_stdlib_err("Unable to add the server close trigger to epoll!");
-			exit(-1);
+			HTTP_Worker_Init_Listeners(this_worker);
+		}
+		else
+		{
+			HTTP_Worker_Init_Client_Queue(this_worker);
 		}
 
+		HTTP_Worker_Init_File_IO(this_worker, i);
+
 		http_workers.push_back(this_worker);
-		/*
-		create the mutex first, 
-		to avoid locking a non existent mutex
-		*/
-		http_workers[http_workers.size() - 1].connections_mutex = new std::mutex();
-		http_workers[http_workers.size() - 1].worker_thread = new std::thread(http_worker_thread, http_workers.size() - 1);
+		http_workers[i].worker_thread = new std::thread(http_worker_thread, i);
+	}
+
+	if (is_server_config_variable_true("reuseport_cpu_steering"))
+	{
+		HTTP_Worker_Init_CPU_Steering();
 	}
 
 	SERVER_LOG_WRITE_NORMAL.lock();
@@ -561,6 +2149,28 @@ void HTTP_Workers_Join()
 		http_workers[i].worker_thread->join();
 		delete (http_workers[i].worker_thread);
 	}
+
+	//the server listeners can push clients until every worker stopped
+	for (unsigned int i = 0; i < http_workers.size(); i++)
+	{
+		if (http_workers[i].client_queue)
+		{
+			Client_Queue_Free(http_workers[i].client_queue);
+			delete (http_workers[i].client_queue);
+			close(http_workers[i].client_queue_event);
+		}
+	}
+
+	free(http_workers_load);
+	http_workers_load = NULL;
+
+	#ifndef DISABLE_HTTPS
+	if (worker_listeners_openssl_ctx)
+	{
+		SSL_CTX_free(worker_listeners_openssl_ctx);
+		worker_listeners_openssl_ctx = NULL;
+	}
+	#endif
 }
 
 void HTTP_Worker_Init_Aux_Modules(int worker_id)
@@ -2,7 +2,11 @@
 #define __http_worker_incl__
 
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <arpa/inet.h>
 
+#include <string>
+#include <vector>
 #include <thread>
 #include <mutex>
 #include <atomic>
@@ -22,6 +26,12 @@
 #include "http2_stream_processor.h"
 
 #include "request_processor.h"
+#include "timer_wheel.h"
+#include "client_queue.h"
+
+#ifndef DISABLE_IO_URING
+#include "io_uring_api.h"
+#endif
 
 struct GENERIC_HTTP_CONNECTION
 {
@@ -29,9 +39,9 @@ struct GENERIC_HTTP_CONNECTION
 	uint8_t state;
 	bool https;
 
-	std::string remote_addr;
+	char remote_addr[INET6_ADDRSTRLEN];
 	uint16_t remote_port;
-	std::string server_addr;
+	char server_addr[INET6_ADDRSTRLEN];
 	uint16_t server_port;
 
 	int ip_addr_version;
@@ -39,22 +49,119 @@ struct GENERIC_HTTP_CONNECTION
 	int client_sock;
 	#ifndef DISABLE_HTTPS
 	SSL* ssl_wrapper;
+	bool ktls_send; //the TLS records are encrypted by the kernel
+	#endif
+
+	#ifndef DISABLE_IO_URING
+	//the data received by the multishot recv of the worker io_uring, recv_buffers is NULL if the socket is read directly
+	struct IO_URING_BUFFER_RING* recv_buffers;
+	struct IO_URING_BUFFER_QUEUE recv_queue;
+	uint8_t recv_state;
 	#endif
 
 	struct timespec last_action;
-	int milisecond_timeout;
+
+	//scheduled at the deadline of the current state, checked against last_action when it fires
+	struct TIMER_WHEEL_NODE timeout_timer;
+
+	//position in the worker connection table
+	uint32_t slot_id;
+	uint32_t next_free_slot;
+	bool in_use;
+
+	//incremented when the slot is released, tells apart the events of a previous connection
+	uint32_t event_generation;
 
 	void* raw_connection;
 };
 
+#define HTTP_CONNECTION_TABLE_CHUNK_SIZE 256
+#define HTTP_CONNECTION_TABLE_NO_SLOT 0xFFFFFFFF
+
+//connection slots of a worker, allocated in chunks that never move so the connection pointers stay valid
+struct HTTP_CONNECTION_TABLE
+{
+	struct GENERIC_HTTP_CONNECTION** chunks;
+	uint32_t max_chunks;
+	uint32_t allocated_chunks;
+	uint32_t first_free_slot;
+};
+
+//event data layout: 2 bits event type, 1 bit io_uring operation, 29 bits connection generation or accept slot, 32 bits slot id or listener descriptor
+#define HTTP_WORKER_EVENT_CLOSE_TRIGGER 0ULL
+#define HTTP_WORKER_EVENT_LISTENER 1ULL
+#define HTTP_WORKER_EVENT_CONNECTION 2ULL
+#define HTTP_WORKER_EVENT_IGNORED 3ULL
+
+//set on the multishot recv of a connection and on the final send of a closed one, the id is then the slot of its buffer
+#define HTTP_WORKER_EVENT_IO (1ULL << 61)
+
+#define HTTP_WORKER_EVENT_GENERATION_MASK 0x1FFFFFFF
+
+#define HTTP_WORKER_EVENT_DATA(type, generation, id) (((type) << 62) | ((uint64_t)((generation) & HTTP_WORKER_EVENT_GENERATION_MASK) << 32) | (uint32_t)(id))
+#define HTTP_WORKER_EVENT_TYPE(event_data) ((event_data) >> 62)
+#define HTTP_WORKER_EVENT_GENERATION(event_data) ((uint32_t)((event_data) >> 32) & HTTP_WORKER_EVENT_GENERATION_MASK)
+#define HTTP_WORKER_EVENT_ID(event_data) ((uint32_t)(event_data))
+
+//the multishot recv of a connection, paused while too much received data waits to be read and once the client closed
+#define HTTP_CONNECTION_RECV_ARMED 0
+#define HTTP_CONNECTION_RECV_CANCELLING 1
+#define HTTP_CONNECTION_RECV_PAUSED 2
+
+
+#ifndef DISABLE_IO_URING
+//an accept of a worker listener, the kernel writes the peer address into its slot
+struct HTTP_WORKER_ACCEPT_SLOT
+{
+	struct sockaddr_in6 addr;
+	socklen_t addr_size;
+	bool is_armed;
+};
+#endif
 
 struct HTTP_WORKER_NODE
 {
 	std::thread* worker_thread;
-	std::unordered_map<int, struct GENERIC_HTTP_CONNECTION> connections;
-	std::mutex* connections_mutex;
+	struct HTTP_CONNECTION_TABLE* connections;
 	int worker_epoll;
 	char* recv_buffer;
+
+	//connection timeouts, only touched by the worker thread like the connections
+	struct TIMER_WHEEL* timeout_wheel;
+
+	//clients accepted by the server listeners, the eventfd wakes up the worker, NULL and -1 if the worker listeners are used
+	struct CLIENT_QUEUE* client_queue;
+	int client_queue_event;
+
+	//the file loads finished by the I/O threads, -1 if the worker reads the files itself
+	int file_io_event;
+
+	#ifndef DISABLE_IO_URING
+	struct IO_URING_RING* io_ring;
+
+	//the buffers of the multishot recv of the plain connections, NULL if the kernel does not provide them
+	struct IO_URING_BUFFER_RING* recv_buffers;
+
+	//the event data of the connections whose recv is paused
+	std::vector<uint64_t> paused_recvs;
+
+	//the last responses sent together with the close, released by the completion of their send
+	std::vector<std::string*> final_sends;
+	std::vector<uint32_t> free_final_sends;
+
+	//the accepts in flight on the http and then the https listener, the slot index is the generation of their event data
+	struct HTTP_WORKER_ACCEPT_SLOT* accept_slots;
+	#endif
+
+	//the cpu the worker thread is pinned to, -1 if it is not pinned
+	int cpu;
+
+	//listening sockets owned by the worker, -1 if the server listeners are used
+	int http_listener;
+	int https_listener;
+
+	//the listeners were handed over by an upgrade, the worker stops once its connections are done
+	bool draining;
 	
 	#ifndef NO_MOD_MYSQL
 	mysql_connection* mysql_db_handle;
@@ -62,27 +169,39 @@ struct HTTP_WORKER_NODE
 
 };
 
-extern bool is_server_load_balancer_fair;
-extern std::atomic<size_t> total_http_connections;
-extern std::vector<struct HTTP_WORKER_NODE> http_workers;
-extern std::vector<std::atomic<int>> connections_per_worker;
-
-typedef struct
+//load of a worker, each one on its own cache line so the accept bursts do not bounce a shared counter
+struct alignas(64) HTTP_WORKER_LOAD
 {
-	int client_sock;
-	const char *remote_addr;
-	const char *server_addr;
-	uint16_t remote_port; 
-	uint16_t server_port;
-	sa_family_t ip_addr_version; 
-	bool https;
-	#ifndef DISABLE_HTTPS
-	SSL_CTX *openssl_ctx;
-	#endif
-} HTTP_Worker_Add_Client_Parameters;
-
+	std::atomic<int> connections; //clients and HTTP/2 streams
+	std::atomic<int> clients; //compared with max_connections, the streams are not counted
+	std::atomic<int> event_backlog; //events returned by the last wait of the worker
+	std::atomic<uint64_t> config_generation; //runtime config snapshot in use, 0 until the worker is ready
+};
 
-void HTTP_Worker_Add_Client(HTTP_Worker_Add_Client_Parameters& params);
+extern int server_load_balancer_algo;
+extern bool is_server_worker_listeners_enabled;
+extern int server_event_backend;
+extern std::vector<struct HTTP_WORKER_NODE> http_workers;
+extern struct HTTP_WORKER_LOAD* http_workers_load;
+
+//set before the close trigger when the server is replaced by an upgraded binary
+extern std::atomic<bool> is_server_draining;
+
+//the sum of the per worker client counters, compared with max_connections
+int HTTP_Workers_Total_Clients();
+int HTTP_Worker_Select();
+
+//0 if some worker is not ready yet, the older snapshots can be freed
+uint64_t HTTP_Workers_Oldest_Config_Generation();
+
+void HTTP_Worker_Add_Client(const int worker_id, HTTP_Worker_Add_Client_Parameters& params);
+void HTTP_Worker_Insert_Client(const int worker_id, HTTP_Worker_Add_Client_Parameters& params);
+void HTTP_Worker_Receive_Clients(const int worker_id);
+void HTTP_Worker_Init_Listeners(struct HTTP_WORKER_NODE& worker);
+void HTTP_Worker_Init_Client_Queue(struct HTTP_WORKER_NODE& worker);
+void HTTP_Worker_Init_File_IO(struct HTTP_WORKER_NODE& worker, const int worker_id);
+void HTTP_Worker_Receive_File_IO(const int worker_id, const struct timespec& current_time);
+void HTTP_Worker_Init_CPU_Steering();
 void HTTP_Workers_Init(int close_trigger);
 void HTTP_Workers_Join();
 
@@ -90,9 +209,35 @@ void HTTP_Worker_Init_Aux_Modules(int worker_id);
 void HTTP_Worker_Free_Aux_Modules(int worker_id);
 
 int Network_Read_Bytes(struct GENERIC_HTTP_CONNECTION* conn, void *buffer, size_t len);
-int Network_Write_Bytes(struct GENERIC_HTTP_CONNECTION* conn, void *buffer, size_t len);
+int Network_Write_Bytes(struct GENERIC_HTTP_CONNECTION* conn, void *buffer, size_t len, bool more_data = false);
+
+//a single writev on the plain sockets, the TLS connections use Network_Write_Bytes()
+int Network_Write_Vector(struct GENERIC_HTTP_CONNECTION* conn, const struct iovec *iov, int iov_count);
+
+#define NETWORK_SENDFILE_UNSUPPORTED -2
+
+//the file ends before the requested length, it was truncated while it was sent
+#define NETWORK_SENDFILE_EOF -3
+int Network_Sendfile(struct GENERIC_HTTP_CONNECTION* conn, int file_descriptor, int64_t *file_offset, size_t len);
+
+bool HTTP_Connection_Table_Init(struct HTTP_CONNECTION_TABLE* table, uint32_t max_connections);
+void HTTP_Connection_Table_Free(struct HTTP_CONNECTION_TABLE* table);
+//NULL when the table already holds max_connections connections
+struct GENERIC_HTTP_CONNECTION* HTTP_Connection_Table_Insert(struct HTTP_CONNECTION_TABLE* table, const struct GENERIC_HTTP_CONNECTION& conn);
+void HTTP_Connection_Table_Remove(struct HTTP_CONNECTION_TABLE* table, struct GENERIC_HTTP_CONNECTION* conn);
+struct GENERIC_HTTP_CONNECTION* HTTP_Connection_Table_Get(struct HTTP_CONNECTION_TABLE* table, uint64_t event_data);
+
+uint64_t HTTP_Worker_Milliseconds(const struct timespec& time);
+
+uint64_t Generic_Connection_Get_Timeout(struct GENERIC_HTTP_CONNECTION* conn);
+void Generic_Connection_Update_Timer(const int worker_id, struct GENERIC_HTTP_CONNECTION* conn);
+void Generic_Connection_Delete(const int worker_id, struct GENERIC_HTTP_CONNECTION* conn);
 
-void Generic_Connection_Delete(const int worker_id, struct GENERIC_HTTP_CONNECTION* conn, bool lock_mutex = true);
+/*
+the data from offset is sent by the io_uring and the socket closed right after, in the same submission,
+false if the worker reads and writes the socket directly, the data is taken over otherwise
+*/
+bool Generic_Connection_Send_And_Delete(const int worker_id, struct GENERIC_HTTP_CONNECTION* conn, std::string* data, size_t offset);
 
 #endif
 
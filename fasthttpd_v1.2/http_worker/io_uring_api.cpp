@@ -0,0 +1,607 @@
+#include "io_uring_api.h"
+
+#include <new>
+
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/socket.h>
+#include <linux/time_types.h>
+
+
+static int io_uring_setup(unsigned int entries, struct io_uring_params* params)
+{
+	return syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int io_uring_enter(int ring_fd, unsigned int to_submit, unsigned int min_complete, unsigned int flags, void* arg, size_t arg_size)
+{
+	return syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, arg, arg_size);
+}
+
+static int io_uring_register(int ring_fd, unsigned int opcode, void* arg, unsigned int nr_args)
+{
+	return syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr_args);
+}
+
+bool IO_Uring_Init(struct IO_URING_RING* ring, unsigned int entries)
+{
+	memset(ring, 0, sizeof(struct IO_URING_RING));
+
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+
+	ring->ring_fd = io_uring_setup(entries, &params);
+	if (ring->ring_fd == -1)
+	{
+		return false;
+	}
+
+	//the timed wait needs IORING_ENTER_EXT_ARG, the multishot requests must not be dropped on overflow
+	if (!(params.features & IORING_FEAT_EXT_ARG) or !(params.features & IORING_FEAT_NODROP))
+	{
+		close(ring->ring_fd);
+		errno = ENOSYS;
+		return false;
+	}
+
+	ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		if (ring->cq_ring_size > ring->sq_ring_size)
+		{
+			ring->sq_ring_size = ring->cq_ring_size;
+		}
+
+		ring->cq_ring_size = ring->sq_ring_size;
+	}
+
+	ring->sq_ring_ptr = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_SQ_RING);
+	if (ring->sq_ring_ptr == MAP_FAILED)
+	{
+		close(ring->ring_fd);
+		return false;
+	}
+
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		ring->cq_ring_ptr = ring->sq_ring_ptr;
+	}
+	else
+	{
+		ring->cq_ring_ptr = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_CQ_RING);
+		if (ring->cq_ring_ptr == MAP_FAILED)
+		{
+			munmap(ring->sq_ring_ptr, ring->sq_ring_size);
+			close(ring->ring_fd);
+			return false;
+		}
+	}
+
+	ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = (struct io_uring_sqe*) mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED)
+	{
+		if (ring->cq_ring_ptr != ring->sq_ring_ptr)
+		{
+			munmap(ring->cq_ring_ptr, ring->cq_ring_size);
+		}
+
+		munmap(ring->sq_ring_ptr, ring->sq_ring_size);
+		close(ring->ring_fd);
+		return false;
+	}
+
+	char* sq_ring = (char*) ring->sq_ring_ptr;
+	ring->sq_head = (unsigned*) (sq_ring + params.sq_off.head);
+	ring->sq_tail = (unsigned*) (sq_ring + params.sq_off.tail);
+	ring->sq_ring_mask = (unsigned*) (sq_ring + params.sq_off.ring_mask);
+	ring->sq_array = (unsigned*) (sq_ring + params.sq_off.array);
+
+	char* cq_ring = (char*) ring->cq_ring_ptr;
+	ring->cq_head = (unsigned*) (cq_ring + params.cq_off.head);
+	ring->cq_tail = (unsigned*) (cq_ring + params.cq_off.tail);
+	ring->cq_ring_mask = (unsigned*) (cq_ring + params.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe*) (cq_ring + params.cq_off.cqes);
+
+	//the submission slots are used in order, so the indirection array is the identity
+	for (unsigned int i = 0; i < params.sq_entries; i++)
+	{
+		ring->sq_array[i] = i;
+	}
+
+	ring->link_timeouts = new (std::nothrow) struct __kernel_timespec[params.sq_entries];
+	if (!ring->link_timeouts)
+	{
+		IO_Uring_Free(ring);
+		errno = ENOMEM;
+		return false;
+	}
+
+	return true;
+}
+
+void IO_Uring_Free(struct IO_URING_RING* ring)
+{
+	munmap(ring->sqes, ring->sqes_size);
+
+	if (ring->cq_ring_ptr != ring->sq_ring_ptr)
+	{
+		munmap(ring->cq_ring_ptr, ring->cq_ring_size);
+	}
+
+	munmap(ring->sq_ring_ptr, ring->sq_ring_size);
+
+	//closing the ring cancels all the pending requests
+	close(ring->ring_fd);
+	ring->ring_fd = -1;
+
+	delete[] ring->link_timeouts;
+	ring->link_timeouts = NULL;
+}
+
+static struct io_uring_sqe* IO_Uring_Get_SQE(struct IO_URING_RING* ring)
+{
+	unsigned int entries = *ring->sq_ring_mask + 1;
+
+	while (true)
+	{
+		unsigned int head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+		unsigned int tail = *ring->sq_tail;
+
+		if (tail - head < entries)
+		{
+			struct io_uring_sqe* sqe = &ring->sqes[tail & *ring->sq_ring_mask];
+			memset(sqe, 0, sizeof(struct io_uring_sqe));
+			return sqe;
+		}
+
+		//the submission queue is full, hand the pending requests to the kernel
+		int submitted = io_uring_enter(ring->ring_fd, ring->sq_pending, 0, 0, NULL, 0);
+		if (submitted == -1)
+		{
+			if (errno != EINTR and errno != EAGAIN and errno != EBUSY)
+			{
+				return NULL;
+			}
+		}
+		else
+		{
+			ring->sq_pending -= ((unsigned int) submitted > ring->sq_pending) ? ring->sq_pending : submitted;
+		}
+	}
+}
+
+static void IO_Uring_Queue_SQE(struct IO_URING_RING* ring)
+{
+	__atomic_store_n(ring->sq_tail, *ring->sq_tail + 1, __ATOMIC_RELEASE);
+	ring->sq_pending++;
+}
+
+bool IO_Uring_Opcode_Supported(struct IO_URING_RING* ring, uint8_t opcode)
+{
+	//the header is followed by one entry per opcode
+	uint64_t probe_buffer[(sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op)) / sizeof(uint64_t)];
+	memset(probe_buffer, 0, sizeof(probe_buffer));
+
+	struct io_uring_probe* probe = (struct io_uring_probe*) probe_buffer;
+	if (io_uring_register(ring->ring_fd, IORING_REGISTER_PROBE, probe, 256) == -1)
+	{
+		return false;
+	}
+
+	return opcode <= probe->last_op and (probe->ops[opcode].flags & IO_URING_OP_SUPPORTED);
+}
+
+bool IO_Uring_Reserve(struct IO_URING_RING* ring, unsigned int count)
+{
+	unsigned int entries = *ring->sq_ring_mask + 1;
+
+	while (entries - (*ring->sq_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE)) < count)
+	{
+		int submitted = io_uring_enter(ring->ring_fd, ring->sq_pending, 0, 0, NULL, 0);
+		if (submitted == -1)
+		{
+			if (errno != EINTR and errno != EAGAIN and errno != EBUSY)
+			{
+				return false;
+			}
+		}
+		else
+		{
+			ring->sq_pending -= ((unsigned int) submitted > ring->sq_pending) ? ring->sq_pending : submitted;
+		}
+	}
+
+	return true;
+}
+
+void IO_Uring_Set_Last_Flags(struct IO_URING_RING* ring, uint8_t flags)
+{
+	//the kernel reads the request only after the tail is submitted
+	ring->sqes[(*ring->sq_tail - 1) & *ring->sq_ring_mask].flags |= flags;
+}
+
+static void IO_Uring_Buffer_Ring_Publish(struct IO_URING_BUFFER_RING* buffers)
+{
+	//the bufs member of io_uring_buf_ring is misplaced by C++, only its tail is used
+	__atomic_store_n(&((struct io_uring_buf_ring*) buffers->ring)->tail, buffers->tail, __ATOMIC_RELEASE);
+}
+
+bool IO_Uring_Buffer_Ring_Init(struct IO_URING_RING* ring, struct IO_URING_BUFFER_RING* buffers, uint16_t group_id, unsigned int entries, unsigned int buffer_size)
+{
+	memset(buffers, 0, sizeof(struct IO_URING_BUFFER_RING));
+
+	buffers->entries = entries;
+	buffers->buffer_size = buffer_size;
+	buffers->group_id = group_id;
+
+	//the ring must be page aligned, the anonymous mappings are
+	buffers->ring_size = entries * sizeof(struct io_uring_buf);
+	buffers->ring = (struct io_uring_buf*) mmap(NULL, buffers->ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buffers->ring == MAP_FAILED)
+	{
+		return false;
+	}
+
+	buffers->buffers_size = (size_t) entries * buffer_size;
+	buffers->buffers = (char*) mmap(NULL, buffers->buffers_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buffers->buffers == MAP_FAILED)
+	{
+		munmap(buffers->ring, buffers->ring_size);
+		return false;
+	}
+
+	buffers->data_len = new (std::nothrow) uint32_t[entries];
+	buffers->next_buffer = new (std::nothrow) int32_t[entries];
+	if (!buffers->data_len or !buffers->next_buffer)
+	{
+		delete[] buffers->data_len;
+		delete[] buffers->next_buffer;
+		munmap(buffers->buffers, buffers->buffers_size);
+		munmap(buffers->ring, buffers->ring_size);
+		errno = ENOMEM;
+		return false;
+	}
+
+	struct io_uring_buf_reg buffer_reg;
+	memset(&buffer_reg, 0, sizeof(buffer_reg));
+	buffer_reg.ring_addr = (uint64_t) buffers->ring;
+	buffer_reg.ring_entries = entries;
+	buffer_reg.bgid = group_id;
+
+	if (io_uring_register(ring->ring_fd, IORING_REGISTER_PBUF_RING, &buffer_reg, 1) == -1)
+	{
+		delete[] buffers->data_len;
+		delete[] buffers->next_buffer;
+		munmap(buffers->buffers, buffers->buffers_size);
+		munmap(buffers->ring, buffers->ring_size);
+		return false;
+	}
+
+	for (unsigned int i = 0; i < entries; i++)
+	{
+		struct io_uring_buf* buffer = &buffers->ring[i];
+		buffer->addr = (uint64_t) (buffers->buffers + (size_t) i * buffer_size);
+		buffer->len = buffer_size;
+		buffer->bid = i;
+	}
+
+	buffers->tail = entries;
+	IO_Uring_Buffer_Ring_Publish(buffers);
+
+	return true;
+}
+
+void IO_Uring_Buffer_Ring_Free(struct IO_URING_RING* ring, struct IO_URING_BUFFER_RING* buffers)
+{
+	struct io_uring_buf_reg buffer_reg;
+	memset(&buffer_reg, 0, sizeof(buffer_reg));
+	buffer_reg.bgid = buffers->group_id;
+
+	//the ring may be closed already, its buffer rings are unregistered with it
+	if (ring->ring_fd != -1)
+	{
+		io_uring_register(ring->ring_fd, IORING_UNREGISTER_PBUF_RING, &buffer_reg, 1);
+	}
+
+	delete[] buffers->data_len;
+	delete[] buffers->next_buffer;
+	munmap(buffers->buffers, buffers->buffers_size);
+	munmap(buffers->ring, buffers->ring_size);
+}
+
+void IO_Uring_Buffer_Recycle(struct IO_URING_BUFFER_RING* buffers, uint16_t buffer_id)
+{
+	struct io_uring_buf* buffer = &buffers->ring[buffers->tail & (buffers->entries - 1)];
+	buffer->addr = (uint64_t) (buffers->buffers + (size_t) buffer_id * buffers->buffer_size);
+	buffer->len = buffers->buffer_size;
+	buffer->bid = buffer_id;
+
+	buffers->tail++;
+	IO_Uring_Buffer_Ring_Publish(buffers);
+}
+
+void IO_Uring_Buffer_Queue_Init(struct IO_URING_BUFFER_QUEUE* queue)
+{
+	queue->first_buffer = -1;
+	queue->last_buffer = -1;
+	queue->offset = 0;
+	queue->length = 0;
+}
+
+void IO_Uring_Buffer_Queue_Push(struct IO_URING_BUFFER_RING* buffers, struct IO_URING_BUFFER_QUEUE* queue, uint16_t buffer_id, uint32_t len)
+{
+	buffers->data_len[buffer_id] = len;
+	buffers->next_buffer[buffer_id] = -1;
+
+	if (queue->last_buffer == -1)
+	{
+		queue->first_buffer = buffer_id;
+	}
+	else
+	{
+		buffers->next_buffer[queue->last_buffer] = buffer_id;
+	}
+
+	queue->last_buffer = buffer_id;
+	queue->length++;
+
+	buffers->held++;
+}
+
+size_t IO_Uring_Buffer_Queue_Read(struct IO_URING_BUFFER_RING* buffers, struct IO_URING_BUFFER_QUEUE* queue, void* dest, size_t len)
+{
+	size_t read_bytes = 0;
+
+	while (queue->first_buffer != -1 and read_bytes < len)
+	{
+		int32_t buffer_id = queue->first_buffer;
+
+		size_t copy_bytes = buffers->data_len[buffer_id] - queue->offset;
+		if (copy_bytes > len - read_bytes)
+		{
+			copy_bytes = len - read_bytes;
+		}
+
+		memcpy((char*) dest + read_bytes, buffers->buffers + (size_t) buffer_id * buffers->buffer_size + queue->offset, copy_bytes);
+		read_bytes += copy_bytes;
+		queue->offset += copy_bytes;
+
+		if (queue->offset == buffers->data_len[buffer_id])
+		{
+			queue->first_buffer = buffers->next_buffer[buffer_id];
+			queue->offset = 0;
+			queue->length--;
+
+			if (queue->first_buffer == -1)
+			{
+				queue->last_buffer = -1;
+			}
+
+			IO_Uring_Buffer_Recycle(buffers, buffer_id);
+			buffers->held--;
+		}
+	}
+
+	return read_bytes;
+}
+
+void IO_Uring_Buffer_Queue_Clear(struct IO_URING_BUFFER_RING* buffers, struct IO_URING_BUFFER_QUEUE* queue)
+{
+	while (queue->first_buffer != -1)
+	{
+		int32_t buffer_id = queue->first_buffer;
+		queue->first_buffer = buffers->next_buffer[buffer_id];
+
+		IO_Uring_Buffer_Recycle(buffers, buffer_id);
+		buffers->held--;
+	}
+
+	IO_Uring_Buffer_Queue_Init(queue);
+}
+
+int IO_Uring_Submit_And_Wait(struct IO_URING_RING* ring, unsigned int wait_nr, int milisecond_timeout)
+{
+	struct __kernel_timespec timeout;
+	timeout.tv_sec = milisecond_timeout / 1000;
+	timeout.tv_nsec = (milisecond_timeout % 1000) * 1000000;
+
+	struct io_uring_getevents_arg wait_arg;
+	memset(&wait_arg, 0, sizeof(wait_arg));
+	wait_arg.ts = (uint64_t) &timeout;
+
+	unsigned int flags = IORING_ENTER_EXT_ARG;
+	if (wait_nr > 0)
+	{
+		flags |= IORING_ENTER_GETEVENTS;
+	}
+
+	int result = io_uring_enter(ring->ring_fd, ring->sq_pending, wait_nr, flags, &wait_arg, sizeof(wait_arg));
+	if (result == -1)
+	{
+		//timeout, signal or completion queue overflow, the caller simply reaps what is available
+		if (errno == ETIME or errno == EINTR or errno == EAGAIN or errno == EBUSY)
+		{
+			return 0;
+		}
+
+		return -1;
+	}
+
+	ring->sq_pending -= ((unsigned int) result > ring->sq_pending) ? ring->sq_pending : result;
+	return result;
+}
+
+struct io_uring_cqe* IO_Uring_Peek_CQE(struct IO_URING_RING* ring)
+{
+	unsigned int head = *ring->cq_head;
+	unsigned int tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+
+	if (head == tail)
+	{
+		return NULL;
+	}
+
+	return &ring->cqes[head & *ring->cq_ring_mask];
+}
+
+void IO_Uring_CQE_Seen(struct IO_URING_RING* ring)
+{
+	__atomic_store_n(ring->cq_head, *ring->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+bool IO_Uring_Poll_Multishot(struct IO_URING_RING* ring, int fd, uint32_t events, uint64_t user_data)
+{
+	struct io_uring_sqe* sqe = IO_Uring_Get_SQE(ring);
+	if (!sqe)
+	{
+		return false;
+	}
+
+	//without IORING_POLL_ADD_LEVEL the poll is edge triggered, just like the epoll backend
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = fd;
+	sqe->poll32_events = events;
+	sqe->len = IORING_POLL_ADD_MULTI;
+	sqe->user_data = user_data;
+
+	IO_Uring_Queue_SQE(ring);
+	return true;
+}
+
+bool IO_Uring_Poll_Remove(struct IO_URING_RING* ring, uint64_t target_user_data, uint64_t user_data)
+{
+	struct io_uring_sqe* sqe = IO_Uring_Get_SQE(ring);
+	if (!sqe)
+	{
+		return false;
+	}
+
+	sqe->opcode = IORING_OP_POLL_REMOVE;
+	sqe->fd = -1;
+	sqe->addr = target_user_data;
+	sqe->user_data = user_data;
+
+	IO_Uring_Queue_SQE(ring);
+	return true;
+}
+
+bool IO_Uring_Accept(struct IO_URING_RING* ring, int listener, struct sockaddr* addr, socklen_t* addr_size, uint64_t user_data)
+{
+	struct io_uring_sqe* sqe = IO_Uring_Get_SQE(ring);
+	if (!sqe)
+	{
+		return false;
+	}
+
+	//a multishot accept would write every peer address to the same buffer
+	sqe->opcode = IORING_OP_ACCEPT;
+	sqe->fd = listener;
+	sqe->addr = (uint64_t) addr;
+	sqe->addr2 = (uint64_t) addr_size;
+	sqe->accept_flags = SOCK_NONBLOCK;
+	sqe->user_data = user_data;
+
+	IO_Uring_Queue_SQE(ring);
+	return true;
+}
+
+bool IO_Uring_Cancel(struct IO_URING_RING* ring, uint64_t target_user_data, uint64_t user_data)
+{
+	struct io_uring_sqe* sqe = IO_Uring_Get_SQE(ring);
+	if (!sqe)
+	{
+		return false;
+	}
+
+	//the ring holds its own reference to the file, closing the descriptor does not stop a multishot request
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->fd = -1;
+	sqe->addr = target_user_data;
+	sqe->user_data = user_data;
+
+	IO_Uring_Queue_SQE(ring);
+	return true;
+}
+
+bool IO_Uring_Recv_Multishot(struct IO_URING_RING* ring, int fd, uint16_t group_id, uint64_t user_data)
+{
+	struct io_uring_sqe* sqe = IO_Uring_Get_SQE(ring);
+	if (!sqe)
+	{
+		return false;
+	}
+
+	//the kernel picks a buffer of the group for every completion, len 0 lets it fill the whole buffer
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = fd;
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = group_id;
+	sqe->user_data = user_data;
+
+	IO_Uring_Queue_SQE(ring);
+	return true;
+}
+
+bool IO_Uring_Send(struct IO_URING_RING* ring, int fd, const void* buffer, size_t len, int flags, uint64_t user_data)
+{
+	struct io_uring_sqe* sqe = IO_Uring_Get_SQE(ring);
+	if (!sqe)
+	{
+		return false;
+	}
+
+	sqe->opcode = IORING_OP_SEND;
+	sqe->fd = fd;
+	sqe->addr = (uint64_t) buffer;
+	sqe->len = len;
+	sqe->msg_flags = flags;
+	sqe->user_data = user_data;
+
+	IO_Uring_Queue_SQE(ring);
+	return true;
+}
+
+bool IO_Uring_Link_Timeout(struct IO_URING_RING* ring, int milisecond_timeout, uint64_t user_data)
+{
+	struct io_uring_sqe* sqe = IO_Uring_Get_SQE(ring);
+	if (!sqe)
+	{
+		return false;
+	}
+
+	struct __kernel_timespec* timeout = &ring->link_timeouts[*ring->sq_tail & *ring->sq_ring_mask];
+	timeout->tv_sec = milisecond_timeout / 1000;
+	timeout->tv_nsec = (milisecond_timeout % 1000) * 1000000;
+
+	sqe->opcode = IORING_OP_LINK_TIMEOUT;
+	sqe->fd = -1;
+	sqe->addr = (uint64_t) timeout;
+	sqe->len = 1;
+	sqe->user_data = user_data;
+
+	IO_Uring_Queue_SQE(ring);
+	return true;
+}
+
+bool IO_Uring_Close(struct IO_URING_RING* ring, int fd, uint64_t user_data)
+{
+	struct io_uring_sqe* sqe = IO_Uring_Get_SQE(ring);
+	if (!sqe)
+	{
+		return false;
+	}
+
+	sqe->opcode = IORING_OP_CLOSE;
+	sqe->fd = fd;
+	sqe->user_data = user_data;
+
+	IO_Uring_Queue_SQE(ring);
+	return true;
+}
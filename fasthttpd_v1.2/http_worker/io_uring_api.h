@@ -0,0 +1,114 @@
+#ifndef _IO_URING_API_INC__
+#define _IO_URING_API_INC__
+
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/socket.h>
+
+//minimal io_uring wrapper over the raw syscalls, one ring per worker thread
+struct IO_URING_RING
+{
+	int ring_fd;
+
+	unsigned* sq_head;
+	unsigned* sq_tail;
+	unsigned* sq_ring_mask;
+	unsigned* sq_array;
+	struct io_uring_sqe* sqes;
+	unsigned sq_pending;
+
+	unsigned* cq_head;
+	unsigned* cq_tail;
+	unsigned* cq_ring_mask;
+	struct io_uring_cqe* cqes;
+
+	void* sq_ring_ptr;
+	size_t sq_ring_size;
+	void* cq_ring_ptr;
+	size_t cq_ring_size;
+	size_t sqes_size;
+
+	//the timeouts are read by the kernel when the request is submitted, one per submission slot
+	struct __kernel_timespec* link_timeouts;
+};
+
+//the buffers the kernel fills for the multishot recv, the received data stays in them until they are recycled
+struct IO_URING_BUFFER_RING
+{
+	//the entries start with the ring, the tail overlays the reserved field of the first one
+	struct io_uring_buf* ring;
+	size_t ring_size;
+	char* buffers;
+	size_t buffers_size;
+
+	unsigned int entries;
+	unsigned int buffer_size;
+	uint16_t group_id;
+	uint16_t tail;
+
+	unsigned int held; //the buffers waiting in a queue
+
+	//the data length of each buffer and the next buffer of the same queue, -1 at the end
+	uint32_t* data_len;
+	int32_t* next_buffer;
+};
+
+//the received buffers of a socket in arrival order
+struct IO_URING_BUFFER_QUEUE
+{
+	int32_t first_buffer; //-1 if empty
+	int32_t last_buffer;
+	uint32_t offset; //the bytes already read from the first buffer
+	unsigned int length;
+};
+
+bool IO_Uring_Init(struct IO_URING_RING* ring, unsigned int entries);
+void IO_Uring_Free(struct IO_URING_RING* ring);
+
+int IO_Uring_Submit_And_Wait(struct IO_URING_RING* ring, unsigned int wait_nr, int milisecond_timeout);
+
+struct io_uring_cqe* IO_Uring_Peek_CQE(struct IO_URING_RING* ring);
+void IO_Uring_CQE_Seen(struct IO_URING_RING* ring);
+
+bool IO_Uring_Opcode_Supported(struct IO_URING_RING* ring, uint8_t opcode);
+
+//submits the pending requests if less than count slots are free, so a chain of linked requests is never split
+bool IO_Uring_Reserve(struct IO_URING_RING* ring, unsigned int count);
+
+//adds IOSQE_IO_LINK, IOSQE_IO_HARDLINK or IOSQE_CQE_SKIP_SUCCESS to the last queued request
+void IO_Uring_Set_Last_Flags(struct IO_URING_RING* ring, uint8_t flags);
+
+//entries must be a power of 2, every buffer is handed to the kernel
+bool IO_Uring_Buffer_Ring_Init(struct IO_URING_RING* ring, struct IO_URING_BUFFER_RING* buffers, uint16_t group_id, unsigned int entries, unsigned int buffer_size);
+void IO_Uring_Buffer_Ring_Free(struct IO_URING_RING* ring, struct IO_URING_BUFFER_RING* buffers);
+
+//gives a buffer filled by the kernel back to it, without queueing its data
+void IO_Uring_Buffer_Recycle(struct IO_URING_BUFFER_RING* buffers, uint16_t buffer_id);
+
+void IO_Uring_Buffer_Queue_Init(struct IO_URING_BUFFER_QUEUE* queue);
+void IO_Uring_Buffer_Queue_Push(struct IO_URING_BUFFER_RING* buffers, struct IO_URING_BUFFER_QUEUE* queue, uint16_t buffer_id, uint32_t len);
+
+//copies up to len bytes, the emptied buffers go back to the kernel
+size_t IO_Uring_Buffer_Queue_Read(struct IO_URING_BUFFER_RING* buffers, struct IO_URING_BUFFER_QUEUE* queue, void* dest, size_t len);
+void IO_Uring_Buffer_Queue_Clear(struct IO_URING_BUFFER_RING* buffers, struct IO_URING_BUFFER_QUEUE* queue);
+
+bool IO_Uring_Poll_Multishot(struct IO_URING_RING* ring, int fd, uint32_t events, uint64_t user_data);
+bool IO_Uring_Poll_Remove(struct IO_URING_RING* ring, uint64_t target_user_data, uint64_t user_data);
+bool IO_Uring_Cancel(struct IO_URING_RING* ring, uint64_t target_user_data, uint64_t user_data);
+
+//the received data goes to the buffers of the group, the buffer id is in the upper bits of the completion flags
+bool IO_Uring_Recv_Multishot(struct IO_URING_RING* ring, int fd, uint16_t group_id, uint64_t user_data);
+
+//the accepted socket is nonblocking, the peer address is written to addr, which must stay valid until the completion
+bool IO_Uring_Accept(struct IO_URING_RING* ring, int listener, struct sockaddr* addr, socklen_t* addr_size, uint64_t user_data);
+
+//the buffer must stay valid until the completion
+bool IO_Uring_Send(struct IO_URING_RING* ring, int fd, const void* buffer, size_t len, int flags, uint64_t user_data);
+
+//cancels the previous request of the chain if it does not complete in time
+bool IO_Uring_Link_Timeout(struct IO_URING_RING* ring, int milisecond_timeout, uint64_t user_data);
+bool IO_Uring_Close(struct IO_URING_RING* ring, int fd, uint64_t user_data);
+
+#endif
@@ -2,12 +2,17 @@
 #include "http_worker.h"
 #include "http_parser.h"
 #include "hpack_api.h"
+#include "content_cache.h"
+#include "http_compression.h"
+#include "file_io.h"
 
 #include "../server_config.h"
 #include "../server_log.h"
 #include "../custom_bound.h"
 #include "../file_permissions.h"
+#include "../file_cache.h"
 #include "../helper_functions.h"
+#include "../simd_scan.h"
 
 #include <unistd.h>
 #include <fcntl.h>
@@ -16,6 +21,68 @@
 
 #include <cstring>
 #include <cstdlib>
+#include <cstdio>
+
+//the generated bodies, like the custom pages, the directory listings and the error pages, are compressed as a whole
+static void HTTP_Request_Compress_Body(const struct HTTP_REQUEST *request, struct HTTP_RESPONSE *response)
+{
+	if (response->body.empty() or response->code == 206 or response->headers.find("content-encoding") != response->headers.end())
+	{
+		return;
+	}
+
+	auto content_type = response->headers.find("content-type");
+	if (content_type == response->headers.end() or !HTTP_Compression_Is_Compressible(content_type->second, response->body.size()))
+	{
+		return;
+	}
+
+	response->headers["vary"] = "accept-encoding";
+
+	int encoding = HTTP_Compression_Select_Encoding(request);
+	if (encoding == -1)
+	{
+		return;
+	}
+
+	std::string compressed_body;
+	if (!HTTP_Compress(encoding, server_runtime_config->compression_level, response->body.data(), response->body.size(), &compressed_body) or
+	    compressed_body.size() >= response->body.size())
+	{
+		return;
+	}
+
+	response->body.swap(compressed_body);
+	response->headers["content-encoding"] = http_compression_encoding_names[encoding];
+	response->headers["content-length"] = int2str(response->body.size());
+
+	auto etag = response->headers.find("etag");
+	if (etag != response->headers.end() and etag->second.compare(0, 2, "W/") != 0)
+	{
+		etag->second.insert(0, "W/");
+	}
+}
+
+void HTTP_Request_Set_Body_ETag(const struct HTTP_REQUEST *request, struct HTTP_RESPONSE *response)
+{
+	if (response->code != 200 or response->headers.find("etag") != response->headers.end())
+	{
+		return;
+	}
+
+	char etag[24];
+	snprintf(etag, sizeof(etag), "\"%016llx\"", (unsigned long long) SIMD_Hash(response->body.data(), response->body.size()));
+	response->headers["etag"] = etag;
+
+	std::string if_none_match_header;
+	if ((request->method == HTTP_METHOD_GET or request->method == HTTP_METHOD_HEAD) and
+	    HTTP_Request_Get_Header(request, "if-none-match", &if_none_match_header) and HTTP_Match_ETag(if_none_match_header, etag, true))
+	{
+		response->code = 304;
+		response->body.clear();
+		response->headers.erase("content-length");
+	}
+}
 
 int HTTP_Request_Send_Response(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn, const uint32_t stream_id)
 {
@@ -24,11 +91,16 @@ int HTTP_Request_Send_Response(const int worker_id, struct GENERIC_HTTP_CONNECTI
 		struct HTTP2_CONNECTION *http2_conn = (struct HTTP2_CONNECTION*) conn->raw_connection;;
 		struct HTTP2_STREAM *current_stream = &http2_conn->streams[stream_id];
 
+		HTTP_Request_Compress_Body(&current_stream->request, &current_stream->response);
+
 		HPACK_encode_headers(http2_conn->hpack_encoder, &current_stream->response, &current_stream->send_buffer);
 		return HTTP2_Stream_Send_Headers(worker_id, conn, stream_id);
 	}
 	else
 	{
+		struct HTTP1_CONNECTION *http1_conn = (struct HTTP1_CONNECTION*) conn->raw_connection;
+		HTTP_Request_Compress_Body(&http1_conn->request, &http1_conn->response);
+
 		HTTP1_Connection_Generate_Response(conn);
 		return HTTP1_Connection_Send_Data(worker_id, conn);
 	}
@@ -62,7 +134,7 @@ int HTTP_Request_Set_Error_Page(const int worker_id, struct GENERIC_HTTP_CONNECT
 	
 	if (server_error_page_exists(error_code))
 	{
-		http_response->body = SERVER_ERROR_PAGES[error_code];
+		http_response->body = server_runtime_config->error_pages.at(error_code);
 	}
 	else
 	{
@@ -71,13 +143,13 @@ int HTTP_Request_Set_Error_Page(const int worker_id, struct GENERIC_HTTP_CONNECT
 		reason.append(" encountered but no error page found!");
 
 		http_response->code = 500;
-		http_response->body = SERVER_ERROR_PAGES[500];
+		http_response->body = server_runtime_config->error_pages.at(500);
 	}
 
-	str_replace_first(&http_response->body, "$SERVER_NAME", &SERVER_CONFIGURATION["server_name"]);
-	str_replace_first(&http_response->body, "$SERVER_VERSION", &SERVER_CONFIGURATION["server_version"]);
-	str_replace_first(&http_response->body, "$OS_NAME", &SERVER_CONFIGURATION["os_name"]);
-	str_replace_first(&http_response->body, "$OS_VERSION", &SERVER_CONFIGURATION["os_version"]);
+	str_replace_first(&http_response->body, "$SERVER_NAME", &server_runtime_config->server_name);
+	str_replace_first(&http_response->body, "$SERVER_VERSION", &server_runtime_config->server_version);
+	str_replace_first(&http_response->body, "$OS_NAME", &server_runtime_config->os_name);
+	str_replace_first(&http_response->body, "$OS_VERSION", &server_runtime_config->os_version);
 	str_replace_first(&http_response->body, "$SERVER_PORT", int2str(conn->server_port).c_str());
 	str_replace_first(&http_response->body, "$REASON", &reason);
 
@@ -94,13 +166,14 @@ int HTTP_Request_Set_Error_Page(const int worker_id, struct GENERIC_HTTP_CONNECT
 
 	str_replace_first(&http_response->body, "$URL", html_special_chars_escape(&path_url).c_str());
 
-	if (http_request->headers.find("host") == http_request->headers.end())
+	std::string hostname;
+	if (!HTTP_Request_Get_Header(http_request, "host", &hostname))
 	{
-		str_replace_first(&http_response->body, "$HOSTNAME", &SERVER_CONFIGURATION["default_host"]);
+		str_replace_first(&http_response->body, "$HOSTNAME", &server_runtime_config->default_host->hostname);
 	}
 	else
 	{
-		str_replace_first(&http_response->body, "$HOSTNAME", &http_request->headers["host"]);
+		str_replace_first(&http_response->body, "$HOSTNAME", &hostname);
 	}
 
 	if (!conn->https)
@@ -127,6 +200,17 @@ int HTTP_Request_Set_Error_Page(const int worker_id, struct GENERIC_HTTP_CONNECT
 		http_response->headers.erase(last_modified_header_p);
 	}
 
+	http_response->headers.erase("etag");
+
+	//the error page is sent instead of the file, a chosen precompressed copy or range does not describe it
+	http_response->headers.erase("content-encoding");
+	http_response->headers.erase("vary");
+
+	if (http_response->code != 416)
+	{
+		http_response->headers.erase("content-range");
+	}
+
 	SERVER_LOG_REQUEST(conn, stream_id);
 
 	if(conn->http_version == HTTP_VERSION_2)
@@ -245,22 +329,22 @@ int HTTP_Generate_Folder_Response(const int worker_id, struct GENERIC_HTTP_CONNE
 
 	closedir(folder);
 
-	std::string footer = SERVER_CONFIGURATION["server_name"];
-	footer.append("/");
-	footer.append(SERVER_CONFIGURATION["server_version"]);
+	std::string footer = server_runtime_config->server_header;
 	footer.append(" (");
-	footer.append(SERVER_CONFIGURATION["os_name"]);
+	footer.append(server_runtime_config->os_name);
 	footer.append("/");
-	footer.append(SERVER_CONFIGURATION["os_version"]);
+	footer.append(server_runtime_config->os_version);
 	footer.append(") on ");
 
-	if (http_request->headers.find("host") == http_request->headers.end())
+	const char *hostname;
+	size_t hostname_len;
+	if (!HTTP_Request_Find_Header(http_request, "host", &hostname, &hostname_len))
 	{
-		footer.append(SERVER_CONFIGURATION["default_host"]);
+		footer.append(server_runtime_config->default_host->hostname);
 	}
 	else
 	{
-		footer.append(http_request->headers["host"]);
+		footer.append(hostname, hostname_len);
 	}
 
 	footer.append(" port ");
@@ -275,7 +359,7 @@ int HTTP_Generate_Folder_Response(const int worker_id, struct GENERIC_HTTP_CONNE
 	}
 #endif
 
-	http_response->body = SERVER_DIRECTORY_LISTING_TEMPLATE;
+	http_response->body = server_runtime_config->directory_listing_template;
 
 	str_replace_first(&http_response->body, "$top_title", &top_title);
 	str_replace_first(&http_response->body, "$dir_content", &directory_listing_content);
@@ -302,63 +386,57 @@ int HTTP_Generate_Folder_Response(const int worker_id, struct GENERIC_HTTP_CONNE
 	return HTTP_Request_Send_Response(worker_id, conn, stream_id);
 }
 
-int HTTP_Request_Host_Get(struct HTTP_REQUEST *request, struct HTTP_RESPONSE *response, bool strict_hosts, std::string* real_hostname)
+const struct SERVER_HOST_CONFIG* HTTP_Request_Host_Get(struct HTTP_REQUEST *request)
 {
-	if (request->headers.find("host") == request->headers.end())
+	std::string hostname;
+	if (!HTTP_Request_Get_Header(request, "host", &hostname))
 	{
 		SERVER_LOG_WRITE_ERROR.lock();
 		SERVER_LOG_WRITE(SERVER_LOG_strtime(SERVER_LOG_LOCALTIME_REPORTING), true);
 		SERVER_LOG_WRITE(" The request doesn't have a host header!\n\n", true);
 		SERVER_LOG_WRITE_ERROR.unlock();
 
-		if(strict_hosts)
+		if(server_runtime_config->strict_hosts)
 		{
-			return false;
+			return NULL;
 		}
 
-		request->headers["host"] = SERVER_CONFIGURATION["default_host"];
+		request->headers["host"] = server_runtime_config->default_host->hostname;
+		return server_runtime_config->default_host;
 	}
-	
-	*real_hostname = request->headers["host"];
 
-	if (SERVER_HOSTNAMES.find(*real_hostname) == SERVER_HOSTNAMES.end()) // bad host
+	// an unknown host falls back to the default host unless the hosts are strict
+	const struct SERVER_HOST_CONFIG* host = server_config_find_host(hostname);
+	if (!host)
 	{
-		if (strict_hosts)
-		{
-			SERVER_LOG_WRITE_ERROR.lock();
-			SERVER_LOG_WRITE(SERVER_LOG_strtime(SERVER_LOG_LOCALTIME_REPORTING), true);
-			SERVER_LOG_WRITE(" The requested host is not defined in the hosts list!\n\n", true);
-			SERVER_LOG_WRITE_ERROR.unlock();
-
-			return false;
-		}
-		else
-		{
-			*real_hostname = SERVER_CONFIGURATION["default_host"];
-		}
+		SERVER_LOG_WRITE_ERROR.lock();
+		SERVER_LOG_WRITE(SERVER_LOG_strtime(SERVER_LOG_LOCALTIME_REPORTING), true);
+		SERVER_LOG_WRITE(" The requested host is not defined in the hosts list!\n\n", true);
+		SERVER_LOG_WRITE_ERROR.unlock();
 	}
 	
-	return true;
+	return host;
 }
 
 int HTTP_Request_Connection_Header_Process(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn, struct HTTP_REQUEST *request, struct HTTP_RESPONSE *response)
 {
 	if (conn->http_version == HTTP_VERSION_1 or conn->http_version == HTTP_VERSION_1_1)
 	{
-		auto connection_header = request->headers.find("connection");
-		auto upgrade_header = request->headers.find("upgrade");
-		auto http2_settings_header = request->headers.find("http2-settings");
+		std::string connection_header, upgrade_header;
+		bool has_upgrade_header = HTTP_Request_Get_Header(request, "upgrade", &upgrade_header);
+		bool has_http2_settings_header = HTTP_Request_Has_Header(request, "http2-settings");
 
-		if (connection_header == request->headers.end())
+		//the upgraded server takes the next requests of the client
+		if (!HTTP_Request_Get_Header(request, "connection", &connection_header) or http_workers[worker_id].draining)
 		{
 			response->headers["connection"] = "close";
 			return HTTP_CONNECTION_OK;
 		}
 
-		std::string connection_header_val = str_ansi_to_lower(&connection_header->second); //TBD for requests with body
-		if (connection_header_val.find("upgrade") != std::string::npos and upgrade_header != request->headers.end() and http2_settings_header != request->headers.end())
+		std::string connection_header_val = str_ansi_to_lower(&connection_header); //TBD for requests with body
+		if (connection_header_val.find("upgrade") != std::string::npos and has_upgrade_header and has_http2_settings_header)
 		{
-			std::string upgrade_header_val = str_ansi_to_lower(&upgrade_header->second);
+			std::string upgrade_header_val = str_ansi_to_lower(&upgrade_header);
 
 			std::string upgrade_protocol;
 			if (upgrade_header_val.find("h2c") != std::string::npos)
@@ -393,10 +471,7 @@ int HTTP_Request_Connection_Header_Process(const int worker_id, struct GENERIC_H
 		{
 			response->headers["connection"] = "keep-alive";
 
-			std::string keep_alive_value = "timeout=";
-			keep_alive_value.append(SERVER_CONFIGURATION["request_timeout"]);
-
-			response->headers["keep-alive"] = keep_alive_value;
+			response->headers["keep-alive"] = server_runtime_config->keep_alive_header;
 		}
 		else
 		{
@@ -407,6 +482,206 @@ int HTTP_Request_Connection_Header_Process(const int worker_id, struct GENERIC_H
 	return HTTP_CONNECTION_OK;
 }
 
+//the date header changes once per second, so each worker renders it once per second
+static const std::string& HTTP_Request_Current_Date()
+{
+	static thread_local time_t rendered_time = 0;
+	static thread_local std::string rendered_date;
+
+	time_t current_time = time(NULL);
+	if (current_time != rendered_time)
+	{
+		rendered_time = current_time;
+		rendered_date = convert_ctime2_http_date(current_time);
+	}
+
+	return rendered_date;
+}
+
+//the file headers are pre-rendered, only the per request headers are added to them
+static int HTTP_Request_Send_Cached_Content(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn, const uint32_t stream_id, const struct CONTENT_CACHE_ENTRY *cached_content)
+{
+	if(conn->http_version == HTTP_VERSION_2)
+	{
+		struct HTTP2_CONNECTION *http2_conn = (struct HTTP2_CONNECTION*) conn->raw_connection;
+		struct HTTP2_STREAM *current_stream = &http2_conn->streams[stream_id];
+
+		current_stream->response.code = 200;
+		current_stream->state = HTTP2_STREAM_STATE_SEND_HEADERS;
+
+		//the DATA frames point inside the entry, over TLS only if the kernel encrypts the records
+		bool zero_copy = !conn->https;
+
+		#ifndef DISABLE_HTTPS
+		if (conn->https)
+		{
+			zero_copy = conn->ktls_send;
+		}
+		#endif
+
+		//an empty file ends the stream with the headers
+		if (zero_copy and !cached_content->content.empty())
+		{
+			current_stream->cached_content = Content_Cache_Hold(cached_content);
+		}
+		else
+		{
+			current_stream->response.body = cached_content->content;
+		}
+
+		SERVER_LOG_REQUEST(conn, stream_id);
+
+		HPACK_encode_headers(http2_conn->hpack_encoder, &current_stream->response, &current_stream->send_buffer, cached_content->http2_headers.data(), cached_content->http2_headers.size());
+		return HTTP2_Stream_Send_Headers(worker_id, conn, stream_id);
+	}
+
+	struct HTTP1_CONNECTION *http1_conn = (struct HTTP1_CONNECTION*) conn->raw_connection;
+
+	http1_conn->response.code = 200;
+	conn->state = HTTP_STATE_CONTENT_BOUND;
+
+	SERVER_LOG_REQUEST(conn, stream_id);
+
+	HTTP1_Connection_Generate_Cached_Response(conn, cached_content->http1_headers);
+	return HTTP1_Connection_Send_Content(worker_id, conn, cached_content->content);
+}
+
+//the If-Range validator must be the strong ETag of the file or its exact Last-Modified date
+static bool HTTP_Request_Is_Range_Valid(const struct HTTP_REQUEST *request, const struct FILE_CACHE_INFO *file_info)
+{
+	std::string if_range_header;
+	if (!HTTP_Request_Get_Header(request, "if-range", &if_range_header))
+	{
+		return true;
+	}
+
+	if (if_range_header.compare(0, 2, "W/") == 0 or if_range_header.compare(0, 1, "\"") == 0)
+	{
+		return HTTP_Match_ETag(if_range_header, file_info->etag, false);
+	}
+
+	time_t range_time;
+	return convert_http_date2_ctime(&if_range_header, &range_time) and range_time == file_info->last_modified;
+}
+
+//the body of a multipart/byteranges response, returns its length
+static uint64_t HTTP_Request_Set_File_Parts(struct HTTP_FILE_TRANSFER *file_transfer, const std::vector<struct HTTP_BYTE_RANGE> &ranges, const struct FILE_CACHE_INFO *file_info, std::string *boundary)
+{
+	//unique for each response of the worker, the file version keeps it out of the bytes of the file
+	static thread_local uint64_t boundary_counter = 0;
+
+	char boundary_buffer[40];
+	snprintf(boundary_buffer, sizeof(boundary_buffer), "%016llx%016llx", (unsigned long long) SIMD_Hash(file_info->etag.data(), file_info->etag.size()),
+	         (unsigned long long) ++boundary_counter);
+	*boundary = boundary_buffer;
+
+	uint64_t content_length = 0;
+
+	file_transfer->parts.resize(ranges.size() + 1);
+	file_transfer->next_part = 0;
+
+	for (size_t i = 0; i < ranges.size(); i++)
+	{
+		struct HTTP_FILE_PART &part = file_transfer->parts[i];
+
+		part.header = "\r\n--";
+		part.header.append(*boundary);
+		part.header.append("\r\ncontent-type: ");
+		part.header.append(file_info->content_type);
+		part.header.append("\r\ncontent-range: ");
+		part.header.append(HTTP_Encode_Content_Range(ranges[i].start, ranges[i].stop, file_info->size));
+		part.header.append("\r\n\r\n");
+
+		part.file_offset = ranges[i].start;
+		part.stop_offset = ranges[i].stop;
+
+		content_length += part.header.size() + (ranges[i].stop - ranges[i].start);
+	}
+
+	struct HTTP_FILE_PART &closing_part = file_transfer->parts.back();
+	closing_part.header = "\r\n--";
+	closing_part.header.append(*boundary);
+	closing_part.header.append("--\r\n");
+	closing_part.file_offset = 0;
+	closing_part.stop_offset = 0;
+
+	return content_length + closing_part.header.size();
+}
+
+bool HTTP_File_Transfer_Next_Part(struct HTTP_FILE_TRANSFER *file_transfer, std::string *part_header)
+{
+	if (file_transfer->file_offset != file_transfer->stop_offset or file_transfer->next_part == file_transfer->parts.size())
+	{
+		return false;
+	}
+
+	struct HTTP_FILE_PART &part = file_transfer->parts[file_transfer->next_part++];
+	*part_header = part.header;
+
+	file_transfer->file_offset = part.file_offset;
+	file_transfer->stop_offset = part.stop_offset;
+
+	return true;
+}
+
+//the file a request path resolves to, with the result of its access check and its page generator
+struct HTTP_REQUEST_ROUTE
+{
+	std::string full_path;
+	int access_code; //0 if the file can be accessed, otherwise the error code
+	bool is_custom_bound;
+	struct custom_bound_entry custom_page_generator;
+};
+
+/*
+the route of the raw URI path, resolved once per worker and configuration snapshot,
+valid until the next call, the hosts and the page generators belong to the snapshot
+*/
+static const struct HTTP_REQUEST_ROUTE* HTTP_Request_Route_Get(const int worker_id, const struct SERVER_HOST_CONFIG* host, const std::string& URI_path)
+{
+	static thread_local uint64_t routes_generation = 0;
+	static thread_local size_t routes_num = 0;
+	static thread_local std::unordered_map<const struct SERVER_HOST_CONFIG*, std::unordered_map<std::string, struct HTTP_REQUEST_ROUTE>> routes;
+
+	if (routes_generation != server_runtime_config->generation)
+	{
+		routes.clear();
+		routes_num = 0;
+		routes_generation = server_runtime_config->generation;
+	}
+
+	auto host_routes = routes.find(host);
+	if (host_routes != routes.end())
+	{
+		auto route_it = host_routes->second.find(URI_path);
+		if (route_it != host_routes->second.end())
+		{
+			return &route_it->second;
+		}
+	}
+
+	if (routes_num >= HTTP_REQUEST_ROUTE_CACHE_SIZE)
+	{
+		routes.clear();
+		routes_num = 0;
+	}
+
+	std::string relative_path = rectify_path(&URI_path);
+
+	struct HTTP_REQUEST_ROUTE& route = routes[host][URI_path];
+	routes_num++;
+
+	route.full_path = host->document_root;
+	route.full_path.append(1, '/');
+	route.full_path.append(relative_path);
+	route.full_path = rectify_path(&route.full_path);
+
+	route.access_code = check_file_access(worker_id, relative_path, host->document_root);
+	route.is_custom_bound = check_custom_bound_path(route.full_path, &route.custom_page_generator);
+
+	return &route;
+}
+
 int HTTP_Request_Process(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn, const uint32_t stream_id)
 {
 	struct HTTP1_CONNECTION *http1_conn = NULL; 
@@ -439,20 +714,12 @@ int HTTP_Request_Process(const int worker_id, struct GENERIC_HTTP_CONNECTION *co
 	if ((conn->http_version == HTTP_VERSION_2 and current_stream->state == HTTP2_STREAM_STATE_PROCESSING) or 
 	    (conn->http_version != HTTP_VERSION_2 and conn->state == HTTP_STATE_PROCESSING))
 	{
-		http_response->headers["server"] = SERVER_CONFIGURATION["server_name"];
-		http_response->headers["server"].append(1, '/');
-		http_response->headers["server"].append(SERVER_CONFIGURATION["server_version"]);
-
-		http_response->headers["date"] = convert_ctime2_http_date(time(NULL));
+		http_response->headers["server"] = server_runtime_config->server_header;
 
-		bool strict_hosts = true;
-		if (is_server_config_variable_false("strict_hosts"))
-		{
-			strict_hosts = false;
-		}
+		http_response->headers["date"] = HTTP_Request_Current_Date();
 
-		std::string real_hostname;
-		if(!HTTP_Request_Host_Get(http_request, http_response, strict_hosts, &real_hostname))
+		const struct SERVER_HOST_CONFIG* host = HTTP_Request_Host_Get(http_request);
+		if(!host)
 		{
 			return HTTP_Request_Set_Error_Page(worker_id, conn, stream_id, 400);
 		}
@@ -462,25 +729,25 @@ int HTTP_Request_Process(const int worker_id, struct GENERIC_HTTP_CONNECTION *co
 			return HTTP2_CONNECTION_DELETED;
 		}
 
-		http_response->headers["host"] = http_request->headers["host"];
+		HTTP_Request_Get_Header(http_request, "host", &http_response->headers["host"]);
 
-		std::string relative_path = rectify_path(&http_request->URI_path);
-        std::string full_path = SERVER_HOSTNAMES[real_hostname];   
-        full_path.append(1,'/');
-        full_path.append(relative_path);
-        full_path = rectify_path(&full_path);
-		
-		int check_file_code = check_file_access(worker_id, relative_path, SERVER_HOSTNAMES[real_hostname]);
-		if (check_file_code != 0)
+		//a repeated path skips the rectify_path() and check_file_access() calls
+		const struct HTTP_REQUEST_ROUTE* route = HTTP_Request_Route_Get(worker_id, host, http_request->URI_path);
+		const std::string* full_path = &route->full_path;
+
+		if (route->access_code != 0)
 		{
-			return HTTP_Request_Set_Error_Page(worker_id, conn, stream_id, check_file_code);	
+			return HTTP_Request_Set_Error_Page(worker_id, conn, stream_id, route->access_code);
 		}
 
-		struct custom_bound_entry custom_page_generator;
-		if (check_custom_bound_path(full_path, &custom_page_generator))
+		if (route->is_custom_bound)
 		{
+			struct custom_bound_entry custom_page_generator = route->custom_page_generator;
+
 			//parse cookies
-			HTTP_Parse_Cookie_Header(http_request->headers["cookie"], &http_request->COOKIES);
+			std::string cookie_header;
+			HTTP_Request_Get_Header(http_request, "cookie", &cookie_header);
+			HTTP_Parse_Cookie_Header(cookie_header, &http_request->COOKIES);
 
 			//parse the body
 			if(HTTP_Parse_Request_Body(worker_id, conn, stream_id, http_request, http_response))
@@ -513,27 +780,87 @@ int HTTP_Request_Process(const int worker_id, struct GENERIC_HTTP_CONNECTION *co
 			return HTTP_Request_Set_Error_Page(worker_id, conn, stream_id, 405);
 		}
 
-		uint64_t requested_file_size;
-		time_t requested_file_mdate;
-		bool is_folder;
-		if (get_file_info(&full_path, &requested_file_size, &requested_file_mdate, &is_folder) == -1) // get file size and modification date
+		std::shared_ptr<const struct FILE_CACHE_INFO> file_info;
+		if (File_Cache_Get(*full_path, host->document_root, &file_info) == -1) // get file size and modification date
 		{
 			return HTTP_Request_Set_Error_Page(worker_id, conn, stream_id, 404);
 		}
 
-		if (is_folder)
+		if (file_info->is_folder)
 		{
-			return HTTP_Generate_Folder_Response(worker_id, conn, stream_id, &full_path);
+			return HTTP_Generate_Folder_Response(worker_id, conn, stream_id, full_path);
 		}
 
-		http_response->headers["last-modified"] = convert_ctime2_http_date(requested_file_mdate);
-		http_response->headers["content-type"] = get_MIME_type_by_ext(&full_path);
-		http_response->headers["accept-ranges"] = "bytes";
+		//an accepted precompressed copy is sent instead of the file, with the content type of the file
+		std::string precompressed_path;
+		if (file_info->precompressed)
+		{
+			http_response->headers["vary"] = "accept-encoding";
 
-		if (http_request->headers.find("if-modified-since") != http_request->headers.end())
+			int encoding = HTTP_Request_Select_Encoding(http_request, file_cache_encoding_names, FILE_CACHE_ENCODINGS_NUM, file_info->precompressed);
+			if (encoding != -1)
+			{
+				precompressed_path = *full_path + file_cache_encoding_extensions[encoding];
+
+				std::shared_ptr<const struct FILE_CACHE_INFO> precompressed_info;
+				if (File_Cache_Get(precompressed_path, host->document_root, &precompressed_info) == 0 and !precompressed_info->is_folder)
+				{
+					//the shared info of the copy keeps its own content type
+					std::shared_ptr<struct FILE_CACHE_INFO> served_info = std::make_shared<struct FILE_CACHE_INFO>(*precompressed_info);
+					served_info->content_type = file_info->content_type;
+
+					file_info = served_info;
+					full_path = &precompressed_path;
+
+					http_response->headers["content-encoding"] = file_cache_encoding_names[encoding];
+				}
+			}
+		}
+
+		//the text files without a precompressed copy are compressed on the fly, the ranges are served from the file itself
+		const char* conditional_header;
+		size_t conditional_header_len;
+		int compression_encoding = -1;
+
+		if (http_response->headers.find("content-encoding") == http_response->headers.end() and
+		    HTTP_Compression_Is_Compressible(file_info->content_type, file_info->size))
+		{
+			http_response->headers["vary"] = "accept-encoding";
+
+			if (http_request->method == HTTP_METHOD_GET and !HTTP_Request_Find_Header(http_request, "range", &conditional_header, &conditional_header_len))
+			{
+				compression_encoding = HTTP_Compression_Select_Encoding(http_request);
+
+				//HTTP/1.0 only gets the compressed copies kept in memory, the other files are sent as they are
+				if (compression_encoding != -1 and conn->http_version == HTTP_VERSION_1 and !Content_Cache_Is_Eligible(file_info.get(), true))
+				{
+					compression_encoding = -1;
+				}
+			}
+		}
+
+		//a compressed response has other bytes than the file, its ETag can only be weak
+		const std::string* etag = &file_info->etag;
+
+		std::string weak_etag;
+		if (compression_encoding != -1 and etag->compare(0, 2, "W/") != 0)
+		{
+			weak_etag = "W/" + *etag;
+			etag = &weak_etag;
+		}
+
+		//If-None-Match replaces If-Modified-Since when both are sent, the revalidations are answered before the content is looked up
+		bool is_not_modified = false;
+
+		std::string conditional_header_value;
+		if (HTTP_Request_Get_Header(http_request, "if-none-match", &conditional_header_value))
+		{
+			is_not_modified = HTTP_Match_ETag(conditional_header_value, *etag, true);
+		}
+		else if (HTTP_Request_Get_Header(http_request, "if-modified-since", &conditional_header_value))
 		{
 			time_t mod_time;
-			if (!convert_http_date2_ctime(&http_request->headers["if-modified-since"], &mod_time))
+			if (!convert_http_date2_ctime(&conditional_header_value, &mod_time))
 			{
 				SERVER_LOG_WRITE_ERROR.lock();
 				SERVER_LOG_WRITE(SERVER_LOG_strtime(SERVER_LOG_LOCALTIME_REPORTING), true);
@@ -543,60 +870,130 @@ int HTTP_Request_Process(const int worker_id, struct GENERIC_HTTP_CONNECTION *co
 				return HTTP_Request_Set_Error_Page(worker_id, conn, stream_id, 400);
 			}
 
-			if (requested_file_mdate <= mod_time)
-			{
-				http_response->code = 304;
-				
-				if(conn->http_version == HTTP_VERSION_2)
-				{
-					current_stream->state = HTTP2_STREAM_STATE_SEND_HEADERS;
-				}
-				else
-				{
-					conn->state = HTTP_STATE_CONTENT_BOUND;
-				}
+			is_not_modified = file_info->last_modified <= mod_time;
+		}
+
+		if (is_not_modified)
+		{
+			http_response->code = 304;
+			http_response->headers["last-modified"] = file_info->last_modified_date;
+			http_response->headers["etag"] = *etag;
 
-				SERVER_LOG_REQUEST(conn, stream_id);
-				return HTTP_Request_Send_Response(worker_id, conn, stream_id);
+			if(conn->http_version == HTTP_VERSION_2)
+			{
+				current_stream->state = HTTP2_STREAM_STATE_SEND_HEADERS;
 			}
+			else
+			{
+				conn->state = HTTP_STATE_CONTENT_BOUND;
+			}
+
+			SERVER_LOG_REQUEST(conn, stream_id);
+			return HTTP_Request_Send_Response(worker_id, conn, stream_id);
 		}
 
-		if (http_request->headers.find("range") != http_request->headers.end())
+		//the small files are answered from memory, the ranges take the usual path
+		if (http_request->method == HTTP_METHOD_GET and compression_encoding == -1 and Content_Cache_Is_Eligible(file_info.get()) and
+		    !HTTP_Request_Find_Header(http_request, "range", &conditional_header, &conditional_header_len))
 		{
-			int64_t req_start, req_stop;
-			if (!HTTP_Decode_Content_Range(http_request->headers["range"], &req_start, &req_stop))
+			const struct CONTENT_CACHE_ENTRY* cached_content = Content_Cache_Get(worker_id, *full_path, file_info.get());
+			if (!cached_content)
 			{
-				SERVER_LOG_WRITE_ERROR.lock();
-				SERVER_LOG_WRITE(SERVER_LOG_strtime(SERVER_LOG_LOCALTIME_REPORTING), true);
-				SERVER_LOG_WRITE(" The request Range header can't be parsed!\n\n", true);
-				SERVER_LOG_WRITE_ERROR.unlock();
-
-				return HTTP_Request_Set_Error_Page(worker_id, conn, stream_id, 416);
+				cached_content = Content_Cache_Load(*full_path, file_info.get());
 			}
 
-			// some browsers specifiy only the starting offset
-			if (req_stop == -1)
+			if (cached_content)
 			{
-				req_stop = requested_file_size;
+				return HTTP_Request_Send_Cached_Content(worker_id, conn, stream_id, cached_content);
 			}
+		}
 
-			if (req_start >= req_stop or (uint64_t) req_stop > requested_file_size)
+		/*
+		the compressed copy is kept in memory, a large file is compressed by a helper thread,
+		until the copy is ready the file is compressed while it is sent, HTTP/1.0 can not receive it chunked
+		*/
+		bool is_compressed_stream = false;
+		if (compression_encoding != -1)
+		{
+			int compression_level = server_runtime_config->compression_level;
+			const char* content_encoding = http_compression_encoding_names[compression_encoding];
+
+			if (Content_Cache_Is_Eligible(file_info.get(), true))
 			{
-				SERVER_LOG_WRITE_ERROR.lock();
-				SERVER_LOG_WRITE(SERVER_LOG_strtime(SERVER_LOG_LOCALTIME_REPORTING), true);
-				SERVER_LOG_WRITE(" The request Range header is not valid!\n\n", true);
-				SERVER_LOG_WRITE_ERROR.unlock();
+				const struct CONTENT_CACHE_ENTRY* cached_content = Content_Cache_Get(worker_id, *full_path, file_info.get(), content_encoding);
+				if (!cached_content)
+				{
+					if (HTTP_Compression_Is_Inline(file_info.get()))
+					{
+						cached_content = Content_Cache_Load_Compressed(*full_path, file_info.get(), compression_encoding, compression_level);
+					}
+					else
+					{
+						HTTP_Compression_Queue_File(*full_path, file_info.get(), compression_encoding, compression_level);
+					}
+				}
 
-				return HTTP_Request_Set_Error_Page(worker_id, conn, stream_id, 416);
+				if (cached_content)
+				{
+					http_response->headers["content-encoding"] = content_encoding;
+					return HTTP_Request_Send_Cached_Content(worker_id, conn, stream_id, cached_content);
+				}
 			}
 
+			is_compressed_stream = conn->http_version != HTTP_VERSION_1;
+		}
+
+		uint64_t requested_file_size = file_info->size;
+
+		http_response->headers["last-modified"] = file_info->last_modified_date;
+		http_response->headers["etag"] = is_compressed_stream ? *etag : file_info->etag; //the file is sent as it is
+		http_response->headers["content-type"] = file_info->content_type;
+		http_response->headers["accept-ranges"] = "bytes";
+
+		//a resumed download gets the whole file if it changed since the first part
+		std::vector<struct HTTP_BYTE_RANGE> ranges;
+		int range_result = HTTP_RANGE_IGNORED;
+
+		std::string range_header;
+		if (HTTP_Request_Get_Header(http_request, "range", &range_header) and HTTP_Request_Is_Range_Valid(http_request, file_info.get()))
+		{
+			range_result = HTTP_Decode_Byte_Ranges(range_header, requested_file_size, &ranges);
+		}
+
+		if (range_result == HTTP_RANGE_NOT_SATISFIABLE)
+		{
+			SERVER_LOG_WRITE_ERROR.lock();
+			SERVER_LOG_WRITE(SERVER_LOG_strtime(SERVER_LOG_LOCALTIME_REPORTING), true);
+			SERVER_LOG_WRITE(" The request Range header is not valid!\n\n", true);
+			SERVER_LOG_WRITE_ERROR.unlock();
+
+			http_response->headers["content-range"] = "bytes */" + int2str(requested_file_size);
+			return HTTP_Request_Set_Error_Page(worker_id, conn, stream_id, 416);
+		}
+
+		if (range_result == HTTP_RANGE_SATISFIABLE and ranges.size() == 1)
+		{
 			http_response->code = 206;
 
-			http_response->headers["content-range"] = HTTP_Encode_Content_Range(req_start, req_stop, requested_file_size);
-			http_response->headers["content-length"] = int2str(req_stop - req_start);
+			http_response->headers["content-range"] = HTTP_Encode_Content_Range(ranges[0].start, ranges[0].stop, requested_file_size);
+			http_response->headers["content-length"] = int2str(ranges[0].stop - ranges[0].start);
 
-			http_file_transfer->file_offset = req_start;
-			http_file_transfer->stop_offset = req_stop;
+			http_file_transfer->file_offset = ranges[0].start;
+			http_file_transfer->stop_offset = ranges[0].stop;
+		}
+		else if (range_result == HTTP_RANGE_SATISFIABLE)
+		{
+			http_response->code = 206;
+
+			//the parts are sent from the file one after the other, the transfer starts with the header of the first one
+			std::string boundary;
+			uint64_t content_length = HTTP_Request_Set_File_Parts(http_file_transfer, ranges, file_info.get(), &boundary);
+
+			http_response->headers["content-type"] = "multipart/byteranges; boundary=" + boundary;
+			http_response->headers["content-length"] = int2str(content_length);
+
+			http_file_transfer->file_offset = 0;
+			http_file_transfer->stop_offset = 0;
 		}
 		else 
 		{
@@ -623,17 +1020,51 @@ int HTTP_Request_Process(const int worker_id, struct GENERIC_HTTP_CONNECTION *co
 			return HTTP_Request_Send_Response(worker_id, conn, stream_id);
 		}
 
-		http_file_transfer->file_descriptor = open(full_path.c_str(), O_RDONLY | O_CLOEXEC);
+		http_file_transfer->file_descriptor = File_Cache_Open(*full_path);
 		if (http_file_transfer->file_descriptor == -1)
 		{
 			std::string error_msg = "The server is unable to open the following resource!\nPath: ";
-			error_msg.append(full_path);
+			error_msg.append(*full_path);
 
 			SERVER_ERROR_LOG_stdlib_err(error_msg.c_str());
 
 			return HTTP_Request_Set_Error_Page(worker_id, conn, stream_id, 500);
 		}
 
+		File_IO_Advise_Transfer(http_file_transfer);
+		http_file_transfer->nowait_reads = true;
+
+		//send the file with sendfile(), over TLS only if the kernel encrypts the records
+		http_file_transfer->zero_copy = !conn->https;
+
+		#ifndef DISABLE_HTTPS
+		if (conn->https)
+		{
+			http_file_transfer->zero_copy = conn->ktls_send;
+		}
+		#endif
+
+		//the length of the compressed stream is known only at its end
+		if (is_compressed_stream)
+		{
+			http_file_transfer->compressor = HTTP_Compressor_Create(compression_encoding, server_runtime_config->compression_level);
+		}
+
+		if (http_file_transfer->compressor)
+		{
+			http_file_transfer->zero_copy = false;
+
+			http_response->headers["content-encoding"] = http_compression_encoding_names[compression_encoding];
+
+			http_response->headers.erase("content-length");
+			http_response->headers.erase("accept-ranges");
+
+			if (conn->http_version != HTTP_VERSION_2)
+			{
+				http_response->headers["transfer-encoding"] = "chunked";
+			}
+		}
+
 		if (conn->http_version == HTTP_VERSION_2)
 		{
 			current_stream->state = HTTP2_STREAM_STATE_FILE_BOUND;
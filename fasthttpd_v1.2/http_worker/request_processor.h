@@ -3,9 +3,18 @@
 
 #include "http2_core.h"
 
+//the resolved request paths remembered by each worker, the whole cache is dropped when it is full
+#define HTTP_REQUEST_ROUTE_CACHE_SIZE 4096
+
 int HTTP_Request_Set_Error_Page(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn, const uint32_t stream_id, const int error_code, std::string reason = "");
 int HTTP_Request_Process(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn, const uint32_t stream_id);
 
 int HTTP_Request_Send_Response(const int worker_id, struct GENERIC_HTTP_CONNECTION *conn, const uint32_t stream_id);
 
+//sets the ETag of a generated 200 response to the hash of its body, a GET or HEAD request that already has it gets a 304 without the body
+void HTTP_Request_Set_Body_ETag(const struct HTTP_REQUEST *request, struct HTTP_RESPONSE *response);
+
+//moves a multipart/byteranges transfer to its next part once the current range is sent, the header of the part replaces part_header, false when there is none
+bool HTTP_File_Transfer_Next_Part(struct HTTP_FILE_TRANSFER *file_transfer, std::string *part_header);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,135 @@
+#include "timer_wheel.h"
+
+#include <stddef.h>
+
+static void Timer_Wheel_Link(struct TIMER_WHEEL_NODE* slot, struct TIMER_WHEEL_NODE* node)
+{
+	node->prev = slot->prev;
+	node->next = slot;
+	slot->prev->next = node;
+	slot->prev = node;
+}
+
+static void Timer_Wheel_Place(struct TIMER_WHEEL* wheel, struct TIMER_WHEEL_NODE* node)
+{
+	uint64_t delta = node->expire_tick - wheel->current_tick;
+
+	//the level is chosen by the distance, the slot by the expire tick bits of that level
+	int level = 0;
+	while (level < TIMER_WHEEL_LEVELS - 1 and delta >= (1ULL << ((level + 1) * TIMER_WHEEL_LEVEL_BITS)))
+	{
+		level++;
+	}
+
+	size_t slot = (node->expire_tick >> (level * TIMER_WHEEL_LEVEL_BITS)) & TIMER_WHEEL_SLOT_MASK;
+	Timer_Wheel_Link(&wheel->slots[level][slot], node);
+}
+
+uint64_t Timer_Wheel_Milliseconds_To_Tick(uint64_t milliseconds)
+{
+	return milliseconds / TIMER_WHEEL_TICK_MS;
+}
+
+void Timer_Wheel_Init(struct TIMER_WHEEL* wheel, uint64_t current_milliseconds)
+{
+	wheel->current_tick = Timer_Wheel_Milliseconds_To_Tick(current_milliseconds);
+
+	for (int level = 0; level < TIMER_WHEEL_LEVELS; level++)
+	{
+		for (int slot = 0; slot < TIMER_WHEEL_SLOTS; slot++)
+		{
+			//an empty slot is a sentinel linked to itself
+			wheel->slots[level][slot].prev = &wheel->slots[level][slot];
+			wheel->slots[level][slot].next = &wheel->slots[level][slot];
+			wheel->slots[level][slot].data = NULL;
+		}
+	}
+}
+
+void Timer_Wheel_Node_Init(struct TIMER_WHEEL_NODE* node, void* data)
+{
+	node->prev = NULL;
+	node->next = NULL;
+	node->expire_tick = 0;
+	node->data = data;
+}
+
+bool Timer_Wheel_Node_Is_Armed(const struct TIMER_WHEEL_NODE* node)
+{
+	return node->next != NULL;
+}
+
+void Timer_Wheel_Add(struct TIMER_WHEEL* wheel, struct TIMER_WHEEL_NODE* node, uint64_t expire_milliseconds)
+{
+	Timer_Wheel_Remove(node);
+
+	uint64_t expire_tick = Timer_Wheel_Milliseconds_To_Tick(expire_milliseconds);
+
+	//the current slot is already processed, the earliest possible expiration is the next tick
+	if (expire_tick <= wheel->current_tick)
+	{
+		expire_tick = wheel->current_tick + 1;
+	}
+	else if (expire_tick - wheel->current_tick > TIMER_WHEEL_MAX_TICKS)
+	{
+		expire_tick = wheel->current_tick + TIMER_WHEEL_MAX_TICKS;
+	}
+
+	node->expire_tick = expire_tick;
+	Timer_Wheel_Place(wheel, node);
+}
+
+void Timer_Wheel_Remove(struct TIMER_WHEEL_NODE* node)
+{
+	if (!Timer_Wheel_Node_Is_Armed(node))
+	{
+		return;
+	}
+
+	node->prev->next = node->next;
+	node->next->prev = node->prev;
+
+	node->prev = NULL;
+	node->next = NULL;
+}
+
+void Timer_Wheel_Advance(struct TIMER_WHEEL* wheel, uint64_t current_milliseconds, std::vector<void*>* expired)
+{
+	uint64_t target_tick = Timer_Wheel_Milliseconds_To_Tick(current_milliseconds);
+
+	while (wheel->current_tick < target_tick)
+	{
+		wheel->current_tick++;
+
+		//when a level wraps, the next slot of the coarser level is spread over the finer levels
+		for (int level = 1; level < TIMER_WHEEL_LEVELS; level++)
+		{
+			uint64_t lower_bits = wheel->current_tick & ((1ULL << (level * TIMER_WHEEL_LEVEL_BITS)) - 1);
+			if (lower_bits != 0)
+			{
+				break;
+			}
+
+			struct TIMER_WHEEL_NODE* slot = &wheel->slots[level][(wheel->current_tick >> (level * TIMER_WHEEL_LEVEL_BITS)) & TIMER_WHEEL_SLOT_MASK];
+			struct TIMER_WHEEL_NODE* node = slot->next;
+
+			slot->prev = slot;
+			slot->next = slot;
+
+			while (node != slot)
+			{
+				struct TIMER_WHEEL_NODE* next_node = node->next;
+				Timer_Wheel_Place(wheel, node);
+				node = next_node;
+			}
+		}
+
+		struct TIMER_WHEEL_NODE* slot = &wheel->slots[0][wheel->current_tick & TIMER_WHEEL_SLOT_MASK];
+		while (slot->next != slot)
+		{
+			struct TIMER_WHEEL_NODE* node = slot->next;
+			Timer_Wheel_Remove(node);
+			expired->push_back(node->data);
+		}
+	}
+}
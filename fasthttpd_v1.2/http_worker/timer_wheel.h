@@ -0,0 +1,44 @@
+#ifndef __timer_wheel_incl__
+#define __timer_wheel_incl__
+
+#include <stdint.h>
+#include <vector>
+
+#define TIMER_WHEEL_TICK_MS 100
+#define TIMER_WHEEL_LEVELS 3
+#define TIMER_WHEEL_LEVEL_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_LEVEL_BITS)
+#define TIMER_WHEEL_SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+
+//the longest delay that can be scheduled, about 7 hours with 100 ms ticks
+#define TIMER_WHEEL_MAX_TICKS ((1ULL << (TIMER_WHEEL_LEVELS * TIMER_WHEEL_LEVEL_BITS)) - 1)
+
+//embedded in the object that owns the timer, linked into one of the wheel slots
+struct TIMER_WHEEL_NODE
+{
+	struct TIMER_WHEEL_NODE* prev;
+	struct TIMER_WHEEL_NODE* next;
+	uint64_t expire_tick;
+	void* data;
+};
+
+//hierarchical timing wheel, every level is TIMER_WHEEL_SLOTS times coarser than the previous one
+struct TIMER_WHEEL
+{
+	uint64_t current_tick;
+	struct TIMER_WHEEL_NODE slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+};
+
+uint64_t Timer_Wheel_Milliseconds_To_Tick(uint64_t milliseconds);
+
+void Timer_Wheel_Init(struct TIMER_WHEEL* wheel, uint64_t current_milliseconds);
+void Timer_Wheel_Node_Init(struct TIMER_WHEEL_NODE* node, void* data);
+
+bool Timer_Wheel_Node_Is_Armed(const struct TIMER_WHEEL_NODE* node);
+void Timer_Wheel_Add(struct TIMER_WHEEL* wheel, struct TIMER_WHEEL_NODE* node, uint64_t expire_milliseconds);
+void Timer_Wheel_Remove(struct TIMER_WHEEL_NODE* node);
+
+//moves the wheel to the current time and collects the data of the expired nodes, the nodes are unlinked
+void Timer_Wheel_Advance(struct TIMER_WHEEL* wheel, uint64_t current_milliseconds, std::vector<void*>* expired);
+
+#endif
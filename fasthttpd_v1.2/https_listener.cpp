@@ -73,7 +73,7 @@ static int openssl_ALPN_select_callback(SSL *ssl, const unsigned char **out, uns
 	return SSL_TLSEXT_ERR_OK;
 }
 
-void https_listener_main(int SERVER_CLOSE_TRIGGER)
+SSL_CTX* init_openssl_server_context()
 {
 	SSL_load_error_strings();
 	OpenSSL_add_ssl_algorithms();
@@ -115,6 +115,17 @@ void https_listener_main(int SERVER_CLOSE_TRIGGER)
 		exit(-1);
 	}
 
+	//let the kernel encrypt the TLS records, OpenSSL keeps using the userspace path if the kernel lacks the TLS ULP
+	if (is_server_config_variable_true("enable_ktls"))
+	{
+	#ifdef SSL_OP_ENABLE_KTLS
+		SSL_CTX_set_options(openssl_ctx, SSL_OP_ENABLE_KTLS);
+	#else
+		SERVER_LOG_WRITE(SERVER_LOG_strtime(SERVER_LOG_LOCALTIME_REPORTING),true); 
+		SERVER_LOG_WRITE(" Kernel TLS is enabled but the OpenSSL library does not support it!\n\n",true);
+	#endif
+	}
+
 	//advertised TLS ALPN extensions
     unsigned char ALPN_vec[] = {8, 'h', 't', 't', 'p', '/', '1', '.', '1', 3, 'h', '2', 'c', 2, 'h', '2'};
  	unsigned int ALPN_vec_len = sizeof(ALPN_vec);
@@ -125,12 +136,13 @@ void https_listener_main(int SERVER_CLOSE_TRIGGER)
  	}
 
 	SSL_CTX_set_alpn_select_cb(openssl_ctx, openssl_ALPN_select_callback, NULL);
-	
-	int HTTPS_LISTENER = init_server_listener_socket(true);
-	if(HTTPS_LISTENER == -1)
-	{
-		exit(-1);
-	}
+
+	return openssl_ctx;
+}
+
+void https_listener_main(int HTTPS_LISTENER, int SERVER_CLOSE_TRIGGER)
+{
+	SSL_CTX* openssl_ctx = init_openssl_server_context();
 
 	int SERVER_HTTPS_EPOLL = init_server_listener_epoll(HTTPS_LISTENER, SERVER_CLOSE_TRIGGER);
 	if(SERVER_HTTPS_EPOLL == -1)
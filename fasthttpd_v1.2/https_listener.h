@@ -1,7 +1,10 @@
 #ifndef __https_listener_incl__
 #define __https_listener_incl__
 
-void https_listener_main(int);
+#include <openssl/ssl.h>
+
+SSL_CTX* init_openssl_server_context();
+void https_listener_main(int, int);
 
 int get_openssl_error_callback(const char *str, size_t len, void *u);
 
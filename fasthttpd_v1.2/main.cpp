@@ -11,11 +11,19 @@
 #endif 
 
 #include "helper_functions.h"
+#include "simd_scan.h"
+#include "cpu_affinity.h"
 #include "server_config.h"
 #include "server_log.h"
 #include "server_listener.h"
 #include "custom_bound.h"
+#include "server_upgrade.h"
+#include "file_cache.h"
+#include "mime_types.h"
 #include "http_worker/http_worker.h"
+#include "http_worker/content_cache.h"
+#include "http_worker/http_compression.h"
+#include "http_worker/file_io.h"
 
 #include <unistd.h>
 #include <sys/resource.h>
@@ -33,14 +41,57 @@ void terminate_signal_handler(int)
         }
 }
 
-void http_listener_main(int SERVER_CLOSE_TRIGGER)
+int SERVER_RELOAD_TRIGGER;
+void reload_signal_handler(int)
 {
-	int HTTP_LISTENER = init_server_listener_socket();
-	if(HTTP_LISTENER == -1)
+	eventfd_t event_data = 1;
+	if(eventfd_write(SERVER_RELOAD_TRIGGER, event_data) == -1)
 	{
+		SERVER_ERROR_LOG_stdlib_err("Failed to trigger the server reload eventfd!");
 		exit(-1);
 	}
+}
+
+int SERVER_UPGRADE_TRIGGER;
+void upgrade_signal_handler(int)
+{
+	eventfd_t event_data = 1;
+	if(eventfd_write(SERVER_UPGRADE_TRIGGER, event_data) == -1)
+	{
+		SERVER_ERROR_LOG_stdlib_err("Failed to trigger the server upgrade eventfd!");
+		exit(-1);
+	}
+}
+
+//builds a runtime config snapshot from the loaded configuration and hands it to the workers
+void publish_server_config()
+{
+	struct SERVER_RUNTIME_CONFIG* runtime_config = build_server_runtime_config();
+	build_custom_bound_table(runtime_config);
+	publish_server_runtime_config(runtime_config);
+}
+
+//the content cache counters, written on each reload and at shutdown
+void log_content_cache_stats()
+{
+	uint64_t hits, misses;
+	size_t used_memory;
+	Content_Cache_Get_Stats(&hits, &misses, &used_memory);
+
+	SERVER_LOG_WRITE_NORMAL.lock();
+	SERVER_LOG_WRITE(SERVER_LOG_strtime(SERVER_LOG_LOCALTIME_REPORTING));
+	SERVER_LOG_WRITE(" Content cache hits: ");
+	SERVER_LOG_WRITE(hits);
+	SERVER_LOG_WRITE("\nContent cache misses: ");
+	SERVER_LOG_WRITE(misses);
+	SERVER_LOG_WRITE("\nContent cache memory: ");
+	SERVER_LOG_WRITE(used_memory / 1024);
+	SERVER_LOG_WRITE(" KB\n\n");
+	SERVER_LOG_WRITE_NORMAL.unlock();
+}
 
+void http_listener_main(int HTTP_LISTENER, int SERVER_CLOSE_TRIGGER)
+{
 	int SERVER_HTTP_EPOLL = init_server_listener_epoll(HTTP_LISTENER, SERVER_CLOSE_TRIGGER);
 	if(SERVER_HTTP_EPOLL == -1)
 	{
@@ -63,14 +114,10 @@ void http_listener_main(int SERVER_CLOSE_TRIGGER)
 
 int main(int argc, char** argv)
 {
-	if(argc >= 2)
-	{
-		load_server_config(argv[1]);
-	}
-	else
-	{
-		load_server_config(NULL);
-	}
+	SIMD_Scan_Init();
+
+	char* config_file = (argc >= 2) ? argv[1] : NULL;
+	load_server_config(config_file);
 
 	#ifndef NO_MOD_MYSQL
 	if(mysql_library_init(0,NULL,NULL) != 0)
@@ -114,7 +161,32 @@ int main(int argc, char** argv)
 		}
 	}
 
-	load_custom_bound_paths();
+	publish_server_config();
+
+	//the types of the file are added to the built-in ones
+	std::string mime_types_file = server_config_variable_exists("mime_types_file") ? SERVER_CONFIGURATION["mime_types_file"] : "";
+	if(!MIME_Types_Init(mime_types_file))
+	{
+		SERVER_ERROR_LOG_stdlib_err(3, "Unable to read the MIME types file ( ", mime_types_file.c_str(), " ), only the built-in types are used!");
+	}
+
+	if(!File_Cache_Init(str2uint(SERVER_CONFIGURATION["max_file_cache_size"])))
+	{
+		SERVER_ERROR_LOG_stdlib_err("Unable to create the file cache inotify, the file cache is disabled!");
+	}
+
+	//the cached contents are checked against the file cache, they can not be used without it
+	if(File_Cache_Notify_Descriptor() != -1)
+	{
+		Content_Cache_Init(str2uint(SERVER_CONFIGURATION["hot_content_cache_size"]) * 1024 * 1024, str2uint(SERVER_CONFIGURATION["max_hot_file_size"]) * 1024,
+		                   str2uint(SERVER_CONFIGURATION["max_compressed_file_size"]) * 1024, str2uint(SERVER_CONFIGURATION["server_workers"]));
+
+		//the helpers fill the content cache with the compressed copies of the large files
+		HTTP_Compression_Init(str2uint(SERVER_CONFIGURATION["compression_threads"]));
+	}
+
+	//the listening sockets of the previous binary, when started by an upgrade
+	Server_Upgrade_Load_Inherited_Listeners();
 
 	SERVER_CLOSE_TRIGGER = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
 	if(SERVER_CLOSE_TRIGGER == -1)
@@ -123,26 +195,90 @@ int main(int argc, char** argv)
 		return -1;
 	}
 
+	SERVER_RELOAD_TRIGGER = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if(SERVER_RELOAD_TRIGGER == -1)
+	{
+        SERVER_ERROR_LOG_stdlib_err("Unable to create the server reload trigger!");
+		return -1;
+	}
+
+	if(signal(SIGHUP, reload_signal_handler) == SIG_ERR)
+	{
+		SERVER_ERROR_LOG_stdlib_err("Unable to register the reload signal handler!");
+		return -1;
+	}
+
+	SERVER_UPGRADE_TRIGGER = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if(SERVER_UPGRADE_TRIGGER == -1)
+	{
+        SERVER_ERROR_LOG_stdlib_err("Unable to create the server upgrade trigger!");
+		return -1;
+	}
+
+	if(signal(SIGUSR2, upgrade_signal_handler) == SIG_ERR)
+	{
+		SERVER_ERROR_LOG_stdlib_err("Unable to register the upgrade signal handler!");
+		return -1;
+	}
+
+	//the cold file chunks are read by the I/O threads of each NUMA node
+	File_IO_Init(str2uint(SERVER_CONFIGURATION["file_io_threads"]), str2uint(SERVER_CONFIGURATION["server_workers"]));
+
 	HTTP_Workers_Init(SERVER_CLOSE_TRIGGER);
 
+	//the workers accept the new clients by themselves
+	size_t num_listener_threads = is_server_worker_listeners_enabled ? 0 : str2uint(SERVER_CONFIGURATION["server_listeners"]);
+
+	std::vector<int> listener_cpus;
+	if(SERVER_CONFIGURATION["listener_cpu_affinity"] != "none")
+	{
+		CPU_Affinity_Parse(SERVER_CONFIGURATION["listener_cpu_affinity"], &listener_cpus);
+	}
+
+	//the sockets are created before the threads, so they are known to the upgrade
 	std::vector<std::thread*> http_listener_threads;
-	for(size_t i = 0; i < str2uint(SERVER_CONFIGURATION["server_listeners"]); i++)
+	for(size_t i = 0; i < num_listener_threads; i++)
 	{
-		http_listener_threads.push_back(new std::thread(http_listener_main, SERVER_CLOSE_TRIGGER));
+		int http_listener = init_server_listener_socket();
+		if(http_listener == -1)
+		{
+			return -1;
+		}
+
+		http_listener_threads.push_back(new std::thread(http_listener_main, http_listener, SERVER_CLOSE_TRIGGER));
+
+		if(!listener_cpus.empty() and !CPU_Affinity_Pin_Thread(http_listener_threads.back(), listener_cpus[i % listener_cpus.size()]))
+		{
+			SERVER_ERROR_LOG_stdlib_err("Unable to pin the http listener to its cpu!");
+		}
 	}
 
 	#ifndef DISABLE_HTTPS
 	std::vector<std::thread*> https_listener_threads;
 	if(is_server_config_variable_true("enable_https"))
 	{
-		for(size_t i = 0; i < str2uint(SERVER_CONFIGURATION["server_listeners"]); i++)
+		for(size_t i = 0; i < num_listener_threads; i++)
 		{
-			https_listener_threads.push_back(new std::thread(https_listener_main, SERVER_CLOSE_TRIGGER));
+			int https_listener = init_server_listener_socket(true);
+			if(https_listener == -1)
+			{
+				return -1;
+			}
+
+			https_listener_threads.push_back(new std::thread(https_listener_main, https_listener, SERVER_CLOSE_TRIGGER));
+
+			if(!listener_cpus.empty() and !CPU_Affinity_Pin_Thread(https_listener_threads.back(), listener_cpus[i % listener_cpus.size()]))
+			{
+				SERVER_ERROR_LOG_stdlib_err("Unable to pin the https listener to its cpu!");
+			}
 		}
 	}
 	#endif
+
+	//every listener is open, the previous binary can stop accepting
+	Server_Upgrade_Notify_Ready();
 	
-	//init a epoll to wait for the close event
+	//init a epoll to wait for the close, reload and upgrade events
 	int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
 	if(epoll_fd == -1)
 	{
@@ -162,10 +298,56 @@ int main(int argc, char** argv)
 		return -1;
 	}
 
+	epoll_config.events = EPOLLIN;
+	epoll_config.data.fd = SERVER_RELOAD_TRIGGER;
+
+	if(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, SERVER_RELOAD_TRIGGER,&epoll_config) == -1)
+	{	
+        SERVER_ERROR_LOG_stdlib_err("Unable to add the server reload trigger to epoll!");
+		return -1;
+	}
+
+	epoll_config.events = EPOLLIN;
+	epoll_config.data.fd = SERVER_UPGRADE_TRIGGER;
+
+	if(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, SERVER_UPGRADE_TRIGGER,&epoll_config) == -1)
+	{	
+        SERVER_ERROR_LOG_stdlib_err("Unable to add the server upgrade trigger to epoll!");
+		return -1;
+	}
+
+	int file_cache_notify = File_Cache_Notify_Descriptor();
+	if(file_cache_notify != -1)
+	{
+		epoll_config.events = EPOLLIN;
+		epoll_config.data.fd = file_cache_notify;
+
+		if(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, file_cache_notify, &epoll_config) == -1)
+		{	
+			SERVER_ERROR_LOG_stdlib_err("Unable to add the file cache inotify to epoll!");
+			return -1;
+		}
+	}
+
+	struct epoll_event triggered_events[4];
+	bool is_reload_pending = false;
+
+	//the listener threads read SERVER_CONFIGURATION while they start, like the workers
+	size_t listener_threads_num = http_listener_threads.size();
+	#ifndef DISABLE_HTTPS
+	listener_threads_num += https_listener_threads.size();
+	#endif
+
+	//readable when the upgraded server is ready or exits, -1 if no upgrade is running
+	int upgrade_ready_fd = -1;
+	bool has_retired_configs = false;
+
 	bool should_stop = false;
 	while(!should_stop)
 	{
-		int epoll_result = epoll_wait(epoll_fd, &epoll_config, 1, -1);
+		//the workers and the listeners are polled while a reload waits for them or an old snapshot is still in use
+		int wait_time = (is_reload_pending or has_retired_configs) ? 1000 : -1;
+		int epoll_result = epoll_wait(epoll_fd, triggered_events, 4, wait_time);
 
 		if(epoll_result == -1)
 		{
@@ -176,17 +358,103 @@ int main(int argc, char** argv)
 			}
 		}
 
-		//close trigger is fired
-		else if(epoll_result > 0)
+		for(int i = 0; i < epoll_result; i++)
 		{
-			should_stop = true;
+			//close trigger is fired
+			if(triggered_events[i].data.fd == SERVER_CLOSE_TRIGGER)
+			{
+				should_stop = true;
+			}
+
+			else if(triggered_events[i].data.fd == SERVER_RELOAD_TRIGGER)
+			{
+				eventfd_t reload_requests;
+				eventfd_read(SERVER_RELOAD_TRIGGER, &reload_requests);
+				is_reload_pending = true;
+			}
+
+			//the main thread drops the changed files from the cache shared by the workers
+			else if(triggered_events[i].data.fd == file_cache_notify)
+			{
+				File_Cache_Process_Events();
+			}
+
+			else if(triggered_events[i].data.fd == SERVER_UPGRADE_TRIGGER)
+			{
+				eventfd_t upgrade_requests;
+				eventfd_read(SERVER_UPGRADE_TRIGGER, &upgrade_requests);
+
+				if(upgrade_ready_fd == -1)
+				{
+					upgrade_ready_fd = Server_Upgrade_Spawn(argv);
+
+					epoll_config.events = EPOLLIN;
+					epoll_config.data.fd = upgrade_ready_fd;
+
+					if(upgrade_ready_fd != -1 and epoll_ctl(epoll_fd, EPOLL_CTL_ADD, upgrade_ready_fd, &epoll_config) == -1)
+					{
+						SERVER_ERROR_LOG_stdlib_err("Unable to add the server upgrade pipe to epoll!");
+						return -1;
+					}
+				}
+			}
+
+			else if(triggered_events[i].data.fd == upgrade_ready_fd)
+			{
+				//closing the pipe also removes it from epoll
+				bool is_upgraded = Server_Upgrade_Finish(upgrade_ready_fd);
+				upgrade_ready_fd = -1;
+
+				if(is_upgraded)
+				{
+					//the workers stop accepting and finish their connections
+					is_server_draining = true;
+					terminate_signal_handler(0);
+					should_stop = true;
+				}
+			}
+		}
+
+		if(should_stop)
+		{
+			break;
+		}
+
+		uint64_t oldest_config_generation = HTTP_Workers_Oldest_Config_Generation();
+
+		//the workers and the listeners read SERVER_CONFIGURATION while they start
+		if(is_reload_pending and oldest_config_generation != 0 and server_listeners_ready() == listener_threads_num)
+		{
+			is_reload_pending = false;
+
+			if(reload_server_config(config_file))
+			{
+				publish_server_config();
+
+				SERVER_LOG_WRITE_NORMAL.lock();
+				SERVER_LOG_WRITE(SERVER_LOG_strtime(SERVER_LOG_LOCALTIME_REPORTING)); 
+				SERVER_LOG_WRITE(" The configuration was reloaded!\n\n");
+				SERVER_LOG_WRITE_NORMAL.unlock();
+			}
+
+			log_content_cache_stats();
 		}
+
+		has_retired_configs = !free_retired_server_runtime_configs(oldest_config_generation);
 	}
 	
 	SERVER_LOG_WRITE_NORMAL.lock();
 	SERVER_LOG_WRITE(SERVER_LOG_strtime(SERVER_LOG_LOCALTIME_REPORTING)); 
-	SERVER_LOG_WRITE(" Received TERMINATE signal!\n");
-	SERVER_LOG_WRITE("The server is shutting down!\n\n");
+	if(is_server_draining)
+	{
+		SERVER_LOG_WRITE(" The server was upgraded!\n");
+		SERVER_LOG_WRITE("Finishing the open connections!\n\n");
+	}
+	else
+	{
+		SERVER_LOG_WRITE(" Received TERMINATE signal!\n");
+		SERVER_LOG_WRITE("The server is shutting down!\n\n");
+	}
 	SERVER_LOG_WRITE_NORMAL.unlock();
 
 	std::thread force_shutdown_thread([](uint8_t wait_sec)
@@ -220,8 +488,18 @@ int main(int argc, char** argv)
 	#endif
 
 	HTTP_Workers_Join();
+	free_server_runtime_configs();
+
+	log_content_cache_stats();
+	HTTP_Compression_Free();
+	File_IO_Free();
+	Content_Cache_Free();
+	File_Cache_Free();
+
 	close(epoll_fd);
 	close(SERVER_CLOSE_TRIGGER);
+	close(SERVER_RELOAD_TRIGGER);
+	close(SERVER_UPGRADE_TRIGGER);
 
 	#ifndef NO_MOD_MYSQL
 	mysql_library_end();
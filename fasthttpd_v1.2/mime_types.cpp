@@ -0,0 +1,338 @@
+#include "mime_types.h"
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <cstdint>
+
+#define MIME_TYPES_NO_ENTRY 0xFFFFFFFF
+
+//the seeds tried for a bucket before the table is built again with more slots
+#define MIME_TYPES_MAX_DISPLACEMENT 65536
+
+static const char* const mime_types_builtin[][2] =
+{
+	{"aac", "audio/aac"},
+	{"abw", "application/x-abiword"},
+	{"apng", "image/png"},
+	{"avi", "video/x-msvideo"},
+	{"azw", "application/vnd.amazon.ebook"},
+	{"bmp", "image/bmp"},
+	{"bz", "application/x-bzip"},
+	{"bz2", "application/x-bzip2"},
+	{"csh", "application/x-csh"},
+	{"css", "text/css"},
+	{"csv", "text/csv"},
+	{"doc", "application/msword"},
+	{"docx", "application/vnd.openxmlformats-officedocument.wordprocessingml.document"},
+	{"divx", "video/x-divx"},
+	{"eot", "application/vnd.ms-fontobject"},
+	{"epub", "application/epub+zip"},
+	{"es", "application/ecmascript"},
+	{"gif", "image/gif"},
+	{"htm", "text/html"},
+	{"html", "text/html"},
+	{"ico", "image/x-icon"},
+	{"ics", "text/calendar"},
+	{"jar", "application/java-archive"},
+	{"jpeg", "image/jpeg"},
+	{"jpg", "image/jpeg"},
+	{"js", "text/javascript"},
+	{"jsx", "text/jsx"},
+	{"json", "application/json"},
+	{"mid", "audio/midi"},
+	{"midi", "audio/midi"},
+	{"mkv", "video/x-matroska"},
+	{"mpeg", "video/mpeg"},
+	{"mpkg", "application/vnd.apple.installer+xml"},
+	{"mp3", "audio/mpeg"},
+	{"mp4", "video/mp4"},
+	{"odp", "application/vnd.oasis.opendocument.presentation"},
+	{"ods", "application/vnd.oasis.opendocument.spreadsheet"},
+	{"odt", "application/vnd.oasis.opendocument.text"},
+	{"oga", "audio/ogg"},
+	{"ogv", "video/ogg"},
+	{"ogx", "application/ogg"},
+	{"otf", "font/otf"},
+	{"png", "image/png"},
+	{"pdf", "application/pdf"},
+	{"ppt", "application/vnd.ms-powerpoint"},
+	{"pptx", "application/vnd.openxmlformats-officedocument.presentationml.presentation"},
+	{"rar", "application/x-rar-compressed"},
+	{"rtf", "application/rtf"},
+	{"sh", "application/x-sh"},
+	{"svg", "image/svg+xml"},
+	{"swf", "application/x-shockwave-flash"},
+	{"tar", "application/x-tar"},
+	{"tif", "image/tiff"},
+	{"tiff", "image/tiff"},
+	{"ts", "application/typescript"},
+	{"ttf", "font/ttf"},
+	{"txt", "text/plain"},
+	{"vsd", "application/vnd.visio"},
+	{"wav", "audio/wav"},
+	{"weba", "audio/webm"},
+	{"webm", "audio/webm"},
+	{"webp", "image/webp"},
+	{"woff", "font/woff"},
+	{"woff2", "font/woff2"},
+	{"xhtml", "application/xhtml+xml"},
+	{"xls", "application/vnd.ms-excel"},
+	{"xlsx", "application/vnd.openxmlformats-officedocument.spreadsheetml.sheet"},
+	{"xml", "application/xml"},
+	{"xul", "application/vnd.mozilla.xul+xml"},
+	{"zip", "application/zip"},
+	{"3gp", "video/3gpp"},
+	{"3g2", "video/3gpp2"},
+	{"7z", "application/x-7z-compressed"},
+};
+
+struct MIME_TYPES_ENTRY
+{
+	std::string extension; //lower case
+	uint32_t type_id;
+};
+
+//each type is stored once, the lookups return references to these strings
+static std::vector<std::string> mime_types_names;
+static std::vector<struct MIME_TYPES_ENTRY> mime_types_entries;
+
+/*
+hash and displace perfect hash, the first hash selects a bucket,
+the displacement of the bucket seeds the second hash which selects a slot only used by that extension
+*/
+static std::vector<uint32_t> mime_types_displacements;
+static std::vector<uint32_t> mime_types_slots;
+
+static const std::string mime_type_default = MIME_TYPE_DEFAULT;
+
+static inline uint8_t MIME_Types_Lower(char c)
+{
+	return (c >= 'A' and c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+static uint32_t MIME_Types_Hash(const char* extension, size_t len, uint32_t seed)
+{
+	//FNV-1a over the lower case bytes, the seed selects another function of the family
+	uint32_t hash = 2166136261u ^ (seed * 0x9E3779B9u);
+	for (size_t i = 0; i < len; i++)
+	{
+		hash ^= MIME_Types_Lower(extension[i]);
+		hash *= 16777619u;
+	}
+
+	//the slot is taken from the low bits, so they have to depend on every byte
+	hash ^= hash >> 16;
+	hash *= 0x85EBCA6Bu;
+	hash ^= hash >> 13;
+	hash *= 0xC2B2AE35u;
+	hash ^= hash >> 16;
+
+	return hash;
+}
+
+static void MIME_Types_Add(const std::string& extension, const std::string& type, std::unordered_map<std::string, uint32_t>* entry_ids,
+                           std::unordered_map<std::string, uint32_t>* type_ids)
+{
+	if (extension.empty() or extension.size() > MIME_TYPES_MAX_EXTENSION_LEN)
+	{
+		return;
+	}
+
+	auto type_it = type_ids->find(type);
+	if (type_it == type_ids->end())
+	{
+		type_it = type_ids->insert(std::make_pair(type, (uint32_t) mime_types_names.size())).first;
+		mime_types_names.push_back(type);
+	}
+
+	std::string lower_extension = extension;
+	for (size_t i = 0; i < lower_extension.size(); i++)
+	{
+		lower_extension[i] = MIME_Types_Lower(lower_extension[i]);
+	}
+
+	//a later definition of the extension replaces the previous one
+	auto entry_it = entry_ids->find(lower_extension);
+	if (entry_it != entry_ids->end())
+	{
+		mime_types_entries[entry_it->second].type_id = type_it->second;
+		return;
+	}
+
+	entry_ids->insert(std::make_pair(lower_extension, (uint32_t) mime_types_entries.size()));
+	mime_types_entries.push_back({lower_extension, type_it->second});
+}
+
+static bool MIME_Types_Load_File(const std::string& mime_types_file, std::unordered_map<std::string, uint32_t>* entry_ids,
+                                 std::unordered_map<std::string, uint32_t>* type_ids)
+{
+	std::ifstream mime_types_stream(mime_types_file.c_str());
+	if (!mime_types_stream.is_open())
+	{
+		return false;
+	}
+
+	//each line is a type followed by its extensions, the comments start with #
+	std::string current_line;
+	while (std::getline(mime_types_stream, current_line))
+	{
+		current_line.erase(std::min(current_line.find('#'), current_line.size()));
+
+		std::istringstream line_stream(current_line);
+
+		std::string type, extension;
+		if (!(line_stream >> type))
+		{
+			continue;
+		}
+
+		while (line_stream >> extension)
+		{
+			MIME_Types_Add(extension, type, entry_ids, type_ids);
+		}
+	}
+
+	return true;
+}
+
+static bool MIME_Types_Build_Table(size_t slots_num)
+{
+	size_t buckets_num = slots_num / 4;
+
+	std::vector<std::vector<uint32_t> > buckets(buckets_num);
+	for (uint32_t i = 0; i < mime_types_entries.size(); i++)
+	{
+		const std::string& extension = mime_types_entries[i].extension;
+		buckets[MIME_Types_Hash(extension.c_str(), extension.size(), 0) & (buckets_num - 1)].push_back(i);
+	}
+
+	//the largest buckets are placed first, while most slots are still free
+	std::vector<uint32_t> bucket_order(buckets_num);
+	for (uint32_t i = 0; i < buckets_num; i++)
+	{
+		bucket_order[i] = i;
+	}
+
+	std::stable_sort(bucket_order.begin(), bucket_order.end(), [&buckets](uint32_t a, uint32_t b) { return buckets[a].size() > buckets[b].size(); });
+
+	mime_types_displacements.assign(buckets_num, 0);
+	mime_types_slots.assign(slots_num, MIME_TYPES_NO_ENTRY);
+
+	std::vector<uint32_t> bucket_slots;
+
+	for (size_t i = 0; i < buckets_num and !buckets[bucket_order[i]].empty(); i++)
+	{
+		const std::vector<uint32_t>& bucket = buckets[bucket_order[i]];
+
+		uint32_t displacement = 1;
+		for (; displacement < MIME_TYPES_MAX_DISPLACEMENT; displacement++)
+		{
+			bucket_slots.clear();
+
+			for (size_t j = 0; j < bucket.size(); j++)
+			{
+				const std::string& extension = mime_types_entries[bucket[j]].extension;
+				uint32_t slot = MIME_Types_Hash(extension.c_str(), extension.size(), displacement) & (slots_num - 1);
+
+				if (mime_types_slots[slot] != MIME_TYPES_NO_ENTRY or std::find(bucket_slots.begin(), bucket_slots.end(), slot) != bucket_slots.end())
+				{
+					break;
+				}
+
+				bucket_slots.push_back(slot);
+			}
+
+			if (bucket_slots.size() == bucket.size())
+			{
+				break;
+			}
+		}
+
+		if (displacement == MIME_TYPES_MAX_DISPLACEMENT)
+		{
+			return false;
+		}
+
+		mime_types_displacements[bucket_order[i]] = displacement;
+		for (size_t j = 0; j < bucket.size(); j++)
+		{
+			mime_types_slots[bucket_slots[j]] = bucket[j];
+		}
+	}
+
+	return true;
+}
+
+bool MIME_Types_Init(const std::string& mime_types_file)
+{
+	mime_types_names.clear();
+	mime_types_entries.clear();
+
+	std::unordered_map<std::string, uint32_t> entry_ids, type_ids;
+
+	for (size_t i = 0; i < sizeof(mime_types_builtin) / sizeof(mime_types_builtin[0]); i++)
+	{
+		MIME_Types_Add(mime_types_builtin[i][0], mime_types_builtin[i][1], &entry_ids, &type_ids);
+	}
+
+	bool is_file_loaded = mime_types_file.empty() or MIME_Types_Load_File(mime_types_file, &entry_ids, &type_ids);
+
+	//twice as many slots as extensions, a table that can not be built gets more
+	size_t slots_num = 16;
+	while (slots_num < mime_types_entries.size() * 2)
+	{
+		slots_num <<= 1;
+	}
+
+	while (!MIME_Types_Build_Table(slots_num))
+	{
+		slots_num <<= 1;
+	}
+
+	return is_file_loaded;
+}
+
+const std::string& MIME_Types_Get(const std::string& filename)
+{
+	size_t point_position = filename.find_last_of('.');
+	if (point_position == std::string::npos or mime_types_slots.empty())
+	{
+		return mime_type_default;
+	}
+
+	const char* extension = filename.c_str() + point_position + 1;
+	size_t len = filename.size() - point_position - 1;
+
+	if (len == 0 or len > MIME_TYPES_MAX_EXTENSION_LEN)
+	{
+		return mime_type_default;
+	}
+
+	uint32_t displacement = mime_types_displacements[MIME_Types_Hash(extension, len, 0) & (mime_types_displacements.size() - 1)];
+	uint32_t entry_id = mime_types_slots[MIME_Types_Hash(extension, len, displacement) & (mime_types_slots.size() - 1)];
+
+	if (entry_id == MIME_TYPES_NO_ENTRY)
+	{
+		return mime_type_default;
+	}
+
+	//the slot holds the only extension that can match, compared without building a lower case copy
+	const struct MIME_TYPES_ENTRY& entry = mime_types_entries[entry_id];
+	if (entry.extension.size() != len)
+	{
+		return mime_type_default;
+	}
+
+	for (size_t i = 0; i < len; i++)
+	{
+		if (MIME_Types_Lower(extension[i]) != (uint8_t) entry.extension[i])
+		{
+			return mime_type_default;
+		}
+	}
+
+	return mime_types_names[entry.type_id];
+}
@@ -0,0 +1,20 @@
+#ifndef __mime_types_incl__
+#define __mime_types_incl__
+
+#include <string>
+
+#define MIME_TYPE_DEFAULT "application/octet-stream"
+
+//the longest extension looked up, the longer ones get the default type
+#define MIME_TYPES_MAX_EXTENSION_LEN 32
+
+/*
+builds the lookup table from the built-in types and, when mime_types_file is not empty, a file in the mime.types format,
+its extensions replace the built-in ones, false if the file can not be read, the built-in types are used anyway
+*/
+bool MIME_Types_Init(const std::string& mime_types_file);
+
+//the type of the file extension, compared case insensitively, the string stays valid until the server stops
+const std::string& MIME_Types_Get(const std::string& filename);
+
+#endif
@@ -4,19 +4,60 @@
 #include <cstdlib> 
 #include <errno.h>
 #include <cstring>
+#include <new>
 #include <cstdlib>
+#include <vector>
+#include <mutex>
 #include <sys/types.h>
 #include <sys/socket.h>
 
 #include "server_config.h"
 #include "helper_functions.h"
 #include "server_log.h"
+#include "cpu_affinity.h"
+#include "custom_bound.h"
 
 std::unordered_map<std::string, std::string > SERVER_CONFIGURATION;
 std::unordered_map<std::string, std::string > SERVER_HOSTNAMES;
+thread_local const struct SERVER_RUNTIME_CONFIG* server_runtime_config = NULL;
 std::unordered_map<int, std::string > SERVER_ERROR_PAGES;
 std::string SERVER_DIRECTORY_LISTING_TEMPLATE;
 
+static std::atomic<const struct SERVER_RUNTIME_CONFIG*> latest_server_runtime_config(NULL);
+
+//the snapshots replaced by a reload, only used by the main thread
+static std::vector<const struct SERVER_RUNTIME_CONFIG*> retired_server_runtime_configs;
+
+static bool is_server_config_reloading = false;
+static bool is_server_config_reload_failed = false;
+
+//keys used once at startup, a reload keeps their running values
+static const char* server_config_restart_keys[] =
+{
+	"ip_version", "ip_addr", "listen_http_port", "listen_https_port", "ipv6_dual_stack", "reuse_addr", "reuse_port",
+	"max_connections", "recv_kernel_buffer_size", "send_kernel_buffer_size", "read_buffer_size",
+	"server_workers", "server_listeners", "worker_listeners", "load_balancer_algo", "event_backend",
+	"worker_cpu_affinity", "listener_cpu_affinity", "reuseport_cpu_steering", "priority",
+	"enable_https", "ssl_cert_file", "ssl_key_file", "enable_ktls",
+	"log_normal_output_file", "log_error_output_file", "disable_log", "log_localtime_reporting",
+	"max_file_access_cache_size", "disable_file_access_API", "max_file_cache_size", "max_hot_file_size", "hot_content_cache_size",
+	"max_compressed_file_size", "compression_threads", "file_io_threads", "mime_types_file",
+	"enable_MOD_MYSQL", "mysql_hostname", "mysql_username", "mysql_password", "mysql_database", "mysql_port",
+	"mysql_unix_socket", "mysql_connection_timeout", "mysql_error_logging",
+	NULL
+};
+
+//a bad configuration stops the server at startup, a reload keeps the running one
+static void server_config_load_failed()
+{
+	if(!is_server_config_reloading)
+	{
+		exit(-1);
+	}
+
+	is_server_config_reload_failed = true;
+}
+
 void parse_config_line(const std::string *config_line, std::unordered_map<std::string, std::string>* config_map)
 {
 	size_t separator_position = config_line->find('=');
@@ -72,7 +113,7 @@ bool http_host_exists(const std::string* key)
 
 bool server_error_page_exists(int error_code)
 {
-    if(SERVER_ERROR_PAGES.find(error_code) != SERVER_ERROR_PAGES.end())
+    if(server_runtime_config->error_pages.find(error_code) != server_runtime_config->error_pages.end())
 	{
     	return true;
 	}
@@ -214,13 +255,13 @@ void load_server_error_pages()
 		str_replace_first(&SERVER_ERROR_PAGES[error_page_codes[i - 1]],"$SERVERVERSION",DEFAULT_CONFIG_SERVER_VERSION);
 	}
 
-	if(!server_error_page_exists(500))
+	if(SERVER_ERROR_PAGES.find(500) == SERVER_ERROR_PAGES.end())
 	{
 		SERVER_LOG_WRITE(SERVER_LOG_strtime(SERVER_LOG_LOCALTIME_REPORTING),true);
 		SERVER_LOG_WRITE(" No error page for status 500 is available!",true);
 		SERVER_LOG_WRITE("\n\n",true);
 
-		exit(-1);
+		server_config_load_failed();
 	}
 
 }
@@ -249,7 +290,8 @@ void load_hosts_list()
 			SERVER_LOG_WRITE(" bytes",true);
 			SERVER_LOG_WRITE("\n\n",true);
 
-			exit(-1);
+			server_config_load_failed();
+			return;
 		}
 
 		std::string current_line;
@@ -292,7 +334,7 @@ void load_hosts_list()
 			SERVER_LOG_WRITE(SERVER_CONFIGURATION["default_host"],true);
 			SERVER_LOG_WRITE(" does not match any defined hosts!\n\n",true);
 
-			exit(-1);
+			server_config_load_failed();
 		}
 	}
 }
@@ -305,7 +347,8 @@ void load_directory_listing_template()
 	if(!dir_template_file_stream.is_open())
 	{
 		SERVER_ERROR_LOG_stdlib_err(3,"Unable to open the directory listing html template ( ",SERVER_CONFIGURATION["directory_listing_template"].c_str()," )");
-		exit(-1);
+		server_config_load_failed();
+		return;
 	}
 
 	size_t template_size = dir_template_file_stream.tellg();
@@ -320,7 +363,8 @@ void load_directory_listing_template()
 		SERVER_LOG_WRITE(" bytes",true);
 		SERVER_LOG_WRITE("\n\n",true);
 
-		exit(-1);
+		server_config_load_failed();
+		return;
 	}
 
 	char buffer[10 * 1024];
@@ -329,7 +373,156 @@ void load_directory_listing_template()
 	SERVER_DIRECTORY_LISTING_TEMPLATE = std::string(buffer,template_size);
 }
 
-void load_server_config(char* config_file)
+const struct SERVER_HOST_CONFIG* server_config_find_host(const std::string& hostname)
+{
+	auto host = server_runtime_config->hosts.find(hostname);
+	if(host != server_runtime_config->hosts.end())
+	{
+		return &host->second;
+	}
+
+	return server_runtime_config->strict_hosts ? NULL : server_runtime_config->default_host;
+}
+
+struct SERVER_RUNTIME_CONFIG* build_server_runtime_config()
+{
+	struct SERVER_RUNTIME_CONFIG* runtime_config = new (std::nothrow) struct SERVER_RUNTIME_CONFIG();
+	if(!runtime_config)
+	{
+		SERVER_ERROR_LOG_stdlib_err("Unable to allocate memory for the server runtime config!");
+		exit(-1);
+	}
+
+	//the values were validated by load_server_config
+	runtime_config->read_buffer_size = str2uint(SERVER_CONFIGURATION["read_buffer_size"]) * 1024;
+	runtime_config->max_request_size = str2uint(SERVER_CONFIGURATION["max_request_size"]) * 1024;
+
+	runtime_config->max_query_args = str2uint(SERVER_CONFIGURATION["max_query_args"]);
+	runtime_config->max_post_args = str2uint(SERVER_CONFIGURATION["max_post_args"]);
+	runtime_config->max_uploaded_files = str2uint(SERVER_CONFIGURATION["max_uploaded_files"]);
+	runtime_config->continue_if_args_limit_exceeded = is_server_config_variable_true("continue_if_args_limit_exceeded");
+
+	runtime_config->http2_max_concurrent_streams = str2uint(SERVER_CONFIGURATION["http2_max_concurrent_streams"]);
+	runtime_config->http2_init_window_size = str2uint(SERVER_CONFIGURATION["http2_init_window_size"]) * 1024;
+	runtime_config->http2_max_frame_size = str2uint(SERVER_CONFIGURATION["http2_max_frame_size"]) * 1024;
+
+	runtime_config->server_name = SERVER_CONFIGURATION["server_name"];
+	runtime_config->server_version = SERVER_CONFIGURATION["server_version"];
+	runtime_config->server_header = runtime_config->server_name + "/" + runtime_config->server_version;
+	runtime_config->os_name = SERVER_CONFIGURATION["os_name"];
+	runtime_config->os_version = SERVER_CONFIGURATION["os_version"];
+	runtime_config->keep_alive_header = "timeout=" + SERVER_CONFIGURATION["keep_alive_timeout"];
+
+	runtime_config->header_timeout = str2uint(SERVER_CONFIGURATION["header_timeout"]) * 1000;
+	runtime_config->body_timeout = str2uint(SERVER_CONFIGURATION["body_timeout"]) * 1000;
+	runtime_config->keep_alive_timeout = str2uint(SERVER_CONFIGURATION["keep_alive_timeout"]) * 1000;
+	runtime_config->send_timeout = str2uint(SERVER_CONFIGURATION["send_timeout"]) * 1000;
+
+	//the hosts are strict unless they are explicitly disabled
+	runtime_config->strict_hosts = !is_server_config_variable_false("strict_hosts");
+
+	for(auto i = SERVER_HOSTNAMES.begin(); i != SERVER_HOSTNAMES.end(); ++i)
+	{
+		struct SERVER_HOST_CONFIG host;
+		host.hostname = i->first;
+		host.document_root = i->second;
+
+		runtime_config->hosts[i->first] = host;
+	}
+
+	runtime_config->default_host = &runtime_config->hosts[SERVER_CONFIGURATION["default_host"]];
+
+	runtime_config->error_pages = SERVER_ERROR_PAGES;
+	runtime_config->directory_listing_template = SERVER_DIRECTORY_LISTING_TEMPLATE;
+
+	runtime_config->compression_enabled = is_server_config_variable_true("enable_compression");
+	runtime_config->compression_level = str2uint(SERVER_CONFIGURATION["compression_level"]);
+	runtime_config->compression_min_size = str2uint(SERVER_CONFIGURATION["compression_min_size"]);
+
+	std::vector<std::string> compression_mime_types;
+	explode(&SERVER_CONFIGURATION["compression_mime_types"], ",", &compression_mime_types);
+
+	for(size_t i = 0; i < compression_mime_types.size(); i++)
+	{
+		std::string mime_type = str_ansi_to_lower(compression_mime_types[i]);
+		mime_type.erase(0, mime_type.find_first_not_of(" \t"));
+		mime_type.erase(mime_type.find_last_not_of(" \t") + 1);
+
+		if(!mime_type.empty())
+		{
+			runtime_config->compression_mime_types.push_back(mime_type);
+		}
+	}
+
+	//filled by build_custom_bound_table
+	runtime_config->custom_bound_table = NULL;
+
+	runtime_config->mysql_auto_reconnect = is_server_config_variable_true("enable_MOD_MYSQL") and is_server_config_variable_true("mysql_auto_reconnect");
+
+	return runtime_config;
+}
+
+static void free_server_runtime_config(const struct SERVER_RUNTIME_CONFIG* runtime_config)
+{
+	delete (runtime_config->custom_bound_table);
+	delete (runtime_config);
+}
+
+void publish_server_runtime_config(struct SERVER_RUNTIME_CONFIG* runtime_config)
+{
+	const struct SERVER_RUNTIME_CONFIG* previous_config = latest_server_runtime_config.load();
+
+	runtime_config->generation = previous_config ? previous_config->generation + 1 : 1;
+	latest_server_runtime_config.store(runtime_config);
+
+	//the workers may still use it until their next loop iteration
+	if(previous_config)
+	{
+		retired_server_runtime_configs.push_back(previous_config);
+	}
+
+	server_runtime_config = runtime_config;
+}
+
+const struct SERVER_RUNTIME_CONFIG* acquire_server_runtime_config()
+{
+	server_runtime_config = latest_server_runtime_config.load();
+	return server_runtime_config;
+}
+
+bool free_retired_server_runtime_configs(uint64_t oldest_generation_in_use)
+{
+	size_t kept_configs = 0;
+	for(size_t i = 0; i < retired_server_runtime_configs.size(); i++)
+	{
+		if(retired_server_runtime_configs[i]->generation < oldest_generation_in_use)
+		{
+			free_server_runtime_config(retired_server_runtime_configs[i]);
+		}
+		else
+		{
+			retired_server_runtime_configs[kept_configs++] = retired_server_runtime_configs[i];
+		}
+	}
+
+	retired_server_runtime_configs.resize(kept_configs);
+	return retired_server_runtime_configs.empty();
+}
+
+void free_server_runtime_configs()
+{
+	free_retired_server_runtime_configs(UINT64_MAX);
+
+	const struct SERVER_RUNTIME_CONFIG* runtime_config = latest_server_runtime_config.exchange(NULL);
+	if(runtime_config)
+	{
+		free_server_runtime_config(runtime_config);
+	}
+
+	server_runtime_config = NULL;
+}
+
+static bool read_server_config_file(char* config_file)
 {
 	if(config_file == NULL)
 	{
@@ -345,7 +538,8 @@ void load_server_config(char* config_file)
 		if(!config_file_stream.is_open())
 		{
 			SERVER_ERROR_LOG_stdlib_err(3,"Unable to open configuration file ( ",config_file," )");
-			exit(-1);
+			server_config_load_failed();
+			return false;
 		}
 
 		size_t config_file_size = config_file_stream.tellg();
@@ -360,7 +554,8 @@ void load_server_config(char* config_file)
 			SERVER_LOG_WRITE(" bytes",true);
 			SERVER_LOG_WRITE("\n\n",true);
 
-			exit(-1);
+			server_config_load_failed();
+			return false;
 		}
 
 		std::string current_line;
@@ -372,29 +567,37 @@ void load_server_config(char* config_file)
 		config_file_stream.close(); 
 	}
 
+	return true;
+}
 
-	if(server_config_variable_exists("log_normal_output_file") && server_config_variable_exists("log_error_output_file"))
-	{
-		SERVER_LOG_INIT(SERVER_CONFIGURATION["log_normal_output_file"].c_str(),SERVER_CONFIGURATION["log_error_output_file"].c_str());
-	}
-	else if(server_config_variable_exists("log_normal_output_file") && !server_config_variable_exists("log_error_output_file"))
-	{
-		SERVER_LOG_INIT(SERVER_CONFIGURATION["log_normal_output_file"].c_str(),NULL);
-	}
-	else if(!server_config_variable_exists("log_normal_output_file") && server_config_variable_exists("log_error_output_file"))
+static void check_server_config()
+{
+	//the log files are opened once, the other threads are already writing to them on a reload
+	if(!is_server_config_reloading)
 	{
-		SERVER_LOG_INIT(NULL, SERVER_CONFIGURATION["log_error_output_file"].c_str());
-	}
+		if(server_config_variable_exists("log_normal_output_file") && server_config_variable_exists("log_error_output_file"))
+		{
+			SERVER_LOG_INIT(SERVER_CONFIGURATION["log_normal_output_file"].c_str(),SERVER_CONFIGURATION["log_error_output_file"].c_str());
+		}
+		else if(server_config_variable_exists("log_normal_output_file") && !server_config_variable_exists("log_error_output_file"))
+		{
+			SERVER_LOG_INIT(SERVER_CONFIGURATION["log_normal_output_file"].c_str(),NULL);
+		}
+		else if(!server_config_variable_exists("log_normal_output_file") && server_config_variable_exists("log_error_output_file"))
+		{
+			SERVER_LOG_INIT(NULL, SERVER_CONFIGURATION["log_error_output_file"].c_str());
+		}
 
 
-	if(is_server_config_variable_true("disable_log"))
-	{
-		SERVER_LOG_DISABLED = true;
-	}
+		if(is_server_config_variable_true("disable_log"))
+		{
+			SERVER_LOG_DISABLED = true;
+		}
 
-	if(is_server_config_variable_true("log_localtime_reporting"))
-	{
-		SERVER_LOG_LOCALTIME_REPORTING = true;
+		if(is_server_config_variable_true("log_localtime_reporting"))
+		{
+			SERVER_LOG_LOCALTIME_REPORTING = true;
+		}
 	}
 
 
@@ -409,11 +612,26 @@ void load_server_config(char* config_file)
 	check_server_config_uintval("max_query_args",DEFAULT_CONFIG_SERVER_MAX_QUERY_ARGS,1,1 << 14);
 	check_server_config_uintval("shutdown_wait_timeout",DEFAULT_CONFIG_SERVER_SHUTDOWN_TIMEOUT,2,20);
 	check_server_config_uintval("request_timeout",DEFAULT_CONFIG_SERVER_REQ_TIMEOUT,0,600);
+
+	//the timeouts of each connection phase default to the request timeout
+	const std::string request_timeout = SERVER_CONFIGURATION["request_timeout"];
+	check_server_config_uintval("header_timeout",request_timeout.c_str(),0,600);
+	check_server_config_uintval("body_timeout",request_timeout.c_str(),0,600);
+	check_server_config_uintval("keep_alive_timeout",request_timeout.c_str(),0,600);
+	check_server_config_uintval("send_timeout",request_timeout.c_str(),0,600);
 	check_server_config_uintval("read_buffer_size",DEFAULT_CONFIG_SERVER_READ_BUFFER_SIZE,1,uint64_t(1) << 34);
 	check_server_config_uintval("server_workers",DEFAULT_CONFIG_SERVER_WORKERS,1,1 << 14);
 	check_server_config_uintval("server_listeners", DEFAULT_CONFIG_SERVER_LISTENERS, 1, 128);
 	check_server_config_uintval("max_request_size",DEFAULT_CONFIG_SERVER_MAX_REQ_SIZE,4,uint64_t(1) << 34);
 	check_server_config_uintval("max_file_access_cache_size",DEFAULT_CONFIG_SERVER_MAX_FILE_ACCESS_CACHE_SIZE,1,1 << 24);
+	check_server_config_uintval("max_file_cache_size",DEFAULT_CONFIG_SERVER_MAX_FILE_CACHE_SIZE,0,1 << 20);
+	check_server_config_uintval("max_hot_file_size",DEFAULT_CONFIG_SERVER_MAX_HOT_FILE_SIZE,0,1 << 14);
+	check_server_config_uintval("hot_content_cache_size",DEFAULT_CONFIG_SERVER_HOT_CONTENT_CACHE_SIZE,0,1 << 16);
+	check_server_config_uintval("compression_level",DEFAULT_CONFIG_SERVER_COMPRESSION_LEVEL,1,9);
+	check_server_config_uintval("compression_min_size",DEFAULT_CONFIG_SERVER_COMPRESSION_MIN_SIZE,0,1 << 30);
+	check_server_config_uintval("max_compressed_file_size",DEFAULT_CONFIG_SERVER_MAX_COMPRESSED_FILE_SIZE,0,1 << 16);
+	check_server_config_uintval("compression_threads",DEFAULT_CONFIG_SERVER_COMPRESSION_THREADS,0,64);
+	check_server_config_uintval("file_io_threads",DEFAULT_CONFIG_SERVER_FILE_IO_THREADS,0,64);
 
 	check_server_config_uintval("http2_max_frame_size", DEFAULT_CONFIG_HTTP2_MAX_FRAME_SIZE, 16, 16384);
 	check_server_config_uintval("http2_init_window_size", DEFAULT_CONFIG_HTTP2_INIT_WINDOW_SIZE, 65, 2097152);
@@ -454,7 +672,8 @@ void load_server_config(char* config_file)
 		else if(r == -1)
 		{
 			SERVER_ERROR_LOG_stdlib_err(2,"Unable to test ip address ",SERVER_CONFIGURATION["ip_addr"].c_str());
-			exit(-1);
+			server_config_load_failed();
+			return;
 		}
 
 	}
@@ -529,19 +748,40 @@ void load_server_config(char* config_file)
 		{
 			SERVER_LOG_WRITE(SERVER_LOG_strtime(SERVER_LOG_LOCALTIME_REPORTING),true); 
 			SERVER_LOG_WRITE(" HTTPS is enabled but no certificate file is provided!\n\n",true);
-			exit(-1);
+			server_config_load_failed();
+			return;
 		}
 
 		if(!server_config_variable_exists("ssl_key_file"))
 		{
 			SERVER_LOG_WRITE(SERVER_LOG_strtime(SERVER_LOG_LOCALTIME_REPORTING),true); 
 			SERVER_LOG_WRITE(" HTTPS is enabled but no private key file is provided!\n\n",true);
-			exit(-1);
+			server_config_load_failed();
+			return;
 		}
 		#endif
 
 	}	
 
+	if(is_server_config_variable_true("enable_compression"))
+	{
+		#ifdef DISABLE_COMPRESSION
+		SERVER_LOG_WRITE(SERVER_LOG_strtime(SERVER_LOG_LOCALTIME_REPORTING),true); 
+		SERVER_LOG_WRITE(" Compression is enabled but the compression support module is not compiled!\n\n",true);
+
+		SERVER_CONFIGURATION["enable_compression"] = "false";
+		#endif
+	}
+
+	if(!server_config_variable_exists("compression_mime_types"))
+	{
+		SERVER_CONFIGURATION["compression_mime_types"] = DEFAULT_CONFIG_SERVER_COMPRESSION_MIME_TYPES;
+		SERVER_LOG_WRITE(SERVER_LOG_strtime(SERVER_LOG_LOCALTIME_REPORTING)); 
+		SERVER_LOG_WRITE(" No compressed MIME types specified!\nLoading default: ");
+		SERVER_LOG_WRITE(SERVER_CONFIGURATION["compression_mime_types"]);
+		SERVER_LOG_WRITE("\n\n");
+	}
+
 
 	SERVER_CONFIGURATION["os_name"] = get_OS_name();
 	SERVER_CONFIGURATION["os_version"] = get_OS_version();
@@ -590,13 +830,110 @@ void load_server_config(char* config_file)
 		SERVER_LOG_WRITE("\n\n");
 	}
 	
+	int load_balancer_algo = SERVER_LOAD_BALANCER_RR;
 	if(SERVER_CONFIGURATION["load_balancer_algo"] == "fair")
 	{
-		is_server_load_balancer_fair = true;
+		load_balancer_algo = SERVER_LOAD_BALANCER_FAIR;
 	}
-	else
+	else if(SERVER_CONFIGURATION["load_balancer_algo"] == "p2c")
+	{
+		load_balancer_algo = SERVER_LOAD_BALANCER_P2C;
+	}
+	else if(SERVER_CONFIGURATION["load_balancer_algo"] != "rr")
+	{
+		SERVER_LOG_WRITE(SERVER_LOG_strtime(SERVER_LOG_LOCALTIME_REPORTING),true); 
+		SERVER_LOG_WRITE(" Unknown load balancer algorithm specified!\nLoading default: ",true);
+		SERVER_LOG_WRITE(DEFAULT_CONFIG_SERVER_LOAD_BALANCER_ALGO,true);
+		SERVER_LOG_WRITE("\n\n",true);
+
+		SERVER_CONFIGURATION["load_balancer_algo"] = DEFAULT_CONFIG_SERVER_LOAD_BALANCER_ALGO;
+	}
+
+	//let every worker accept on its own listener instead of the dedicated listener threads
+	bool worker_listeners_enabled = false;
+	if(is_server_config_variable_true("worker_listeners"))
+	{
+		if(!is_server_config_variable_true("reuse_addr") or !is_server_config_variable_true("reuse_port"))
+		{
+			SERVER_LOG_WRITE(SERVER_LOG_strtime(SERVER_LOG_LOCALTIME_REPORTING),true); 
+			SERVER_LOG_WRITE(" Worker listeners enabled, but socket options reuse_addr and/or reuse_port are disabled!\n",true);
+			SERVER_LOG_WRITE("Reverting to the dedicated listener threads!\n",true);
+			SERVER_LOG_WRITE("Please consult the server manual for more information!",true);
+			SERVER_LOG_WRITE("\n\n",true);
+
+			SERVER_CONFIGURATION["worker_listeners"] = "false";
+		}
+		else
+		{
+			worker_listeners_enabled = true;
+		}
+	}
+
+	//the cpus the worker and listener threads are pinned to
+	const char* cpu_affinity_keys[2] = {"worker_cpu_affinity", "listener_cpu_affinity"};
+	for(int i = 0; i < 2; i++)
+	{
+		std::vector<int> cpus;
+		if(!server_config_variable_exists(cpu_affinity_keys[i]))
+		{
+			SERVER_CONFIGURATION[cpu_affinity_keys[i]] = DEFAULT_CONFIG_SERVER_CPU_AFFINITY;
+		}
+		else if(SERVER_CONFIGURATION[cpu_affinity_keys[i]] != "none" and !CPU_Affinity_Parse(SERVER_CONFIGURATION[cpu_affinity_keys[i]], &cpus))
+		{
+			SERVER_LOG_WRITE(SERVER_LOG_strtime(SERVER_LOG_LOCALTIME_REPORTING),true); 
+			SERVER_LOG_WRITE(" Invalid cpu list specified for ",true);
+			SERVER_LOG_WRITE(cpu_affinity_keys[i],true);
+			SERVER_LOG_WRITE("!\nLoading default: ",true);
+			SERVER_LOG_WRITE(DEFAULT_CONFIG_SERVER_CPU_AFFINITY,true);
+			SERVER_LOG_WRITE("\n\n",true);
+
+			SERVER_CONFIGURATION[cpu_affinity_keys[i]] = DEFAULT_CONFIG_SERVER_CPU_AFFINITY;
+		}
+	}
+
+	//the steering maps the cpu that received the connection to the worker pinned on it
+	if(is_server_config_variable_true("reuseport_cpu_steering"))
+	{
+		if(!worker_listeners_enabled or SERVER_CONFIGURATION["worker_cpu_affinity"] == "none")
+		{
+			SERVER_LOG_WRITE(SERVER_LOG_strtime(SERVER_LOG_LOCALTIME_REPORTING),true); 
+			SERVER_LOG_WRITE(" The reuseport cpu steering requires worker_listeners and worker_cpu_affinity to be enabled!\n",true);
+			SERVER_LOG_WRITE("Disabling the reuseport cpu steering!",true);
+			SERVER_LOG_WRITE("\n\n",true);
+
+			SERVER_CONFIGURATION["reuseport_cpu_steering"] = "false";
+		}
+	}
+
+	//the event loop used by the workers
+	int event_backend = SERVER_EVENT_BACKEND_EPOLL;
+	if(!server_config_variable_exists("event_backend"))
 	{
-		is_server_load_balancer_fair = false;
+		SERVER_CONFIGURATION["event_backend"] = DEFAULT_CONFIG_SERVER_EVENT_BACKEND;
+	}
+
+	if(SERVER_CONFIGURATION["event_backend"] == "io_uring")
+	{
+	#ifdef DISABLE_IO_URING
+		SERVER_LOG_WRITE(SERVER_LOG_strtime(SERVER_LOG_LOCALTIME_REPORTING),true); 
+		SERVER_LOG_WRITE(" The io_uring event backend is selected but the io_uring support is not compiled!\nLoading default: ",true);
+		SERVER_LOG_WRITE(DEFAULT_CONFIG_SERVER_EVENT_BACKEND,true);
+		SERVER_LOG_WRITE("\n\n",true);
+
+		SERVER_CONFIGURATION["event_backend"] = DEFAULT_CONFIG_SERVER_EVENT_BACKEND;
+	#else
+		//the ring is not shared between threads, the server listeners hand the clients over through the worker queues
+		event_backend = SERVER_EVENT_BACKEND_IO_URING;
+	#endif
+	}
+	else if(SERVER_CONFIGURATION["event_backend"] != "epoll")
+	{
+		SERVER_LOG_WRITE(SERVER_LOG_strtime(SERVER_LOG_LOCALTIME_REPORTING),true); 
+		SERVER_LOG_WRITE(" Unknown event backend specified!\nLoading default: ",true);
+		SERVER_LOG_WRITE(DEFAULT_CONFIG_SERVER_EVENT_BACKEND,true);
+		SERVER_LOG_WRITE("\n\n",true);
+
+		SERVER_CONFIGURATION["event_backend"] = DEFAULT_CONFIG_SERVER_EVENT_BACKEND;
 	}
 
 
@@ -663,5 +1000,82 @@ void load_server_config(char* config_file)
 
 	#endif
 	}
+
+	//the listeners and the workers read these without locking, they are not changed by a reload
+	if(!is_server_config_reloading)
+	{
+		server_load_balancer_algo = load_balancer_algo;
+		is_server_worker_listeners_enabled = worker_listeners_enabled;
+		server_event_backend = event_backend;
+	}
 }
 
+void load_server_config(char* config_file)
+{
+	read_server_config_file(config_file);
+	check_server_config();
+}
+
+bool reload_server_config(char* config_file)
+{
+	std::unordered_map<std::string, std::string> running_configuration = SERVER_CONFIGURATION;
+	std::unordered_map<std::string, std::string> running_hostnames = SERVER_HOSTNAMES;
+	std::unordered_map<int, std::string> running_error_pages = SERVER_ERROR_PAGES;
+	std::string running_directory_listing_template = SERVER_DIRECTORY_LISTING_TEMPLATE;
+
+	SERVER_CONFIGURATION.clear();
+	SERVER_HOSTNAMES.clear();
+	SERVER_ERROR_PAGES.clear();
+
+	//the loaders write to the log without locking, the other threads are running now
+	std::lock_guard<std::recursive_mutex> normal_log_lock(SERVER_LOG_WRITE_NORMAL);
+	std::lock_guard<std::recursive_mutex> error_log_lock(SERVER_LOG_WRITE_ERROR);
+
+	is_server_config_reloading = true;
+	is_server_config_reload_failed = false;
+
+	if(read_server_config_file(config_file))
+	{
+		for(int i = 0; server_config_restart_keys[i] != NULL; i++)
+		{
+			const char* key = server_config_restart_keys[i];
+			auto running_value = running_configuration.find(key);
+
+			if(server_config_variable_exists(key) and (running_value == running_configuration.end() or running_value->second != SERVER_CONFIGURATION[key]))
+			{
+				SERVER_LOG_WRITE(SERVER_LOG_strtime(SERVER_LOG_LOCALTIME_REPORTING),true); 
+				SERVER_LOG_WRITE(" The server must be restarted to change ",true);
+				SERVER_LOG_WRITE(key,true);
+				SERVER_LOG_WRITE("!\nKeeping the running value!\n\n",true);
+			}
+
+			if(running_value != running_configuration.end())
+			{
+				SERVER_CONFIGURATION[key] = running_value->second;
+			}
+			else
+			{
+				SERVER_CONFIGURATION.erase(key);
+			}
+		}
+
+		check_server_config();
+	}
+
+	is_server_config_reloading = false;
+
+	if(is_server_config_reload_failed)
+	{
+		SERVER_CONFIGURATION = running_configuration;
+		SERVER_HOSTNAMES = running_hostnames;
+		SERVER_ERROR_PAGES = running_error_pages;
+		SERVER_DIRECTORY_LISTING_TEMPLATE = running_directory_listing_template;
+
+		SERVER_LOG_WRITE(SERVER_LOG_strtime(SERVER_LOG_LOCALTIME_REPORTING),true); 
+		SERVER_LOG_WRITE(" Unable to reload the configuration!\nKeeping the running configuration!\n\n",true);
+
+		return false;
+	}
+
+	return true;
+}
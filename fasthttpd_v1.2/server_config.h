@@ -3,6 +3,10 @@
 
 #include <string>
 #include <unordered_map>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
 
 #define MAX_CONFIG_FILE_SIZE 2 * 1024 * 1024
 
@@ -25,11 +29,22 @@
 #define DEFAULT_CONFIG_SERVER_WORKERS "50"
 #define DEFAULT_CONFIG_SERVER_LISTENERS "1"
 #define DEFAULT_CONFIG_SERVER_LOAD_BALANCER_ALGO "rr" 
+#define DEFAULT_CONFIG_SERVER_EVENT_BACKEND "epoll"
+#define DEFAULT_CONFIG_SERVER_CPU_AFFINITY "none"
 #define DEFAULT_CONFIG_SERVER_MAX_REQ_SIZE "1024"
 #define DEFAULT_CONFIG_SERVER_MAX_UPLOAD_FILES "32"
 #define DEFAULT_CONFIG_SERVER_MAX_POST_ARGS "64"
 #define DEFAULT_CONFIG_SERVER_MAX_QUERY_ARGS "32"
 #define DEFAULT_CONFIG_SERVER_MAX_FILE_ACCESS_CACHE_SIZE "64"
+#define DEFAULT_CONFIG_SERVER_MAX_FILE_CACHE_SIZE "1024"
+#define DEFAULT_CONFIG_SERVER_MAX_HOT_FILE_SIZE "32"
+#define DEFAULT_CONFIG_SERVER_HOT_CONTENT_CACHE_SIZE "64"
+#define DEFAULT_CONFIG_SERVER_COMPRESSION_LEVEL "5"
+#define DEFAULT_CONFIG_SERVER_COMPRESSION_MIN_SIZE "256"
+#define DEFAULT_CONFIG_SERVER_MAX_COMPRESSED_FILE_SIZE "1024"
+#define DEFAULT_CONFIG_SERVER_COMPRESSION_THREADS "1"
+#define DEFAULT_CONFIG_SERVER_FILE_IO_THREADS "2"
+#define DEFAULT_CONFIG_SERVER_COMPRESSION_MIME_TYPES "text/*,application/javascript,application/json,application/xml,application/xhtml+xml,image/svg+xml"
 
 #define DEFAULT_CONFIG_HTTP2_MAX_FRAME_SIZE "16"
 #define DEFAULT_CONFIG_HTTP2_INIT_WINDOW_SIZE "65"
@@ -44,6 +59,14 @@
 #define DEFAULT_CONFIG_SERVER_DIR_LISTING_TEMPLATE "config/directory_listing_template.html"
 
 
+#define SERVER_EVENT_BACKEND_EPOLL 0
+#define SERVER_EVENT_BACKEND_IO_URING 1
+
+#define SERVER_LOAD_BALANCER_RR 0
+#define SERVER_LOAD_BALANCER_FAIR 1
+#define SERVER_LOAD_BALANCER_P2C 2
+
+
 #ifndef NO_MOD_MYSQL
 #define DEFAULT_CONFIG_SERVER_MYSQL_HOSTNAME "localhost"
 #define DEFAULT_CONFIG_SERVER_MYSQL_USERNAME "root"
@@ -52,14 +75,107 @@
 #endif
 
 
+struct custom_bound_entry;
+
+struct SERVER_HOST_CONFIG
+{
+	std::string hostname;
+	std::string document_root;
+};
+
+/*
+typed copy of the validated configuration, the request path reads these fields instead of parsing SERVER_CONFIGURATION,
+a snapshot is immutable once published, a reload publishes a new one
+*/
+struct SERVER_RUNTIME_CONFIG
+{
+	uint64_t generation; //starts at 1, increased by every reload
+
+	size_t read_buffer_size; //bytes
+	uint64_t max_request_size; //bytes
+
+	unsigned int max_query_args;
+	unsigned int max_post_args;
+	unsigned int max_uploaded_files;
+	bool continue_if_args_limit_exceeded;
+
+	uint32_t http2_max_concurrent_streams;
+	uint32_t http2_init_window_size; //bytes
+	uint32_t http2_max_frame_size; //bytes
+
+	std::string server_name;
+	std::string server_version;
+	std::string server_header; //name/version
+	std::string os_name;
+	std::string os_version;
+	std::string keep_alive_header; //timeout=N
+
+	//milliseconds, 0 means no timeout
+	uint64_t header_timeout;
+	uint64_t body_timeout;
+	uint64_t keep_alive_timeout;
+	uint64_t send_timeout;
+
+	//an unknown host is answered with 400 instead of the default host
+	bool strict_hosts;
+	std::unordered_map<std::string, struct SERVER_HOST_CONFIG> hosts;
+	const struct SERVER_HOST_CONFIG* default_host;
+
+	std::unordered_map<int, std::string> error_pages;
+	std::string directory_listing_template;
+
+	//on the fly compression of the responses
+	bool compression_enabled;
+	int compression_level;
+	uint64_t compression_min_size; //bytes
+	std::vector<std::string> compression_mime_types; //lowercase, "type/*" allows every subtype
+
+	//the custom page generators, keyed by the full file path
+	std::unordered_map<std::string, struct custom_bound_entry>* custom_bound_table;
+
+	bool mysql_auto_reconnect;
+};
+
+//the snapshot used by the current thread, see acquire_server_runtime_config
+extern thread_local const struct SERVER_RUNTIME_CONFIG* server_runtime_config;
+
+struct SERVER_RUNTIME_CONFIG* build_server_runtime_config();
+
+//makes the snapshot visible to every thread, the previous one is retired
+void publish_server_runtime_config(struct SERVER_RUNTIME_CONFIG* runtime_config);
+
+//switches the current thread to the latest published snapshot
+const struct SERVER_RUNTIME_CONFIG* acquire_server_runtime_config();
+
+/*
+frees the retired snapshots older than the oldest generation still in use,
+returns false if some retired snapshots are still referenced
+*/
+bool free_retired_server_runtime_configs(uint64_t oldest_generation_in_use);
+
+//frees every snapshot, once no other thread can use them
+void free_server_runtime_configs();
+
+//the host serving the request, NULL if there is none
+const struct SERVER_HOST_CONFIG* server_config_find_host(const std::string& hostname);
+
 extern std::unordered_map<std::string, std::string > SERVER_CONFIGURATION;
 extern std::unordered_map<std::string, std::string > SERVER_HOSTNAMES;
 extern std::unordered_map<int, std::string > SERVER_ERROR_PAGES;
 extern std::string SERVER_DIRECTORY_LISTING_TEMPLATE;
-extern bool is_server_load_balancer_fair;
+extern int server_load_balancer_algo;
+extern bool is_server_worker_listeners_enabled;
+extern int server_event_backend;
 
 void load_server_config(char* config_file = NULL);
 
+/*
+reloads the configuration, the host list, the error pages and the directory listing template,
+the settings used once at startup keep their running values,
+an invalid configuration is logged and the running one is restored
+*/
+bool reload_server_config(char* config_file = NULL);
+
 bool server_config_variable_exists(const char* key);
 
 bool server_error_page_exists(int error_code);
@@ -1,45 +1,66 @@
 #include <cstring>
 #include <atomic>
+#include <algorithm>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/epoll.h>
 #include <unistd.h>
 #include <arpa/inet.h>
 #include <errno.h>
+#include <time.h>
 
 #include "server_listener.h"
 #include "helper_functions.h"
 #include "server_config.h"
 #include "server_log.h"
+#include "server_upgrade.h"
 #include "http_worker/http_worker.h"
 
 
-typedef struct 
+int init_server_listener_socket(bool https)
 {
-	int http_listener;
-	uint16_t http_listener_port;
+	int ip_addr_version = (SERVER_CONFIGURATION["ip_version"] == "4") ? AF_INET : AF_INET6;
 
-	socklen_t incoming_addr_size;
-	unsigned int max_connections;
+	struct sockaddr_in6 http_listener_addr;
+	memset(&http_listener_addr,0,sizeof(struct sockaddr_in6));
 
-	bool resize_recv_kernel_buffer;
-	socklen_t recv_kernel_buffer_size;
+	struct sockaddr_in* http_listener_addr4 = (struct sockaddr_in*)&http_listener_addr;
+	struct sockaddr_in6* http_listener_addr6 = &http_listener_addr;
 
-	bool resize_send_kernel_buffer;
-	socklen_t send_kernel_buffer_size;
+	http_listener_addr.sin6_family = ip_addr_version;
 
-	bool https;
+	inet_pton(ip_addr_version,SERVER_CONFIGURATION["ip_addr"].c_str(),((ip_addr_version == AF_INET6) ? (void*)&http_listener_addr6->sin6_addr : (void*)&http_listener_addr4->sin_addr));
 
-	#ifndef DISABLE_HTTPS
-	SSL_CTX* openssl_ctx;
-	#endif
+	uint16_t http_listener_port;
+	if(https)
+	{
+		http_listener_port = str2uint(&SERVER_CONFIGURATION["listen_https_port"]);
+	}
+	else
+	{
+		http_listener_port = str2uint(&SERVER_CONFIGURATION["listen_http_port"]);
+	}
+
+	if(ip_addr_version == AF_INET6)
+	{
+		http_listener_addr6->sin6_port = endian_conv_hton16(http_listener_port);
+	}
+	else
+	{
+		http_listener_addr4->sin_port = endian_conv_hton16(http_listener_port);
+	}
 
-} accept_new_client_func_parameters;
+	socklen_t http_listener_addr_size = (ip_addr_version == AF_INET6) ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in);
 
-int init_server_listener_socket(bool https)
-{
-	int ip_addr_version = (SERVER_CONFIGURATION["ip_version"] == "4") ? AF_INET : AF_INET6;
-	int http_listener = socket(ip_addr_version, SOCK_STREAM, IPPROTO_TCP);
+	//the socket handed over by the previous binary keeps its queued connections
+	int http_listener = Server_Upgrade_Take_Listener((struct sockaddr*)&http_listener_addr, http_listener_addr_size);
+	if(http_listener != -1)
+	{
+		Server_Upgrade_Register_Listener(http_listener);
+		return http_listener;
+	}
+
+	http_listener = socket(ip_addr_version, SOCK_STREAM, IPPROTO_TCP);
 
 	if(http_listener == -1)
 	{
@@ -108,36 +129,7 @@ int init_server_listener_socket(bool https)
 		}		
 	}
 	
-	struct sockaddr_in6 http_listener_addr;
-	memset(&http_listener_addr,0,sizeof(struct sockaddr_in6));
-
-	struct sockaddr_in* http_listener_addr4 = (struct sockaddr_in*)&http_listener_addr;
-	struct sockaddr_in6* http_listener_addr6 = &http_listener_addr;
-
-	http_listener_addr.sin6_family = ip_addr_version;
-
-	inet_pton(ip_addr_version,SERVER_CONFIGURATION["ip_addr"].c_str(),((ip_addr_version == AF_INET6) ? (void*)&http_listener_addr6->sin6_addr : (void*)&http_listener_addr4->sin_addr));
-
-	uint16_t http_listener_port;
-	if(https)
-	{
-		http_listener_port = str2uint(&SERVER_CONFIGURATION["listen_https_port"]);
-	}
-	else
-	{
-		http_listener_port = str2uint(&SERVER_CONFIGURATION["listen_http_port"]);
-	}
-
-	if(ip_addr_version == AF_INET6)
-	{
-		http_listener_addr6->sin6_port = endian_conv_hton16(http_listener_port);
-	}
-	else
-	{
-		http_listener_addr4->sin_port = endian_conv_hton16(http_listener_port);
-	}
-
-	if(bind(http_listener,(struct sockaddr*)&http_listener_addr,((ip_addr_version == AF_INET6) ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in))) == -1)
+	if(bind(http_listener,(struct sockaddr*)&http_listener_addr,http_listener_addr_size) == -1)
 	{
 		SERVER_ERROR_LOG_stdlib_err("Unable to bind the listener socket!");
 		return -1;
@@ -149,6 +141,7 @@ int init_server_listener_socket(bool https)
 		return -1;
 	}
 
+	Server_Upgrade_Register_Listener(http_listener);
 	return http_listener;
 }
 	
@@ -185,26 +178,135 @@ int init_server_listener_epoll(int listener_socket, int close_trigger)
 	return server_epoll;
 }
 
-int accept_new_client(accept_new_client_func_parameters& params)
+int setup_new_client(accept_new_client_func_parameters& params, int client_sock, struct sockaddr_in6& incoming_addr)
 {
-	struct sockaddr_in6 incoming_addr;
-	char incoming_addr_str[INET6_ADDRSTRLEN];
-
 	HTTP_Worker_Add_Client_Parameters add_client_params;
+	add_client_params.client_sock = client_sock;
+	add_client_params.remote_addr = incoming_addr;
 	add_client_params.https = params.https;
-	add_client_params.server_addr = SERVER_CONFIGURATION["ip_addr"].c_str();
+	add_client_params.server_addr = params.server_addr;
 	add_client_params.server_port = params.http_listener_port;
 
 	#ifndef DISABLE_HTTPS
 	add_client_params.openssl_ctx = params.openssl_ctx;
 	#endif
 
+	//a connection was accepted, the descriptors are available again
+	params.accept_backoff_ms = 0;
+
+	//the limit is for the whole server, a worker filled by the reuseport hash does not refuse the clients alone
+	if (HTTP_Workers_Total_Clients() >= params.max_connections)
+	{	
+		SERVER_ERROR_LOG_conn_exceeded();
+		close(add_client_params.client_sock);
+		return 0;
+	}
+
+	int worker_id = (params.worker_id == -1) ? HTTP_Worker_Select() : params.worker_id;
+
+	if (params.resize_recv_kernel_buffer)
+	{
+		if (setsockopt(add_client_params.client_sock, SOL_SOCKET, SO_RCVBUF, &params.recv_kernel_buffer_size, sizeof(socklen_t)) == -1)
+		{
+			SERVER_ERROR_LOG_stdlib_err("Unable to adjust client socket SO_RCVBUF!");
+		}
+	}
+
+	if (params.resize_send_kernel_buffer)
+	{
+		if (setsockopt(add_client_params.client_sock, SOL_SOCKET, SO_SNDBUF, &params.send_kernel_buffer_size, sizeof(socklen_t)) == -1)
+		{
+			SERVER_ERROR_LOG_stdlib_err("Unable to adjust client socket SO_SNDBUF!");
+		}
+	}
+
+	if (params.worker_id == -1)
+	{
+		HTTP_Worker_Add_Client(worker_id, add_client_params);
+	}
+	else
+	{
+		http_workers_load[worker_id].connections++;
+		http_workers_load[worker_id].clients++;
+		HTTP_Worker_Insert_Client(worker_id, add_client_params);
+	}
+
+	return 0;
+}
+
+static uint64_t listener_milliseconds()
+{
+	struct timespec current_time;
+	if (clock_gettime(CLOCK_MONOTONIC, &current_time) == -1)
+	{
+		SERVER_ERROR_LOG_stdlib_err("Unable to get time!");
+		exit(-1);
+	}
+
+	return (uint64_t)current_time.tv_sec * 1000 + current_time.tv_nsec / 1000000;
+}
+
+bool handle_accept_error(accept_new_client_func_parameters& params, int error)
+{
+	switch (error)
+	{
+		//the client is gone or the network failed before the accept, linux reports these errors on the listener too
+		case ECONNABORTED:
+		case EPROTO:
+		case EPERM:
+		case ETIMEDOUT:
+		case ENETDOWN:
+		case ENETUNREACH:
+		case ENONET:
+		case EHOSTDOWN:
+		case EHOSTUNREACH:
+		case ENOPROTOOPT:
+		case EOPNOTSUPP:
+			return true;
+
+		default:
+			break;
+	}
+
+	//EMFILE, ENFILE, ENOBUFS and ENOMEM go away once connections are closed, the waiting clients stay in the backlog
+	if (params.accept_backoff_ms == 0)
+	{
+		errno = error;
+		SERVER_ERROR_LOG_stdlib_err("Unable to accept the incoming connection, the accepts are paused!");
+
+		params.accept_backoff_ms = SERVER_LISTENER_ACCEPT_BACKOFF_MIN_MS;
+	}
+	else if (params.accept_backoff_ms < SERVER_LISTENER_ACCEPT_BACKOFF_MAX_MS)
+	{
+		params.accept_backoff_ms = std::min(params.accept_backoff_ms * 2, (unsigned int)SERVER_LISTENER_ACCEPT_BACKOFF_MAX_MS);
+	}
+
+	params.accept_resume_ms = listener_milliseconds() + params.accept_backoff_ms;
+	return false;
+}
+
+bool accept_backoff_expired(accept_new_client_func_parameters& params, uint64_t current_ms)
+{
+	if (params.accept_resume_ms == 0 or current_ms < params.accept_resume_ms)
+	{
+		return false;
+	}
+
+	params.accept_resume_ms = 0;
+	return true;
+}
+
+int accept_new_client(accept_new_client_func_parameters& params)
+{
+	struct sockaddr_in6 incoming_addr;
+
 	bool should_stop = false;
 	while (!should_stop)
 	{
-		add_client_params.client_sock = accept(params.http_listener, (struct sockaddr*) &incoming_addr, &params.incoming_addr_size);
+		socklen_t incoming_addr_size = params.incoming_addr_size;
+		int client_sock = accept4(params.http_listener, (struct sockaddr*) &incoming_addr, &incoming_addr_size, SOCK_NONBLOCK);
 
-		if (add_client_params.client_sock == -1)
+		if (client_sock == -1)
 		{
 			if (errno == EINTR)
 			{
@@ -216,80 +318,31 @@ int accept_new_client(accept_new_client_func_parameters& params)
 				continue;
 			}
 
-			SERVER_ERROR_LOG_stdlib_err("Unable to accept the incoming connection!");
-
-			if (errno == EMFILE or errno == ENFILE)
+			//the edge triggered listener is not reported again for the clients left in the backlog, the caller retries after the backoff
+			if (!handle_accept_error(params, errno))
 			{
-				continue;
+				should_stop = true;
 			}
 
-			return -1;
-		}
-		
-		if (total_http_connections >= params.max_connections)
-		{	
-			SERVER_ERROR_LOG_conn_exceeded();
-			close(add_client_params.client_sock);
 			continue;
 		}
 
-		total_http_connections++;
-
-		if (set_socket_nonblock(add_client_params.client_sock) == -1)
+		if (setup_new_client(params, client_sock, incoming_addr) == -1)
 		{
-			SERVER_ERROR_LOG_stdlib_err("Unable to put the http client in nonblocking mode!");
 			return -1;
 		}
-
-		struct sockaddr_in *incoming_addr4 = (sockaddr_in*) &incoming_addr;
-
-		const char* ip2text_result = NULL;
-
-		if(incoming_addr.sin6_family == AF_INET6)
-		{
-			ip2text_result = inet_ntop(AF_INET6, (const void*) &incoming_addr.sin6_addr, incoming_addr_str, sizeof(incoming_addr_str));
-		}
-		else
-		{
-			ip2text_result = inet_ntop(AF_INET, (const void*) &incoming_addr4->sin_addr, incoming_addr_str, sizeof(incoming_addr_str));
-		}
-
-		if (ip2text_result == NULL)
-		{
-			SERVER_ERROR_LOG_stdlib_err("Unable to read the remote socket address!");
-			return -1;
-		}
-
-		add_client_params.remote_addr = incoming_addr_str;
-		add_client_params.remote_port = endian_conv_ntoh16(incoming_addr.sin6_port);
-		add_client_params.ip_addr_version = incoming_addr.sin6_family;
-
-		if (params.resize_recv_kernel_buffer)
-		{
-			if (setsockopt(add_client_params.client_sock, SOL_SOCKET, SO_RCVBUF, &params.recv_kernel_buffer_size, sizeof(socklen_t)) == -1)
-			{
-				SERVER_ERROR_LOG_stdlib_err("Unable to adjust client socket SO_RCVBUF!");
-			}
-		}
-
-		if (params.resize_send_kernel_buffer)
-		{
-			if (setsockopt(add_client_params.client_sock, SOL_SOCKET, SO_SNDBUF, &params.send_kernel_buffer_size, sizeof(socklen_t)) == -1)
-			{
-				SERVER_ERROR_LOG_stdlib_err("Unable to adjust client socket SO_SNDBUF!");
-			}
-		}
-
-		HTTP_Worker_Add_Client(add_client_params);
 	}
 
 	return 0;
 }
 
-int run_server_listener_loop(server_listener_parameters& params)
+void init_accept_new_client_parameters(server_listener_parameters& params, accept_new_client_func_parameters& accept_client_params, int worker_id)
 {
-	accept_new_client_func_parameters accept_client_params;
 	accept_client_params.http_listener = params.http_listener;
+	//a reload rebuilds SERVER_CONFIGURATION, the queued clients keep pointing to this copy
+	static const std::string listener_addr = SERVER_CONFIGURATION["ip_addr"];
+	accept_client_params.server_addr = listener_addr.c_str();
+	accept_client_params.worker_id = worker_id;
 
 	accept_client_params.max_connections = str2uint(&SERVER_CONFIGURATION["max_connections"]);
 	accept_client_params.incoming_addr_size = (SERVER_CONFIGURATION["ip_version"] == "6") ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in);
@@ -304,6 +357,8 @@ int run_server_listener_loop(server_listener_parameters& params)
 	}
 
 	accept_client_params.https = params.https;
+	accept_client_params.accept_resume_ms = 0;
+	accept_client_params.accept_backoff_ms = 0;
 
 	#ifndef DISABLE_HTTPS
 	accept_client_params.openssl_ctx = params.openssl_ctx;
@@ -328,13 +383,31 @@ int run_server_listener_loop(server_listener_parameters& params)
 		accept_client_params.send_kernel_buffer_size = 1024 * str2uint(&SERVER_CONFIGURATION["send_kernel_buffer_size"]);
 		accept_client_params.resize_send_kernel_buffer = true;
 	}
+}
+
+static std::atomic<size_t> ready_server_listeners(0);
+
+size_t server_listeners_ready()
+{
+	return ready_server_listeners.load();
+}
+
+int run_server_listener_loop(server_listener_parameters& params)
+{
+	accept_new_client_func_parameters accept_client_params;
+	init_accept_new_client_parameters(params, accept_client_params);
+
+	//the https listeners read the certificate paths before, a reload may change SERVER_CONFIGURATION from now on
+	ready_server_listeners++;
 
 	struct epoll_event triggered_event;
 	memset(&triggered_event, 0, sizeof(triggered_event)); //to suppress valgrind warnings
 	
 	while(true)
 	{
-		int epoll_result = epoll_wait(params.server_epoll, &triggered_event, 1, -1);
+		//woken up for the retry of the paused accepts
+		int epoll_timeout = (accept_client_params.accept_resume_ms != 0) ? accept_client_params.accept_backoff_ms : -1;
+		int epoll_result = epoll_wait(params.server_epoll, &triggered_event, 1, epoll_timeout);
 
 		if(epoll_result == -1)
 		{
@@ -345,13 +418,22 @@ int run_server_listener_loop(server_listener_parameters& params)
 			}
 		}
 
-		else if(epoll_result > 0)
+		else if(accept_backoff_expired(accept_client_params, listener_milliseconds()))
+		{
+			if(accept_new_client(accept_client_params) == -1)
+			{
+				return -1;
+			}
+		}
+
+		if(epoll_result > 0)
 		{
 			if(triggered_event.data.fd == params.http_listener)
 			{
 				if(triggered_event.events & EPOLLIN)
 				{
-					if(accept_new_client(accept_client_params) == -1)
+					//a new client does not end the backoff, the paused accepts are retried above
+					if(accept_client_params.accept_resume_ms == 0 and accept_new_client(accept_client_params) == -1)
 					{
 						return -1;
 					}
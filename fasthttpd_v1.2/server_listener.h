@@ -1,10 +1,20 @@
 #ifndef __server_listener_API_incl__
 #define __server_listener_API_incl__
 
+#include <cstdint>
+#include <cstddef>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+
 #ifndef DISABLE_HTTPS
 #include <openssl/ssl.h>
 #endif
 
+//the accepts stopped by running out of descriptors or memory are retried after this wait, it doubles up to the max while it lasts
+#define SERVER_LISTENER_ACCEPT_BACKOFF_MIN_MS 10
+#define SERVER_LISTENER_ACCEPT_BACKOFF_MAX_MS 1000
+
 int init_server_listener_socket(bool https = false);
 int init_server_listener_epoll(int listener_socket,int close_trigger);
 
@@ -19,6 +29,51 @@ typedef struct
 	#endif
 } server_listener_parameters;
 
+typedef struct 
+{
+	int http_listener;
+	uint16_t http_listener_port;
+	const char* server_addr;
+
+	socklen_t incoming_addr_size;
+
+	//compared with the sum of the client counters of the workers, each one on its own cache line
+	int max_connections;
+
+	bool resize_recv_kernel_buffer;
+	socklen_t recv_kernel_buffer_size;
+
+	bool resize_send_kernel_buffer;
+	socklen_t send_kernel_buffer_size;
+
+	bool https;
+
+	//CLOCK_MONOTONIC milliseconds when the paused accepts are retried, 0 while accepting
+	uint64_t accept_resume_ms;
+	unsigned int accept_backoff_ms;
+
+	//the worker that owns the listener, -1 if the load balancer picks one
+	int worker_id;
+
+	#ifndef DISABLE_HTTPS
+	SSL_CTX* openssl_ctx;
+	#endif
+
+} accept_new_client_func_parameters;
+
+void init_accept_new_client_parameters(server_listener_parameters& params, accept_new_client_func_parameters& accept_client_params, int worker_id = -1);
+//the client socket is accepted nonblocking, incoming_addr is the peer address reported by the accept
+int setup_new_client(accept_new_client_func_parameters& params, int client_sock, struct sockaddr_in6& incoming_addr);
+int accept_new_client(accept_new_client_func_parameters& params);
+
+//true if the error belongs to a single connection and the next one can be accepted, otherwise the accepts are paused
+bool handle_accept_error(accept_new_client_func_parameters& params, int error);
+
+//true once the paused accepts should be retried, the listener is accepting again from then on
+bool accept_backoff_expired(accept_new_client_func_parameters& params, uint64_t current_ms);
 int run_server_listener_loop(server_listener_parameters& params);
 
+//the listener threads that stopped reading SERVER_CONFIGURATION, a reload waits for all of them
+size_t server_listeners_ready();
+
 #endif
@@ -12,12 +12,13 @@
 
 #include "server_log.h"
 #include "helper_functions.h"
+#include "http_worker/http_parser.h"
 
 bool SERVER_LOG_DISABLED = false;
 bool SERVER_LOG_LOCALTIME_REPORTING = false;
 
-std::mutex SERVER_LOG_WRITE_NORMAL;
-std::mutex SERVER_LOG_WRITE_ERROR;
+std::recursive_mutex SERVER_LOG_WRITE_NORMAL;
+std::recursive_mutex SERVER_LOG_WRITE_ERROR;
 
 std::ofstream error_file_stream;
 std::ofstream info_file_stream;
@@ -159,6 +160,20 @@ void SERVER_ERROR_LOG_conn_exceeded()
 	SERVER_LOG_WRITE_ERROR.unlock();
 }
 
+void SERVER_ERROR_LOG_client_queue_full()
+{
+	if (SERVER_LOG_DISABLED)
+	{
+		return;
+	}
+
+	SERVER_LOG_WRITE_ERROR.lock();
+	SERVER_LOG_WRITE(SERVER_LOG_strtime(SERVER_LOG_LOCALTIME_REPORTING), true);
+	SERVER_LOG_WRITE(" Unable to accept the new connection!\n", true);
+	SERVER_LOG_WRITE("The http worker client queue is full, the connection is dropped!\n\n", true);
+	SERVER_LOG_WRITE_ERROR.unlock();
+}
+
 /*
 FORMAT:
 [time] PROCESSED_REQUEST: hostname:port client_ip:port protocol_version request_method "URI_path" http_status "user_agent"
@@ -192,10 +207,10 @@ void SERVER_LOG_REQUEST(struct GENERIC_HTTP_CONNECTION *conn, const uint32_t str
 	SERVER_LOG_WRITE(SERVER_LOG_strtime(SERVER_LOG_LOCALTIME_REPORTING));
 	SERVER_LOG_WRITE(" HTTP REQUEST PROCESSED: ");
 
-	auto hostname_it = http_request->headers.find("host");
-	if (hostname_it != http_request->headers.end())
+	std::string hostname;
+	if (HTTP_Request_Get_Header(http_request, "host", &hostname))
 	{
-		SERVER_LOG_WRITE(hostname_it->second);
+		SERVER_LOG_WRITE(hostname);
 	}
 	else
 	{
@@ -302,10 +317,10 @@ void SERVER_LOG_REQUEST(struct GENERIC_HTTP_CONNECTION *conn, const uint32_t str
 	SERVER_LOG_WRITE(http_response->code);
 	SERVER_LOG_WRITE(" \"");
 
-	auto UA_it = http_request->headers.find("user-agent");
-	if (UA_it != http_request->headers.end())
+	std::string user_agent;
+	if (HTTP_Request_Get_Header(http_request, "user-agent", &user_agent))
 	{
-		SERVER_LOG_WRITE(UA_it->second);
+		SERVER_LOG_WRITE(user_agent);
 	}
 	else
 	{
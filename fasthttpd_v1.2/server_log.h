@@ -8,8 +8,9 @@
 extern bool SERVER_LOG_DISABLED;
 extern bool SERVER_LOG_LOCALTIME_REPORTING;
 
-extern std::mutex SERVER_LOG_WRITE_NORMAL;
-extern std::mutex SERVER_LOG_WRITE_ERROR;
+//recursive, a configuration reload holds both while the loaders write to the log
+extern std::recursive_mutex SERVER_LOG_WRITE_NORMAL;
+extern std::recursive_mutex SERVER_LOG_WRITE_ERROR;
 
 void SERVER_LOG_INIT(const char* info_file,const char* error_file);
 std::string SERVER_LOG_strtime(bool local);
@@ -42,6 +43,7 @@ void SERVER_ERROR_LOG_openssl_err(const char* s);
 #endif
 
 void SERVER_ERROR_LOG_conn_exceeded();
+void SERVER_ERROR_LOG_client_queue_full();
 void SERVER_LOG_REQUEST(struct GENERIC_HTTP_CONNECTION *conn, const uint32_t stream_id);
 
 #endif
@@ -0,0 +1,293 @@
+#include "server_upgrade.h"
+#include "helper_functions.h"
+#include "server_log.h"
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <errno.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+#include <netinet/in.h>
+
+extern char** environ;
+
+//only used by the main thread
+static std::vector<int> inherited_listeners;
+static std::vector<int> server_upgrade_listeners;
+static int server_upgrade_ready_fd = -1;
+static pid_t server_upgrade_pid = -1;
+
+static int Server_Upgrade_Parse_Fd(const std::string& value)
+{
+	bool invalid_chars;
+	uint64_t fd = str2uint(value, &invalid_chars);
+
+	if (value.empty() or invalid_chars or fd < 3 or fd > INT32_MAX)
+	{
+		return -1;
+	}
+
+	return fd;
+}
+
+void Server_Upgrade_Load_Inherited_Listeners()
+{
+	const char* listeners_env = getenv(SERVER_UPGRADE_LISTENERS_ENV);
+	if (listeners_env)
+	{
+		std::string listeners_list = listeners_env;
+		std::vector<std::string> listeners;
+		explode(&listeners_list, ",", &listeners);
+
+		for (size_t i = 0; i < listeners.size(); i++)
+		{
+			int listener = Server_Upgrade_Parse_Fd(listeners[i]);
+
+			//only the sockets still in listening state are used
+			int is_listening = 0;
+			socklen_t option_size = sizeof(is_listening);
+			if (listener == -1 or getsockopt(listener, SOL_SOCKET, SO_ACCEPTCONN, &is_listening, &option_size) == -1 or !is_listening)
+			{
+				continue;
+			}
+
+			inherited_listeners.push_back(listener);
+		}
+	}
+
+	const char* ready_fd_env = getenv(SERVER_UPGRADE_READY_FD_ENV);
+	if (ready_fd_env)
+	{
+		server_upgrade_ready_fd = Server_Upgrade_Parse_Fd(ready_fd_env);
+		if (server_upgrade_ready_fd != -1)
+		{
+			fcntl(server_upgrade_ready_fd, F_SETFD, FD_CLOEXEC);
+		}
+	}
+
+	//the next upgrade builds its own list
+	unsetenv(SERVER_UPGRADE_LISTENERS_ENV);
+	unsetenv(SERVER_UPGRADE_READY_FD_ENV);
+}
+
+int Server_Upgrade_Take_Listener(const struct sockaddr* addr, socklen_t addr_size)
+{
+	for (size_t i = 0; i < inherited_listeners.size(); i++)
+	{
+		struct sockaddr_in6 bound_addr;
+		socklen_t bound_addr_size = sizeof(bound_addr);
+		memset(&bound_addr, 0, sizeof(bound_addr));
+
+		if (getsockname(inherited_listeners[i], (struct sockaddr*) &bound_addr, &bound_addr_size) == -1 or bound_addr_size != addr_size)
+		{
+			continue;
+		}
+
+		bool is_same_addr;
+		if (addr->sa_family == AF_INET6)
+		{
+			const struct sockaddr_in6* addr6 = (const struct sockaddr_in6*) addr;
+			is_same_addr = bound_addr.sin6_family == AF_INET6 and bound_addr.sin6_port == addr6->sin6_port and memcmp(&bound_addr.sin6_addr, &addr6->sin6_addr, sizeof(addr6->sin6_addr)) == 0;
+		}
+		else
+		{
+			const struct sockaddr_in* addr4 = (const struct sockaddr_in*) addr;
+			const struct sockaddr_in* bound_addr4 = (const struct sockaddr_in*) &bound_addr;
+			is_same_addr = bound_addr4->sin_family == AF_INET and bound_addr4->sin_port == addr4->sin_port and bound_addr4->sin_addr.s_addr == addr4->sin_addr.s_addr;
+		}
+
+		if (is_same_addr)
+		{
+			int listener = inherited_listeners[i];
+			inherited_listeners.erase(inherited_listeners.begin() + i);
+			return listener;
+		}
+	}
+
+	return -1;
+}
+
+void Server_Upgrade_Register_Listener(int listener)
+{
+	server_upgrade_listeners.push_back(listener);
+}
+
+void Server_Upgrade_Notify_Ready()
+{
+	//the kernel would keep queueing connections on them
+	for (size_t i = 0; i < inherited_listeners.size(); i++)
+	{
+		close(inherited_listeners[i]);
+	}
+
+	inherited_listeners.clear();
+
+	if (server_upgrade_ready_fd == -1)
+	{
+		return;
+	}
+
+	char ready = 1;
+	if (write(server_upgrade_ready_fd, &ready, 1) != 1)
+	{
+		SERVER_ERROR_LOG_stdlib_err("Unable to notify the previous server!");
+	}
+
+	close(server_upgrade_ready_fd);
+	server_upgrade_ready_fd = -1;
+}
+
+//runs between fork and exec, only async signal safe calls
+static void Server_Upgrade_Close_Fds(const std::vector<int>& kept_fds, int max_fd)
+{
+	int first_fd = 3;
+	for (size_t i = 0; i <= kept_fds.size(); i++)
+	{
+		int last_fd = (i < kept_fds.size()) ? kept_fds[i] - 1 : max_fd;
+
+		if (first_fd <= last_fd)
+		{
+			#ifdef SYS_close_range
+			if (syscall(SYS_close_range, first_fd, last_fd, 0) == 0)
+			{
+				first_fd = last_fd + 2;
+				continue;
+			}
+			#endif
+
+			for (int fd = first_fd; fd <= last_fd; fd++)
+			{
+				close(fd);
+			}
+		}
+
+		first_fd = last_fd + 2;
+	}
+}
+
+int Server_Upgrade_Spawn(char** argv)
+{
+	int ready_pipe[2];
+	if (pipe2(ready_pipe, O_CLOEXEC) == -1)
+	{
+		SERVER_ERROR_LOG_stdlib_err("Unable to create the upgrade pipe!");
+		return -1;
+	}
+
+	//everything the child needs is prepared before the fork
+	std::string listeners_list;
+	for (size_t i = 0; i < server_upgrade_listeners.size(); i++)
+	{
+		if (i != 0)
+		{
+			listeners_list.append(1, ',');
+		}
+
+		listeners_list.append(int2str(server_upgrade_listeners[i]));
+	}
+
+	std::vector<std::string> env_strings;
+	for (char** env = environ; *env != NULL; env++)
+	{
+		env_strings.push_back(*env);
+	}
+
+	env_strings.push_back(std::string(SERVER_UPGRADE_LISTENERS_ENV) + "=" + listeners_list);
+	env_strings.push_back(std::string(SERVER_UPGRADE_READY_FD_ENV) + "=" + int2str(ready_pipe[1]));
+
+	std::vector<char*> envp;
+	for (size_t i = 0; i < env_strings.size(); i++)
+	{
+		envp.push_back((char*) env_strings[i].c_str());
+	}
+
+	envp.push_back(NULL);
+
+	std::vector<int> kept_fds = server_upgrade_listeners;
+	kept_fds.push_back(ready_pipe[1]);
+	std::sort(kept_fds.begin(), kept_fds.end());
+
+	long max_fd = sysconf(_SC_OPEN_MAX);
+	if (max_fd <= 0 or max_fd > INT32_MAX)
+	{
+		max_fd = 1024;
+	}
+
+	pid_t pid = fork();
+	if (pid == -1)
+	{
+		SERVER_ERROR_LOG_stdlib_err("Unable to fork the upgraded server!");
+		close(ready_pipe[0]);
+		close(ready_pipe[1]);
+		return -1;
+	}
+
+	if (pid == 0)
+	{
+		//the client sockets must not outlive this server
+		Server_Upgrade_Close_Fds(kept_fds, max_fd - 1);
+
+		fcntl(ready_pipe[1], F_SETFD, 0);
+		for (size_t i = 0; i < server_upgrade_listeners.size(); i++)
+		{
+			fcntl(server_upgrade_listeners[i], F_SETFD, 0);
+		}
+
+		execvpe(argv[0], argv, envp.data());
+		_exit(127);
+	}
+
+	close(ready_pipe[1]);
+	server_upgrade_pid = pid;
+
+	SERVER_LOG_WRITE_NORMAL.lock();
+	SERVER_LOG_WRITE(SERVER_LOG_strtime(SERVER_LOG_LOCALTIME_REPORTING));
+	SERVER_LOG_WRITE(" Starting the upgraded server!\nPid: ");
+	SERVER_LOG_WRITE(pid);
+	SERVER_LOG_WRITE("\n\n");
+	SERVER_LOG_WRITE_NORMAL.unlock();
+
+	return ready_pipe[0];
+}
+
+bool Server_Upgrade_Finish(int ready_fd)
+{
+	char ready = 0;
+	ssize_t read_bytes;
+	do
+	{
+		read_bytes = read(ready_fd, &ready, 1);
+	} while (read_bytes == -1 and errno == EINTR);
+
+	close(ready_fd);
+
+	if (read_bytes == 1)
+	{
+		SERVER_LOG_WRITE_NORMAL.lock();
+		SERVER_LOG_WRITE(SERVER_LOG_strtime(SERVER_LOG_LOCALTIME_REPORTING));
+		SERVER_LOG_WRITE(" The upgraded server is ready!\n\n");
+		SERVER_LOG_WRITE_NORMAL.unlock();
+
+		return true;
+	}
+
+	//the pipe is closed without a byte when the new server exits
+	if (server_upgrade_pid != -1)
+	{
+		waitpid(server_upgrade_pid, NULL, 0);
+		server_upgrade_pid = -1;
+	}
+
+	SERVER_LOG_WRITE_ERROR.lock();
+	SERVER_LOG_WRITE(SERVER_LOG_strtime(SERVER_LOG_LOCALTIME_REPORTING), true);
+	SERVER_LOG_WRITE(" The upgraded server failed to start!\nThe server keeps running!\n\n", true);
+	SERVER_LOG_WRITE_ERROR.unlock();
+
+	return false;
+}
@@ -0,0 +1,36 @@
+#ifndef __server_upgrade_incl__
+#define __server_upgrade_incl__
+
+#include <sys/types.h>
+#include <sys/socket.h>
+
+/*
+binary upgrade: the running server execs the new binary with its listening sockets inherited,
+the descriptors are listed in FASTHTTPD_UPGRADE_LISTENERS,
+the new server writes a byte to FASTHTTPD_UPGRADE_READY_FD once it accepts on them
+*/
+#define SERVER_UPGRADE_LISTENERS_ENV "FASTHTTPD_UPGRADE_LISTENERS"
+#define SERVER_UPGRADE_READY_FD_ENV "FASTHTTPD_UPGRADE_READY_FD"
+
+//reads the environment of a server started by an upgrade
+void Server_Upgrade_Load_Inherited_Listeners();
+
+//an inherited listener bound to the address, -1 if there is none
+int Server_Upgrade_Take_Listener(const struct sockaddr* addr, socklen_t addr_size);
+
+//the listeners handed over to the next binary
+void Server_Upgrade_Register_Listener(int listener);
+
+//closes the inherited listeners that the configuration does not use anymore and tells the previous server to stop
+void Server_Upgrade_Notify_Ready();
+
+/*
+starts the binary found at argv[0] with the same arguments,
+returns the descriptor that becomes readable when it is ready or exits, -1 on error
+*/
+int Server_Upgrade_Spawn(char** argv);
+
+//true if the spawned server reported it is ready, false if it exited
+bool Server_Upgrade_Finish(int ready_fd);
+
+#endif
@@ -0,0 +1,332 @@
+#include "simd_scan.h"
+
+#include <cstring>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SIMD_SCAN_X86
+#include <immintrin.h>
+#endif
+
+
+static size_t SIMD_Scan_Any_Scalar(const char* data, size_t len, const char* set, size_t set_len)
+{
+	bool is_delimiter[256];
+	memset(is_delimiter, 0, sizeof(is_delimiter));
+
+	for (size_t i = 0; i < set_len; i++)
+	{
+		is_delimiter[(unsigned char)set[i]] = true;
+	}
+
+	for (size_t i = 0; i < len; i++)
+	{
+		if (is_delimiter[(unsigned char)data[i]])
+		{
+			return i;
+		}
+	}
+
+	return len;
+}
+
+static size_t SIMD_Find_Substring_Scalar(const char* data, size_t len, const char* needle, size_t needle_len)
+{
+	const char* result = (const char*)memmem(data, len, needle, needle_len);
+	if (!result)
+	{
+		return len;
+	}
+
+	return result - data;
+}
+
+//CRC-32C of one byte, the bitwise form of the crc32 instruction
+static uint32_t SIMD_Hash_CRC32C_Byte(uint32_t crc, uint8_t byte)
+{
+	crc ^= byte;
+	for (int i = 0; i < 8; i++)
+	{
+		crc = (crc >> 1) ^ (0x82F63B78 & (0 - (crc & 1)));
+	}
+
+	return crc;
+}
+
+static uint32_t SIMD_Hash_CRC32C_Word(uint32_t crc, uint64_t word)
+{
+	for (int i = 0; i < 8; i++)
+	{
+		crc = SIMD_Hash_CRC32C_Byte(crc, (uint8_t)(word >> (i * 8)));
+	}
+
+	return crc;
+}
+
+/*
+The even and the odd 8 byte words are hashed in two CRC-32C lanes, the halves of the hash.
+A single CRC would have only 32 bits, two lanes over the same words would not add any.
+*/
+static uint64_t SIMD_Hash_Scalar(const char* data, size_t len)
+{
+	uint32_t even_lane = 0xFFFFFFFF ^ (uint32_t)len;
+	uint32_t odd_lane = 0xFFFFFFFF;
+
+	size_t i = 0;
+	for (; i + 16 <= len; i += 16)
+	{
+		uint64_t even_word, odd_word;
+		memcpy(&even_word, data + i, 8);
+		memcpy(&odd_word, data + i + 8, 8);
+
+		even_lane = SIMD_Hash_CRC32C_Word(even_lane, even_word);
+		odd_lane = SIMD_Hash_CRC32C_Word(odd_lane, odd_word);
+	}
+
+	for (; i < len; i++)
+	{
+		odd_lane = SIMD_Hash_CRC32C_Byte(odd_lane, data[i]);
+	}
+
+	return ((uint64_t)~even_lane << 32) | (uint32_t)~odd_lane;
+}
+
+#ifdef SIMD_SCAN_X86
+
+#ifdef __x86_64__
+//the two lanes hide the latency of the crc32 instruction
+__attribute__((target("sse4.2")))
+static uint64_t SIMD_Hash_SSE42(const char* data, size_t len)
+{
+	uint64_t even_lane = 0xFFFFFFFF ^ (uint32_t)len;
+	uint64_t odd_lane = 0xFFFFFFFF;
+
+	size_t i = 0;
+	for (; i + 16 <= len; i += 16)
+	{
+		uint64_t even_word, odd_word;
+		memcpy(&even_word, data + i, 8);
+		memcpy(&odd_word, data + i + 8, 8);
+
+		even_lane = _mm_crc32_u64(even_lane, even_word);
+		odd_lane = _mm_crc32_u64(odd_lane, odd_word);
+	}
+
+	for (; i < len; i++)
+	{
+		odd_lane = _mm_crc32_u8((uint32_t)odd_lane, data[i]);
+	}
+
+	return ((uint64_t)~(uint32_t)even_lane << 32) | (uint32_t)~(uint32_t)odd_lane;
+}
+#endif
+
+__attribute__((target("sse4.2")))
+static size_t SIMD_Scan_Any_SSE42(const char* data, size_t len, const char* set, size_t set_len)
+{
+	if (set_len > 16)
+	{
+		return SIMD_Scan_Any_Scalar(data, len, set, set_len);
+	}
+
+	char set_buffer[16];
+	memset(set_buffer, 0, sizeof(set_buffer));
+	memcpy(set_buffer, set, set_len);
+
+	const __m128i set_vector = _mm_loadu_si128((const __m128i*)set_buffer);
+
+	size_t i = 0;
+	for (; i + 16 <= len; i += 16)
+	{
+		__m128i block = _mm_loadu_si128((const __m128i*)(data + i));
+
+		int index = _mm_cmpestri(set_vector, set_len, block, 16, _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_LEAST_SIGNIFICANT);
+		if (index < 16)
+		{
+			return i + index;
+		}
+	}
+
+	return i + SIMD_Scan_Any_Scalar(data + i, len - i, set, set_len);
+}
+
+__attribute__((target("avx2")))
+static size_t SIMD_Scan_Any_AVX2(const char* data, size_t len, const char* set, size_t set_len)
+{
+	//nothing can match an empty set, like the other implementations
+	if (set_len == 0)
+	{
+		return len;
+	}
+
+	//one compare per character, pcmpestri is faster for bigger sets
+	if (set_len > 4)
+	{
+		return SIMD_Scan_Any_SSE42(data, len, set, set_len);
+	}
+
+	__m256i set_vectors[4];
+	for (size_t j = 0; j < set_len; j++)
+	{
+		set_vectors[j] = _mm256_set1_epi8(set[j]);
+	}
+
+	size_t i = 0;
+	for (; i + 32 <= len; i += 32)
+	{
+		__m256i block = _mm256_loadu_si256((const __m256i*)(data + i));
+
+		__m256i matches = _mm256_cmpeq_epi8(block, set_vectors[0]);
+		for (size_t j = 1; j < set_len; j++)
+		{
+			matches = _mm256_or_si256(matches, _mm256_cmpeq_epi8(block, set_vectors[j]));
+		}
+
+		uint32_t mask = _mm256_movemask_epi8(matches);
+		if (mask)
+		{
+			return i + __builtin_ctz(mask);
+		}
+	}
+
+	return i + SIMD_Scan_Any_Scalar(data + i, len - i, set, set_len);
+}
+
+/*
+The first and the last byte of the needle are compared for a whole block at once,
+only the positions where both match are verified with memcmp().
+This skips quickly over binary data, where the first byte alone matches too often.
+*/
+static size_t SIMD_Find_Substring_SSE2(const char* data, size_t len, const char* needle, size_t needle_len)
+{
+	const __m128i first = _mm_set1_epi8(needle[0]);
+	const __m128i last = _mm_set1_epi8(needle[needle_len - 1]);
+
+	size_t i = 0;
+	for (; i + needle_len - 1 + 16 <= len; i += 16)
+	{
+		__m128i block_first = _mm_loadu_si128((const __m128i*)(data + i));
+		__m128i block_last = _mm_loadu_si128((const __m128i*)(data + i + needle_len - 1));
+
+		uint32_t mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, block_first), _mm_cmpeq_epi8(last, block_last)));
+		while (mask)
+		{
+			unsigned int bit = __builtin_ctz(mask);
+			if (memcmp(data + i + bit + 1, needle + 1, needle_len - 2) == 0)
+			{
+				return i + bit;
+			}
+
+			mask &= mask - 1;
+		}
+	}
+
+	return i + SIMD_Find_Substring_Scalar(data + i, len - i, needle, needle_len);
+}
+
+__attribute__((target("avx2")))
+static size_t SIMD_Find_Substring_AVX2(const char* data, size_t len, const char* needle, size_t needle_len)
+{
+	const __m256i first = _mm256_set1_epi8(needle[0]);
+	const __m256i last = _mm256_set1_epi8(needle[needle_len - 1]);
+
+	size_t i = 0;
+	for (; i + needle_len - 1 + 32 <= len; i += 32)
+	{
+		__m256i block_first = _mm256_loadu_si256((const __m256i*)(data + i));
+		__m256i block_last = _mm256_loadu_si256((const __m256i*)(data + i + needle_len - 1));
+
+		uint32_t mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(first, block_first), _mm256_cmpeq_epi8(last, block_last)));
+		while (mask)
+		{
+			unsigned int bit = __builtin_ctz(mask);
+			if (memcmp(data + i + bit + 1, needle + 1, needle_len - 2) == 0)
+			{
+				return i + bit;
+			}
+
+			mask &= mask - 1;
+		}
+	}
+
+	return i + SIMD_Find_Substring_Scalar(data + i, len - i, needle, needle_len);
+}
+
+#endif
+
+static size_t (*SIMD_Scan_Any_Implementation)(const char*, size_t, const char*, size_t) = SIMD_Scan_Any_Scalar;
+static uint64_t (*SIMD_Hash_Implementation)(const char*, size_t) = SIMD_Hash_Scalar;
+
+#ifdef SIMD_SCAN_X86
+static size_t (*SIMD_Find_Substring_Implementation)(const char*, size_t, const char*, size_t) = SIMD_Find_Substring_SSE2; //SSE2 is always present on x86_64
+#else
+static size_t (*SIMD_Find_Substring_Implementation)(const char*, size_t, const char*, size_t) = SIMD_Find_Substring_Scalar;
+#endif
+
+void SIMD_Scan_Init()
+{
+	#ifdef SIMD_SCAN_X86
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx2"))
+	{
+		SIMD_Scan_Any_Implementation = SIMD_Scan_Any_AVX2;
+		SIMD_Find_Substring_Implementation = SIMD_Find_Substring_AVX2;
+	}
+	else if (__builtin_cpu_supports("sse4.2"))
+	{
+		SIMD_Scan_Any_Implementation = SIMD_Scan_Any_SSE42;
+	}
+
+	#ifdef __x86_64__
+	if (__builtin_cpu_supports("sse4.2"))
+	{
+		SIMD_Hash_Implementation = SIMD_Hash_SSE42;
+	}
+	#endif
+
+	#ifdef __i386__
+	if (!__builtin_cpu_supports("sse2"))
+	{
+		SIMD_Find_Substring_Implementation = SIMD_Find_Substring_Scalar;
+	}
+	#endif
+	#endif
+}
+
+size_t SIMD_Scan_Any(const char* data, size_t len, const char* set, size_t set_len)
+{
+	//memchr() is already vectorized by the C library
+	if (set_len == 1)
+	{
+		const char* result = (const char*)memchr(data, set[0], len);
+		return (result) ? (size_t)(result - data) : len;
+	}
+
+	return SIMD_Scan_Any_Implementation(data, len, set, set_len);
+}
+
+size_t SIMD_Find_Substring(const char* data, size_t len, const char* needle, size_t needle_len)
+{
+	if (needle_len == 0)
+	{
+		return 0;
+	}
+
+	if (needle_len > len)
+	{
+		return len;
+	}
+
+	if (needle_len == 1)
+	{
+		return SIMD_Scan_Any(data, len, needle, 1);
+	}
+
+	return SIMD_Find_Substring_Implementation(data, len, needle, needle_len);
+}
+
+uint64_t SIMD_Hash(const char* data, size_t len)
+{
+	return SIMD_Hash_Implementation(data, len);
+}
@@ -0,0 +1,19 @@
+#ifndef __simd_scan_incl__
+#define __simd_scan_incl__
+
+#include <cstddef>
+#include <cstdint>
+
+//selects the fastest implementation supported by the CPU, the scalar code is used until then
+void SIMD_Scan_Init();
+
+//offset of the first byte that is in set, len if there is none
+size_t SIMD_Scan_Any(const char* data, size_t len, const char* set, size_t set_len);
+
+//offset of the first occurrence of needle, len if there is none
+size_t SIMD_Find_Substring(const char* data, size_t len, const char* needle, size_t needle_len);
+
+//64 bit hash of the data for the ETags, the same value on every CPU, crc32 instructions are used when present
+uint64_t SIMD_Hash(const char* data, size_t len);
+
+#endif